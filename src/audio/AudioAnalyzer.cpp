@@ -7,6 +7,13 @@ namespace vc {
 
 namespace {
 
+constexpr f32 FEATURE_SMOOTHING = 2.0f;  // Seconds for features to settle
+constexpr f32 PEAK_DECAY = 0.98f;        // Per second, for energy
+constexpr f64 ONSET_WINDOW = 4.0;        // Seconds onsets are counted over
+constexpr f64 MIN_ONSET_GAP = 0.05;
+constexpr f64 MIN_BEAT_GAP = 0.25;       // 240 BPM
+constexpr usize TEMPO_INTERVALS = 8;     // Tempo is their median
+
 // Simple in-place Cooley-Tukey FFT
 void fft(std::vector<std::complex<f32>>& x) {
     const usize N = x.size();
@@ -49,6 +56,7 @@ AudioAnalyzer::AudioAnalyzer()
     , magnitudes_(SPECTRUM_SIZE)
     , pcmBuffer_(FFT_SIZE * 2)  // Stereo
     , energyHistory_(43)  // ~1 second at 43 fps
+    , previousMagnitudes_(SPECTRUM_SIZE)
 {
     // Generate Hann window
     for (usize i = 0; i < FFT_SIZE; ++i) {
@@ -61,6 +69,19 @@ void AudioAnalyzer::reset() {
     std::fill(energyHistory_.begin(), energyHistory_.end(), 0.0f);
     avgEnergy_ = 0.0f;
     energyHistoryPos_ = 0;
+
+    features_ = {};
+    clock_ = 0.0;
+    lastBeatTime_ = -1.0;
+    lastOnsetTime_ = -1.0;
+    wasBeat_ = false;
+    levelPeak_ = 0.0f;
+    fluxAverage_ = 0.0f;
+    std::fill(previousMagnitudes_.begin(), previousMagnitudes_.end(), 0.0f);
+    onsetTimes_.clear();
+    beatIntervals_.clear();
+    barAccent_.fill(0.0f);
+    downbeatPosition_ = 0;
 }
 
 AudioSpectrum AudioAnalyzer::analyze(std::span<const f32> samples, u32 sampleRate, u32 channels) {
@@ -109,6 +130,11 @@ AudioSpectrum AudioAnalyzer::analyze(std::span<const f32> samples, u32 sampleRat
     spectrum.beatIntensity = energy;
     spectrum.beatDetected = detectBeat(energy);
     
+    // Slow features for preset selection
+    f32 seconds = static_cast<f32>(samples.size() / channels) / static_cast<f32>(sampleRate);
+    updateFeatures((spectrum.leftLevel + spectrum.rightLevel) * 0.5f, energy, spectrum.beatDetected, seconds);
+    spectrum.features = features_;
+    
     return spectrum;
 }
 
@@ -144,4 +170,73 @@ f32 AudioAnalyzer::detectBeat(f32 currentEnergy) {
     return currentEnergy > avgEnergy_ * beatThreshold_;
 }
 
+void AudioAnalyzer::updateFeatures(f32 level, f32 beatEnergy, bool beat, f32 seconds) {
+    clock_ += seconds;
+    const f32 blend = std::min(1.0f, seconds / FEATURE_SMOOTHING);
+    auto smooth = [blend](f32& value, f32 target) { value += (target - value) * blend; };
+    
+    // Energy against a slowly decaying peak, so quiet tracks still have
+    // loud and soft passages
+    levelPeak_ = std::max(level, levelPeak_ * std::pow(PEAK_DECAY, seconds));
+    smooth(features_.energy, levelPeak_ > 1e-6f ? level / levelPeak_ : 0.0f);
+    
+    // Centroid and spectral flux from the unsmoothed magnitudes
+    f32 weighted = 0.0f, total = 0.0f, flux = 0.0f;
+    for (usize i = 1; i < SPECTRUM_SIZE; ++i) {
+        weighted += magnitudes_[i] * static_cast<f32>(i);
+        total += magnitudes_[i];
+        flux += std::max(0.0f, magnitudes_[i] - previousMagnitudes_[i]);
+    }
+    std::copy(magnitudes_.begin(), magnitudes_.end(), previousMagnitudes_.begin());
+    if (total > 1e-6f)
+        smooth(features_.spectralCentroid, weighted / total / static_cast<f32>(SPECTRUM_SIZE));
+    
+    // An onset is flux well above its running average
+    if (flux > fluxAverage_ * 1.5f && flux > 1e-4f
+        && (lastOnsetTime_ < 0.0 || clock_ - lastOnsetTime_ >= MIN_ONSET_GAP)) {
+        onsetTimes_.push_back(clock_);
+        lastOnsetTime_ = clock_;
+    }
+    fluxAverage_ += (flux - fluxAverage_) * 0.1f;
+    while (!onsetTimes_.empty() && clock_ - onsetTimes_.front() > ONSET_WINDOW)
+        onsetTimes_.pop_front();
+    smooth(features_.onsetDensity, static_cast<f32>(onsetTimes_.size() / ONSET_WINDOW));
+    
+    // Beats are rising edges of the energy detector
+    bool newBeat = beat && !wasBeat_
+                   && (lastBeatTime_ < 0.0 || clock_ - lastBeatTime_ >= MIN_BEAT_GAP);
+    wasBeat_ = beat;
+    if (!newBeat)
+        return;
+    
+    if (lastBeatTime_ >= 0.0) {
+        beatIntervals_.push_back(static_cast<f32>(clock_ - lastBeatTime_));
+        if (beatIntervals_.size() > TEMPO_INTERVALS)
+            beatIntervals_.pop_front();
+        std::array<f32, TEMPO_INTERVALS> sorted{};
+        auto end = std::copy(beatIntervals_.begin(), beatIntervals_.end(), sorted.begin());
+        auto middle = sorted.begin() + beatIntervals_.size() / 2;
+        std::nth_element(sorted.begin(), middle, end);
+        // Fold into one octave; the detector happily skips or doubles beats
+        f32 bpm = 60.0f / *middle;
+        while (bpm < 70.0f) bpm *= 2.0f;
+        while (bpm >= 180.0f) bpm *= 0.5f;
+        features_.tempo = features_.tempo > 0.0f ? features_.tempo + (bpm - features_.tempo) * 0.25f : bpm;
+    }
+    lastBeatTime_ = clock_;
+    
+    // The downbeat is whichever position in the bar has been hit hardest
+    // over the last few bars, decided once per bar so it can't flicker
+    const u32 position = static_cast<u32>(features_.beatCount % AudioFeatures::BEATS_PER_BAR);
+    if (position == 0) {
+        downbeatPosition_ = static_cast<u32>(std::max_element(barAccent_.begin(), barAccent_.end()) - barAccent_.begin());
+        for (f32& accent : barAccent_)
+            accent *= 0.8f;
+    }
+    barAccent_[position] += beatEnergy;
+    ++features_.beatCount;
+    if (position == downbeatPosition_)
+        ++features_.downbeatCount;
+}
+
 } // namespace vc
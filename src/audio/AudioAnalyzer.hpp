@@ -5,6 +5,7 @@
 #include "util/Types.hpp"
 #include <array>
 #include <complex>
+#include <deque>
 #include <vector>
 
 namespace vc {
@@ -13,6 +14,19 @@ namespace vc {
 constexpr usize FFT_SIZE = 2048;
 constexpr usize SPECTRUM_SIZE = FFT_SIZE / 2;
 
+// Slow-moving description of the music, for choosing presets rather than
+// drawing them. Smoothed over a couple of seconds; 0..1 unless noted.
+struct AudioFeatures {
+    static constexpr u32 BEATS_PER_BAR = 4;
+
+    f32 energy{0.0f};           // Loudness relative to the recent peak
+    f32 tempo{0.0f};            // BPM, 0 until a few beats have been seen
+    f32 onsetDensity{0.0f};     // Onsets per second (not normalised)
+    f32 spectralCentroid{0.0f}; // Spectral brightness, fraction of Nyquist
+    u64 beatCount{0};           // Beats since reset
+    u64 downbeatCount{0};       // Beats that started a bar
+};
+
 // Frequency band data for visualizer
 struct AudioSpectrum {
     std::array<f32, SPECTRUM_SIZE> magnitudes{};
@@ -20,6 +34,7 @@ struct AudioSpectrum {
     f32 rightLevel{0.0f};
     f32 beatIntensity{0.0f};
     bool beatDetected{false};
+    AudioFeatures features;
 };
 
 class AudioAnalyzer {
@@ -39,6 +54,7 @@ private:
     void performFFT(std::span<const f32> input);
     void applyWindow(std::span<f32> samples);
     f32 detectBeat(f32 currentEnergy);
+    void updateFeatures(f32 level, f32 beatEnergy, bool beat, f32 seconds);
     
     // FFT buffers
     std::vector<std::complex<f32>> fftBuffer_;
@@ -54,6 +70,20 @@ private:
     std::vector<f32> energyHistory_;
     usize energyHistoryPos_{0};
     
+    // Feature tracking (see AudioFeatures)
+    AudioFeatures features_;
+    f64 clock_{0.0};             // Seconds of audio analyzed
+    f64 lastBeatTime_{-1.0};
+    f64 lastOnsetTime_{-1.0};
+    bool wasBeat_{false};
+    f32 levelPeak_{0.0f};
+    f32 fluxAverage_{0.0f};
+    std::vector<f32> previousMagnitudes_;
+    std::deque<f64> onsetTimes_;     // Within ONSET_WINDOW
+    std::deque<f32> beatIntervals_;  // Most recent last
+    std::array<f32, AudioFeatures::BEATS_PER_BAR> barAccent_{}; // Per beat in bar
+    u32 downbeatPosition_{0};
+
     // Smoothing
     std::array<f32, SPECTRUM_SIZE> smoothedMagnitudes_{};
     f32 smoothingFactor_{0.3f};
@@ -1,6 +1,10 @@
 #include "FFmpegAudioSource.hpp"
 #include "core/Logger.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
 extern "C" {
 #include <libavformat/avformat.h>
 #include <libavcodec/avcodec.h>
@@ -27,6 +31,16 @@ struct FFmpegAudioSource::Private {
     
     bool isPlaying = false;
     bool isPaused = false;
+    
+    // read(): converted samples not handed out yet, reused across calls
+    std::vector<f32> pending;
+    usize pendingPos = 0;
+    bool draining = false; // Decoder flushed, emptying swresample
+    bool finished = false;
+    i64 seekTarget = -1;   // Output sample seek() wants read() to start at
+    
+    bool decodeMore();
+    void trimToSeekTarget(i64 pts);
 };
 
 FFmpegAudioSource::FFmpegAudioSource() 
@@ -141,6 +155,144 @@ bool FFmpegAudioSource::loadFile(const std::string& path) {
     return true;
 }
 
+bool FFmpegAudioSource::open(const std::string& path, int sampleRate) {
+    d->projectM = nullptr;
+    d->sampleRate = sampleRate;
+    return loadFile(path);
+}
+
+usize FFmpegAudioSource::read(f32* out, usize frames) {
+    usize done = 0;
+    while (done < frames) {
+        usize available = (d->pending.size() - d->pendingPos) / 2;
+        if (available > 0) {
+            usize count = std::min(available, frames - done);
+            std::memcpy(out + done * 2,
+                        d->pending.data() + d->pendingPos,
+                        count * 2 * sizeof(f32));
+            d->pendingPos += count * 2;
+            done += count;
+            continue;
+        }
+        d->pending.clear();
+        d->pendingPos = 0;
+        if (!d->decodeMore())
+            break;
+    }
+    return done;
+}
+
+bool FFmpegAudioSource::seek(f64 seconds) {
+    if (!d->formatCtx || !d->codecCtx)
+        return false;
+    
+    // Lands on the packet at or before the target; decodeMore() cuts the
+    // rest off the first frames it gets
+    auto* stream = d->formatCtx->streams[d->audioStreamIndex];
+    i64 target = av_rescale_q(static_cast<i64>(seconds * AV_TIME_BASE),
+                              AV_TIME_BASE_Q,
+                              stream->time_base);
+    if (av_seek_frame(d->formatCtx,
+                      d->audioStreamIndex,
+                      target,
+                      AVSEEK_FLAG_BACKWARD) < 0) {
+        LOG_WARN("Could not seek to {:.2f} s", seconds);
+        return false;
+    }
+    avcodec_flush_buffers(d->codecCtx);
+    swr_init(d->swrCtx); // Drops what it held from before the seek
+    
+    d->pending.clear();
+    d->pendingPos = 0;
+    d->draining = false;
+    d->finished = false;
+    d->seekTarget = std::llround(seconds * d->sampleRate);
+    return true;
+}
+
+f64 FFmpegAudioSource::durationSeconds() const {
+    if (!d->formatCtx || d->formatCtx->duration == AV_NOPTS_VALUE)
+        return 0.0;
+    return static_cast<f64>(d->formatCtx->duration) / AV_TIME_BASE;
+}
+
+// Converts the next decoded frame into `pending`. At the end of the file
+// the decoder and then swresample are flushed, so nothing is cut off.
+bool FFmpegAudioSource::Private::decodeMore() {
+    if (finished || !formatCtx || !codecCtx)
+        return false;
+    
+    for (;;) {
+        int ret = avcodec_receive_frame(codecCtx, frame);
+        if (ret == 0) {
+            i64 pts = frame->best_effort_timestamp;
+            pendingPos = 0;
+            int outSamples = swr_get_out_samples(swrCtx, frame->nb_samples);
+            pending.resize(static_cast<usize>(outSamples) * 2);
+            auto* outputPtr = reinterpret_cast<uint8_t*>(pending.data());
+            int converted = swr_convert(swrCtx, &outputPtr, outSamples,
+                                        (const uint8_t**)frame->data,
+                                        frame->nb_samples);
+            av_frame_unref(frame);
+            if (converted < 0) {
+                LOG_WARN("swr_convert failed: {}", converted);
+                converted = 0;
+            }
+            pending.resize(static_cast<usize>(converted) * 2);
+            if (seekTarget >= 0)
+                trimToSeekTarget(pts);
+            if (pendingPos < pending.size())
+                return true;
+            continue;
+        }
+        if (ret == AVERROR_EOF) {
+            // Whatever swresample still holds back
+            int outSamples = swr_get_out_samples(swrCtx, 0);
+            pending.resize(static_cast<usize>(std::max(outSamples, 0)) * 2);
+            auto* outputPtr = reinterpret_cast<uint8_t*>(pending.data());
+            int converted = outSamples > 0
+                    ? swr_convert(swrCtx, &outputPtr, outSamples, nullptr, 0)
+                    : 0;
+            pending.resize(static_cast<usize>(std::max(converted, 0)) * 2);
+            pendingPos = 0;
+            finished = true;
+            return !pending.empty();
+        }
+        if (ret != AVERROR(EAGAIN))
+            return false;
+        
+        // The decoder wants more input
+        if (draining)
+            return false;
+        if (av_read_frame(formatCtx, packet) < 0) {
+            draining = true;
+            avcodec_send_packet(codecCtx, nullptr);
+            continue;
+        }
+        if (packet->stream_index == audioStreamIndex &&
+            avcodec_send_packet(codecCtx, packet) < 0) {
+            LOG_WARN("Error sending packet to decoder");
+        }
+        av_packet_unref(packet);
+    }
+}
+
+// Skips the part of a freshly decoded frame that lies before the seek target
+void FFmpegAudioSource::Private::trimToSeekTarget(i64 pts) {
+    if (pts == AV_NOPTS_VALUE) {
+        seekTarget = -1; // No way to tell; take it as it comes
+        return;
+    }
+    auto* stream = formatCtx->streams[audioStreamIndex];
+    i64 start = av_rescale_q(pts, stream->time_base, AVRational{1, sampleRate});
+    i64 skip = std::clamp<i64>(seekTarget - start,
+                               0,
+                               static_cast<i64>(pending.size() / 2));
+    pendingPos = static_cast<usize>(skip) * 2;
+    if (pendingPos < pending.size())
+        seekTarget = -1; // Reached it
+}
+
 void FFmpegAudioSource::play() {
     if (!d->formatCtx || !d->codecCtx) {
         LOG_WARN("No file loaded");
@@ -273,6 +425,11 @@ void FFmpegAudioSource::cleanup() {
     }
     
     d->audioStreamIndex = -1;
+    d->pending.clear();
+    d->pendingPos = 0;
+    d->draining = false;
+    d->finished = false;
+    d->seekTarget = -1;
 }
 
 } // namespace vc
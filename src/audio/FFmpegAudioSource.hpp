@@ -22,6 +22,20 @@ public:
     // Load audio file
     bool loadFile(const std::string& path);
     
+    // Pull decoding, for offline rendering: no projectM, no thread. Opens
+    // `path` for read() at `sampleRate`. Don't mix with play().
+    bool open(const std::string& path, int sampleRate = 48000);
+    
+    // Fills `out` with up to `frames` interleaved stereo float samples and
+    // returns how many it wrote; fewer only at the end of the file
+    usize read(f32* out, usize frames);
+    
+    // Moves read() to `seconds` from the start, to the sample
+    bool seek(f64 seconds);
+    
+    // From the container header; 0 if it doesn't say
+    f64 durationSeconds() const;
+    
     // Playback control
     void play();
     void pause();
@@ -0,0 +1,56 @@
+#pragma once
+// SyntheticAudio.hpp - A deterministic test signal for offscreen renders
+// Four on the floor, one sine, some hiss. Every preset gets the same song.
+
+#include "util/Types.hpp"
+
+#include <cmath>
+#include <numbers>
+
+namespace vc {
+
+// 120 BPM: a decaying 60 Hz kick on every beat, a steady 440 Hz tone, and
+// LCG noise hi-hats on the off-beats. Fully determined by the frame
+// position, so two renders of the same preset are comparable.
+class SyntheticAudio {
+public:
+    static constexpr u32 SAMPLE_RATE = 44100;
+    static constexpr u32 CHANNELS = 2;
+
+    // Writes `frames` interleaved stereo frames and advances the clock
+    void generate(f32* out, u32 frames) {
+        constexpr f32 twoPi = 2.0f * std::numbers::pi_v<f32>;
+        constexpr u64 beat = SAMPLE_RATE / 2;
+        for (u32 i = 0; i < frames; ++i, ++position_) {
+            // 440 whole cycles per second, so wrapping keeps f32 precise
+            f32 t = static_cast<f32>(position_ % SAMPLE_RATE) / SAMPLE_RATE;
+            f32 sinceBeat = static_cast<f32>(position_ % beat) / SAMPLE_RATE;
+            f32 sinceOff = static_cast<f32>((position_ + beat / 2) % beat) /
+                           SAMPLE_RATE;
+
+            noise_ = noise_ * 1664525u + 1013904223u;
+            f32 white = static_cast<f32>(noise_ >> 8) / 8388608.0f - 1.0f;
+
+            f32 kick = std::sin(twoPi * 60.0f * sinceBeat) *
+                       std::exp(-sinceBeat * 12.0f);
+            f32 tone = 0.2f * std::sin(twoPi * 440.0f * t);
+            f32 hat = 0.3f * white * std::exp(-sinceOff * 60.0f);
+
+            f32 left = 0.5f * kick + tone + hat;
+            f32 right = 0.5f * kick + tone - hat;
+            out[i * CHANNELS] = left;
+            out[i * CHANNELS + 1] = right;
+        }
+    }
+
+    void reset() {
+        position_ = 0;
+        noise_ = 1;
+    }
+
+private:
+    u64 position_{0};
+    u32 noise_{1};
+};
+
+} // namespace vc
@@ -4,16 +4,22 @@
 #include "Logger.hpp"
 #include "audio/AudioEngine.hpp"
 #include "overlay/OverlayEngine.hpp"
+#include "recorder/OfflineExport.hpp"
+#include "recorder/RenderQueue.hpp"
 #include "recorder/VideoRecorder.hpp"
 #include "ui/MainWindow.hpp"
 #include "util/FileUtils.hpp"
 #include "util/GLIncludes.hpp"
+#include "visualizer/PresetPack.hpp"
 #include "visualizer/RatingManager.hpp"
 
 #include <QDir>
 #include <QFile>
 #include <QFontDatabase>
 #include <QStyleFactory>
+#include <cstdio>
+#include <cstdlib>
+#include <format>
 #include <iostream>
 
 namespace vc {
@@ -52,6 +58,40 @@ Result<AppOptions> Application::parseArgs() {
             opts.debug = true;
         } else if (arg == "--headless") {
             opts.headless = true;
+        } else if (arg == "--export-chunk") {
+            if (i + 2 >= argc_) {
+                return Result<AppOptions>::err(
+                        "--export-chunk requires <first frame> <frames>");
+            }
+            OfflineExport::Chunk chunk;
+            chunk.firstFrame = std::strtoull(argv_[++i], nullptr, 10);
+            chunk.frames = std::strtoull(argv_[++i], nullptr, 10);
+            opts.exportChunk = chunk;
+        } else if (arg == "--render-queue") {
+            if (i + 1 >= argc_) {
+                return Result<AppOptions>::err(
+                        "--render-queue requires a playlist or directory");
+            }
+            opts.renderQueue = fs::path(argv_[++i]);
+        } else if (arg == "--encoder-preset") {
+            if (i + 1 >= argc_) {
+                return Result<AppOptions>::err(
+                        "--encoder-preset requires a name argument");
+            }
+            opts.encoderPreset = argv_[++i];
+        } else if (arg == "--workers") {
+            if (i + 1 >= argc_) {
+                return Result<AppOptions>::err("--workers requires a count");
+            }
+            int workers = std::atoi(argv_[++i]);
+            if (workers < 1 || workers > 256) {
+                return Result<AppOptions>::err(
+                        std::string("Invalid value for --workers: ") +
+                        argv_[i]);
+            }
+            opts.workers = static_cast<u32>(workers);
+        } else if (arg == "--report-progress") {
+            opts.reportProgress = true;
         } else if (arg == "-r" || arg == "--record") {
             opts.startRecording = true;
         } else if (arg == "-o" || arg == "--output") {
@@ -74,6 +114,62 @@ Result<AppOptions> Application::parseArgs() {
             opts.presetName = argv_[++i];
         } else if (arg == "--default-preset") {
             opts.useDefaultPreset = true;
+        } else if (arg == "--build-preset-pack") {
+            if (i + 2 >= argc_) {
+                return Result<AppOptions>::err(
+                        "--build-preset-pack requires <dir> <pack.cvpk>");
+            }
+            AppOptions::PresetPackJob job;
+            job.sourceDir = fs::path(argv_[++i]);
+            job.packFile = fs::path(argv_[++i]);
+            opts.buildPresetPack = std::move(job);
+        } else if (arg == "--uncompressed") {
+            if (!opts.buildPresetPack) {
+                return Result<AppOptions>::err(
+                        "--uncompressed must follow --build-preset-pack");
+            }
+            opts.buildPresetPack->compress = false;
+        } else if (arg == "--benchmark-presets") {
+            if (i + 2 >= argc_) {
+                return Result<AppOptions>::err(
+                        "--benchmark-presets requires <presets> <report>");
+            }
+            PresetBenchmark::Options bench;
+            bench.presets = fs::path(argv_[++i]);
+            bench.report = fs::path(argv_[++i]);
+            opts.benchmarkPresets = std::move(bench);
+        } else if (arg == "--size" || arg == "--seconds" || arg == "--fps") {
+            if (!opts.benchmarkPresets) {
+                return Result<AppOptions>::err(
+                        std::string(arg) + " must follow --benchmark-presets");
+            }
+            if (i + 1 >= argc_) {
+                return Result<AppOptions>::err(std::string(arg) +
+                                               " requires a value");
+            }
+            auto& bench = *opts.benchmarkPresets;
+            std::string value = argv_[++i];
+            bool valid = false;
+            if (arg == "--size") {
+                u32 w = 0, h = 0;
+                valid = std::sscanf(value.c_str(), "%ux%u", &w, &h) == 2 &&
+                        w >= 16 && h >= 16 && w <= 7680 && h <= 4320;
+                bench.width = w;
+                bench.height = h;
+            } else if (arg == "--seconds") {
+                bench.seconds = std::atof(value.c_str());
+                valid = bench.seconds > 0.0;
+            } else {
+                bench.fps = static_cast<u32>(std::atoi(value.c_str()));
+                valid = bench.fps >= 10 && bench.fps <= 240;
+            }
+            if (!valid) {
+                return Result<AppOptions>::err("Invalid value for " +
+                                               std::string(arg) + ": " +
+                                               value);
+            }
+        } else if (arg == "--software-gl") {
+            opts.softwareGL = true;
         } else if (arg[0] != '-') {
             // Positional argument - input file
             opts.inputFiles.push_back(fs::path(arg));
@@ -86,12 +182,221 @@ Result<AppOptions> Application::parseArgs() {
     return Result<AppOptions>::ok(std::move(opts));
 }
 
-Result<void> Application::init(const AppOptions& opts) {
-    // Initialize logging first
+std::optional<int> Application::runCommand(const AppOptions& opts) {
+    // Mesa reads this when the first context is created
+    if (opts.softwareGL)
+        ::setenv("LIBGL_ALWAYS_SOFTWARE", "1", 1);
+
+    if (opts.benchmarkPresets)
+        return benchmarkPresets(opts);
+    if (opts.renderQueue)
+        return runRenderQueue(opts);
+    if (opts.headless)
+        return exportOffline(opts);
+    if (!opts.buildPresetPack)
+        return std::nullopt;
+
     Logger::init("chadvis-projectm-qt", opts.debug);
-    LOG_INFO("chadvis-projectm-qt starting up. I use Arch btw.");
+    const auto& job = *opts.buildPresetPack;
+    auto result = PresetPack::build(job.sourceDir, job.packFile, job.compress);
+    if (!result) {
+        std::cerr << "Error: " << result.error().message << "\n";
+        return 1;
+    }
+    const auto& stats = *result;
+    std::cout << "Packed " << stats.presets << " presets ("
+              << file::humanSize(stats.inputBytes) << ") into "
+              << job.packFile.string() << " ("
+              << file::humanSize(stats.packBytes) << ", " << stats.compressed
+              << " compressed, " << stats.duplicates << " duplicates)\n"
+              << "Set visualizer.preset_path to it to use it.\n";
+    return 0;
+}
 
-    // Load configuration
+int Application::benchmarkPresets(const AppOptions& opts) {
+    Logger::init("chadvis-projectm-qt", opts.debug);
+    // Offscreen surfaces need a platform connection, but nothing is shown
+    qapp_ = std::make_unique<QApplication>(argc_, argv_);
+
+    PresetBenchmark benchmark(*opts.benchmarkPresets);
+    if (auto result = benchmark.run(); !result) {
+        std::cerr << "Error: " << result.error().message << "\n";
+        return 1;
+    }
+    usize failed = benchmark.failures();
+    std::cout << "Benchmarked " << benchmark.results().size()
+              << " presets into " << opts.benchmarkPresets->report.string()
+              << " (" << failed << " failed)\n";
+    // Non-zero when any preset failed, so a pack can be gated on it
+    return failed > 0 ? 2 : 0;
+}
+
+int Application::exportOffline(const AppOptions& opts) {
+    Logger::init("chadvis-projectm-qt", opts.debug);
+    if (auto result = loadConfig(opts); !result)
+        return 1;
+    if (opts.inputFiles.empty()) {
+        std::cerr << "Error: --headless needs at least one input file\n";
+        return 1;
+    }
+    bool oneFile = opts.inputFiles.size() == 1 && opts.outputFile;
+    if (opts.exportChunk && !oneFile) {
+        std::cerr << "Error: --export-chunk needs one input and --output\n";
+        return 1;
+    }
+    // Offscreen surfaces need a platform connection, but nothing is shown
+    qapp_ = std::make_unique<QApplication>(argc_, argv_);
+
+    // One input may be rendered to a file; otherwise -o names a directory
+    bool toFile = opts.outputFile && opts.inputFiles.size() == 1 &&
+                  !fs::is_directory(*opts.outputFile);
+    fs::path outputDir = opts.outputFile && !toFile
+                                 ? *opts.outputFile
+                                 : CONFIG.recording().outputDirectory;
+    // Chunk processes render with everything this one was told
+    std::vector<std::string> chunkArgs = workerArgs(opts);
+    if (opts.presetName) {
+        chunkArgs.push_back("--preset");
+        chunkArgs.push_back(*opts.presetName);
+    }
+    if (opts.useDefaultPreset)
+        chunkArgs.push_back("--default-preset");
+    if (opts.encoderPreset) {
+        chunkArgs.push_back("--encoder-preset");
+        chunkArgs.push_back(*opts.encoderPreset);
+    }
+    EncoderSettings settings = EncoderSettings::fromConfig();
+    if (opts.encoderPreset) {
+        auto preset = EncoderSettings::fromPreset(*opts.encoderPreset);
+        if (!preset) {
+            std::cerr << "Error: " << preset.error().message << "\n";
+            return 1;
+        }
+        settings = *preset;
+    }
+    if (!toFile) {
+        if (auto result = file::ensureDir(outputDir); !result) {
+            std::cerr << "Error: " << result.error().message << "\n";
+            return 1;
+        }
+    }
+
+    int failed = 0;
+    for (const auto& input : opts.inputFiles) {
+        OfflineExport::Options job;
+        job.input = input;
+        job.settings = settings;
+        job.settings.outputPath =
+                toFile ? *opts.outputFile
+                       : outputDir / (input.stem().string() +
+                                      job.settings.containerExtension());
+        job.preset = opts.presetName.value_or("");
+        job.idlePreset = opts.useDefaultPreset;
+        job.chunk = opts.exportChunk;
+        job.workers = opts.workers.value_or(0);
+        job.workerArgs = chunkArgs;
+        auto output = job.settings.outputPath;
+
+        OfflineExport exporter(std::move(job));
+        if (opts.reportProgress) {
+            exporter.progress.connect([](f64 done) {
+                std::cout << std::format("progress {:.4f}", done) << std::endl;
+            });
+        }
+        activeExport_ = &exporter;
+        auto result = exporter.run();
+        activeExport_ = nullptr;
+        if (!result) {
+            std::cerr << "Error: " << input.string() << ": "
+                      << result.error().message << "\n";
+            ++failed;
+            if (exporter.cancelled())
+                break;
+            continue;
+        }
+        const auto& stats = *result;
+        std::cout << "Rendered " << input.filename().string() << " to "
+                  << output.string() << ": " << stats.frames << " frames, "
+                  << std::format("{:.1f} s in {:.1f} s ({:.2f}x realtime)",
+                                 stats.mediaSeconds,
+                                 stats.wallSeconds,
+                                 stats.mediaSeconds /
+                                         std::max(stats.wallSeconds, 1e-6))
+                  << "\n";
+    }
+    return failed > 0 ? 1 : 0;
+}
+
+int Application::runRenderQueue(const AppOptions& opts) {
+    Logger::init("chadvis-projectm-qt", opts.debug);
+    if (auto result = loadConfig(opts); !result)
+        return 1;
+    qapp_ = std::make_unique<QApplication>(argc_, argv_);
+
+    RenderQueue::Options options;
+    options.source = *opts.renderQueue;
+    options.outputDir =
+            opts.outputFile.value_or(CONFIG.recording().outputDirectory);
+    options.encoderPreset = opts.encoderPreset.value_or("");
+    options.preset = opts.presetName.value_or("");
+    options.idlePreset = opts.useDefaultPreset;
+    options.workers = opts.workers.value_or(0);
+    options.workerArgs = workerArgs(opts);
+
+    RenderQueue queue(std::move(options));
+    if (auto result = queue.load(); !result) {
+        std::cerr << "Error: " << result.error().message << "\n";
+        return 1;
+    }
+    const auto& jobs = queue.jobs();
+    std::cout << "Queued " << jobs.size() << " tracks, "
+              << queue.count(JobState::UpToDate) << " already up to date\n";
+
+    // One line per job as it starts and ends; progress is for the GUI
+    queue.jobChanged.connect([&](usize index) {
+        const auto& job = jobs[index];
+        if (job.state == JobState::Running && job.progress > 0.0)
+            return;
+        std::cout << std::format("[{}/{}] {} {}",
+                                 index + 1,
+                                 jobs.size(),
+                                 RenderQueue::stateName(job.state),
+                                 job.input.filename().string());
+        if (!job.error.empty())
+            std::cout << ": " << job.error;
+        std::cout << std::endl;
+    });
+    queue.finished.connect([this] { qapp_->quit(); });
+
+    activeQueue_ = &queue;
+    queue.start();
+    qapp_->exec();
+    activeQueue_ = nullptr;
+
+    usize pending = queue.count(JobState::Pending);
+    usize failed = queue.count(JobState::Failed);
+    std::cout << "Rendered " << queue.count(JobState::Done) << ", " << failed
+              << " failed";
+    if (pending > 0)
+        std::cout << ", " << pending << " left for next time";
+    std::cout << "\n";
+    return failed > 0 || pending > 0 ? 1 : 0;
+}
+
+std::vector<std::string> Application::workerArgs(const AppOptions& opts) {
+    std::vector<std::string> args;
+    if (opts.configFile) {
+        args.push_back("--config");
+        args.push_back(opts.configFile->string());
+    }
+    if (opts.debug)
+        args.push_back("--debug");
+    if (opts.softwareGL)
+        args.push_back("--software-gl");
+    return args;
+}
+
+Result<void> Application::loadConfig(const AppOptions& opts) {
     if (opts.configFile) {
         if (auto result = CONFIG.load(*opts.configFile); !result) {
             LOG_ERROR("Failed to load config: {}", result.error().message);
@@ -104,6 +409,17 @@ Result<void> Application::init(const AppOptions& opts) {
             // Continue with defaults
         }
     }
+    return Result<void>::ok();
+}
+
+Result<void> Application::init(const AppOptions& opts) {
+    // Initialize logging first
+    Logger::init("chadvis-projectm-qt", opts.debug);
+    LOG_INFO("chadvis-projectm-qt starting up. I use Arch btw.");
+
+    // Load configuration
+    if (auto result = loadConfig(opts); !result)
+        return result;
 
     // Override debug from command line
     if (opts.debug) {
@@ -206,6 +522,17 @@ int Application::exec() {
 }
 
 void Application::quit() {
+    // An offline export finishes its file and returns on its own. Both only
+    // set a flag, since this may be running in a signal handler.
+    if (activeExport_) {
+        activeExport_->cancel();
+        return;
+    }
+    if (activeQueue_) {
+        activeQueue_->requestCancel();
+        return;
+    }
+
     LOG_INFO("Shutting down...");
 
     // Stop recording if active
@@ -310,13 +637,49 @@ Options:
    --default-preset        Use projectM's default visualizer (no preset)
    -r, --record            Start recording immediately
    -o, --output <path>     Output file for recording
-   --headless              Run without GUI (for batch processing)
+   --headless              Render each input file to a video offscreen, as
+                           fast as the machine allows, and exit. -o is the
+                           file (one input) or directory (default:
+                           recording.output_directory); -p picks the preset.
+                           Long tracks render in recording.offline.workers
+                           processes at once
+   --encoder-preset <name> With --headless or --render-queue: encode with a
+                           quality preset ("YouTube 1080p60", "Lossless"...)
+                           instead of the recording.* settings
+   --workers <n>           With --headless or --render-queue: render
+                           processes at once (recording.offline.workers)
+   --render-queue <playlist.m3u|dir>
+                           Render every track to -o (default:
+                           recording.output_directory), skipping those
+                           already rendered with the same settings. Safe to
+                           cancel and run again
+   --export-chunk <first> <frames>
+                           With --headless: render only those frames, as a
+                           video-only segment (what those processes run)
+   --build-preset-pack <dir> <pack.cvpk>
+                           Pack every preset under <dir> into one file,
+                           zstd-compressed if available, and exit
+   --uncompressed          With --build-preset-pack: store presets as-is
+   --benchmark-presets <presets> <report.csv|report.json>
+                           Render every preset offscreen and report load,
+                           compile and frame times (avg/p95/p99), then exit
+                           with 2 if any preset failed
+   --size <WxH>            With --benchmark-presets: resolution (1280x720)
+   --seconds <n>           With --benchmark-presets: time per preset (10)
+   --fps <n>               With --benchmark-presets: frame rate (60)
+   --software-gl           Render with Mesa's llvmpipe, no GPU needed
 
 Examples:
    chadvis-projectm-qt ~/Music/*.flac
    chadvis-projectm-qt --record --output video.mp4 song.mp3
    chadvis-projectm-qt --preset "Aderrasi - Airhandler" playlist.m3u
    chadvis-projectm-qt --default-preset song.mp3
+   chadvis-projectm-qt --build-preset-pack ~/presets ~/presets.cvpk
+   xvfb-run chadvis-projectm-qt --headless -o ~/Videos song1.flac song2.mp3
+   chadvis-projectm-qt --render-queue ~/Music/Album -o ~/Videos/Album \
+       --encoder-preset "YouTube 1080p60" --workers 4
+   xvfb-run chadvis-projectm-qt --software-gl --benchmark-presets \
+       ~/presets.cvpk report.json --size 640x360 --seconds 5
 
 Config: ~/.config/chadvis-projectm-qt/config.toml
 Logs:   ~/.cache/chadvis-projectm-qt/logs/
@@ -4,6 +4,8 @@
 
 #include "util/Types.hpp"
 #include "util/Result.hpp"
+#include "recorder/OfflineExport.hpp"
+#include "visualizer/PresetBenchmark.hpp"
 #include <QApplication>
 #include <memory>
 #include <vector>
@@ -12,18 +14,35 @@ namespace vc {
 
 class MainWindow;
 class AudioEngine;
+class RenderQueue;
 class OverlayEngine;
 class VideoRecorder;
 
 struct AppOptions {
     bool debug{false};
-    bool headless{false};
+    bool headless{false}; // Render inputFiles offline instead of the GUI
     bool startRecording{false};
     bool useDefaultPreset{false};
     std::optional<fs::path> outputFile;
     std::optional<fs::path> configFile;
     std::vector<fs::path> inputFiles;
     std::optional<std::string> presetName;
+    // --export-chunk: one piece of a chunked --headless export
+    std::optional<OfflineExport::Chunk> exportChunk;
+    std::optional<std::string> encoderPreset; // A getQualityPresets() name
+    std::optional<u32> workers;               // Render processes
+    bool reportProgress{false};               // For RenderQueue
+    std::optional<fs::path> renderQueue;      // Playlist or directory
+
+    // One-shot tools; the app exits after running them
+    struct PresetPackJob {
+        fs::path sourceDir;
+        fs::path packFile;
+        bool compress{true};
+    };
+    std::optional<PresetPackJob> buildPresetPack;
+    std::optional<PresetBenchmark::Options> benchmarkPresets;
+    bool softwareGL{false}; // Force Mesa's llvmpipe
 };
 
 class Application : public QObject {
@@ -36,6 +55,10 @@ public:
     // Parse command line arguments
     Result<AppOptions> parseArgs();
     
+    // Run a command line tool instead of the app, if one was asked for.
+    // Returns the exit code, or nullopt to carry on with init().
+    std::optional<int> runCommand(const AppOptions& opts);
+
     // Initialize and run
     Result<void> init(const AppOptions& opts);
     int exec();
@@ -59,6 +82,11 @@ private:
     void setupStyle();
     void printVersion();
     void printHelp();
+    Result<void> loadConfig(const AppOptions& opts);
+    int benchmarkPresets(const AppOptions& opts);
+    int exportOffline(const AppOptions& opts);
+    int runRenderQueue(const AppOptions& opts);
+    static std::vector<std::string> workerArgs(const AppOptions& opts);
     
     static Application* instance_;
     
@@ -67,6 +95,8 @@ private:
     std::unique_ptr<AudioEngine> audioEngine_;
     std::unique_ptr<OverlayEngine> overlayEngine_;
     std::unique_ptr<VideoRecorder> videoRecorder_;
+    OfflineExport* activeExport_{nullptr}; // Cancelled by quit()
+    RenderQueue* activeQueue_{nullptr};
     
     int argc_;
     char** argv_;
@@ -193,9 +193,14 @@ void Config::parseVisualizer(const toml::table& tbl) {
         visualizer_.smoothPresetDuration =
                 std::clamp(get(*viz, "smooth_preset_duration", 5u), 0u, 30u);
         visualizer_.shufflePresets = get(*viz, "shuffle_presets", true);
+        visualizer_.smartRotation = get(*viz, "smart_rotation", true);
         visualizer_.forcePreset = get(*viz, "force_preset", std::string());
         visualizer_.useDefaultPreset = get(*viz, "use_default_preset", false);
         visualizer_.lowResourceMode = get(*viz, "low_resource_mode", false);
+        visualizer_.gpuBudgetMs =
+                std::max(get(*viz, "gpu_budget_ms", 0.0f), 0.0f);
+        visualizer_.thumbnailWorkers =
+                std::min(get(*viz, "thumbnail_workers", 2u), 8u);
         LOG_INFO("Config: visualizer {}x{} @ {}fps",
                  visualizer_.width,
                  visualizer_.height,
@@ -215,6 +220,14 @@ void Config::parseRecording(const toml::table& tbl) {
                     "default_filename",
                     std::string("chadvis-projectm-qt_{date}_{time}"));
         recording_.container = get(*rec, "container", std::string("mp4"));
+        recording_.hugePages = get(*rec, "huge_pages", false);
+        recording_.backpressure =
+                get(*rec, "backpressure", std::string("drop_oldest"));
+        recording_.convertThreads = get(*rec, "convert_threads", 0u);
+        recording_.audioClock = get(*rec, "audio_clock", true);
+        recording_.fragmentSeconds = get(*rec, "fragment_seconds", 2u);
+        recording_.segmentSeconds = get(*rec, "segment_seconds", 0u);
+        recording_.segmentMegabytes = get(*rec, "segment_megabytes", 0u);
 
         if (auto video = (*rec)["video"].as_table()) {
             recording_.video.codec =
@@ -237,6 +250,8 @@ void Config::parseRecording(const toml::table& tbl) {
 
             recording_.video.fps =
                     std::clamp(get(*video, "fps", 30u), 10u, 120u);
+            recording_.video.gpuYCbCr = get(*video, "gpu_ycbcr", false);
+            recording_.video.fullRange = get(*video, "full_range", false);
         }
 
         if (auto audio = (*rec)["audio"].as_table()) {
@@ -244,6 +259,39 @@ void Config::parseRecording(const toml::table& tbl) {
             recording_.audio.bitrate =
                     std::clamp(get(*audio, "bitrate", 192u), 64u, 640u);
         }
+
+        if (auto offline = (*rec)["offline"].as_table()) {
+            recording_.offline.workers = get(*offline, "workers", 0u);
+            recording_.offline.chunkSeconds =
+                    std::max(get(*offline, "chunk_seconds", 60u), 5u);
+            recording_.offline.prerollSeconds =
+                    std::max(get(*offline, "preroll_seconds", 5.0f), 0.0f);
+        }
+
+        recording_.renditions.clear();
+        if (auto renditions = (*rec)["renditions"].as_array()) {
+            for (const auto& node : *renditions) {
+                auto* tbl = node.as_table();
+                if (!tbl)
+                    continue;
+                RenditionConfig cfg;
+                cfg.name = get(*tbl, "name", std::string(""));
+                // Even sizes, as the encoders want
+                cfg.width = get(*tbl, "width", 1280u) & ~1u;
+                cfg.height = get(*tbl, "height", 720u) & ~1u;
+                cfg.crf = std::clamp(get(*tbl, "crf", 23u), 0u, 51u);
+                cfg.bitrate = get(*tbl, "bitrate", 0u);
+                recording_.renditions.push_back(std::move(cfg));
+            }
+        }
+
+        if (auto replay = (*rec)["replay"].as_table()) {
+            recording_.replay.enabled = get(*replay, "enabled", false);
+            recording_.replay.seconds =
+                    std::clamp(get(*replay, "seconds", 60u), 5u, 3600u);
+            recording_.replay.maxMegabytes =
+                    get(*replay, "max_megabytes", 512u);
+        }
     }
 }
 
@@ -307,6 +355,7 @@ void Config::parseKeyboard(const toml::table& tbl) {
         keyboard_.nextTrack = get(*kb, "next_track", std::string("N"));
         keyboard_.prevTrack = get(*kb, "prev_track", std::string("P"));
         keyboard_.toggleRecord = get(*kb, "toggle_record", std::string("R"));
+        keyboard_.saveReplay = get(*kb, "save_replay", std::string("F9"));
         keyboard_.toggleFullscreen =
                 get(*kb, "toggle_fullscreen", std::string("F"));
         keyboard_.nextPreset = get(*kb, "next_preset", std::string("Right"));
@@ -355,9 +404,14 @@ toml::table Config::serialize() const {
                         {"smooth_preset_duration",
                          static_cast<i64>(visualizer_.smoothPresetDuration)},
                         {"shuffle_presets", visualizer_.shufflePresets},
+                        {"smart_rotation", visualizer_.smartRotation},
                         {"force_preset", visualizer_.forcePreset},
                         {"use_default_preset", visualizer_.useDefaultPreset},
-                        {"low_resource_mode", visualizer_.lowResourceMode}});
+                        {"low_resource_mode", visualizer_.lowResourceMode},
+                        {"gpu_budget_ms",
+                         static_cast<double>(visualizer_.gpuBudgetMs)},
+                        {"thumbnail_workers",
+                         static_cast<i64>(visualizer_.thumbnailWorkers)}});
 
     // Recording
     toml::table recVideo{{"codec", recording_.video.codec},
@@ -366,12 +420,37 @@ toml::table Config::serialize() const {
                          {"pixel_format", recording_.video.pixelFormat},
                          {"width", static_cast<i64>(recording_.video.width)},
                          {"height", static_cast<i64>(recording_.video.height)},
-                         {"fps", static_cast<i64>(recording_.video.fps)}};
+                         {"fps", static_cast<i64>(recording_.video.fps)},
+                         {"gpu_ycbcr", recording_.video.gpuYCbCr},
+                         {"full_range", recording_.video.fullRange}};
 
     toml::table recAudio{
             {"codec", recording_.audio.codec},
             {"bitrate", static_cast<i64>(recording_.audio.bitrate)}};
 
+    toml::table recOffline{
+            {"workers", static_cast<i64>(recording_.offline.workers)},
+            {"chunk_seconds",
+             static_cast<i64>(recording_.offline.chunkSeconds)},
+            {"preroll_seconds",
+             static_cast<double>(recording_.offline.prerollSeconds)}};
+
+    toml::table recReplay{
+            {"enabled", recording_.replay.enabled},
+            {"seconds", static_cast<i64>(recording_.replay.seconds)},
+            {"max_megabytes",
+             static_cast<i64>(recording_.replay.maxMegabytes)}};
+
+    toml::array recRenditions;
+    for (const auto& rendition : recording_.renditions) {
+        recRenditions.push_back(toml::table{
+                {"name", rendition.name},
+                {"width", static_cast<i64>(rendition.width)},
+                {"height", static_cast<i64>(rendition.height)},
+                {"crf", static_cast<i64>(rendition.crf)},
+                {"bitrate", static_cast<i64>(rendition.bitrate)}});
+    }
+
     root.insert("recording",
                 toml::table{{"enabled", recording_.enabled},
                             {"auto_record", recording_.autoRecord},
@@ -379,8 +458,22 @@ toml::table Config::serialize() const {
                              recording_.outputDirectory.string()},
                             {"default_filename", recording_.defaultFilename},
                             {"container", recording_.container},
+                            {"huge_pages", recording_.hugePages},
+                            {"backpressure", recording_.backpressure},
+                            {"convert_threads",
+                             static_cast<i64>(recording_.convertThreads)},
+                            {"audio_clock", recording_.audioClock},
+                            {"fragment_seconds",
+                             static_cast<i64>(recording_.fragmentSeconds)},
+                            {"segment_seconds",
+                             static_cast<i64>(recording_.segmentSeconds)},
+                            {"segment_megabytes",
+                             static_cast<i64>(recording_.segmentMegabytes)},
                             {"video", recVideo},
-                            {"audio", recAudio}});
+                            {"audio", recAudio},
+                            {"offline", recOffline},
+                            {"replay", recReplay},
+                            {"renditions", recRenditions}});
 
     // Overlay elements
     toml::array elementsArr;
@@ -419,6 +512,7 @@ toml::table Config::serialize() const {
                             {"next_track", keyboard_.nextTrack},
                             {"prev_track", keyboard_.prevTrack},
                             {"toggle_record", keyboard_.toggleRecord},
+                            {"save_replay", keyboard_.saveReplay},
                             {"toggle_fullscreen", keyboard_.toggleFullscreen},
                             {"next_preset", keyboard_.nextPreset},
                             {"prev_preset", keyboard_.prevPreset}});
@@ -34,6 +34,8 @@ struct VideoEncoderConfig {
     u32 width{1920};
     u32 height{1080};
     u32 fps{60};
+    bool gpuYCbCr{false}; // Convert to BT.709 YCbCr in the compositor
+    bool fullRange{false}; // 0-255 YUV instead of 16-235 (not gpu_ycbcr)
 };
 
 // Audio encoding settings
@@ -42,6 +44,29 @@ struct AudioEncoderConfig {
     u32 bitrate{320};
 };
 
+// --headless exports
+struct OfflineExportConfig {
+    u32 workers{0};        // Render processes, 0 = one per 8 cores, 1 = serial
+    u32 chunkSeconds{60};  // Track length each process renders at a time
+    f32 prerollSeconds{5.0f}; // Rendered before a chunk to settle projectM
+};
+
+// An extra, smaller output of every recording ([[recording.renditions]])
+struct RenditionConfig {
+    std::string name; // File suffix, empty = "<height>p"
+    u32 width{1280};
+    u32 height{720};
+    u32 crf{23};
+    u32 bitrate{0}; // kbps, 0 = use crf
+};
+
+// Instant replay buffer
+struct ReplayBufferConfig {
+    bool enabled{false}; // Encode into memory, save the recent past on demand
+    u32 seconds{60};
+    u32 maxMegabytes{512}; // Cap on memory used, 0 = none
+};
+
 // Recording configuration
 struct RecordingConfig {
     bool enabled{true};
@@ -49,8 +74,18 @@ struct RecordingConfig {
     fs::path outputDirectory;
     std::string defaultFilename{"chadvis-projectm-qt_{date}_{time}"};
     std::string container{"mp4"};
+    bool hugePages{false}; // Back the capture frame pool with huge pages
+    std::string backpressure{"drop_oldest"}; // drop_oldest, block, duplicate
+    u32 convertThreads{0}; // RGBA -> YUV workers, 0 = a quarter of the cores
+    bool audioClock{true}; // Sync video to the audio clock, not frame count
+    u32 fragmentSeconds{2}; // Crash-safe fragments, 0 = index written at stop
+    u32 segmentSeconds{0};  // Start a new file this often, 0 = never
+    u32 segmentMegabytes{0}; // ... or at this size, 0 = never
     VideoEncoderConfig video;
     AudioEncoderConfig audio;
+    OfflineExportConfig offline;
+    ReplayBufferConfig replay;
+    std::vector<RenditionConfig> renditions;
 };
 
 // Visualizer configuration
@@ -63,9 +98,12 @@ struct VisualizerConfig {
     u32 presetDuration{30};
     u32 smoothPresetDuration{5};
     bool shufflePresets{true};
+    bool smartRotation{true}; // Shuffle picks to suit the music, on downbeats
     std::string forcePreset{}; // Force specific preset for debugging
     bool useDefaultPreset{false}; // Use default projectM visualizer (no preset)
     bool lowResourceMode{false};
+    f32 gpuBudgetMs{0.0f}; // p95 GPU ms per frame before quarantine, 0 = off
+    u32 thumbnailWorkers{2}; // Background preview renderers, 0 = off
 };
 
 // Audio configuration
@@ -91,6 +129,7 @@ struct KeyboardConfig {
     std::string nextTrack{"N"};
     std::string prevTrack{"P"};
     std::string toggleRecord{"R"};
+    std::string saveReplay{"F9"};
     std::string toggleFullscreen{"F"};
     std::string nextPreset{"Right"};
     std::string prevPreset{"Left"};
@@ -50,6 +50,10 @@ int main(int argc, char* argv[]) {
         }
         
         auto opts = std::move(*optsResult);
+
+        // Command line tools run and exit without bringing up the app
+        if (auto code = app.runCommand(opts))
+            return *code;
         
         // Initialize application
         auto initResult = app.init(opts);
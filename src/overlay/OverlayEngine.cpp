@@ -48,6 +48,20 @@ void OverlayEngine::render(u32 width, u32 height) {
     if (!enabled_)
         return;
 
+    prepare(width, height);
+
+    // 5. Draw Quad
+    renderer_->draw();
+}
+
+GLuint OverlayEngine::texture() const {
+    return enabled_ ? renderer_->textureId() : 0;
+}
+
+void OverlayEngine::prepare(u32 width, u32 height) {
+    if (!enabled_)
+        return;
+
     // 1. Initialize Renderer if needed
     if (!renderer_->isInitialized()) {
         renderer_->init();
@@ -82,9 +96,6 @@ void OverlayEngine::render(u32 width, u32 height) {
             renderer_->upload(*canvas_);
         needsUpload_ = false;
     }
-
-    // 5. Draw Quad
-    renderer_->draw();
 }
 
 void OverlayEngine::setAlignedLyrics(const suno::AlignedLyrics& lyrics) {
@@ -52,6 +52,11 @@ public:
     // 4. Draws full screen quad
     void render(u32 width, u32 height);
 
+    // Steps 1-4 only: bring the overlay texture up to date for this frame.
+    // Call once, then hand texture() to the compositor for every output.
+    void prepare(u32 width, u32 height);
+    GLuint texture() const; // 0 when disabled or nothing uploaded yet
+
     // Helpers
     void setEnabled(bool e) {
         enabled_ = e;
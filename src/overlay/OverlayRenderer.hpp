@@ -33,6 +33,11 @@ public:
         return initialized_;
     }
 
+    // Raw texture for compositing elsewhere (0 if nothing uploaded)
+    GLuint textureId() const {
+        return texture_ && texture_->isCreated() ? texture_->textureId() : 0;
+    }
+
 private:
     std::unique_ptr<QOpenGLShaderProgram> program_;
     QOpenGLBuffer vbo_{QOpenGLBuffer::VertexBuffer};
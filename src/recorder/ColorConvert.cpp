@@ -0,0 +1,348 @@
+#include "ColorConvert.hpp"
+#include "util/WorkerPool.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define VC_COLOR_X86 1
+#include <immintrin.h>
+#endif
+
+namespace vc {
+
+namespace {
+
+using Coefficients = ColorConverter::Coefficients;
+
+// log2 of the pixels averaged into one chroma sample, horizontal and total
+constexpr u32 chromaShiftX(ChromaFormat chroma) {
+    return chroma == ChromaFormat::Yuv444 ? 0 : 1;
+}
+constexpr u32 chromaShift(ChromaFormat chroma) {
+    return chroma == ChromaFormat::Yuv420   ? 2
+           : chroma == ChromaFormat::Yuv422 ? 1
+                                            : 0;
+}
+constexpr u32 rowStep(ChromaFormat chroma) {
+    return chroma == ChromaFormat::Yuv420 ? 2 : 1;
+}
+
+Coefficients makeCoefficients(bool fullRange) {
+    constexpr f64 KR = 0.2126;
+    constexpr f64 KB = 0.0722;
+    const f64 yScale = fullRange ? 1.0 : 219.0 / 255.0;
+    const f64 cScale = fullRange ? 1.0 : 224.0 / 255.0;
+    auto q16 = [](f64 v) {
+        return static_cast<i32>(std::lround(v * 65536.0));
+    };
+
+    // The middle coefficient absorbs the rounding, so white lands exactly
+    // on white and greys exactly on 128
+    Coefficients k{};
+    k.yr = q16(KR * yScale);
+    k.yb = q16(KB * yScale);
+    k.yg = q16(yScale) - k.yr - k.yb;
+    k.yOffset = fullRange ? 0 : 16;
+    k.ub = q16(0.5 * cScale);
+    k.ur = q16(-0.5 * cScale * KR / (1.0 - KB));
+    k.ug = -k.ub - k.ur;
+    k.vr = q16(0.5 * cScale);
+    k.vb = q16(-0.5 * cScale * KB / (1.0 - KR));
+    k.vg = -k.vr - k.vb;
+    return k;
+}
+
+u8 clampByte(i32 value) {
+    return static_cast<u8>(std::clamp(value, 0, 255));
+}
+
+i32 lumaBias(const Coefficients& k) {
+    return (k.yOffset << 16) + (1 << 15);
+}
+
+// `shift` is 16 plus log2 of the pixels summed into r, g and b
+i32 chromaBias(u32 shift) {
+    return (128 << shift) + (1 << (shift - 1));
+}
+
+#ifdef VC_COLOR_X86
+
+#define VC_AVX2 __attribute__((target("avx2")))
+
+struct Rgb8 {
+    __m256i r, g, b;
+};
+
+struct Row3 {
+    __m256i r, g, b, bias;
+    __m128i shift;
+};
+
+// Eight RGBA pixels, one channel per 32-bit lane
+VC_AVX2 inline Rgb8 unpack(const u8* p) {
+    __m256i px = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    __m256i mask = _mm256_set1_epi32(0xFF);
+    return {_mm256_and_si256(px, mask),
+            _mm256_and_si256(_mm256_srli_epi32(px, 8), mask),
+            _mm256_and_si256(_mm256_srli_epi32(px, 16), mask)};
+}
+
+VC_AVX2 inline Rgb8 add(const Rgb8& a, const Rgb8& b) {
+    return {_mm256_add_epi32(a.r, b.r),
+            _mm256_add_epi32(a.g, b.g),
+            _mm256_add_epi32(a.b, b.b)};
+}
+
+VC_AVX2 inline Row3 row(i32 r, i32 g, i32 b, i32 bias, u32 shift) {
+    return {_mm256_set1_epi32(r),
+            _mm256_set1_epi32(g),
+            _mm256_set1_epi32(b),
+            _mm256_set1_epi32(bias),
+            _mm_cvtsi32_si128(static_cast<int>(shift))};
+}
+
+VC_AVX2 inline __m256i apply(const Rgb8& c, const Row3& m) {
+    __m256i sum = _mm256_add_epi32(_mm256_mullo_epi32(c.r, m.r),
+                                   _mm256_mullo_epi32(c.g, m.g));
+    sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(c.b, m.b));
+    return _mm256_sra_epi32(_mm256_add_epi32(sum, m.bias), m.shift);
+}
+
+// Sums of adjacent lanes across a and b, in pixel order
+VC_AVX2 inline __m256i pairs(__m256i a, __m256i b) {
+    return _mm256_permute4x64_epi64(_mm256_hadd_epi32(a, b), 0xD8);
+}
+
+VC_AVX2 inline Rgb8 pairs(const Rgb8& a, const Rgb8& b) {
+    return {pairs(a.r, b.r), pairs(a.g, b.g), pairs(a.b, b.b)};
+}
+
+// Sixteen 32-bit values to sixteen saturated bytes
+VC_AVX2 inline void store16(u8* out, __m256i a, __m256i b) {
+    __m256i words = _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), 0xD8);
+    __m256i bytes = _mm256_packus_epi16(words, words);
+    bytes = _mm256_permute4x64_epi64(bytes, 0x08);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out),
+                     _mm256_castsi256_si128(bytes));
+}
+
+// Eight 32-bit values to eight saturated bytes
+VC_AVX2 inline void store8(u8* out, __m256i a) {
+    __m256i words = _mm256_permute4x64_epi64(_mm256_packus_epi32(a, a), 0xD8);
+    __m256i bytes = _mm256_packus_epi16(words, words);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(out),
+                     _mm256_castsi256_si128(bytes));
+}
+
+// 16 pixels per step; returns how far it got, the caller does the rest
+template <ChromaFormat Chroma>
+VC_AVX2 u32 rgbaRowsAvx2(const Coefficients& k,
+                         const u8* src,
+                         usize srcStride,
+                         u32 width,
+                         u32 rowBegin,
+                         u32 rowEnd,
+                         const PlanarImage& dst) {
+    constexpr u32 STEP = rowStep(Chroma);
+    const u32 cShift = 16 + chromaShift(Chroma);
+    const Row3 luma = row(k.yr, k.yg, k.yb, lumaBias(k), 16);
+    const Row3 cb = row(k.ur, k.ug, k.ub, chromaBias(cShift), cShift);
+    const Row3 cr = row(k.vr, k.vg, k.vb, chromaBias(cShift), cShift);
+    const u32 end = width & ~15u;
+
+    for (u32 y = rowBegin; y < rowEnd; y += STEP) {
+        const u32 y1 = std::min(y + STEP - 1, rowEnd - 1); // Odd last row
+        const u8* in0 = src + y * srcStride;
+        const u8* in1 = src + y1 * srcStride;
+        u8* luma0 = dst.data[0] + static_cast<usize>(y) * dst.stride[0];
+        u8* luma1 = dst.data[0] + static_cast<usize>(y1) * dst.stride[0];
+        u8* u = dst.data[1] + static_cast<usize>(y / STEP) * dst.stride[1];
+        u8* v = dst.data[2] + static_cast<usize>(y / STEP) * dst.stride[2];
+
+        for (u32 x = 0; x < end; x += 16) {
+            Rgb8 a = unpack(in0 + x * 4);
+            Rgb8 b = unpack(in0 + x * 4 + 32);
+            store16(luma0 + x, apply(a, luma), apply(b, luma));
+
+            if constexpr (Chroma == ChromaFormat::Yuv444) {
+                store16(u + x, apply(a, cb), apply(b, cb));
+                store16(v + x, apply(a, cr), apply(b, cr));
+                continue;
+            }
+            if constexpr (Chroma == ChromaFormat::Yuv420) {
+                Rgb8 a1 = unpack(in1 + x * 4);
+                Rgb8 b1 = unpack(in1 + x * 4 + 32);
+                store16(luma1 + x, apply(a1, luma), apply(b1, luma));
+                a = add(a, a1);
+                b = add(b, b1);
+            }
+            Rgb8 sums = pairs(a, b);
+            store8(u + x / 2, apply(sums, cb));
+            store8(v + x / 2, apply(sums, cr));
+        }
+    }
+    return end;
+}
+
+#undef VC_AVX2
+
+#endif // VC_COLOR_X86
+
+} // namespace
+
+ColorConverter::ColorConverter(const Format& format, bool simd)
+    : format_(format),
+      coeffs_(makeCoefficients(format.fullRange)),
+      avx2_(simd && !format.vuya && cpuHasAvx2()) {}
+
+bool ColorConverter::cpuHasAvx2() {
+#ifdef VC_COLOR_X86
+    static const bool has = __builtin_cpu_supports("avx2");
+    return has;
+#else
+    return false;
+#endif
+}
+
+void ColorConverter::convert(const u8* src,
+                             usize srcStride,
+                             u32 width,
+                             u32 height,
+                             const PlanarImage& dst,
+                             WorkerPool* pool) const {
+    // Slice edges on even rows keep 4:2:0 chroma rows whole
+    const u32 align = rowStep(format_.chroma);
+    u32 slices = pool ? pool->size() + 1 : 1;
+    slices = std::clamp(height / MIN_SLICE_ROWS, 1u, slices);
+
+    auto slice = [&](u32 i) {
+        u32 begin = static_cast<u32>(u64(height) * i / slices) / align * align;
+        u32 end = i + 1 == slices
+                          ? height
+                          : static_cast<u32>(u64(height) * (i + 1) / slices) /
+                                    align * align;
+        convertRows(src, srcStride, width, begin, end, dst);
+    };
+    if (slices == 1)
+        slice(0);
+    else
+        pool->parallelFor(slices, slice);
+}
+
+void ColorConverter::convertRows(const u8* src,
+                                 usize srcStride,
+                                 u32 width,
+                                 u32 rowBegin,
+                                 u32 rowEnd,
+                                 const PlanarImage& dst) const {
+    if (format_.vuya) {
+        vuyaRows(src, srcStride, width, rowBegin, rowEnd, dst);
+        return;
+    }
+
+    u32 done = 0;
+#ifdef VC_COLOR_X86
+    if (avx2_) {
+        switch (format_.chroma) {
+        case ChromaFormat::Yuv420:
+            done = rgbaRowsAvx2<ChromaFormat::Yuv420>(
+                    coeffs_, src, srcStride, width, rowBegin, rowEnd, dst);
+            break;
+        case ChromaFormat::Yuv422:
+            done = rgbaRowsAvx2<ChromaFormat::Yuv422>(
+                    coeffs_, src, srcStride, width, rowBegin, rowEnd, dst);
+            break;
+        case ChromaFormat::Yuv444:
+            done = rgbaRowsAvx2<ChromaFormat::Yuv444>(
+                    coeffs_, src, srcStride, width, rowBegin, rowEnd, dst);
+            break;
+        }
+    }
+#endif
+    if (done < width)
+        rgbaRowsScalar(src, srcStride, done, width, rowBegin, rowEnd, dst);
+}
+
+void ColorConverter::rgbaRowsScalar(const u8* src,
+                                    usize srcStride,
+                                    u32 xBegin,
+                                    u32 width,
+                                    u32 rowBegin,
+                                    u32 rowEnd,
+                                    const PlanarImage& dst) const {
+    const auto& k = coeffs_;
+    const u32 step = rowStep(format_.chroma);
+    const u32 xShift = chromaShiftX(format_.chroma);
+    const u32 cShift = 16 + chromaShift(format_.chroma);
+    const i32 yBias = lumaBias(k);
+    const i32 cBias = chromaBias(cShift);
+
+    for (u32 y = rowBegin; y < rowEnd; y += step) {
+        const u32 y1 = std::min(y + step - 1, rowEnd - 1);
+        const u8* in[2] = {src + y * srcStride, src + y1 * srcStride};
+        u8* luma[2] = {dst.data[0] + static_cast<usize>(y) * dst.stride[0],
+                       dst.data[0] + static_cast<usize>(y1) * dst.stride[0]};
+        u8* u = dst.data[1] + static_cast<usize>(y / step) * dst.stride[1];
+        u8* v = dst.data[2] + static_cast<usize>(y / step) * dst.stride[2];
+
+        for (u32 x = xBegin; x < width; x += 1u << xShift) {
+            i32 r = 0, g = 0, b = 0;
+            for (u32 row = 0; row < step; ++row) {
+                for (u32 dx = 0; dx < (1u << xShift); ++dx) {
+                    const u32 px = std::min(x + dx, width - 1); // Odd width
+                    const u8* p = in[row] + px * 4;
+                    luma[row][px] = clampByte(
+                            (k.yr * p[0] + k.yg * p[1] + k.yb * p[2] + yBias) >>
+                            16);
+                    r += p[0];
+                    g += p[1];
+                    b += p[2];
+                }
+            }
+            u[x >> xShift] =
+                    clampByte((k.ur * r + k.ug * g + k.ub * b + cBias) >> cShift);
+            v[x >> xShift] =
+                    clampByte((k.vr * r + k.vg * g + k.vb * b + cBias) >> cShift);
+        }
+    }
+}
+
+void ColorConverter::vuyaRows(const u8* src,
+                              usize srcStride,
+                              u32 width,
+                              u32 rowBegin,
+                              u32 rowEnd,
+                              const PlanarImage& dst) const {
+    // Already Y'CbCr; only the chroma needs subsampling
+    const u32 step = rowStep(format_.chroma);
+    const u32 xShift = chromaShiftX(format_.chroma);
+    const u32 shift = chromaShift(format_.chroma);
+    const u32 round = (1u << shift) >> 1;
+
+    for (u32 y = rowBegin; y < rowEnd; y += step) {
+        const u32 y1 = std::min(y + step - 1, rowEnd - 1);
+        const u8* in[2] = {src + y * srcStride, src + y1 * srcStride};
+        u8* luma[2] = {dst.data[0] + static_cast<usize>(y) * dst.stride[0],
+                       dst.data[0] + static_cast<usize>(y1) * dst.stride[0]};
+        u8* u = dst.data[1] + static_cast<usize>(y / step) * dst.stride[1];
+        u8* v = dst.data[2] + static_cast<usize>(y / step) * dst.stride[2];
+
+        for (u32 x = 0; x < width; x += 1u << xShift) {
+            u32 cb = 0, cr = 0;
+            for (u32 row = 0; row < step; ++row) {
+                for (u32 dx = 0; dx < (1u << xShift); ++dx) {
+                    const u32 px = std::min(x + dx, width - 1); // Odd width
+                    const u8* p = in[row] + px * 4;
+                    luma[row][px] = p[2];
+                    cb += p[1];
+                    cr += p[0];
+                }
+            }
+            u[x >> xShift] = static_cast<u8>((cb + round) >> shift);
+            v[x >> xShift] = static_cast<u8>((cr + round) >> shift);
+        }
+    }
+}
+
+} // namespace vc
@@ -0,0 +1,96 @@
+#pragma once
+// ColorConvert.hpp - Captured frames to planar YUV, without swscale
+// sws_scale is a Swiss army knife; we only ever needed the bottle opener
+
+#include "util/Types.hpp"
+
+#include <array>
+
+namespace vc {
+
+class WorkerPool;
+
+enum class ChromaFormat { Yuv420, Yuv422, Yuv444 };
+
+// Destination planes (Y, U, V), e.g. an AVFrame's data and linesize
+struct PlanarImage {
+    std::array<u8*, 3> data{};
+    std::array<i32, 3> stride{};
+};
+
+// Converts same-size frames from the capture path (RGBA, or VUYA when the
+// compositor already did the matrix) to planar 4:2:0, 4:2:2 or 4:4:4 with
+// BT.709 coefficients in limited or full range. Chroma is the average of
+// the pixels it covers; an odd last column or row counts twice. RGBA rows
+// run through an AVX2 kernel when the CPU has one, with a scalar kernel
+// doing the same fixed-point maths for the rest, so both produce identical
+// bytes.
+//
+// convert() cuts the frame into horizontal slices and spreads them over a
+// WorkerPool. Slices only share the read-only source, so there's nothing
+// to synchronise beyond waiting for the last one.
+class ColorConverter {
+public:
+    struct Format {
+        bool vuya{false}; // Source is BT.709 limited VUYA, not RGBA
+        ChromaFormat chroma{ChromaFormat::Yuv420};
+        bool fullRange{false}; // RGBA sources only; VUYA is what it is
+    };
+
+    static constexpr u32 MIN_SLICE_ROWS = 64;
+
+    // `simd` false forces the scalar kernel
+    explicit ColorConverter(const Format& format, bool simd = true);
+
+    // Whole frame, sliced over `pool` (may be null) and the calling thread
+    void convert(const u8* src,
+                 usize srcStride,
+                 u32 width,
+                 u32 height,
+                 const PlanarImage& dst,
+                 WorkerPool* pool) const;
+
+    // Rows [rowBegin, rowEnd). For 4:2:0 both must be even.
+    void convertRows(const u8* src,
+                     usize srcStride,
+                     u32 width,
+                     u32 rowBegin,
+                     u32 rowEnd,
+                     const PlanarImage& dst) const;
+
+    const Format& format() const {
+        return format_;
+    }
+    bool usesAvx2() const {
+        return avx2_;
+    }
+    static bool cpuHasAvx2();
+
+    // Q16 fixed-point BT.709 matrix, offsets included in the bias terms
+    struct Coefficients {
+        i32 yr, yg, yb, yOffset;
+        i32 ur, ug, ub;
+        i32 vr, vg, vb;
+    };
+
+private:
+    void rgbaRowsScalar(const u8* src,
+                        usize srcStride,
+                        u32 xBegin,
+                        u32 width,
+                        u32 rowBegin,
+                        u32 rowEnd,
+                        const PlanarImage& dst) const;
+    void vuyaRows(const u8* src,
+                  usize srcStride,
+                  u32 width,
+                  u32 rowBegin,
+                  u32 rowEnd,
+                  const PlanarImage& dst) const;
+
+    Format format_;
+    Coefficients coeffs_{};
+    bool avx2_{false};
+};
+
+} // namespace vc
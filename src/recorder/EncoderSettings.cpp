@@ -2,6 +2,9 @@
 #include "core/Config.hpp"
 #include "core/Logger.hpp"
 
+#include <algorithm>
+#include <cctype>
+
 namespace vc {
 
 std::string VideoSettings::codecName() const {
@@ -78,6 +81,16 @@ std::string AudioSettings::codecName() const {
     return "aac";
 }
 
+std::string Rendition::suffix() const {
+    return name.empty() ? std::to_string(height) + "p" : name;
+}
+
+fs::path Rendition::pathFor(const fs::path& outputPath) const {
+    return outputPath.parent_path() /
+           (outputPath.stem().string() + "_" + suffix() +
+            outputPath.extension().string());
+}
+
 std::string EncoderSettings::containerExtension() const {
     switch (container) {
     case Container::MP4:
@@ -94,6 +107,28 @@ std::string EncoderSettings::containerExtension() const {
     return ".mp4";
 }
 
+BackpressurePolicy EncoderSettings::parseBackpressure(const std::string& name) {
+    if (name == "block")
+        return BackpressurePolicy::BlockProducer;
+    if (name == "duplicate")
+        return BackpressurePolicy::DuplicatePrevious;
+    if (name != "drop_oldest")
+        LOG_WARN("Unknown backpressure policy '{}', using drop_oldest", name);
+    return BackpressurePolicy::DropOldest;
+}
+
+std::string EncoderSettings::backpressureName(BackpressurePolicy policy) {
+    switch (policy) {
+    case BackpressurePolicy::DropOldest:
+        return "drop_oldest";
+    case BackpressurePolicy::BlockProducer:
+        return "block";
+    case BackpressurePolicy::DuplicatePrevious:
+        return "duplicate";
+    }
+    return "drop_oldest";
+}
+
 Result<void> EncoderSettings::validate() const {
     // Check codec/container compatibility
     if (container == Container::WebM) {
@@ -125,6 +160,38 @@ Result<void> EncoderSettings::validate() const {
         return Result<void>::err("CRF must be between 0 and 51");
     }
 
+    if (replay.enabled && replay.seconds == 0) {
+        return Result<void>::err("Replay buffer needs a length in seconds");
+    }
+
+    // Renditions are scaled down from the main video, never up
+    if (replay.enabled && !renditions.empty()) {
+        return Result<void>::err("Replay mode records a single rendition");
+    }
+    for (usize i = 0; i < renditions.size(); ++i) {
+        const auto& rendition = renditions[i];
+        if (rendition.width == 0 || rendition.height == 0 ||
+            rendition.width % 2 != 0 || rendition.height % 2 != 0) {
+            return Result<void>::err("Rendition dimensions must be even");
+        }
+        if (rendition.width > video.width || rendition.height > video.height) {
+            return Result<void>::err("Renditions can't be larger than the "
+                                     "main video");
+        }
+        if (rendition.crf > 51) {
+            return Result<void>::err("CRF must be between 0 and 51");
+        }
+        // Two with the same name (or no name and the same height) would
+        // write the same file
+        for (usize j = 0; j < i; ++j) {
+            if (renditions[j].suffix() == rendition.suffix()) {
+                return Result<void>::err("Two renditions would write _" +
+                                         rendition.suffix() +
+                                         "; give them different names");
+            }
+        }
+    }
+
     return Result<void>::ok();
 }
 
@@ -146,6 +213,12 @@ EncoderSettings EncoderSettings::fromConfig() {
     settings.video.width = recCfg.video.width;
     settings.video.height = recCfg.video.height;
     settings.video.fps = recCfg.video.fps;
+    settings.video.gpuYCbCr = recCfg.video.gpuYCbCr;
+    settings.video.fullRange = recCfg.video.fullRange;
+    if (recCfg.video.pixelFormat == "yuv422p")
+        settings.video.pixelFormat = PixelFormat::YUV422P;
+    else if (recCfg.video.pixelFormat == "yuv444p")
+        settings.video.pixelFormat = PixelFormat::YUV444P;
     settings.video.crf = 23; // Default to 23 for better performance on N4500
 
     // Parse preset
@@ -183,9 +256,49 @@ EncoderSettings EncoderSettings::fromConfig() {
     else if (recCfg.container == "mov")
         settings.container = Container::MOV;
 
+    settings.backpressure = parseBackpressure(recCfg.backpressure);
+    settings.convertThreads = recCfg.convertThreads;
+    settings.audioClock = recCfg.audioClock;
+
+    settings.file.fragmentSeconds = recCfg.fragmentSeconds;
+    settings.file.segmentSeconds = recCfg.segmentSeconds;
+    settings.file.segmentMegabytes = recCfg.segmentMegabytes;
+    settings.replay.enabled = recCfg.replay.enabled;
+    settings.replay.seconds = recCfg.replay.seconds;
+    settings.replay.maxMegabytes = recCfg.replay.maxMegabytes;
+
+    for (const auto& cfg : recCfg.renditions) {
+        Rendition rendition;
+        rendition.name = cfg.name;
+        rendition.width = cfg.width;
+        rendition.height = cfg.height;
+        rendition.crf = cfg.crf;
+        rendition.bitrate = cfg.bitrate;
+        settings.renditions.push_back(std::move(rendition));
+    }
+
     return settings;
 }
 
+Result<EncoderSettings> EncoderSettings::fromPreset(std::string_view name) {
+    auto lower = [](std::string_view text) {
+        std::string out(text);
+        std::ranges::transform(out, out.begin(), [](unsigned char c) {
+            return static_cast<char>(std::tolower(c));
+        });
+        return out;
+    };
+    std::string names;
+    for (auto& preset : getQualityPresets()) {
+        if (lower(preset.name) == lower(name))
+            return Result<EncoderSettings>::ok(std::move(preset.settings));
+        names += (names.empty() ? "" : ", ") + preset.name;
+    }
+    return Result<EncoderSettings>::err("Unknown encoder preset '" +
+                                        std::string(name) + "' (" + names +
+                                        ")");
+}
+
 EncoderSettings EncoderSettings::youtube1080p60() {
     EncoderSettings s;
     s.video.codec = VideoCodec::H264;
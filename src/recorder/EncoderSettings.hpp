@@ -58,6 +58,13 @@ enum class PixelFormat {
     RGB24       // For lossless
 };
 
+// What the capture queue does when the encoder falls behind
+enum class BackpressurePolicy {
+    DropOldest,        // Live: keep latency bounded, lose old frames
+    BlockProducer,     // Offline: stall rendering, never lose a frame
+    DuplicatePrevious  // CFR: drop the new frame, repeat the last one
+};
+
 struct VideoSettings {
     VideoCodec codec{VideoCodec::H264};
     u32 width{1920};
@@ -70,6 +77,9 @@ struct VideoSettings {
     u32 gopSize{0};             // 0 = auto (fps * 2)
     u32 bFrames{3};
     bool twoPass{false};
+    bool gpuYCbCr{false};       // Frames arrive as BT.709 VUYA, not RGBA
+    bool fullRange{false};      // Full-range YUV from RGBA (not gpuYCbCr)
+    bool closedGop{false};      // No GOP refers to the one before it
     
     // Codec-specific options
     std::string extraOptions;
@@ -85,15 +95,51 @@ struct AudioSettings {
     u32 sampleRate{48000};
     u32 channels{2};
     u32 bitrate{320};           // kbps
+    bool enabled{true};         // false: a video-only file
     
     // Get FFmpeg codec name
     std::string codecName() const;
 };
 
+// Another output from the same capture: the main video's codec, preset and
+// container at its own size and quality, in <output>_<name>.<ext>
+struct Rendition {
+    std::string name; // Empty: "<height>p"
+    u32 width{1280};
+    u32 height{720};
+    u32 crf{23};
+    u32 bitrate{0};   // kbps, 0 = use CRF
+
+    // name, or "<height>p" without one
+    std::string suffix() const;
+    // outputPath with "_<suffix>" before the extension
+    fs::path pathFor(const fs::path& outputPath) const;
+};
+
+// How a recording is laid out on disk (see OutputWriter)
+struct FileSettings {
+    u32 fragmentSeconds{0}; // Fragmented MP4 / MKV clusters, 0 = moov at end
+    u32 segmentSeconds{0};  // New file every so often, 0 = one file
+    u32 segmentMegabytes{0}; // ... or every so many MB, 0 = no limit
+};
+
+// Instant replay: encode into memory, save the last stretch on demand
+struct ReplaySettings {
+    bool enabled{false};  // No file until VideoRecorder::saveReplay()
+    u32 seconds{60};      // At least this much is kept
+    u32 maxMegabytes{0};  // Cap on the packets kept, 0 = none
+};
+
 struct EncoderSettings {
     VideoSettings video;
     AudioSettings audio;
+    FileSettings file;
+    ReplaySettings replay;
+    std::vector<Rendition> renditions; // Extra outputs, none bigger than video
     Container container{Container::MP4};
+    BackpressurePolicy backpressure{BackpressurePolicy::DropOldest};
+    u32 convertThreads{0}; // Frame conversion workers, 0 = auto
+    bool audioClock{true}; // Place frames by timestamp on the audio clock
     fs::path outputPath;
     
     // Metadata
@@ -104,12 +150,19 @@ struct EncoderSettings {
     // Get container extension
     std::string containerExtension() const;
     
+    // Parse/format the recording.backpressure config value
+    static BackpressurePolicy parseBackpressure(const std::string& name);
+    static std::string backpressureName(BackpressurePolicy policy);
+    
     // Validate settings compatibility
     Result<void> validate() const;
     
     // Create from config
     static EncoderSettings fromConfig();
     
+    // One of getQualityPresets(), by name (case doesn't matter)
+    static Result<EncoderSettings> fromPreset(std::string_view name);
+    
     // Presets
     static EncoderSettings youtube1080p60();
     static EncoderSettings youtube4k60();
@@ -1,10 +1,15 @@
 #pragma once
 
+#include "util/Types.hpp"
+
 extern "C" {
 #include <libavformat/avformat.h>
 #include <libavcodec/avcodec.h>
 #include <libavutil/avutil.h>
 #include <libavutil/frame.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/opt.h>
+#include <libavutil/pixdesc.h>
 #include <libswscale/swscale.h>
 #include <libswresample/swresample.h>
 }
@@ -18,6 +23,7 @@ namespace vc {
 struct AVFrameDeleter { void operator()(AVFrame* f) const { if (f) av_frame_free(&f); } };
 struct AVPacketDeleter { void operator()(AVPacket* p) const { if (p) av_packet_free(&p); } };
 struct AVCodecContextDeleter { void operator()(AVCodecContext* c) const { if (c) avcodec_free_context(&c); } };
+struct AVCodecParametersDeleter { void operator()(AVCodecParameters* p) const { if (p) avcodec_parameters_free(&p); } };
 struct AVFormatContextDeleter { 
     void operator()(AVFormatContext* c) const { 
         if (c) {
@@ -28,16 +34,21 @@ struct AVFormatContextDeleter {
         }
     } 
 };
+struct AVInputContextDeleter { void operator()(AVFormatContext* c) const { if (c) avformat_close_input(&c); } };
 struct SwsContextDeleter { void operator()(SwsContext* s) const { if (s) sws_freeContext(s); } };
 struct SwrContextDeleter { void operator()(SwrContext* s) const { if (s) swr_free(&s); } };
+struct AVBufferPoolDeleter { void operator()(AVBufferPool* p) const { if (p) av_buffer_pool_uninit(&p); } };
 
 // Unique pointer aliases
 using AVFramePtr = std::unique_ptr<AVFrame, AVFrameDeleter>;
 using AVPacketPtr = std::unique_ptr<AVPacket, AVPacketDeleter>;
 using AVCodecContextPtr = std::unique_ptr<AVCodecContext, AVCodecContextDeleter>;
+using AVCodecParametersPtr = std::unique_ptr<AVCodecParameters, AVCodecParametersDeleter>;
 using AVFormatContextPtr = std::unique_ptr<AVFormatContext, AVFormatContextDeleter>;
+using AVInputContextPtr = std::unique_ptr<AVFormatContext, AVInputContextDeleter>;
 using SwsContextPtr = std::unique_ptr<SwsContext, SwsContextDeleter>;
 using SwrContextPtr = std::unique_ptr<SwrContext, SwrContextDeleter>;
+using AVBufferPoolPtr = std::unique_ptr<AVBufferPool, AVBufferPoolDeleter>;
 
 // Helper for error messages
 inline std::string ffmpegError(int err) {
@@ -46,4 +57,64 @@ inline std::string ffmpegError(int err) {
     return buf;
 }
 
+// Pictures of one size and format. A buffer comes back for reuse only
+// once the last frame referring to it is gone, so a picture an encoder
+// still holds is left alone instead of being overwritten or copied out
+// of the way; the pool grows to however many are out at once.
+class PictureBufferPool {
+public:
+    bool init(AVPixelFormat format, int width, int height) {
+        pool_.reset();
+        if (av_image_fill_linesizes(linesize_, format, width) < 0)
+            return false;
+        ptrdiff_t linesizes[4];
+        for (int i = 0; i < 4; ++i) {
+            linesize_[i] = (linesize_[i] + ALIGN - 1) & ~(ALIGN - 1);
+            linesizes[i] = linesize_[i];
+        }
+        int ret =
+                av_image_fill_plane_sizes(planeSize_, format, height, linesizes);
+        if (ret < 0)
+            return false;
+        usize bytes = 0;
+        for (usize size : planeSize_)
+            bytes += size;
+        pool_.reset(av_buffer_pool_init(bytes, nullptr));
+        format_ = format;
+        width_ = width;
+        height_ = height;
+        return pool_ != nullptr;
+    }
+
+    void reset() { pool_.reset(); }
+
+    // Drops whatever `frame` refers to and points it at a free picture
+    bool attach(AVFrame* frame) const {
+        av_frame_unref(frame);
+        frame->buf[0] = av_buffer_pool_get(pool_.get());
+        if (!frame->buf[0])
+            return false;
+        frame->format = format_;
+        frame->width = width_;
+        frame->height = height_;
+        u8* plane = frame->buf[0]->data;
+        for (int i = 0; i < 4; ++i) {
+            frame->data[i] = planeSize_[i] ? plane : nullptr;
+            frame->linesize[i] = linesize_[i];
+            plane += planeSize_[i];
+        }
+        return true;
+    }
+
+private:
+    static constexpr int ALIGN = 64; // Widest SIMD row loads
+
+    AVBufferPoolPtr pool_;
+    AVPixelFormat format_{AV_PIX_FMT_NONE};
+    int width_{0};
+    int height_{0};
+    int linesize_[4]{};
+    usize planeSize_[4]{};
+};
+
 } // namespace vc
@@ -2,6 +2,8 @@
 #include "core/Logger.hpp"
 #include "util/GLIncludes.hpp"
 #include <algorithm>
+#include <chrono>
+#include <cstring>
 
 namespace vc {
 
@@ -19,97 +21,135 @@ void FrameGrabber::setSize(u32 width, u32 height) {
 }
 
 void FrameGrabber::grab(RenderTarget& target, i64 timestamp) {
-    if (!running_) return;
+    if (!running_ || !pool_) return;
     
     GrabbedFrame frame;
     frame.width = target.width();
     frame.height = target.height();
     frame.timestamp = timestamp;
-    frame.frameNumber = frameNumber_++;
-    frame.data.resize(frame.width * frame.height * 4);
-    
+    // An exhausted pool or one sized for another resolution counts the
+    // drop itself
+    frame.data = pool_->acquire(usize(frame.width) * frame.height * 4);
+    if (!frame.data)
+        return;
+
     // Read pixels from render target
     target.readPixels(frame.data.data(), GL_RGBA, GL_UNSIGNED_BYTE);
     
-    // Flip if needed
-    if (flipVertical_) {
-        flipImage(frame.data, frame.width, frame.height);
-    }
-    
-    // Add to queue
-    {
-        std::lock_guard lock(queueMutex_);
-        
-        if (frameQueue_.size() >= MAX_QUEUE_SIZE) {
-            // Drop oldest frame
-            frameQueue_.pop();
-            ++droppedFrames_;
-        }
-        
-        frameQueue_.push(std::move(frame));
-    }
-    queueCond_.notify_one();
+    pushFrame(std::move(frame));
 }
 
-void FrameGrabber::grabScreen(u32 width, u32 height, i64 timestamp) {
-    if (!running_) return;
+bool FrameGrabber::pushFrame(GrabbedFrame&& frame) {
+    if (!running_)
+        return false;
     
-    GrabbedFrame frame;
-    frame.width = width;
-    frame.height = height;
-    frame.timestamp = timestamp;
     frame.frameNumber = frameNumber_++;
-    frame.data.resize(width * height * 4);
     
-    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, frame.data.data());
+    switch (policy_) {
+    case BackpressurePolicy::DropOldest:
+        // Evict until there's room. Another producer may refill the slot we
+        // freed, hence the loop.
+        while (!frameQueue_.tryPush(std::move(frame))) {
+            GrabbedFrame stale;
+            if (frameQueue_.tryPop(stale))
+                ++droppedOldest_;
+        }
+        break;
     
-    if (flipVertical_) {
-        flipImage(frame.data, width, height);
-    }
+    case BackpressurePolicy::BlockProducer:
+        if (!frameQueue_.tryPush(std::move(frame))) {
+            ++producerStalls_;
+            auto waitStart = std::chrono::steady_clock::now();
+            for (;;) {
+                u32 seen = spaceSeq_.load(std::memory_order_acquire);
+                if (frameQueue_.tryPush(std::move(frame)))
+                    break;
+                if (!running_)
+                    return false;
+                spaceSeq_.wait(seen, std::memory_order_acquire);
+            }
+            stallMicros_ += std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - waitStart).count();
+        }
+        break;
     
-    {
-        std::lock_guard lock(queueMutex_);
-        
-        if (frameQueue_.size() >= MAX_QUEUE_SIZE) {
-            frameQueue_.pop();
-            ++droppedFrames_;
+    case BackpressurePolicy::DuplicatePrevious:
+        // Repeats owed from earlier drops ride along with the next frame so
+        // the encoder fills the gap right where it happened
+        frame.repeatPrevious = owedRepeats_.exchange(0, std::memory_order_acq_rel);
+        if (!frameQueue_.tryPush(std::move(frame))) {
+            owedRepeats_.fetch_add(frame.repeatPrevious + 1,
+                                   std::memory_order_acq_rel);
+            ++droppedNewest_;
+            return false;
         }
-        
-        frameQueue_.push(std::move(frame));
+        break;
     }
-    queueCond_.notify_one();
+    
+    ++pushed_;
+    usize depth = frameQueue_.sizeApprox();
+    usize peak = peakDepth_.load(std::memory_order_relaxed);
+    while (depth > peak && !peakDepth_.compare_exchange_weak(peak, depth)) {
+    }
+    signalWork();
+    return true;
 }
 
-bool FrameGrabber::getNextFrame(GrabbedFrame& frame, u32 timeoutMs) {
-    std::unique_lock lock(queueMutex_);
-    
-    if (!queueCond_.wait_for(lock, std::chrono::milliseconds(timeoutMs),
-                              [this] { return !frameQueue_.empty() || !running_; })) {
+bool FrameGrabber::tryPop(GrabbedFrame& frame) {
+    if (!frameQueue_.tryPop(frame))
         return false;
-    }
     
-    if (frameQueue_.empty()) {
-        return false;
+    if (policy_ == BackpressurePolicy::BlockProducer) {
+        spaceSeq_.fetch_add(1, std::memory_order_release);
+        spaceSeq_.notify_all();
     }
-    
-    frame = std::move(frameQueue_.front());
-    frameQueue_.pop();
     return true;
 }
 
+void FrameGrabber::signalWork() {
+    workSeq_.fetch_add(1, std::memory_order_release);
+    workSeq_.notify_all();
+}
+
+void FrameGrabber::wake() {
+    signalWork();
+}
+
 bool FrameGrabber::hasFrames() const {
-    std::lock_guard lock(queueMutex_);
-    return !frameQueue_.empty();
+    return !frameQueue_.emptyApprox();
 }
 
 usize FrameGrabber::queueSize() const {
-    std::lock_guard lock(queueMutex_);
-    return frameQueue_.size();
+    return frameQueue_.sizeApprox();
+}
+
+StageDepth FrameGrabber::depth() const {
+    StageDepth depth;
+    depth.current = static_cast<u32>(frameQueue_.sizeApprox());
+    depth.peak = static_cast<u32>(peakDepth_.load(std::memory_order_relaxed));
+    depth.capacity = static_cast<u32>(frameQueue_.capacity());
+    return depth;
+}
+
+FrameQueueStats FrameGrabber::queueStats() const {
+    FrameQueueStats stats;
+    stats.pushed = pushed_;
+    stats.droppedOldest = droppedOldest_;
+    stats.droppedNewest = droppedNewest_;
+    stats.producerStalls = producerStalls_;
+    stats.stallMicros = stallMicros_;
+    return stats;
 }
 
 void FrameGrabber::resetStats() {
-    droppedFrames_ = 0;
     frameNumber_ = 0;
+    pushed_ = 0;
+    droppedOldest_ = 0;
+    droppedNewest_ = 0;
+    producerStalls_ = 0;
+    stallMicros_ = 0;
+    owedRepeats_ = 0;
+    peakDepth_ = 0;
 }
 
 void FrameGrabber::start() {
@@ -119,27 +159,15 @@ void FrameGrabber::start() {
 
 void FrameGrabber::stop() {
     running_ = false;
-    queueCond_.notify_all();
+    // Release anyone parked on either futex
+    spaceSeq_.fetch_add(1, std::memory_order_release);
+    spaceSeq_.notify_all();
+    signalWork();
 }
 
 void FrameGrabber::clear() {
-    std::lock_guard lock(queueMutex_);
-    while (!frameQueue_.empty()) {
-        frameQueue_.pop();
-    }
-}
-
-void FrameGrabber::flipImage(std::vector<u8>& data, u32 width, u32 height) {
-    u32 rowSize = width * 4;
-    std::vector<u8> temp(rowSize);
-    
-    for (u32 y = 0; y < height / 2; ++y) {
-        u8* top = data.data() + y * rowSize;
-        u8* bottom = data.data() + (height - 1 - y) * rowSize;
-        
-        std::memcpy(temp.data(), top, rowSize);
-        std::memcpy(top, bottom, rowSize);
-        std::memcpy(bottom, temp.data(), rowSize);
+    GrabbedFrame frame;
+    while (frameQueue_.tryPop(frame)) {
     }
 }
 
@@ -220,7 +248,7 @@ void AsyncFrameGrabber::startRead(RenderTarget& target, i64 timestamp) {
 }
 
 bool AsyncFrameGrabber::getCompletedFrame(GrabbedFrame& frame) {
-    if (!initialized_) return false;
+    if (!initialized_ || !pool_) return false;
     
     // Check oldest slot for completion
     for (auto& slot : pboSlots_) {
@@ -229,34 +257,28 @@ bool AsyncFrameGrabber::getCompletedFrame(GrabbedFrame& frame) {
             glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
             
             void* ptr = glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
-            if (ptr) {
+            const usize bytes = usize(width_) * height_ * 4;
+            FrameHandle buffer = ptr ? pool_->acquire(bytes) : FrameHandle{};
+            if (ptr && buffer) {
                 frame.width = width_;
                 frame.height = height_;
                 frame.timestamp = slot.timestamp;
                 frame.frameNumber = slot.frameNumber;
-                frame.data.resize(width_ * height_ * 4);
-                std::memcpy(frame.data.data(), ptr, frame.data.size());
+                frame.data = std::move(buffer);
+                std::memcpy(frame.data.data(), ptr, bytes);
                 
                 glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
                 glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
                 
                 slot.inUse = false;
                 slot.ready = true;
-                
-                // Flip image (OpenGL is bottom-up)
-                u32 rowSize = width_ * 4;
-                std::vector<u8> temp(rowSize);
-                for (u32 y = 0; y < height_ / 2; ++y) {
-                    u8* top = frame.data.data() + y * rowSize;
-                    u8* bottom = frame.data.data() + (height_ - 1 - y) * rowSize;
-                    std::memcpy(temp.data(), top, rowSize);
-                    std::memcpy(top, bottom, rowSize);
-                    std::memcpy(bottom, temp.data(), rowSize);
-                }
-                
+
                 return true;
             } else {
-                // Map failed - unbind and mark slot as ready to prevent leak
+                // Map failed (or pool exhausted) - unbind and mark slot as
+                // ready to prevent leak
+                if (ptr)
+                    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
                 glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
                 slot.inUse = false;
                 slot.ready = true;
@@ -3,52 +3,89 @@
 // Stealing pixels from the GPU like a pro
 
 #include <atomic>
-#include <condition_variable>
-#include <mutex>
-#include <queue>
-#include <thread>
 #include <vector>
+#include "EncoderSettings.hpp"
+#include "FramePool.hpp"
+#include "util/BoundedQueue.hpp"
+#include "util/StageQueue.hpp"
 #include "util/Types.hpp"
 #include "visualizer/RenderTarget.hpp"
 
 namespace vc {
 
 struct GrabbedFrame {
-    std::vector<u8> data;
+    FrameHandle data; // RGBA, width * height * 4 bytes, owned by a FramePool
     u32 width{0};
     u32 height{0};
     i64 timestamp{0}; // microseconds
     u32 frameNumber{0};
+    u32 repeatPrevious{0}; // CFR filler: encode the previous frame N times
+                           // before this one (DuplicatePrevious policy)
+};
+
+// Per-policy counters. Only the ones relevant to the active policy move.
+struct FrameQueueStats {
+    u64 pushed{0};
+    u64 droppedOldest{0};  // DropOldest: evicted to make room
+    u64 droppedNewest{0};  // DuplicatePrevious: rejected, repeated instead
+    u64 producerStalls{0}; // BlockProducer: pushes that had to wait
+    u64 stallMicros{0};    // BlockProducer: total time spent waiting
 };
 
 class FrameGrabber {
 public:
+    static constexpr usize MAX_QUEUE_SIZE = 32; // ~0.5 sec at 60fps
+
     FrameGrabber();
     ~FrameGrabber();
 
     // Configuration
     void setSize(u32 width, u32 height);
-    void setFlipVertical(bool flip) {
-        flipVertical_ = flip;
+    void setPool(FramePool* pool) {
+        pool_ = pool;
+    }
+    void setPolicy(BackpressurePolicy policy) {
+        policy_ = policy;
+    }
+    BackpressurePolicy policy() const {
+        return policy_;
     }
 
-    // Grab frame from render target
+    // Grab frame from render target. Rows are read as-is, so the target must
+    // already be top-down (see RenderTarget::blitTo's flipY).
     void grab(RenderTarget& target, i64 timestamp);
 
-    // Grab from current framebuffer
-    void grabScreen(u32 width, u32 height, i64 timestamp);
+    // Queue a frame according to the backpressure policy. Returns false if
+    // the frame was not queued (dropped, or the grabber is stopped).
+    bool pushFrame(GrabbedFrame&& frame);
 
-    // Get next frame (blocking)
-    bool getNextFrame(GrabbedFrame& frame, u32 timeoutMs = 100);
+    // Consumer side. tryPop never blocks; waitForWork sleeps on a futex until
+    // the work sequence moves past `seen` (a push, wake() or stop()).
+    bool tryPop(GrabbedFrame& frame);
+    u32 workSequence() const {
+        return workSeq_.load(std::memory_order_acquire);
+    }
+    void waitForWork(u32 seen) const {
+        workSeq_.wait(seen, std::memory_order_acquire);
+    }
+    void wake();
+
+    // Repeats owed for frames dropped after the last queued one. The
+    // encoder collects these when it drains at shutdown.
+    u32 takeOwedRepeats() {
+        return owedRepeats_.exchange(0, std::memory_order_acq_rel);
+    }
 
     // Check if frames available
     bool hasFrames() const;
     usize queueSize() const;
+    StageDepth depth() const;
 
     // Statistics
-    u32 droppedFrames() const {
-        return droppedFrames_;
+    u64 droppedFrames() const {
+        return droppedOldest_ + droppedNewest_;
     }
+    FrameQueueStats queueStats() const;
     void resetStats();
 
     // Control
@@ -56,37 +93,29 @@ public:
     void stop();
     void clear();
 
-    // Push frame directly
-    void pushFrame(GrabbedFrame&& frame) {
-        if (!running_)
-            return;
-        {
-            std::lock_guard lock(queueMutex_);
-            if (frameQueue_.size() >= MAX_QUEUE_SIZE) {
-                frameQueue_.pop();
-                ++droppedFrames_;
-            }
-            frameQueue_.push(std::move(frame));
-        }
-        queueCond_.notify_one();
-    }
-
 private:
-    void flipImage(std::vector<u8>& data, u32 width, u32 height);
+    void signalWork();
 
     u32 width_{1920};
     u32 height_{1080};
-    bool flipVertical_{true}; // OpenGL is bottom-up
+    FramePool* pool_{nullptr};
+    BackpressurePolicy policy_{BackpressurePolicy::DropOldest};
+
+    BoundedQueue<GrabbedFrame> frameQueue_{MAX_QUEUE_SIZE};
 
-    std::queue<GrabbedFrame> frameQueue_;
-    mutable std::mutex queueMutex_;
-    std::condition_variable queueCond_;
+    // Futex words: consumers wait on workSeq_, blocked producers on spaceSeq_
+    mutable std::atomic<u32> workSeq_{0};
+    std::atomic<u32> spaceSeq_{0};
+    std::atomic<u32> owedRepeats_{0};
 
     std::atomic<bool> running_{false};
     std::atomic<u32> frameNumber_{0};
-    std::atomic<u32> droppedFrames_{0};
-
-    static constexpr usize MAX_QUEUE_SIZE = 30; // ~0.5 sec at 60fps
+    std::atomic<u64> pushed_{0};
+    std::atomic<u64> droppedOldest_{0};
+    std::atomic<u64> droppedNewest_{0};
+    std::atomic<u64> producerStalls_{0};
+    std::atomic<u64> stallMicros_{0};
+    std::atomic<usize> peakDepth_{0};
 };
 
 // PBO-based async frame grabber for better performance
@@ -99,9 +128,15 @@ public:
     Result<void> init(u32 width, u32 height, u32 pboCount = 3);
     void shutdown();
 
-    // Start async read (non-blocking)
+    // Start async read (non-blocking). Like FrameGrabber::grab, the target
+    // must already be top-down.
     void startRead(RenderTarget& target, i64 timestamp);
 
+    // Frames are copied out of the PBOs into buffers from this pool
+    void setPool(FramePool* pool) {
+        pool_ = pool;
+    }
+
     // Get completed frame (non-blocking)
     bool getCompletedFrame(GrabbedFrame& frame);
 
@@ -123,6 +158,7 @@ private:
     u32 height_{0};
     u32 frameNumber_{0};
     bool initialized_{false};
+    FramePool* pool_{nullptr};
 };
 
 } // namespace vc
\ No newline at end of file
@@ -0,0 +1,329 @@
+#include "FramePool.hpp"
+#include "core/Logger.hpp"
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+namespace vc {
+
+namespace {
+
+constexpr usize HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+usize roundUp(usize value, usize align) {
+    return (value + align - 1) / align * align;
+}
+
+} // namespace
+
+struct FrameHandle::Slot {
+    u8* data{nullptr};
+    usize bytes{0}; // The frame size it was mapped for
+    std::atomic<u32> refs{0};
+    std::shared_ptr<FramePoolState> owner; // Set while handed out
+};
+
+// One init()'s buffers. A shut-down mapping with buffers still out is
+// retired and counts them back in.
+struct FramePoolMapping {
+    void* base{nullptr};
+    usize bytes{0};
+    std::vector<std::unique_ptr<FrameHandle::Slot>> slots;
+    usize outstanding{0}; // Only counted once retired
+
+    ~FramePoolMapping() {
+        if (base)
+            munmap(base, bytes);
+    }
+};
+
+struct FramePoolState {
+    // Hands a buffer back: to the free list, or to its retired mapping,
+    // which goes once its last buffer is back
+    void release(FrameHandle::Slot* slot);
+
+    std::unique_ptr<FramePoolMapping> mapping; // Null until init()
+    std::vector<std::unique_ptr<FramePoolMapping>> retired;
+    std::vector<FrameHandle::Slot*> freeList;
+    std::mutex mutex;
+    std::condition_variable freeCond;
+};
+
+// ================== FrameHandle ==================
+
+FrameHandle::~FrameHandle() {
+    reset();
+}
+
+FrameHandle::FrameHandle(const FrameHandle& other) : slot_(other.slot_) {
+    if (slot_)
+        slot_->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+FrameHandle& FrameHandle::operator=(const FrameHandle& other) {
+    if (this != &other) {
+        if (other.slot_)
+            other.slot_->refs.fetch_add(1, std::memory_order_relaxed);
+        reset();
+        slot_ = other.slot_;
+    }
+    return *this;
+}
+
+FrameHandle::FrameHandle(FrameHandle&& other) noexcept
+    : slot_(std::exchange(other.slot_, nullptr)) {
+}
+
+FrameHandle& FrameHandle::operator=(FrameHandle&& other) noexcept {
+    if (this != &other) {
+        reset();
+        slot_ = std::exchange(other.slot_, nullptr);
+    }
+    return *this;
+}
+
+u8* FrameHandle::data() const {
+    return slot_ ? slot_->data : nullptr;
+}
+
+usize FrameHandle::size() const {
+    return slot_ ? slot_->bytes : 0;
+}
+
+void FrameHandle::reset() {
+    if (!slot_)
+        return;
+    if (slot_->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        // Keeps the state (and the slot) alive through the release, even
+        // when the pool is gone and this was the last buffer out
+        auto owner = std::move(slot_->owner);
+        owner->release(slot_);
+    }
+    slot_ = nullptr;
+}
+
+void FramePoolState::release(FrameHandle::Slot* slot) {
+    auto contains = [slot](const FramePoolMapping& m) {
+        auto* base = static_cast<u8*>(m.base);
+        return slot->data >= base && slot->data < base + m.bytes;
+    };
+    {
+        std::lock_guard lock(mutex);
+        if (!mapping || !contains(*mapping)) {
+            // From a mapping shut down while this was out
+            auto it = std::find_if(retired.begin(),
+                                   retired.end(),
+                                   [&](const auto& m) { return contains(*m); });
+            if (it != retired.end() && --(*it)->outstanding == 0)
+                retired.erase(it);
+            return;
+        }
+        freeList.push_back(slot);
+    }
+    freeCond.notify_one();
+}
+
+// ================== FramePool ==================
+
+FramePool::FramePool() : state_(std::make_shared<FramePoolState>()) {
+}
+
+FramePool::~FramePool() {
+    // Buffers still out keep the state, and their mapping, until they're
+    // back
+    shutdown();
+}
+
+Result<void> FramePool::init(usize frameBytes, u32 count, bool hugePages) {
+    if (frameBytes == 0 || count == 0) {
+        return Result<void>::err("Invalid frame pool geometry");
+    }
+
+    auto& state = *state_;
+    {
+        std::lock_guard lock(state.mutex);
+        if (state.mapping && frameBytes == frameBytes_ &&
+            count == state.mapping->slots.size() && hugePages == hugePages_) {
+            return Result<void>::ok();
+        }
+    }
+
+    shutdown();
+
+    const usize pageSize = static_cast<usize>(sysconf(_SC_PAGESIZE));
+    usize stride = roundUp(frameBytes, hugePages ? HUGE_PAGE_SIZE : pageSize);
+    usize total = stride * count;
+
+    void* mem = MAP_FAILED;
+    bool gotHuge = false;
+
+    if (hugePages) {
+        // Explicit hugetlbfs pages first (needs vm.nr_hugepages), then fall
+        // back to transparent huge pages on a regular mapping.
+        mem = mmap(nullptr,
+                   total,
+                   PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE,
+                   -1,
+                   0);
+        gotHuge = mem != MAP_FAILED;
+    }
+
+    if (mem == MAP_FAILED) {
+        mem = mmap(nullptr,
+                   total,
+                   PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS,
+                   -1,
+                   0);
+        if (mem == MAP_FAILED) {
+            return Result<void>::err("Failed to map frame pool (" +
+                                     std::to_string(total) + " bytes)");
+        }
+        if (hugePages) {
+            gotHuge = madvise(mem, total, MADV_HUGEPAGE) == 0;
+        }
+        // Fault everything in now so the capture path never page-faults
+        madvise(mem, total, MADV_WILLNEED);
+        for (usize off = 0; off < total; off += pageSize) {
+            static_cast<volatile u8*>(mem)[off] = 0;
+        }
+    }
+
+    auto mapping = std::make_unique<FramePoolMapping>();
+    mapping->base = mem;
+    mapping->bytes = total;
+    mapping->slots.reserve(count);
+    for (u32 i = 0; i < count; ++i) {
+        auto slot = std::make_unique<FrameHandle::Slot>();
+        slot->data = static_cast<u8*>(mem) + i * stride;
+        slot->bytes = frameBytes;
+        mapping->slots.push_back(std::move(slot));
+    }
+
+    std::lock_guard lock(state.mutex);
+    frameBytes_ = frameBytes;
+    strideBytes_ = stride;
+    hugePages_ = gotHuge;
+    state.freeList.reserve(count);
+    for (auto& slot : mapping->slots)
+        state.freeList.push_back(slot.get());
+    state.mapping = std::move(mapping);
+
+    LOG_DEBUG("FramePool: {} x {} bytes ({} MB total, huge pages: {})",
+              count,
+              frameBytes,
+              total / (1024 * 1024),
+              gotHuge);
+    return Result<void>::ok();
+}
+
+void FramePool::shutdown() {
+    auto& state = *state_;
+    std::unique_lock lock(state.mutex);
+    if (!state.mapping)
+        return;
+
+    usize outstanding = state.mapping->slots.size() - state.freeList.size();
+    if (outstanding > 0) {
+        LOG_DEBUG("FramePool: {} buffers still in use, unmapping once "
+                  "they're back",
+                  outstanding);
+        state.mapping->outstanding = outstanding;
+        state.retired.push_back(std::move(state.mapping));
+    }
+    state.mapping.reset();
+    frameBytes_ = 0;
+    strideBytes_ = 0;
+    hugePages_ = false;
+    state.freeList.clear();
+    lock.unlock();
+
+    // Anyone still blocked in acquireWait() wakes up empty-handed
+    state.freeCond.notify_all();
+}
+
+bool FramePool::fits(usize bytes) {
+    if (!state_->mapping || bytes <= frameBytes_)
+        return true;
+    if (undersized_++ == 0) {
+        LOG_WARN("FramePool: {} byte frame doesn't fit {} byte buffers; "
+                 "dropping until the pool is resized",
+                 bytes,
+                 frameBytes_);
+    }
+    return false;
+}
+
+FrameHandle FramePool::popFree() {
+    auto* slot = state_->freeList.back();
+    state_->freeList.pop_back();
+    slot->refs.store(1, std::memory_order_relaxed);
+    slot->owner = state_;
+    return FrameHandle(slot);
+}
+
+FrameHandle FramePool::acquire(usize bytes) {
+    if (blocking_)
+        return acquireWait(BLOCKING_WAIT_MS, bytes);
+
+    std::lock_guard lock(state_->mutex);
+    if (!fits(bytes))
+        return {};
+    if (state_->freeList.empty()) {
+        ++exhausted_;
+        return {};
+    }
+    return popFree();
+}
+
+FrameHandle FramePool::acquireWait(u32 timeoutMs, usize bytes) {
+    auto& state = *state_;
+    std::unique_lock lock(state.mutex);
+    if (!fits(bytes))
+        return {};
+    auto hasFree = [&state] {
+        return !state.freeList.empty() || !state.mapping;
+    };
+
+    if (timeoutMs == 0) {
+        state.freeCond.wait(lock, hasFree);
+    } else if (!state.freeCond.wait_for(
+                       lock, std::chrono::milliseconds(timeoutMs), hasFree)) {
+        ++exhausted_;
+        return {};
+    }
+
+    // A re-init while we waited may have shrunk the buffers
+    if (!fits(bytes) || state.freeList.empty())
+        return {};
+    return popFree();
+}
+
+bool FramePool::isInitialized() const {
+    std::lock_guard lock(state_->mutex);
+    return state_->mapping != nullptr;
+}
+
+usize FramePool::frameBytes() const {
+    std::lock_guard lock(state_->mutex);
+    return frameBytes_;
+}
+
+u32 FramePool::capacity() const {
+    std::lock_guard lock(state_->mutex);
+    return state_->mapping ? static_cast<u32>(state_->mapping->slots.size())
+                           : 0;
+}
+
+u32 FramePool::available() const {
+    std::lock_guard lock(state_->mutex);
+    return static_cast<u32>(state_->freeList.size());
+}
+
+} // namespace vc
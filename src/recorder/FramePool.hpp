@@ -0,0 +1,131 @@
+#pragma once
+// FramePool.hpp - Fixed pool of page-aligned frame buffers
+// Because malloc'ing 33 MB sixty times a second is a lifestyle choice
+
+#include "util/Result.hpp"
+#include "util/Types.hpp"
+
+#include <atomic>
+#include <memory>
+
+namespace vc {
+
+class FramePool;
+struct FramePoolMapping;
+struct FramePoolState;
+
+// Reference-counted handle to a pooled buffer. Copies share the buffer; the
+// last handle to go away hands it back to the pool. Cheap to pass through
+// Qt signals and queues (one pointer, one atomic increment). A handle may
+// outlive its pool: the buffer stays mapped until it comes back.
+class FrameHandle {
+public:
+    FrameHandle() = default;
+    ~FrameHandle();
+
+    FrameHandle(const FrameHandle& other);
+    FrameHandle& operator=(const FrameHandle& other);
+    FrameHandle(FrameHandle&& other) noexcept;
+    FrameHandle& operator=(FrameHandle&& other) noexcept;
+
+    u8* data() const;
+    usize size() const;
+    bool empty() const {
+        return slot_ == nullptr;
+    }
+    explicit operator bool() const {
+        return slot_ != nullptr;
+    }
+
+    // Give the buffer back early (handle becomes empty)
+    void reset();
+
+private:
+    friend class FramePool;
+    friend struct FramePoolMapping;
+    friend struct FramePoolState;
+    struct Slot;
+
+    explicit FrameHandle(Slot* slot) : slot_(slot) {
+    }
+
+    Slot* slot_{nullptr};
+};
+
+class FramePool {
+public:
+    static constexpr u32 BLOCKING_WAIT_MS = 100;
+
+    FramePool();
+    ~FramePool();
+
+    // Non-copyable, non-movable
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    // Allocate `count` buffers of at least `frameBytes` each. Re-initializing
+    // with the same geometry keeps the existing mapping.
+    Result<void> init(usize frameBytes, u32 count, bool hugePages = false);
+    // Buffers still out (in a queued signal, say) keep their mapping until
+    // the last handle to each is gone; then it is unmapped. The same goes
+    // for destroying the pool.
+    void shutdown();
+
+    // Returns an empty handle when the pool is exhausted, or when its
+    // buffers are smaller than `bytes` (the frame size changed and the
+    // pool hasn't). In blocking mode it waits up to BLOCKING_WAIT_MS for a
+    // buffer first: a live producer (the render thread) slows down with
+    // the encoder but never hangs on it. Offline renders that must not
+    // drop call acquireWait() instead.
+    FrameHandle acquire(usize bytes = 0);
+    void setBlocking(bool blocking) {
+        blocking_ = blocking;
+    }
+    bool blocking() const {
+        return blocking_;
+    }
+
+    // Blocks until a buffer is free or the timeout expires (0 = forever)
+    FrameHandle acquireWait(u32 timeoutMs = 0, usize bytes = 0);
+
+    // Info
+    bool isInitialized() const;
+    usize frameBytes() const;
+    u32 capacity() const;
+    u32 available() const;
+    bool usingHugePages() const {
+        return hugePages_;
+    }
+
+    // Number of acquire() calls that found the pool empty
+    u64 exhaustedCount() const {
+        return exhausted_;
+    }
+    // Number of acquire() calls refused for buffers too small for the frame
+    u64 undersizedCount() const {
+        return undersized_;
+    }
+    void resetStats() {
+        exhausted_ = 0;
+        undersized_ = 0;
+    }
+
+private:
+    // Both under state_'s mutex
+    bool fits(usize bytes);
+    FrameHandle popFree();
+
+    // Mappings, free list and lock. Every buffer that is out holds a
+    // reference, so the last handle can still return it after we're gone.
+    std::shared_ptr<FramePoolState> state_;
+
+    usize frameBytes_{0}; // Under state_'s mutex
+    usize strideBytes_{0};
+    bool hugePages_{false};
+    std::atomic<bool> blocking_{false};
+
+    std::atomic<u64> exhausted_{0};
+    std::atomic<u64> undersized_{0};
+};
+
+} // namespace vc
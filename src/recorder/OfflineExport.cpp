@@ -0,0 +1,402 @@
+// clang-format off
+#include "visualizer/OffscreenRenderer.hpp" // GL headers first
+// clang-format on
+
+#include "OfflineExport.hpp"
+#include "SegmentConcat.hpp"
+#include "VideoRecorder.hpp"
+#include "audio/FFmpegAudioSource.hpp"
+#include "core/Config.hpp"
+#include "core/Logger.hpp"
+#include "util/FileUtils.hpp"
+#include "visualizer/PresetIndex.hpp"
+#include "visualizer/PresetManager.hpp"
+#include "visualizer/PresetPack.hpp"
+
+#include <QCoreApplication>
+#include <QProcess>
+#include <chrono>
+#include <cmath>
+#include <format>
+#include <limits>
+#include <thread>
+#include <vector>
+
+namespace vc {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr auto PROGRESS_INTERVAL = std::chrono::seconds(5);
+constexpr auto SIGNAL_INTERVAL = std::chrono::milliseconds(250);
+constexpr u32 CHANNELS = 2; // FFmpegAudioSource decodes to stereo
+constexpr u32 CORES_PER_WORKER = 8;
+constexpr int POLL_MS = 50;
+
+f64 secondsSince(Clock::time_point start) {
+    return std::chrono::duration<f64>(Clock::now() - start).count();
+}
+
+} // namespace
+
+OfflineExport::OfflineExport(Options options) : options_(std::move(options)) {}
+
+Result<std::string> OfflineExport::presetText() const {
+    if (options_.idlePreset)
+        return Result<std::string>::ok(std::string());
+
+    // A file given directly doesn't need the collection at all
+    if (!options_.preset.empty() && fs::is_regular_file(options_.preset))
+        return readPresetText(nullptr, options_.preset);
+
+    // The GUI's mapped index: parallel exports (and RenderQueue workers)
+    // look their presets up without walking the tree
+    PresetManager presets;
+    presets.setIndexPath(file::cacheDir() / "preset_index.bin");
+    if (auto result = presets.scan(CONFIG.visualizer().presetPath); !result)
+        return Result<std::string>::err(result.error().message);
+
+    const PresetInfo* chosen = nullptr;
+    if (!options_.preset.empty()) {
+        if (!presets.selectByName(options_.preset))
+            return Result<std::string>::err("Preset not found: " +
+                                            options_.preset);
+        chosen = presets.current();
+    } else {
+        // Stable per track, so re-rendering it gives the same video
+        auto active = presets.activePresets();
+        if (active.empty())
+            return Result<std::string>::err("No presets found in " +
+                                            CONFIG.visualizer()
+                                                    .presetPath.string());
+        auto name = options_.input.filename().string();
+        u64 hash = PresetIndex::hashBytes(name.data(), name.size());
+        chosen = active[hash % active.size()];
+    }
+    LOG_INFO("OfflineExport: preset {}", chosen->name);
+    return readPresetText(presets.pack().get(), chosen->path);
+}
+
+u32 OfflineExport::workerCount() const {
+    return options_.workers > 0 ? options_.workers : defaultWorkers();
+}
+
+u32 OfflineExport::defaultWorkers() {
+    u32 workers = CONFIG.recording().offline.workers;
+    if (workers > 0)
+        return workers;
+    // Each process keeps a render thread, a converter and a frame-threaded
+    // encoder busy, so a handful of cores apiece
+    return std::max(1u, std::thread::hardware_concurrency() / CORES_PER_WORKER);
+}
+
+Result<ExportStats> OfflineExport::run() {
+    auto& settings = options_.settings;
+    // Timing comes from the frame count, and every queue waits rather than
+    // drops: the render loop can't fall behind a clock that isn't running
+    settings.backpressure = BackpressurePolicy::BlockProducer;
+    settings.audioClock = false;
+    settings.audio.channels = CHANNELS;
+    // A crashed render is simply run again; a plain file suits editors and
+    // SegmentConcat better than fragments
+    settings.file = FileSettings{};
+    settings.replay.enabled = false;
+    // Chunks would each get their own; an export is cheap to run again at
+    // another size instead
+    settings.renditions.clear();
+
+    if (options_.chunk) {
+        // A segment for SegmentConcat: its own GOPs, the audio comes later
+        settings.video.closedGop = true;
+        settings.audio.enabled = false;
+        settings.convertThreads = 1; // The other processes want the cores
+        return render();
+    }
+
+    u32 workers = workerCount();
+    if (workers > 1) {
+        FFmpegAudioSource probe;
+        if (!probe.open(options_.input.string(),
+                        static_cast<int>(settings.audio.sampleRate))) {
+            return Result<ExportStats>::err("Could not decode " +
+                                            options_.input.string());
+        }
+        // Not worth a process start-up unless every worker gets a chunk
+        f64 duration = probe.durationSeconds();
+        f64 chunk = CONFIG.recording().offline.chunkSeconds;
+        if (duration >= chunk * 2)
+            return renderChunked(workers, duration);
+    }
+    return render();
+}
+
+Result<ExportStats> OfflineExport::render() {
+    const auto& settings = options_.settings;
+    const u32 width = settings.video.width;
+    const u32 height = settings.video.height;
+    const u64 fps = settings.video.fps;
+    const u64 rate = settings.audio.sampleRate;
+
+    FFmpegAudioSource audio;
+    if (!audio.open(options_.input.string(), static_cast<int>(rate))) {
+        return Result<ExportStats>::err("Could not decode " +
+                                        options_.input.string());
+    }
+
+    // A chunk starts rendering (but not recording) a little early, so
+    // projectM's state at its first frame looks like it has been playing
+    u64 firstFrame = 0;
+    u64 endFrame = std::numeric_limits<u64>::max();
+    u64 frame = 0;
+    if (options_.chunk) {
+        firstFrame = options_.chunk->firstFrame;
+        if (options_.chunk->frames > 0)
+            endFrame = firstFrame + options_.chunk->frames;
+        auto preroll = static_cast<u64>(
+                CONFIG.recording().offline.prerollSeconds * fps);
+        frame = firstFrame - std::min(firstFrame, preroll);
+        if (frame > 0 && !audio.seek(static_cast<f64>(frame * rate / fps) /
+                                     static_cast<f64>(rate))) {
+            return Result<ExportStats>::err("Could not seek " +
+                                            options_.input.string());
+        }
+    }
+
+    auto preset = presetText();
+    if (!preset)
+        return Result<ExportStats>::err(preset.error().message);
+
+    OffscreenRenderer renderer;
+    if (auto result = renderer.createSurface(); !result)
+        return Result<ExportStats>::err(result.error().message);
+    if (auto result = renderer.init(width, height, static_cast<u32>(fps));
+        !result) {
+        renderer.destroy();
+        return Result<ExportStats>::err(result.error().message);
+    }
+    if (!preset->empty()) {
+        if (auto result = renderer.loadPreset(*preset); !result) {
+            renderer.destroy();
+            return Result<ExportStats>::err(result.error().message);
+        }
+    }
+    if (!OffscreenRenderer::hasFrameTime()) {
+        LOG_WARN("OfflineExport: projectM older than 4.1 animates by the wall "
+                 "clock, so renders won't be exactly repeatable");
+    }
+
+    VideoRecorder recorder;
+    if (auto result = recorder.start(settings); !result) {
+        renderer.destroy();
+        return Result<ExportStats>::err(result.error().message);
+    }
+
+    ExportStats stats;
+    const usize frameBytes = static_cast<usize>(width) * height * 4;
+    const f64 duration = audio.durationSeconds();
+    std::vector<f32> pcm;
+    auto started = Clock::now();
+    auto lastReport = started;
+    auto lastProgress = started;
+    bool failed = false;
+
+    for (; frame < endFrame && !cancelled_.load(std::memory_order_relaxed);
+         ++frame) {
+        // This frame's slot in samples, computed from zero each time so
+        // rounding never accumulates
+        u64 first = frame * rate / fps;
+        auto wanted = static_cast<usize>((frame + 1) * rate / fps - first);
+        pcm.resize(wanted * CHANNELS);
+        usize got = audio.read(pcm.data(), wanted);
+        if (got == 0)
+            break;
+
+        renderer.addPCM(pcm.data(), static_cast<u32>(got), CHANNELS);
+        renderer.setFrameTime(static_cast<f64>(frame) / fps);
+        renderer.renderFrame();
+        if (frame < firstFrame)
+            continue; // Pre-roll
+
+        if (settings.audio.enabled) {
+            recorder.submitAudioSamples(
+                    pcm.data(), static_cast<u32>(got), CHANNELS, rate);
+        }
+
+        // Waits for a free buffer when the encoder is behind, however long
+        FrameHandle buffer = recorder.framePool().acquireWait();
+        if (!buffer || buffer.size() < frameBytes) {
+            LOG_ERROR("OfflineExport: no frame buffer at frame {}", frame);
+            failed = true;
+            break;
+        }
+        renderer.readFrame(buffer.data());
+        recorder.submitVideoFrame(
+                std::move(buffer),
+                width,
+                height,
+                static_cast<i64>((frame - firstFrame) * 1'000'000 / fps));
+        ++stats.frames;
+        stats.audioSamples += got;
+
+        if (duration > 0.0 && Clock::now() - lastProgress >= SIGNAL_INTERVAL) {
+            f64 done = static_cast<f64>(frame + 1 - firstFrame) / fps;
+            f64 total = options_.chunk && options_.chunk->frames > 0
+                                ? static_cast<f64>(options_.chunk->frames) / fps
+                                : duration - static_cast<f64>(firstFrame) / fps;
+            progress.emitSignal(std::clamp(done / total, 0.0, 1.0));
+            lastProgress = Clock::now();
+        }
+        if (Clock::now() - lastReport >= PROGRESS_INTERVAL) {
+            f64 media = static_cast<f64>(first + got) / rate;
+            LOG_INFO("OfflineExport: {:.0f}/{:.0f} s, {:.2f}x realtime",
+                     media,
+                     duration,
+                     static_cast<f64>(stats.audioSamples) / rate /
+                             secondsSince(started));
+            lastReport = Clock::now();
+        }
+        if (got < wanted)
+            break; // End of the track
+    }
+
+    // Drains every stage, so the file is complete even when cancelled
+    recorder.stop();
+    renderer.destroy();
+
+    stats.mediaSeconds = static_cast<f64>(stats.audioSamples) / rate;
+    stats.wallSeconds = secondsSince(started);
+    stats.framesDropped = recorder.stats().framesDropped;
+    if (failed)
+        return Result<ExportStats>::err("Export failed at frame " +
+                                        std::to_string(frame));
+    if (cancelled_)
+        return Result<ExportStats>::err("Export cancelled");
+    if (recorder.state() == RecordingState::Error)
+        return Result<ExportStats>::err("Encoding failed");
+    return Result<ExportStats>::ok(stats);
+}
+
+Result<ExportStats> OfflineExport::renderChunked(u32 workers, f64 duration) {
+    const auto& settings = options_.settings;
+    const u64 fps = settings.video.fps;
+    const u64 gop = settings.video.gopSize > 0 ? settings.video.gopSize
+                                               : fps * 2;
+
+    // Whole GOPs per chunk, so every chunk starts where a serial export
+    // would have put a keyframe anyway
+    auto gops = static_cast<u64>(std::llround(
+            CONFIG.recording().offline.chunkSeconds * fps /
+            static_cast<f64>(gop)));
+    const u64 chunkFrames = std::max<u64>(gops, 1) * gop;
+    const auto totalFrames = static_cast<u64>(std::ceil(duration * fps));
+    const u64 chunks = (totalFrames + chunkFrames - 1) / chunkFrames;
+    workers = static_cast<u32>(std::min<u64>(workers, chunks));
+
+    fs::path dir = settings.outputPath;
+    dir += ".chunks";
+    if (auto result = file::ensureDir(dir); !result)
+        return Result<ExportStats>::err(result.error().message);
+
+    std::vector<SegmentConcat::Segment> segments;
+    for (u64 i = 0; i < chunks; ++i) {
+        segments.push_back(
+                {dir / std::format("{:05}{}", i, settings.containerExtension()),
+                 i * chunkFrames});
+    }
+    LOG_INFO("OfflineExport: {} chunks of {} frames across {} processes",
+             chunks,
+             chunkFrames,
+             workers);
+
+    struct Worker {
+        std::unique_ptr<QProcess> process;
+        u64 chunk;
+    };
+    std::vector<Worker> running;
+    u64 next = 0;
+    u64 done = 0;
+    std::string error;
+    bool stopping = false;
+    auto started = Clock::now();
+    const auto program = QCoreApplication::applicationFilePath();
+
+    while (next < chunks || !running.empty()) {
+        // A failure or a cancel stops the rest; segments already being
+        // written get finished off by the cancel in their own process
+        if (!stopping && (cancelled() || !error.empty())) {
+            for (auto& worker : running)
+                worker.process->terminate();
+            stopping = true;
+        }
+        while (!stopping && running.size() < workers && next < chunks) {
+            QStringList args;
+            for (const auto& arg : options_.workerArgs)
+                args << QString::fromStdString(arg);
+            // The last chunk runs to whatever end the decoder finds
+            u64 frames = next + 1 < chunks ? chunkFrames : 0;
+            args << "--headless" << "--export-chunk"
+                 << QString::number(segments[next].firstFrame)
+                 << QString::number(frames) << "--output"
+                 << QString::fromStdString(segments[next].path.string())
+                 << QString::fromStdString(options_.input.string());
+
+            auto process = std::make_unique<QProcess>();
+            process->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+            process->setStandardOutputFile(QProcess::nullDevice());
+            process->start(program, args);
+            if (!process->waitForStarted()) {
+                error = "Could not start a render process: " +
+                        process->errorString().toStdString();
+                break;
+            }
+            running.push_back({std::move(process), next++});
+        }
+
+        for (auto it = running.begin(); it != running.end();) {
+            if (!it->process->waitForFinished(POLL_MS)) {
+                ++it;
+                continue;
+            }
+            if (it->process->exitStatus() != QProcess::NormalExit ||
+                it->process->exitCode() != 0) {
+                if (error.empty() && !stopping)
+                    error = "Chunk " + std::to_string(it->chunk) + " failed";
+            } else {
+                ++done;
+                progress.emitSignal(static_cast<f64>(done) / chunks);
+                LOG_INFO("OfflineExport: chunk {} done ({}/{}), {:.0f} s",
+                         it->chunk,
+                         done,
+                         chunks,
+                         secondsSince(started));
+            }
+            it = running.erase(it);
+        }
+    }
+
+    auto cleanup = [&] {
+        std::error_code ec;
+        fs::remove_all(dir, ec);
+    };
+    if (!error.empty() || cancelled()) {
+        cleanup();
+        return Result<ExportStats>::err(error.empty() ? "Export cancelled"
+                                                      : error);
+    }
+
+    SegmentConcat concat(std::move(segments), options_.input, settings);
+    auto joined = concat.run();
+    cleanup();
+    if (!joined)
+        return Result<ExportStats>::err(joined.error().message);
+
+    ExportStats stats;
+    stats.frames = concat.videoFrames();
+    stats.mediaSeconds = static_cast<f64>(stats.frames) / fps;
+    stats.audioSamples = concat.audioSamples();
+    stats.wallSeconds = secondsSince(started);
+    return Result<ExportStats>::ok(stats);
+}
+
+} // namespace vc
@@ -0,0 +1,96 @@
+#pragma once
+// OfflineExport.hpp - Renders a track to video as fast as the box allows
+// No speakers, no vsync, no dropped frames, no excuses
+
+#include "EncoderSettings.hpp"
+#include "util/Result.hpp"
+#include "util/Signal.hpp"
+#include "util/Types.hpp"
+
+#include <atomic>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace vc {
+
+struct ExportStats {
+    u64 frames{0};
+    u64 audioSamples{0}; // Per channel
+    f64 mediaSeconds{0.0};
+    f64 wallSeconds{0.0};
+    u64 framesDropped{0}; // Anything but 0 is a bug
+};
+
+// The offline counterpart of a live recording. FFmpegAudioSource decodes
+// the track and every video frame gets exactly the samples in its 1/fps
+// slot: projectM hears them before rendering that frame (at that frame's
+// time, not the wall clock's) and the recorder's audio track is those same
+// samples. Frames are read back from an OffscreenRenderer into the
+// recorder's pool and submitted with the BlockProducer policy, so the
+// render loop waits whenever the encoder is behind and nothing is dropped.
+// Same track, settings and preset give the same video, however fast or
+// slow the machine.
+//
+// One projectM and one encoder leave most of a big machine idle, so a long
+// track is split into chunks on the GOP grid, and recording.offline.workers
+// copies of this program (--export-chunk) render them side by side. Each
+// renders prerollSeconds before its chunk without encoding them, so the
+// preset's feedback buffers and beat detection are warmed up at the join,
+// then encodes its frames as a video-only segment of closed GOPs.
+// SegmentConcat copies the segments into the output as they are and
+// encodes the audio track in one piece. The joins are the one place a
+// chunked export differs from a serial one: projectM's state there comes
+// from the pre-roll, not from the whole track before it.
+//
+// Runs on the GUI thread with a QApplication but no windows, so it works
+// under xvfb and llvmpipe (--software-gl), like PresetBenchmark.
+class OfflineExport {
+public:
+    // Frames [firstFrame, firstFrame + frames) of the track
+    struct Chunk {
+        u64 firstFrame{0};
+        u64 frames{0}; // 0 = to the end
+    };
+
+    struct Options {
+        fs::path input;
+        EncoderSettings settings; // outputPath included
+        std::string preset;       // Name or file; empty picks by track name
+        bool idlePreset{false};   // projectM's default, no preset at all
+        std::optional<Chunk> chunk; // Render just this, as a segment
+        u32 workers{0}; // Chunk processes, 0 = recording.offline.workers
+        std::vector<std::string> workerArgs; // For chunk processes' argv
+    };
+
+    explicit OfflineExport(Options options);
+
+    // Renders the whole track, or just the chunk. A cancelled serial export
+    // still finalizes the file up to where it got, then fails.
+    Result<ExportStats> run();
+
+    // Any thread (or a signal handler)
+    void cancel() {
+        cancelled_.store(true, std::memory_order_relaxed);
+    }
+    bool cancelled() const {
+        return cancelled_.load(std::memory_order_relaxed);
+    }
+
+    // Fraction done, a few times a second, from run()'s thread
+    Signal<f64> progress;
+
+    // Render processes when the config says 0: one per 8 cores
+    static u32 defaultWorkers();
+
+private:
+    Result<std::string> presetText() const;
+    u32 workerCount() const;
+    Result<ExportStats> render();
+    Result<ExportStats> renderChunked(u32 workers, f64 duration);
+
+    Options options_;
+    std::atomic<bool> cancelled_{false};
+};
+
+} // namespace vc
@@ -0,0 +1,191 @@
+#include "OutputWriter.hpp"
+#include "core/Logger.hpp"
+
+#include <format>
+#include <string>
+
+extern "C" {
+#include <libavutil/mathematics.h>
+}
+
+namespace vc {
+
+OutputWriter::~OutputWriter() {
+    close();
+}
+
+Result<void> OutputWriter::open(const std::vector<AVStream*>& streams,
+                                u32 videoStream,
+                                Options options) {
+    close();
+    options_ = std::move(options);
+    streams_.clear();
+    for (const auto* stream : streams) {
+        AVCodecParametersPtr params(avcodec_parameters_alloc());
+        if (!params ||
+            avcodec_parameters_copy(params.get(), stream->codecpar) < 0) {
+            return Result<void>::err("Failed to copy codec params");
+        }
+        streams_.push_back(Stream{std::move(params), stream->time_base});
+    }
+    videoStream_ = videoStream;
+    fileStartUs_ = 0;
+    fileBytes_ = 0;
+    bytesWritten_ = 0;
+    files_ = 0;
+
+    finalizeQueue_.reset();
+    finalizer_ = std::thread(&OutputWriter::finalizeThread, this);
+    return openFile();
+}
+
+Result<void> OutputWriter::openFile() {
+    fs::path path = segmented() ? segmentPath(options_.path, files_ + 1)
+                                : options_.path;
+    AVFormatContext* ctx = nullptr;
+    int ret = avformat_alloc_output_context2(
+            &ctx, nullptr, nullptr, path.c_str());
+    AVFormatContextPtr file(ctx);
+    if (ret < 0 || !file) {
+        return Result<void>::err("Failed to create output context: " +
+                                 ffmpegError(ret));
+    }
+
+    for (const auto& source : streams_) {
+        AVStream* stream = avformat_new_stream(file.get(), nullptr);
+        if (!stream)
+            return Result<void>::err("Failed to create output stream");
+        ret = avcodec_parameters_copy(stream->codecpar, source.params.get());
+        if (ret < 0)
+            return Result<void>::err("Failed to copy codec params");
+        stream->codecpar->codec_tag = 0; // The container picks its own
+        stream->time_base = source.timeBase;
+    }
+
+    if (!(file->oformat->flags & AVFMT_NOFILE)) {
+        ret = avio_open(&file->pb, path.c_str(), AVIO_FLAG_WRITE);
+        if (ret < 0) {
+            return Result<void>::err("Failed to open output file: " +
+                                     ffmpegError(ret));
+        }
+    }
+
+    // Each muxer takes the options it has and leaves the rest: movflags
+    // and frag_duration for MP4/MOV, cluster_time_limit for Matroska/WebM
+    AVDictionary* opts = nullptr;
+    if (options_.fragmentSeconds > 0) {
+        std::string ms =
+                std::to_string(static_cast<u64>(options_.fragmentSeconds) *
+                               1000);
+        av_dict_set(&opts,
+                    "movflags",
+                    "frag_keyframe+empty_moov+default_base_moof",
+                    0);
+        av_dict_set(&opts, "frag_duration", (ms + "000").c_str(), 0);
+        av_dict_set(&opts, "cluster_time_limit", ms.c_str(), 0);
+    }
+    ret = avformat_write_header(file.get(), &opts);
+    av_dict_free(&opts);
+    if (ret < 0) {
+        return Result<void>::err("Failed to write header: " + ffmpegError(ret));
+    }
+
+    file_ = std::move(file);
+    fileBytes_ = 0;
+    files_.fetch_add(1, std::memory_order_relaxed);
+    if (segmented())
+        LOG_DEBUG("Recording segment {}", path.string());
+    return Result<void>::ok();
+}
+
+void OutputWriter::write(AVPacketPtr packet) {
+    auto index = static_cast<usize>(packet->stream_index);
+    if (index >= streams_.size())
+        return;
+    AVRational timeBase = streams_[index].timeBase;
+
+    // Cut before a keyframe, so it opens the next file. One that failed to
+    // open is tried again at the next keyframe.
+    if (segmented() && index == videoStream_ &&
+        (packet->flags & AV_PKT_FLAG_KEY)) {
+        i64 ts = packet->dts != AV_NOPTS_VALUE ? packet->dts : packet->pts;
+        i64 us = av_rescale_q(ts, timeBase, AV_TIME_BASE_Q);
+        if (!file_ || segmentFull(us)) {
+            if (file_)
+                finalizeQueue_.push(std::move(file_));
+            fileStartUs_ = us;
+            if (auto result = openFile(); !result) {
+                LOG_ERROR("Segment {}: {}",
+                          files_ + 1,
+                          result.error().message);
+            }
+        }
+    }
+    if (!file_)
+        return;
+
+    i64 offset = av_rescale_q(fileStartUs_, AV_TIME_BASE_Q, timeBase);
+    if (packet->pts != AV_NOPTS_VALUE)
+        packet->pts -= offset;
+    if (packet->dts != AV_NOPTS_VALUE)
+        packet->dts -= offset;
+    av_packet_rescale_ts(packet.get(),
+                         timeBase,
+                         file_->streams[index]->time_base);
+
+    int size = packet->size;
+    int ret = av_interleaved_write_frame(file_.get(), packet.get());
+    if (ret < 0) {
+        LOG_WARN("Error writing packet: {}", ffmpegError(ret));
+        return;
+    }
+    fileBytes_ += static_cast<u64>(size);
+    bytesWritten_.fetch_add(static_cast<u64>(size), std::memory_order_relaxed);
+}
+
+bool OutputWriter::segmentFull(i64 us) const {
+    if (options_.segmentSeconds > 0 &&
+        us - fileStartUs_ >= static_cast<i64>(options_.segmentSeconds) *
+                                     1'000'000)
+        return true;
+    return options_.segmentBytes > 0 && fileBytes_ >= options_.segmentBytes;
+}
+
+Result<void> OutputWriter::close() {
+    if (!finalizer_.joinable())
+        return Result<void>::ok();
+
+    // The last trailer is small with fragments: the index went out with them
+    int ret = 0;
+    if (file_) {
+        ret = av_write_trailer(file_.get());
+        file_.reset();
+    }
+    finalizeQueue_.close();
+    finalizer_.join();
+    if (ret < 0) {
+        return Result<void>::err("Failed to write trailer: " +
+                                 ffmpegError(ret));
+    }
+    return Result<void>::ok();
+}
+
+void OutputWriter::finalizeThread() {
+    AVFormatContextPtr file;
+    while (finalizeQueue_.pop(file)) {
+        int ret = av_write_trailer(file.get());
+        if (ret < 0)
+            LOG_WARN("Error finalizing segment: {}", ffmpegError(ret));
+        file.reset(); // Closes it
+    }
+}
+
+fs::path OutputWriter::segmentPath(const fs::path& path, u32 index) {
+    return path.parent_path() /
+           std::format("{}_{:03}{}",
+                       path.stem().string(),
+                       index,
+                       path.extension().string());
+}
+
+} // namespace vc
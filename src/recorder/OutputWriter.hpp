@@ -0,0 +1,93 @@
+#pragma once
+// OutputWriter.hpp - Where the mux stage's packets end up on disk
+// Pull the plug three hours in and lose two seconds, not three hours
+
+#include "FFmpegUtils.hpp"
+#include "util/Result.hpp"
+#include "util/StageQueue.hpp"
+#include "util/Types.hpp"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace vc {
+
+// Writes interleaved packets into a file, or a run of files. With
+// fragmentSeconds the file is fragmented MP4/MOV (an empty moov up front,
+// then a moof per fragment) or Matroska clusters that long, so everything
+// up to the last complete fragment is playable however the recording ends,
+// and the disk sees a fragment at a time instead of a moov at the end.
+//
+// With segmentSeconds or segmentBytes, a new file (path_001.ext,
+// path_002.ext, ...) starts on the first video keyframe past the limit.
+// Every packet goes to exactly one file and each file's timestamps start
+// at its keyframe, so the segments play back to back without a gap; the
+// encoder should use closed GOPs so no frame refers across the cut. A
+// finished segment's trailer is written by a thread of its own, so the mux
+// stage never waits on it.
+//
+// Packets come in the time bases of the streams given to open(), and are
+// converted to whatever each file's muxer picks. write() is the mux
+// thread's.
+class OutputWriter {
+public:
+    static constexpr usize FINALIZE_QUEUE_SIZE = 4;
+
+    struct Options {
+        fs::path path;
+        u32 fragmentSeconds{0}; // 0: one index, written by close()
+        u32 segmentSeconds{0};  // 0: no time limit per file
+        u64 segmentBytes{0};    // 0: no size limit per file
+    };
+
+    OutputWriter() = default;
+    ~OutputWriter();
+
+    // Opens the first file. `streams` give the codec parameters and the
+    // time bases packets will arrive in.
+    Result<void> open(const std::vector<AVStream*>& streams,
+                      u32 videoStream,
+                      Options options);
+    void write(AVPacketPtr packet);
+    // Finishes the last file and waits for every trailer. Safe to repeat.
+    Result<void> close();
+
+    bool segmented() const {
+        return options_.segmentSeconds > 0 || options_.segmentBytes > 0;
+    }
+    u64 bytesWritten() const {
+        return bytesWritten_.load(std::memory_order_relaxed);
+    }
+    u32 files() const {
+        return files_.load(std::memory_order_relaxed);
+    }
+
+    // path_001.ext for index 1
+    static fs::path segmentPath(const fs::path& path, u32 index);
+
+private:
+    struct Stream {
+        AVCodecParametersPtr params;
+        AVRational timeBase{1, 1};
+    };
+
+    Result<void> openFile();
+    bool segmentFull(i64 us) const;
+    void finalizeThread();
+
+    Options options_;
+    std::vector<Stream> streams_;
+    u32 videoStream_{0};
+
+    AVFormatContextPtr file_;
+    i64 fileStartUs_{0}; // Subtracted from every timestamp in file_
+    u64 fileBytes_{0};
+    std::atomic<u64> bytesWritten_{0};
+    std::atomic<u32> files_{0};
+
+    StageQueue<AVFormatContextPtr> finalizeQueue_{FINALIZE_QUEUE_SIZE};
+    std::thread finalizer_;
+};
+
+} // namespace vc
@@ -0,0 +1,72 @@
+#include "PacketInterleaver.hpp"
+
+#include <algorithm>
+
+namespace vc {
+
+void PacketInterleaver::reset(const std::vector<AVStream*>& streams) {
+    lanes_ = std::vector<Lane>(streams.size()); // Lanes are move-only
+    for (auto* stream : streams) {
+        if (stream && static_cast<usize>(stream->index) < lanes_.size())
+            lanes_[stream->index].timeBase = stream->time_base;
+    }
+}
+
+void PacketInterleaver::push(AVPacketPtr packet) {
+    auto index = static_cast<usize>(packet->stream_index);
+    if (index >= lanes_.size())
+        return;
+    lanes_[index].packets.push_back(std::move(packet));
+}
+
+void PacketInterleaver::finish(u32 stream) {
+    if (stream < lanes_.size())
+        lanes_[stream].finished = true;
+}
+
+i64 PacketInterleaver::timeOf(const AVPacket& packet) {
+    return packet.dts != AV_NOPTS_VALUE ? packet.dts : packet.pts;
+}
+
+i64 PacketInterleaver::spreadUs(const Lane& lane) const {
+    if (lane.packets.size() < 2)
+        return 0;
+    i64 span = timeOf(*lane.packets.back()) - timeOf(*lane.packets.front());
+    return av_rescale_q(span, lane.timeBase, AVRational{1, 1'000'000});
+}
+
+AVPacketPtr PacketInterleaver::pop(bool drain) {
+    Lane* earliest = nullptr;
+    bool waiting = false;
+    i64 spread = 0;
+    for (auto& lane : lanes_) {
+        if (lane.packets.empty()) {
+            // An empty lane that may still produce could hold the earliest
+            waiting = waiting || !lane.finished;
+            continue;
+        }
+        spread = std::max(spread, spreadUs(lane));
+        if (!earliest ||
+            av_compare_ts(timeOf(*lane.packets.front()),
+                          lane.timeBase,
+                          timeOf(*earliest->packets.front()),
+                          earliest->timeBase) < 0) {
+            earliest = &lane;
+        }
+    }
+    if (!earliest || (waiting && !drain && spread < MAX_SPREAD_US))
+        return {};
+
+    AVPacketPtr packet = std::move(earliest->packets.front());
+    earliest->packets.pop_front();
+    return packet;
+}
+
+usize PacketInterleaver::pending() const {
+    usize total = 0;
+    for (const auto& lane : lanes_)
+        total += lane.packets.size();
+    return total;
+}
+
+} // namespace vc
@@ -0,0 +1,50 @@
+#pragma once
+// PacketInterleaver.hpp - Orders encoded packets by time before muxing
+// Video and audio leave their encoders whenever they like; the file can't
+
+#include "FFmpegUtils.hpp"
+#include "util/Types.hpp"
+
+#include <deque>
+#include <vector>
+
+namespace vc {
+
+// Holds packets from several encoder threads and hands them back in DTS
+// order across streams. A packet is released once every unfinished stream
+// has something queued to compare it with, so the muxer's own interleaving
+// buffer stays nearly empty. A stream that goes quiet (no audio submitted
+// yet, say) holds the others back for at most MAX_SPREAD_US.
+//
+// Packets must carry their stream_index and timestamps in that stream's
+// time base. Single-threaded: the mux thread owns it.
+class PacketInterleaver {
+public:
+    static constexpr i64 MAX_SPREAD_US = 1'000'000;
+
+    // One lane per stream, indexed by AVStream::index
+    void reset(const std::vector<AVStream*>& streams);
+
+    void push(AVPacketPtr packet);
+    void finish(u32 stream); // No more packets will come for it
+
+    // Next packet to write, or null if it has to wait for another stream.
+    // With `drain`, never waits.
+    AVPacketPtr pop(bool drain = false);
+
+    usize pending() const;
+
+private:
+    struct Lane {
+        AVRational timeBase{1, 1};
+        std::deque<AVPacketPtr> packets;
+        bool finished{false};
+    };
+
+    static i64 timeOf(const AVPacket& packet);
+    i64 spreadUs(const Lane& lane) const;
+
+    std::vector<Lane> lanes_;
+};
+
+} // namespace vc
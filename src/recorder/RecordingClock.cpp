@@ -0,0 +1,96 @@
+#include "RecordingClock.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+namespace vc {
+
+namespace {
+
+constexpr i64 US_PER_SECOND = 1'000'000;
+constexpr i64 SKEW_MIN_US = 10 * US_PER_SECOND; // Jitter swamps less
+
+} // namespace
+
+void RecordingClock::reset(i64 originUs, u32 sampleRate) {
+    origin_ = originUs;
+    sampleRate_ = std::max(sampleRate, 1u);
+    frames_ = 0;
+    skewFrom_ = -originUs;
+    skewSince_ = 0;
+    offset_.store(-originUs, std::memory_order_relaxed);
+    audioStart_.store(0, std::memory_order_relaxed);
+    hasAudio_.store(false, std::memory_order_relaxed);
+    skewPpm_.store(0.0, std::memory_order_relaxed);
+    resyncs_.store(0, std::memory_order_relaxed);
+}
+
+void RecordingClock::addAudio(u64 frames, i64 nowUs) {
+    if (!hasAudio_.load(std::memory_order_relaxed)) {
+        // The first batch started playing `frames` ago; that's where the
+        // audio track begins
+        i64 duration = static_cast<i64>(frames) * US_PER_SECOND / sampleRate_;
+        i64 startUs = std::max<i64>(0, nowUs - duration - origin_);
+        audioStart_.store(startUs * sampleRate_ / US_PER_SECOND,
+                          std::memory_order_relaxed);
+        hasAudio_.store(true, std::memory_order_release);
+        skewSince_ = nowUs;
+    }
+    frames_ += frames;
+
+    i64 endSample = audioStart() + static_cast<i64>(frames_);
+    i64 endUs = endSample * US_PER_SECOND / sampleRate_;
+    i64 measured = endUs - nowUs;
+    i64 offset = offset_.load(std::memory_order_relaxed);
+
+    if (std::abs(measured - offset) > RESYNC_US) {
+        // Not drift: the audio stopped or stuttered. Start over from here.
+        offset = measured;
+        skewFrom_ = measured;
+        skewSince_ = nowUs;
+        resyncs_.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        offset += (measured - offset) / SMOOTHING;
+    }
+    offset_.store(offset, std::memory_order_release);
+
+    if (nowUs - skewSince_ >= SKEW_MIN_US) {
+        f64 elapsed = static_cast<f64>(nowUs - skewSince_);
+        skewPpm_.store(static_cast<f64>(offset - skewFrom_) / elapsed * 1e6,
+                       std::memory_order_relaxed);
+    }
+}
+
+i64 RecordingClock::toRecordingTime(i64 steadyUs) const {
+    return steadyUs + offset_.load(std::memory_order_acquire);
+}
+
+RecordingClock::Placement RecordingClock::place(i64 steadyUs,
+                                                f64 fps,
+                                                i64 next,
+                                                bool started) const {
+    f64 slot = static_cast<f64>(toRecordingTime(steadyUs)) * fps /
+               static_cast<f64>(US_PER_SECOND);
+    Placement placement;
+    placement.next = next;
+    if (!started && next == 0)
+        placement.next = std::max<i64>(0, std::llround(slot));
+
+    // Within a frame either way is jitter. Beyond that the frame is late
+    // (fill the gap with the previous one) or early (its slot is taken).
+    f64 drift = slot - static_cast<f64>(placement.next);
+    if (drift <= -1.0) {
+        placement.drop = true;
+        return placement;
+    }
+    if (drift >= 1.0 && started) {
+        placement.repeats = static_cast<u32>(drift);
+        drift -= placement.repeats;
+    }
+    placement.driftUs =
+            static_cast<i64>(drift * static_cast<f64>(US_PER_SECOND) / fps);
+    return placement;
+}
+
+} // namespace vc
@@ -0,0 +1,81 @@
+#pragma once
+// RecordingClock.hpp - Puts capture timestamps on the audio sample clock
+// The sound card's crystal is the only clock the audience can hear
+
+#include "util/Types.hpp"
+
+#include <atomic>
+
+namespace vc {
+
+// A recording's timeline starts at reset() and runs at the rate the audio
+// is delivered: submitted sample n sits at audioStart() + n. Captures are
+// stamped by steady_clock, which gains or loses tens of ppm against the
+// audio hardware, a frame's worth every few minutes. Each addAudio()
+// measures the offset between the two clocks at that moment and captures
+// are placed with a smoothed copy of it, so video follows the audio however
+// far the clocks wander. A jump bigger than RESYNC_US (a pause, an
+// underrun) is taken at once rather than smoothed in. Until audio arrives,
+// the steady clock alone defines the timeline.
+//
+// One thread (the audio callback) calls addAudio(); anyone may read.
+class RecordingClock {
+public:
+    static constexpr i64 RESYNC_US = 100'000;
+    static constexpr i64 SMOOTHING = 16; // New measurements weigh 1/16
+
+    // `originUs` is the steady-clock time of the recording's zero
+    void reset(i64 originUs, u32 sampleRate);
+
+    // `frames` samples per channel just arrived, the last at `nowUs`
+    void addAudio(u64 frames, i64 nowUs);
+
+    // Recording time in microseconds for a steady-clock timestamp
+    i64 toRecordingTime(i64 steadyUs) const;
+
+    // Where a capture goes on a constant-rate video timeline
+    struct Placement {
+        i64 next{0};      // Next free slot; the first frame may move it
+        bool drop{false}; // A frame or more early: its slot is taken
+        u32 repeats{0};   // A frame or more late: repeat the last one first
+        i64 driftUs{0};   // What's left, under a frame either way
+    };
+    // The capture at `steadyUs` against a timeline whose next free slot is
+    // `next`. Until `started` (nothing encoded yet) the video begins
+    // wherever its first frame lands, like the audio; without a frame to
+    // repeat, a late one just goes in.
+    Placement place(i64 steadyUs, f64 fps, i64 next, bool started) const;
+
+    bool hasAudio() const {
+        return hasAudio_.load(std::memory_order_acquire);
+    }
+    // Where the first submitted sample lands, in samples from zero
+    i64 audioStart() const {
+        return audioStart_.load(std::memory_order_acquire);
+    }
+    // Audio clock rate against steady_clock, in parts per million
+    // (positive: the audio runs fast)
+    f64 skewPpm() const {
+        return skewPpm_.load(std::memory_order_relaxed);
+    }
+    u64 resyncs() const {
+        return resyncs_.load(std::memory_order_relaxed);
+    }
+
+private:
+    i64 origin_{0};
+    u32 sampleRate_{48000};
+
+    // Audio thread only
+    u64 frames_{0};
+    i64 skewFrom_{0}; // Offset and time the skew is measured from
+    i64 skewSince_{0};
+
+    std::atomic<i64> offset_{0}; // Recording time minus steady time, us
+    std::atomic<i64> audioStart_{0};
+    std::atomic<bool> hasAudio_{false};
+    std::atomic<f64> skewPpm_{0.0};
+    std::atomic<u64> resyncs_{0};
+};
+
+} // namespace vc
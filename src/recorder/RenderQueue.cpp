@@ -0,0 +1,434 @@
+#include "RenderQueue.hpp"
+#include "EncoderSettings.hpp"
+#include "OfflineExport.hpp"
+#include "audio/Playlist.hpp"
+#include "core/Config.hpp"
+#include "core/Logger.hpp"
+#include "util/FileUtils.hpp"
+#include "visualizer/PresetIndex.hpp"
+#include "visualizer/PresetManager.hpp"
+
+#include <QCoreApplication>
+#include <QProcess>
+#include <QStringList>
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <format>
+#include <optional>
+#include <set>
+#include <sstream>
+
+namespace vc {
+
+namespace {
+
+i64 mtimeOf(const fs::path& path) {
+    std::error_code ec;
+    auto time = fs::last_write_time(path, ec);
+    return ec ? 0 : static_cast<i64>(time.time_since_epoch().count());
+}
+
+// "progress 0.25", as the export prints it with --report-progress
+std::optional<f64> parseProgress(std::string_view line) {
+    constexpr std::string_view PREFIX = "progress ";
+    if (!line.starts_with(PREFIX))
+        return std::nullopt;
+    line.remove_prefix(PREFIX.size());
+    f64 value = 0.0;
+    auto [end, ec] =
+            std::from_chars(line.data(), line.data() + line.size(), value);
+    if (ec != std::errc())
+        return std::nullopt;
+    return value;
+}
+
+} // namespace
+
+RenderQueue::RenderQueue(Options options) : options_(std::move(options)) {
+    timer_.setInterval(POLL_MS);
+    QObject::connect(&timer_, &QTimer::timeout, [this] { tick(); });
+}
+
+RenderQueue::~RenderQueue() {
+    timer_.stop();
+    if (loader_.joinable())
+        loader_.join();
+
+    // Their output is thrown away, so there's nothing worth waiting for:
+    // one short grace period for all of them, then whoever is left is killed
+    for (auto& worker : workers_)
+        worker.process->terminate();
+    auto deadline = std::chrono::steady_clock::now() +
+                    std::chrono::milliseconds(KILL_GRACE_MS);
+    for (auto& worker : workers_) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now());
+        int waitMs = static_cast<int>(std::max<i64>(left.count(), 0));
+        if (!worker.process->waitForFinished(waitMs))
+            worker.process->kill();
+        std::error_code ec;
+        fs::remove(partPath(jobs_[worker.job]), ec);
+    }
+}
+
+const char* RenderQueue::stateName(JobState state) {
+    switch (state) {
+    case JobState::Pending:
+        return "pending";
+    case JobState::Running:
+        return "rendering";
+    case JobState::Done:
+        return "done";
+    case JobState::UpToDate:
+        return "up to date";
+    case JobState::Failed:
+        return "failed";
+    }
+    return "unknown";
+}
+
+usize RenderQueue::count(JobState state) const {
+    return static_cast<usize>(std::ranges::count(
+            jobs_, state, [](const RenderJob& job) { return job.state; }));
+}
+
+Result<std::vector<fs::path>> RenderQueue::listInputs() const {
+    const auto& source = options_.source;
+    std::vector<fs::path> inputs;
+    if (fs::is_directory(source)) {
+        inputs = file::listFiles(source, file::audioExtensions, true);
+        std::ranges::sort(inputs);
+    } else if (source.extension() == ".m3u" || source.extension() == ".m3u8") {
+        Playlist playlist;
+        if (auto result = playlist.loadM3U(source); !result) {
+            return Result<std::vector<fs::path>>::err(
+                    source.string() + ": " + result.error().message);
+        }
+        for (const auto& item : playlist.items())
+            inputs.push_back(item.path);
+    } else if (fs::is_regular_file(source)) {
+        inputs.push_back(source);
+    }
+    if (inputs.empty()) {
+        return Result<std::vector<fs::path>>::err("No tracks in " +
+                                                  source.string());
+    }
+    return Result<std::vector<fs::path>>::ok(std::move(inputs));
+}
+
+std::string RenderQueue::settingsKey(const EncoderSettings& settings) const {
+    // Everything that changes the pixels or the bytes of the output
+    const auto& v = settings.video;
+    const auto& a = settings.audio;
+    auto text = std::format("{} {}x{}@{} crf{} {}k {} {} g{} b{} | {} {}k | "
+                            "{} | {} {}",
+                            v.codecName(),
+                            v.width,
+                            v.height,
+                            v.fps,
+                            v.crf,
+                            v.bitrate,
+                            v.presetName(),
+                            v.pixelFormatName(),
+                            v.gopSize,
+                            v.bFrames,
+                            a.codecName(),
+                            a.bitrate,
+                            settings.containerExtension(),
+                            options_.preset,
+                            options_.idlePreset);
+    return std::format("{:016x}",
+                       PresetIndex::hashBytes(text.data(), text.size()));
+}
+
+fs::path RenderQueue::partPath(const RenderJob& job) const {
+    fs::path part = job.output;
+    part.replace_extension(".part" + extension_);
+    return part;
+}
+
+void RenderQueue::loadState() {
+    records_.clear();
+    auto text = file::readText(options_.outputDir / STATE_FILE);
+    if (!text)
+        return; // First run
+    std::istringstream lines(*text);
+    std::string line;
+    while (std::getline(lines, line)) {
+        // key \t input mtime \t output
+        auto tab1 = line.find('\t');
+        auto tab2 = line.find('\t', tab1 + 1);
+        if (tab1 == std::string::npos || tab2 == std::string::npos)
+            continue;
+        Record record;
+        record.key = line.substr(0, tab1);
+        const char* first = line.data() + tab1 + 1;
+        const char* last = line.data() + tab2;
+        if (std::from_chars(first, last, record.inputMtime).ec != std::errc())
+            continue;
+        records_[line.substr(tab2 + 1)] = std::move(record);
+    }
+}
+
+void RenderQueue::saveState() const {
+    std::string text;
+    for (const auto& [output, record] : records_) {
+        text += std::format(
+                "{}\t{}\t{}\n", record.key, record.inputMtime, output);
+    }
+    if (auto result = file::writeText(options_.outputDir / STATE_FILE, text);
+        !result) {
+        LOG_WARN("RenderQueue: {}", result.error().message);
+    }
+}
+
+Result<void> RenderQueue::load() {
+    auto settings = options_.encoderPreset.empty()
+                            ? Result<EncoderSettings>::ok(
+                                      EncoderSettings::fromConfig())
+                            : EncoderSettings::fromPreset(
+                                      options_.encoderPreset);
+    if (!settings)
+        return Result<void>::err(settings.error().message);
+    extension_ = settings->containerExtension();
+    key_ = settingsKey(*settings);
+
+    auto inputs = listInputs();
+    if (!inputs)
+        return Result<void>::err(inputs.error().message);
+    if (auto result = file::ensureDir(options_.outputDir); !result)
+        return result;
+    loadState();
+
+    // A directory's layout is kept; a playlist's tracks land side by side
+    bool fromDirectory = fs::is_directory(options_.source);
+    std::set<fs::path> taken;
+    jobs_.clear();
+    for (const auto& input : *inputs) {
+        RenderJob job;
+        job.input = input;
+        fs::path name = fromDirectory
+                                ? input.lexically_relative(options_.source)
+                                : input.filename();
+        name.replace_extension(extension_);
+        job.output = options_.outputDir / name;
+        for (int n = 2; taken.contains(job.output); ++n) {
+            job.output = options_.outputDir / name.parent_path() /
+                         std::format("{} ({}){}",
+                                     name.stem().string(),
+                                     n,
+                                     extension_);
+        }
+        taken.insert(job.output);
+
+        if (fs::exists(job.output)) {
+            i64 inputTime = mtimeOf(input);
+            auto it = records_.find(job.output.string());
+            bool current = it != records_.end()
+                                   ? it->second.key == key_ &&
+                                             it->second.inputMtime == inputTime
+                                   : mtimeOf(job.output) >= inputTime;
+            if (current) {
+                job.state = JobState::UpToDate;
+                job.progress = 1.0;
+            }
+        }
+        jobs_.push_back(std::move(job));
+    }
+
+    // Brought up to date once, here, so the workers only ever map it
+    if (!options_.idlePreset && !fs::is_regular_file(options_.preset)) {
+        PresetManager presets;
+        presets.setIndexPath(file::cacheDir() / "preset_index.bin");
+        if (auto result = presets.scan(CONFIG.visualizer().presetPath);
+            !result) {
+            LOG_WARN("RenderQueue: {}", result.error().message);
+        }
+    }
+
+    LOG_INFO("RenderQueue: {} tracks from {}, {} up to date",
+             jobs_.size(),
+             options_.source.string(),
+             count(JobState::UpToDate));
+    return Result<void>::ok();
+}
+
+void RenderQueue::loadAsync() {
+    if (loader_.joinable())
+        loader_.join();
+    loader_ = std::thread([this] {
+        auto result = load();
+        loaded.emitSignal(result);
+    });
+}
+
+void RenderQueue::start() {
+    if (running_)
+        return;
+    if (loader_.joinable())
+        loader_.join(); // Finished: it emitted loaded
+    running_ = true;
+    cancelling_ = false;
+    cancelRequested_ = false;
+    next_ = 0;
+    timer_.start();
+}
+
+void RenderQueue::cancel() {
+    if (!running_ || cancelling_)
+        return;
+    cancelling_ = true;
+    // Each export finalizes and exits; tick() collects them
+    for (auto& worker : workers_)
+        worker.process->terminate();
+}
+
+void RenderQueue::tick() {
+    if (cancelRequested_.exchange(false, std::memory_order_relaxed))
+        cancel();
+    for (auto& worker : workers_)
+        readOutput(worker);
+    for (auto it = workers_.begin(); it != workers_.end();) {
+        if (it->process->state() != QProcess::NotRunning) {
+            ++it;
+            continue;
+        }
+        finishWorker(*it);
+        it = workers_.erase(it);
+    }
+
+    usize limit = options_.workers > 0 ? options_.workers
+                                       : OfflineExport::defaultWorkers();
+    while (!cancelling_ && workers_.size() < limit) {
+        while (next_ < jobs_.size() && jobs_[next_].state != JobState::Pending)
+            ++next_;
+        if (next_ == jobs_.size())
+            break;
+        launch(next_++);
+    }
+
+    if (workers_.empty() && (cancelling_ || next_ == jobs_.size())) {
+        timer_.stop();
+        running_ = false;
+        LOG_INFO("RenderQueue: {} rendered, {} failed, {} up to date",
+                 count(JobState::Done),
+                 count(JobState::Failed),
+                 count(JobState::UpToDate));
+        finished.emitSignal();
+    }
+}
+
+void RenderQueue::launch(usize index) {
+    auto& job = jobs_[index];
+    if (auto result = file::ensureDir(job.output.parent_path()); !result) {
+        job.state = JobState::Failed;
+        job.error = result.error().message;
+        jobChanged.emitSignal(index);
+        return;
+    }
+
+    // One render per process: the queue is the parallelism, so chunking
+    // each track as well would only oversubscribe the machine
+    QStringList args;
+    for (const auto& arg : options_.workerArgs)
+        args << QString::fromStdString(arg);
+    args << "--headless" << "--report-progress" << "--workers" << "1";
+    if (!options_.encoderPreset.empty())
+        args << "--encoder-preset"
+             << QString::fromStdString(options_.encoderPreset);
+    if (options_.idlePreset)
+        args << "--default-preset";
+    else if (!options_.preset.empty())
+        args << "--preset" << QString::fromStdString(options_.preset);
+    args << "--output" << QString::fromStdString(partPath(job).string())
+         << QString::fromStdString(job.input.string());
+
+    auto process = std::make_unique<QProcess>();
+    process->start(QCoreApplication::applicationFilePath(), args);
+    if (!process->waitForStarted()) {
+        job.state = JobState::Failed;
+        job.error = process->errorString().toStdString();
+        jobChanged.emitSignal(index);
+        return;
+    }
+    job.state = JobState::Running;
+    job.progress = 0.0;
+    job.error.clear();
+    workers_.push_back({std::move(process), index, {}, {}});
+    LOG_INFO("RenderQueue: rendering {}", job.input.string());
+    jobChanged.emitSignal(index);
+}
+
+void RenderQueue::readOutput(Worker& worker) {
+    // Whole lines only; "progress <0-1>" is all the export prints
+    worker.output += worker.process->readAllStandardOutput().toStdString();
+    std::optional<f64> progress;
+    usize start = 0;
+    usize end = 0;
+    while ((end = worker.output.find('\n', start)) != std::string::npos) {
+        auto line = std::string_view(worker.output).substr(start, end - start);
+        if (auto value = parseProgress(line))
+            progress = value;
+        start = end + 1;
+    }
+    worker.output.erase(0, start);
+
+    // Its last complaint is the best explanation if it fails
+    std::string errors = worker.process->readAllStandardError().toStdString();
+    while (!errors.empty() && errors.back() == '\n')
+        errors.pop_back();
+    if (!errors.empty())
+        worker.error = errors.substr(errors.rfind('\n') + 1);
+
+    if (progress) {
+        jobs_[worker.job].progress = std::clamp(*progress, 0.0, 1.0);
+        jobChanged.emitSignal(worker.job);
+    }
+}
+
+void RenderQueue::finishWorker(Worker& worker) {
+    readOutput(worker);
+    auto& job = jobs_[worker.job];
+    fs::path part = partPath(job);
+    std::error_code ec;
+    bool ok = worker.process->exitStatus() == QProcess::NormalExit &&
+              worker.process->exitCode() == 0;
+
+    if (ok) {
+        fs::rename(part, job.output, ec);
+        if (!ec) {
+            job.state = JobState::Done;
+            job.progress = 1.0;
+            records_[job.output.string()] = {key_, mtimeOf(job.input)};
+            saveState();
+        } else {
+            // The render itself is fine: keep it for whoever can move it
+            job.state = JobState::Failed;
+            job.error = std::format("Failed to move {} into place: {}",
+                                    part.string(),
+                                    ec.message());
+            LOG_WARN("RenderQueue: {} failed: {}",
+                     job.input.string(),
+                     job.error);
+        }
+    } else {
+        fs::remove(part, ec);
+        if (cancelling_) {
+            job.state = JobState::Pending; // Next run picks it up
+            job.progress = 0.0;
+        } else {
+            job.state = JobState::Failed;
+            job.error = !worker.error.empty()
+                                ? worker.error
+                                : std::format("exit code {}",
+                                              worker.process->exitCode());
+            LOG_WARN("RenderQueue: {} failed: {}",
+                     job.input.string(),
+                     job.error);
+        }
+    }
+    jobChanged.emitSignal(worker.job);
+}
+
+} // namespace vc
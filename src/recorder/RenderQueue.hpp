@@ -0,0 +1,133 @@
+#pragma once
+// RenderQueue.hpp - Offline renders for a whole album, several at a time
+// Queue it, walk away, come back to a folder full of videos
+
+#include "util/Result.hpp"
+#include "util/Signal.hpp"
+#include "util/Types.hpp"
+
+#include <QTimer>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class QProcess;
+
+namespace vc {
+
+struct EncoderSettings;
+
+enum class JobState { Pending, Running, Done, UpToDate, Failed };
+
+struct RenderJob {
+    fs::path input;
+    fs::path output;
+    JobState state{JobState::Pending};
+    f64 progress{0.0}; // 0-1 while running
+    std::string error;
+};
+
+// Turns a playlist or a directory of tracks into one --headless render per
+// track, `workers` of them at a time. Each runs in its own process (the
+// GL context and projectM instance come with it) and reports its progress
+// on stdout. They all map the same on-disk preset index, refreshed once
+// here before the first one starts, so none of them walks the preset tree.
+//
+// Renders go to a .part file that's renamed once complete. What finished
+// is recorded in the output directory (STATE_FILE) with the input's mtime
+// and a key of the encoder settings and preset, so a queue that was
+// cancelled, crashed or is simply run again only renders what's missing
+// or out of date. An output newer than its input with no record (rendered
+// by hand, say) counts as up to date too.
+//
+// Needs a running Qt event loop: a timer polls the processes.
+class RenderQueue {
+public:
+    static constexpr const char* STATE_FILE = ".chadvis-render-queue.tsv";
+    static constexpr int POLL_MS = 100;
+    // How long the destructor lets all the workers exit before killing them
+    static constexpr int KILL_GRACE_MS = 1000;
+
+    struct Options {
+        fs::path source;           // .m3u/.m3u8 playlist or a directory
+        fs::path outputDir;
+        std::string encoderPreset; // getQualityPresets() name; empty: config
+        std::string preset;        // projectM preset, as -p takes it
+        bool idlePreset{false};
+        u32 workers{0};            // 0 = OfflineExport::defaultWorkers()
+        std::vector<std::string> workerArgs; // --config and the like
+    };
+
+    explicit RenderQueue(Options options);
+    ~RenderQueue(); // Kills whatever is still rendering
+
+    // Lists the tracks and works out which are already done
+    Result<void> load();
+    // load() on a thread of its own (it may scan the preset tree); `loaded`
+    // follows from that thread. Leave the queue alone until then.
+    void loadAsync();
+
+    void start();
+    // Stops the running renders; their jobs go back to Pending
+    void cancel();
+    // cancel() at the next poll. Only sets a flag, so it is safe from a
+    // signal handler.
+    void requestCancel() {
+        cancelRequested_.store(true, std::memory_order_relaxed);
+    }
+    bool running() const {
+        return running_;
+    }
+
+    const std::vector<RenderJob>& jobs() const {
+        return jobs_;
+    }
+    usize count(JobState state) const;
+
+    Signal<usize> jobChanged; // Index into jobs()
+    Signal<> finished;
+    Signal<const Result<void>&> loaded;
+
+    static const char* stateName(JobState state);
+
+private:
+    struct Worker {
+        std::unique_ptr<QProcess> process;
+        usize job;
+        std::string output; // Unparsed tail of its stdout
+        std::string error;  // Last line on its stderr
+    };
+    struct Record {
+        std::string key;
+        i64 inputMtime{0};
+    };
+
+    Result<std::vector<fs::path>> listInputs() const;
+    std::string settingsKey(const EncoderSettings& settings) const;
+    void loadState();
+    void saveState() const;
+    fs::path partPath(const RenderJob& job) const;
+
+    void tick();
+    void launch(usize job);
+    void readOutput(Worker& worker);
+    void finishWorker(Worker& worker);
+
+    Options options_;
+    std::string extension_;
+    std::string key_;
+    std::vector<RenderJob> jobs_;
+    std::unordered_map<std::string, Record> records_; // By output path
+    std::vector<Worker> workers_;
+    QTimer timer_;
+    usize next_{0};
+    bool running_{false};
+    bool cancelling_{false};
+    std::atomic<bool> cancelRequested_{false};
+    std::thread loader_;
+};
+
+} // namespace vc
@@ -0,0 +1,307 @@
+#include "RenditionEncoder.hpp"
+#include "core/Logger.hpp"
+
+namespace vc {
+
+namespace {
+
+constexpr u32 VIDEO_LANE = 0; // Stream indices, in creation order
+constexpr u32 AUDIO_LANE = 1;
+
+} // namespace
+
+RenditionEncoder::RenditionEncoder(Rendition rendition)
+    : rendition_(std::move(rendition)) {}
+
+RenditionEncoder::~RenditionEncoder() {
+    input_.close();
+    close();
+}
+
+Result<void> RenditionEncoder::open(const EncoderSettings& settings,
+                                    const AVCodecContext* source,
+                                    u32 sourceWidth,
+                                    u32 sourceHeight,
+                                    const AVStream* audio) {
+    path_ = rendition_.pathFor(settings.outputPath);
+
+    AVFormatContext* ctx = nullptr;
+    int ret = avformat_alloc_output_context2(
+            &ctx, nullptr, nullptr, path_.c_str());
+    formatCtx_.reset(ctx);
+    if (ret < 0 || !formatCtx_) {
+        return Result<void>::err("Failed to create output context: " +
+                                 ffmpegError(ret));
+    }
+
+    const AVCodec* codec =
+            avcodec_find_encoder_by_name(settings.video.codecName().c_str());
+    if (!codec) {
+        return Result<void>::err("Video codec not found: " +
+                                 settings.video.codecName());
+    }
+    videoStream_ = avformat_new_stream(formatCtx_.get(), nullptr);
+    if (!videoStream_) {
+        return Result<void>::err("Failed to create video stream");
+    }
+    codecCtx_.reset(avcodec_alloc_context3(codec));
+    if (!codecCtx_) {
+        return Result<void>::err("Failed to allocate video codec context");
+    }
+
+    // Everything but size and quality follows the main encoder, so the
+    // renditions cut, seek and look the same
+    codecCtx_->width = static_cast<int>(rendition_.width);
+    codecCtx_->height = static_cast<int>(rendition_.height);
+    codecCtx_->time_base = source->time_base;
+    codecCtx_->framerate = source->framerate;
+    codecCtx_->pix_fmt = source->pix_fmt;
+    codecCtx_->gop_size = source->gop_size;
+    codecCtx_->max_b_frames = source->max_b_frames;
+    codecCtx_->flags |= source->flags & AV_CODEC_FLAG_CLOSED_GOP;
+    codecCtx_->thread_count = 0;
+    codecCtx_->colorspace = source->colorspace;
+    codecCtx_->color_primaries = source->color_primaries;
+    codecCtx_->color_trc = source->color_trc;
+    codecCtx_->color_range = source->color_range;
+    if (formatCtx_->oformat->flags & AVFMT_GLOBALHEADER) {
+        codecCtx_->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    }
+    if (rendition_.bitrate > 0) {
+        codecCtx_->bit_rate = static_cast<i64>(rendition_.bitrate) * 1000;
+    }
+
+    AVDictionary* opts = nullptr;
+    if (settings.video.codec == VideoCodec::H264 ||
+        settings.video.codec == VideoCodec::H265) {
+        av_dict_set(&opts, "preset", settings.video.presetName().c_str(), 0);
+        if (rendition_.bitrate == 0) {
+            av_dict_set(&opts,
+                        "crf",
+                        std::to_string(rendition_.crf).c_str(),
+                        0);
+        }
+        av_dict_set(&opts, "tune", "zerolatency", 0);
+    }
+    ret = avcodec_open2(codecCtx_.get(), codec, &opts);
+    av_dict_free(&opts);
+    if (ret < 0) {
+        return Result<void>::err("Failed to open video codec: " +
+                                 ffmpegError(ret));
+    }
+    ret = avcodec_parameters_from_context(videoStream_->codecpar,
+                                          codecCtx_.get());
+    if (ret < 0) {
+        return Result<void>::err("Failed to copy video codec params");
+    }
+    videoStream_->time_base = codecCtx_->time_base;
+
+    std::vector<AVStream*> streams{videoStream_};
+    if (audio) {
+        audioStream_ = avformat_new_stream(formatCtx_.get(), nullptr);
+        if (!audioStream_) {
+            return Result<void>::err("Failed to create audio stream");
+        }
+        ret = avcodec_parameters_copy(audioStream_->codecpar, audio->codecpar);
+        if (ret < 0) {
+            return Result<void>::err("Failed to copy audio codec params");
+        }
+        audioStream_->time_base = audio->time_base;
+        streams.push_back(audioStream_);
+    }
+
+    // Same pixel format both sides: swscale only resamples, and area
+    // averaging keeps a big step down from aliasing
+    scaler_.reset(sws_getContext(static_cast<int>(sourceWidth),
+                                 static_cast<int>(sourceHeight),
+                                 source->pix_fmt,
+                                 codecCtx_->width,
+                                 codecCtx_->height,
+                                 codecCtx_->pix_fmt,
+                                 SWS_AREA,
+                                 nullptr,
+                                 nullptr,
+                                 nullptr));
+    if (!scaler_) {
+        return Result<void>::err("Failed to create swscale context");
+    }
+    if (!pictures_.init(codecCtx_->pix_fmt,
+                        codecCtx_->width,
+                        codecCtx_->height)) {
+        return Result<void>::err("Failed to create video frame buffer pool");
+    }
+    for (auto& frame : scaled_) {
+        frame.reset(av_frame_alloc());
+        if (!frame) {
+            return Result<void>::err("Failed to allocate video frame");
+        }
+        if (!pictures_.attach(frame.get())) {
+            return Result<void>::err("Failed to allocate video frame buffer");
+        }
+    }
+    last_ = nullptr;
+    framesWritten_ = 0;
+
+    input_.reset();
+    muxQueue_.reset();
+    interleaver_.reset(streams);
+
+    OutputWriter::Options output;
+    output.path = path_;
+    output.fragmentSeconds = settings.file.fragmentSeconds;
+    output.segmentSeconds = settings.file.segmentSeconds;
+    output.segmentBytes = static_cast<u64>(settings.file.segmentMegabytes)
+                          << 20;
+    if (auto result = output_.open(streams, VIDEO_LANE, std::move(output));
+        !result) {
+        return result;
+    }
+
+    LOG_DEBUG("Rendition {}x{} ({}): {}",
+              rendition_.width,
+              rendition_.height,
+              rendition_.bitrate > 0
+                      ? std::to_string(rendition_.bitrate) + " kbps"
+                      : "crf " + std::to_string(rendition_.crf),
+              path_.string());
+    return Result<void>::ok();
+}
+
+void RenditionEncoder::start() {
+    muxThread_ = std::thread(&RenditionEncoder::muxThread, this);
+    encodeThread_ = std::thread(&RenditionEncoder::encodeThread, this);
+}
+
+void RenditionEncoder::pushFrame(AVFramePtr frame, i64 pts) {
+    input_.push(Input{std::move(frame), pts});
+}
+
+void RenditionEncoder::pushAudio(AVPacketPtr packet) {
+    if (!audioStream_)
+        return;
+    if (packet)
+        packet->stream_index = static_cast<int>(AUDIO_LANE);
+    muxQueue_.push(MuxPacket{std::move(packet), AUDIO_LANE});
+}
+
+void RenditionEncoder::finish() {
+    input_.close();
+}
+
+Result<void> RenditionEncoder::close() {
+    // The encoder ends once its input is closed and drained; the muxer once
+    // both encoders have said so
+    if (encodeThread_.joinable())
+        encodeThread_.join();
+    muxQueue_.close();
+    if (muxThread_.joinable())
+        muxThread_.join();
+
+    auto result = output_.close();
+    codecCtx_.reset();
+    scaler_.reset();
+    for (auto& frame : scaled_)
+        frame.reset();
+    pictures_.reset();
+    last_ = nullptr;
+    formatCtx_.reset();
+    videoStream_ = nullptr;
+    audioStream_ = nullptr;
+    return result;
+}
+
+void RenditionEncoder::encodeThread() {
+    Input item;
+    while (input_.pop(item)) {
+        bool fresh = item.frame != nullptr;
+        if (fresh) {
+            last_ = scale(item.frame.get());
+            item.frame.reset(); // The bigger frame can go back to its pool
+        }
+        if (!last_)
+            continue;
+
+        last_->pts = item.pts;
+        if (encode(last_))
+            framesWritten_.fetch_add(1, std::memory_order_relaxed);
+
+        // New pictures go down as references, repeats as nothing
+        if (next_) {
+            AVFramePtr ref;
+            if (fresh)
+                ref.reset(av_frame_clone(last_));
+            next_->pushFrame(std::move(ref), item.pts);
+        }
+    }
+
+    encode(nullptr);
+    muxQueue_.push(MuxPacket{{}, VIDEO_LANE});
+    if (next_)
+        next_->finish();
+}
+
+AVFrame* RenditionEncoder::scale(const AVFrame* frame) {
+    // Never the repeat frame: a failed scale falls back on it
+    AVFrame* out = scaled_[scaled_[0].get() == last_ ? 1 : 0].get();
+    // The encoder or the next rendition may still hold this one's picture
+    if (!av_frame_is_writable(out) && !pictures_.attach(out))
+        return last_;
+    int ret = sws_scale_frame(scaler_.get(), out, frame);
+    if (ret < 0) {
+        LOG_WARN("Rendition {}x{}: scale error: {}",
+                 rendition_.width,
+                 rendition_.height,
+                 ffmpegError(ret));
+        return last_;
+    }
+    return out;
+}
+
+bool RenditionEncoder::encode(AVFrame* frame) {
+    int ret = avcodec_send_frame(codecCtx_.get(), frame);
+    if (ret < 0) {
+        LOG_WARN("Rendition {}x{}: error sending frame: {}",
+                 rendition_.width,
+                 rendition_.height,
+                 ffmpegError(ret));
+        return false;
+    }
+
+    for (;;) {
+        AVPacketPtr packet(av_packet_alloc());
+        if (!packet)
+            return false;
+        ret = avcodec_receive_packet(codecCtx_.get(), packet.get());
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
+            break;
+        if (ret < 0) {
+            LOG_WARN("Rendition {}x{}: error receiving packet: {}",
+                     rendition_.width,
+                     rendition_.height,
+                     ffmpegError(ret));
+            return false;
+        }
+        av_packet_rescale_ts(packet.get(),
+                             codecCtx_->time_base,
+                             videoStream_->time_base);
+        packet->stream_index = static_cast<int>(VIDEO_LANE);
+        muxQueue_.push(MuxPacket{std::move(packet), VIDEO_LANE});
+    }
+    return true;
+}
+
+void RenditionEncoder::muxThread() {
+    MuxPacket item;
+    while (muxQueue_.pop(item)) {
+        if (item.packet)
+            interleaver_.push(std::move(item.packet));
+        else
+            interleaver_.finish(item.stream);
+        while (auto packet = interleaver_.pop())
+            output_.write(std::move(packet));
+    }
+    while (auto packet = interleaver_.pop(true))
+        output_.write(std::move(packet));
+}
+
+} // namespace vc
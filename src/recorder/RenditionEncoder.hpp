@@ -0,0 +1,132 @@
+#pragma once
+// RenditionEncoder.hpp - A smaller copy of the recording, encoded alongside
+// One capture, a 1080p master and a 720p for the group chat
+
+#include "EncoderSettings.hpp"
+#include "FFmpegUtils.hpp"
+#include "OutputWriter.hpp"
+#include "PacketInterleaver.hpp"
+#include "util/Result.hpp"
+#include "util/StageQueue.hpp"
+#include "util/Types.hpp"
+
+#include <array>
+#include <atomic>
+#include <thread>
+
+namespace vc {
+
+// Encodes one of EncoderSettings::renditions from the recorder's converted
+// frames: scales them down with swscale (YUV to YUV, no second colour
+// conversion), encodes with the main video codec at the rendition's size and
+// quality, and muxes the packets with the main recording's audio into a file
+// of its own. Scaling, encoding and muxing run on the rendition's threads,
+// so the main encoder only hands over references.
+//
+// Renditions form a cascade, largest first: each one scales from the frame
+// the one before it produced instead of the full-size frame, and forwards a
+// reference to its own scaled frame to the next. Nothing is copied on the
+// way; a frame's planes stay alive as long as anybody still refers to them.
+//
+// Frames arrive with their pts already set. A repeat of the previous frame
+// (CFR fill) carries no frame at all, and the last scaled one is encoded
+// again. Audio packets are shared with the main file, already encoded.
+class RenditionEncoder {
+public:
+    static constexpr usize QUEUE_SIZE = 4;
+    static constexpr usize MUX_QUEUE_SIZE = 256;
+
+    explicit RenditionEncoder(Rendition rendition);
+    ~RenditionEncoder();
+
+    RenditionEncoder(const RenditionEncoder&) = delete;
+    RenditionEncoder& operator=(const RenditionEncoder&) = delete;
+
+    // Sets up the encoder from the main one (`source` gives codec, pixel
+    // format, timing, GOP and colour), a scaler from `sourceWidth` x
+    // `sourceHeight`, and the output file. `audio` is the main recording's
+    // audio stream, or null.
+    Result<void> open(const EncoderSettings& settings,
+                      const AVCodecContext* source,
+                      u32 sourceWidth,
+                      u32 sourceHeight,
+                      const AVStream* audio);
+    // Gets scaled frames from this one; set before start()
+    void setNext(RenditionEncoder* next) {
+        next_ = next;
+    }
+    void start();
+
+    // From the stage feeding us. A null frame repeats the last one at `pts`.
+    // Waits while the rendition is QUEUE_SIZE frames behind.
+    void pushFrame(AVFramePtr frame, i64 pts);
+    // Encoded audio in the main audio stream's time base; null ends it
+    void pushAudio(AVPacketPtr packet);
+    // No more frames: the encoder flushes, then finishes the next one
+    void finish();
+    // Waits for everything to reach the file and closes it. Safe to repeat.
+    Result<void> close();
+
+    const Rendition& rendition() const {
+        return rendition_;
+    }
+    const fs::path& path() const {
+        return path_;
+    }
+    u32 width() const {
+        return rendition_.width;
+    }
+    u32 height() const {
+        return rendition_.height;
+    }
+    u64 framesWritten() const {
+        return framesWritten_.load(std::memory_order_relaxed);
+    }
+    u64 bytesWritten() const {
+        return output_.bytesWritten();
+    }
+
+private:
+    struct Input {
+        AVFramePtr frame; // Null: repeat the last one
+        i64 pts{0};
+    };
+
+    struct MuxPacket {
+        AVPacketPtr packet; // Null marks the end of the stream
+        u32 stream{0};
+    };
+
+    void encodeThread();
+    void muxThread();
+    AVFrame* scale(const AVFrame* frame);
+    bool encode(AVFrame* frame);
+
+    Rendition rendition_;
+    fs::path path_;
+    RenditionEncoder* next_{nullptr};
+
+    AVFormatContextPtr formatCtx_; // Describes the streams, never written
+    AVCodecContextPtr codecCtx_;
+    AVStream* videoStream_{nullptr};
+    AVStream* audioStream_{nullptr};
+    SwsContextPtr scaler_;
+
+    // Scaled frames: the one kept for repeats and the one being scaled
+    // into. A picture the encoder or the next rendition still refers to is
+    // left to them and the frame takes a free one from pictures_.
+    PictureBufferPool pictures_;
+    std::array<AVFramePtr, 2> scaled_;
+    AVFrame* last_{nullptr}; // For repeats
+
+    StageQueue<Input> input_{QUEUE_SIZE};
+    StageQueue<MuxPacket> muxQueue_{MUX_QUEUE_SIZE};
+    PacketInterleaver interleaver_;
+    OutputWriter output_;
+    std::thread encodeThread_;
+    std::thread muxThread_;
+
+    std::atomic<u64> framesWritten_{0};
+};
+
+} // namespace vc
@@ -0,0 +1,193 @@
+#include "ReplayBuffer.hpp"
+#include "core/Logger.hpp"
+
+extern "C" {
+#include <libavutil/mathematics.h>
+}
+
+namespace vc {
+
+Result<void> ReplayBuffer::reset(const std::vector<AVStream*>& streams,
+                                 u32 videoStream,
+                                 f64 seconds,
+                                 usize maxBytes) {
+    std::lock_guard lock(mutex_);
+    gops_.clear();
+    bytes_ = 0;
+    newestUs_ = 0;
+    params_.clear();
+    timeBases_.clear();
+    for (const auto* stream : streams) {
+        AVCodecParametersPtr params(avcodec_parameters_alloc());
+        if (!params ||
+            avcodec_parameters_copy(params.get(), stream->codecpar) < 0) {
+            return Result<void>::err("Failed to copy codec params for replay");
+        }
+        params_.push_back(std::move(params));
+        timeBases_.push_back(stream->time_base);
+    }
+    videoStream_ = videoStream;
+    windowUs_ = static_cast<i64>(seconds * 1'000'000.0);
+    maxBytes_ = maxBytes;
+    return Result<void>::ok();
+}
+
+void ReplayBuffer::clear() {
+    std::lock_guard lock(mutex_);
+    gops_.clear();
+    bytes_ = 0;
+    newestUs_ = 0;
+}
+
+void ReplayBuffer::push(AVPacketPtr packet) {
+    std::lock_guard lock(mutex_);
+    if (!packet || static_cast<usize>(packet->stream_index) >= params_.size())
+        return;
+    bool keyframe = static_cast<u32>(packet->stream_index) == videoStream_ &&
+                    (packet->flags & AV_PKT_FLAG_KEY);
+    i64 us = timeOf(*packet);
+    usize size = static_cast<usize>(packet->size);
+    if (keyframe)
+        gops_.push_back(Gop{us, 0, {}});
+    // Nothing is kept from before the first keyframe: it couldn't be decoded
+    if (gops_.empty())
+        return;
+    auto& gop = gops_.back();
+    gop.bytes += size;
+    gop.packets.push_back(std::move(packet));
+    bytes_ += size;
+    newestUs_ = std::max(newestUs_, us);
+    trim();
+}
+
+void ReplayBuffer::trim() {
+    // The front group goes once the rest is enough on its own
+    while (gops_.size() > 1 &&
+           (newestUs_ - gops_[1].startUs >= windowUs_ ||
+            (maxBytes_ > 0 && bytes_ > maxBytes_))) {
+        bytes_ -= gops_.front().bytes;
+        gops_.pop_front();
+    }
+}
+
+Result<ReplayBuffer::Snapshot> ReplayBuffer::snapshot() const {
+    Snapshot snapshot;
+    std::lock_guard lock(mutex_);
+    if (gops_.empty())
+        return Result<Snapshot>::err("Replay buffer is empty");
+
+    for (const auto& params : params_) {
+        AVCodecParametersPtr copy(avcodec_parameters_alloc());
+        if (!copy || avcodec_parameters_copy(copy.get(), params.get()) < 0) {
+            return Result<Snapshot>::err(
+                    "Failed to copy codec params for replay");
+        }
+        snapshot.params.push_back(std::move(copy));
+    }
+    snapshot.timeBases = timeBases_;
+
+    usize count = 0;
+    for (const auto& gop : gops_)
+        count += gop.packets.size();
+    snapshot.packets.reserve(count);
+    for (const auto& gop : gops_) {
+        for (const auto& packet : gop.packets) {
+            // A new reference; the payload is shared, not copied
+            AVPacketPtr ref(av_packet_clone(packet.get()));
+            if (!ref)
+                return Result<Snapshot>::err("Out of memory for replay");
+            snapshot.packets.push_back(std::move(ref));
+        }
+    }
+    snapshot.startUs = gops_.front().startUs;
+    snapshot.seconds =
+            static_cast<f64>(newestUs_ - snapshot.startUs) / 1'000'000.0;
+    return Result<Snapshot>::ok(std::move(snapshot));
+}
+
+Result<void> ReplayBuffer::write(const Snapshot& snapshot,
+                                 const fs::path& path) {
+    AVFormatContext* ctx = nullptr;
+    int ret = avformat_alloc_output_context2(
+            &ctx, nullptr, nullptr, path.c_str());
+    AVFormatContextPtr output(ctx);
+    if (ret < 0 || !output) {
+        return Result<void>::err("Failed to create output context: " +
+                                 ffmpegError(ret));
+    }
+
+    for (usize i = 0; i < snapshot.params.size(); ++i) {
+        AVStream* stream = avformat_new_stream(output.get(), nullptr);
+        if (!stream)
+            return Result<void>::err("Failed to create replay stream");
+        ret = avcodec_parameters_copy(stream->codecpar,
+                                      snapshot.params[i].get());
+        if (ret < 0)
+            return Result<void>::err("Failed to copy replay codec params");
+        stream->codecpar->codec_tag = 0; // The container picks its own
+        stream->time_base = snapshot.timeBases[i];
+    }
+
+    if (!(output->oformat->flags & AVFMT_NOFILE)) {
+        ret = avio_open(&output->pb, path.c_str(), AVIO_FLAG_WRITE);
+        if (ret < 0) {
+            return Result<void>::err("Failed to open output file: " +
+                                     ffmpegError(ret));
+        }
+    }
+    ret = avformat_write_header(output.get(), nullptr);
+    if (ret < 0) {
+        return Result<void>::err("Failed to write header: " +
+                                 ffmpegError(ret));
+    }
+
+    // The clip starts at zero, on its first keyframe
+    for (const auto& packet : snapshot.packets) {
+        AVPacketPtr out(av_packet_clone(packet.get()));
+        if (!out)
+            return Result<void>::err("Out of memory writing replay");
+        auto index = static_cast<usize>(out->stream_index);
+        AVRational timeBase = snapshot.timeBases[index];
+        i64 offset = av_rescale_q(snapshot.startUs, AV_TIME_BASE_Q, timeBase);
+        if (out->pts != AV_NOPTS_VALUE)
+            out->pts -= offset;
+        if (out->dts != AV_NOPTS_VALUE)
+            out->dts -= offset;
+        av_packet_rescale_ts(out.get(),
+                             timeBase,
+                             output->streams[index]->time_base);
+        ret = av_interleaved_write_frame(output.get(), out.get());
+        if (ret < 0)
+            LOG_WARN("Error writing replay packet: {}", ffmpegError(ret));
+    }
+
+    ret = av_write_trailer(output.get());
+    if (ret < 0) {
+        return Result<void>::err("Failed to write trailer: " +
+                                 ffmpegError(ret));
+    }
+    return Result<void>::ok();
+}
+
+usize ReplayBuffer::bytes() const {
+    std::lock_guard lock(mutex_);
+    return bytes_;
+}
+
+f64 ReplayBuffer::seconds() const {
+    std::lock_guard lock(mutex_);
+    if (gops_.empty())
+        return 0.0;
+    return static_cast<f64>(newestUs_ - gops_.front().startUs) / 1'000'000.0;
+}
+
+i64 ReplayBuffer::timeOf(const AVPacket& packet) const {
+    i64 ts = packet.dts != AV_NOPTS_VALUE ? packet.dts : packet.pts;
+    if (ts == AV_NOPTS_VALUE)
+        return newestUs_;
+    return av_rescale_q(ts,
+                        timeBases_[static_cast<usize>(packet.stream_index)],
+                        AV_TIME_BASE_Q);
+}
+
+} // namespace vc
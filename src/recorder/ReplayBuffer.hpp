@@ -0,0 +1,71 @@
+#pragma once
+// ReplayBuffer.hpp - The last few minutes of a recording, kept in memory
+// For when the best drop of the set happens and nobody hit record
+
+#include "FFmpegUtils.hpp"
+#include "util/Result.hpp"
+#include "util/Types.hpp"
+
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace vc {
+
+// Encoded packets of every stream, in the order the muxer would write them,
+// grouped by video keyframe. A group is only ever dropped whole, from the
+// front, once the groups after it still cover `seconds` (or the buffer is
+// over `maxBytes`), so the buffer always starts on a keyframe and can be
+// written out as a file without re-encoding.
+//
+// push() is the mux thread's; snapshot() may be called from any thread and
+// takes new references to the packets, not copies of their data. The
+// snapshot is written with write(), which needs nothing from the recorder,
+// so it can run on its own thread while recording goes on.
+class ReplayBuffer {
+public:
+    struct Snapshot {
+        std::vector<AVCodecParametersPtr> params; // By stream index
+        std::vector<AVRational> timeBases;
+        std::vector<AVPacketPtr> packets; // Starts on a video keyframe
+        i64 startUs{0};
+        f64 seconds{0.0};
+    };
+
+    // Copies the streams' parameters; clears whatever was buffered
+    Result<void> reset(const std::vector<AVStream*>& streams,
+                       u32 videoStream,
+                       f64 seconds,
+                       usize maxBytes);
+    void clear();
+
+    void push(AVPacketPtr packet);
+
+    Result<Snapshot> snapshot() const;
+    static Result<void> write(const Snapshot& snapshot, const fs::path& path);
+
+    usize bytes() const;
+    f64 seconds() const;
+
+private:
+    struct Gop {
+        i64 startUs{0};
+        usize bytes{0};
+        std::vector<AVPacketPtr> packets;
+    };
+
+    i64 timeOf(const AVPacket& packet) const;
+    void trim();
+
+    mutable std::mutex mutex_;
+    std::vector<AVCodecParametersPtr> params_;
+    std::vector<AVRational> timeBases_;
+    u32 videoStream_{0};
+    i64 windowUs_{0};
+    usize maxBytes_{0}; // 0 = no limit
+    std::deque<Gop> gops_;
+    usize bytes_{0};
+    i64 newestUs_{0};
+};
+
+} // namespace vc
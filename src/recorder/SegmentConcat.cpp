@@ -0,0 +1,347 @@
+#include "SegmentConcat.hpp"
+#include "core/Logger.hpp"
+
+#include <cstring>
+
+namespace vc {
+
+namespace {
+
+constexpr int VARIABLE_AUDIO_FRAME = 1024; // Same as VideoRecorder's
+constexpr int CHANNELS = 2;                // FFmpegAudioSource's output
+
+} // namespace
+
+SegmentConcat::SegmentConcat(std::vector<Segment> segments,
+                             fs::path audioInput,
+                             EncoderSettings settings)
+    : segments_(std::move(segments)),
+      audioInput_(std::move(audioInput)),
+      settings_(std::move(settings)) {}
+
+Result<void> SegmentConcat::run() {
+    if (segments_.empty())
+        return Result<void>::err("No segments to join");
+    packet_.reset(av_packet_alloc());
+    if (!packet_)
+        return Result<void>::err("Failed to allocate packet");
+
+    // The first segment's stream is the template for the output's
+    if (auto result = openSegment(0); !result)
+        return result;
+    if (auto result = openOutput(); !result)
+        return result;
+
+    std::vector<AVStream*> streams{videoStream_};
+    if (audioStream_)
+        streams.push_back(audioStream_);
+    interleaver_.reset(streams);
+
+    bool videoDone = false;
+    bool audioDone = !audioStream_;
+    while (!videoDone || !audioDone) {
+        // Feed whichever stream is behind; the interleaver does the rest
+        bool video = !videoDone && (audioDone || videoUs_ <= audioUs_);
+        auto more = video ? copyVideo() : encodeAudio();
+        if (!more)
+            return Result<void>::err(more.error().message);
+        if (!*more) {
+            AVStream* stream = video ? videoStream_ : audioStream_;
+            interleaver_.finish(static_cast<u32>(stream->index));
+            (video ? videoDone : audioDone) = true;
+        }
+        writeInterleaved(false);
+    }
+    writeInterleaved(true);
+    input_.reset();
+
+    int ret = av_write_trailer(output_.get());
+    output_.reset();
+    if (ret < 0) {
+        return Result<void>::err("Failed to write trailer: " +
+                                 ffmpegError(ret));
+    }
+    LOG_INFO("SegmentConcat: joined {} segments into {}",
+             segments_.size(),
+             settings_.outputPath.string());
+    return Result<void>::ok();
+}
+
+Result<void> SegmentConcat::openSegment(usize index) {
+    const auto& path = segments_[index].path;
+    AVFormatContext* ctx = nullptr;
+    int ret = avformat_open_input(&ctx, path.c_str(), nullptr, nullptr);
+    input_.reset(ctx);
+    if (ret < 0) {
+        return Result<void>::err("Failed to open segment " + path.string() +
+                                 ": " + ffmpegError(ret));
+    }
+    ret = avformat_find_stream_info(ctx, nullptr);
+    if (ret < 0) {
+        return Result<void>::err("Failed to read segment " + path.string() +
+                                 ": " + ffmpegError(ret));
+    }
+    inputStream_ =
+            av_find_best_stream(ctx, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    if (inputStream_ < 0)
+        return Result<void>::err("No video in segment " + path.string());
+
+    // Copying is only lossless between streams a decoder can't tell apart.
+    // That includes the extradata: the output keeps the first segment's
+    // SPS/PPS, which packets from another encoder session can't be decoded
+    // with.
+    if (videoStream_) {
+        const auto* ours = videoStream_->codecpar;
+        const auto* theirs = ctx->streams[inputStream_]->codecpar;
+        if (theirs->codec_id != ours->codec_id ||
+            theirs->width != ours->width || theirs->height != ours->height ||
+            theirs->format != ours->format) {
+            return Result<void>::err("Segment " + path.string() +
+                                     " was encoded differently");
+        }
+        if (theirs->extradata_size != ours->extradata_size ||
+            (ours->extradata_size > 0 &&
+             std::memcmp(theirs->extradata,
+                         ours->extradata,
+                         static_cast<usize>(ours->extradata_size)) != 0)) {
+            return Result<void>::err("Segment " + path.string() +
+                                     " has different codec headers");
+        }
+    }
+    nextSegment_ = index + 1;
+    return Result<void>::ok();
+}
+
+Result<void> SegmentConcat::openOutput() {
+    AVFormatContext* ctx = nullptr;
+    int ret = avformat_alloc_output_context2(
+            &ctx, nullptr, nullptr, settings_.outputPath.c_str());
+    output_.reset(ctx);
+    if (ret < 0 || !output_) {
+        return Result<void>::err("Failed to create output context: " +
+                                 ffmpegError(ret));
+    }
+
+    AVStream* source = input_->streams[inputStream_];
+    videoStream_ = avformat_new_stream(output_.get(), nullptr);
+    if (!videoStream_)
+        return Result<void>::err("Failed to create video stream");
+    ret = avcodec_parameters_copy(videoStream_->codecpar, source->codecpar);
+    if (ret < 0)
+        return Result<void>::err("Failed to copy video codec params");
+    videoStream_->codecpar->codec_tag = 0; // The container picks its own
+    videoStream_->time_base = source->time_base;
+    videoStream_->avg_frame_rate =
+            AVRational{static_cast<int>(settings_.video.fps), 1};
+
+    if (settings_.audio.enabled) {
+        if (auto result = openAudio(); !result)
+            return result;
+    }
+
+    if (!(output_->oformat->flags & AVFMT_NOFILE)) {
+        ret = avio_open(
+                &output_->pb, settings_.outputPath.c_str(), AVIO_FLAG_WRITE);
+        if (ret < 0) {
+            return Result<void>::err("Failed to open output file: " +
+                                     ffmpegError(ret));
+        }
+    }
+    ret = avformat_write_header(output_.get(), nullptr);
+    if (ret < 0) {
+        return Result<void>::err("Failed to write header: " +
+                                 ffmpegError(ret));
+    }
+    return Result<void>::ok();
+}
+
+Result<void> SegmentConcat::openAudio() {
+    const AVCodec* codec =
+            avcodec_find_encoder_by_name(settings_.audio.codecName().c_str());
+    if (!codec) {
+        LOG_WARN("Audio codec not found: {}, skipping audio",
+                 settings_.audio.codecName());
+        return Result<void>::ok();
+    }
+    const int rate = static_cast<int>(settings_.audio.sampleRate);
+    if (!audioSource_.open(audioInput_.string(), rate))
+        return Result<void>::err("Could not decode " + audioInput_.string());
+
+    audioStream_ = avformat_new_stream(output_.get(), nullptr);
+    if (!audioStream_)
+        return Result<void>::err("Failed to create audio stream");
+    audioCodecCtx_.reset(avcodec_alloc_context3(codec));
+    if (!audioCodecCtx_)
+        return Result<void>::err("Failed to allocate audio codec context");
+
+    AVChannelLayout layout;
+    av_channel_layout_default(&layout, CHANNELS);
+    audioCodecCtx_->sample_rate = rate;
+    audioCodecCtx_->bit_rate = settings_.audio.bitrate * 1000;
+    av_channel_layout_copy(&audioCodecCtx_->ch_layout, &layout);
+    audioCodecCtx_->sample_fmt =
+            codec->sample_fmts ? codec->sample_fmts[0] : AV_SAMPLE_FMT_FLTP;
+    audioCodecCtx_->time_base = AVRational{1, rate};
+    if (output_->oformat->flags & AVFMT_GLOBALHEADER)
+        audioCodecCtx_->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+    int ret = avcodec_open2(audioCodecCtx_.get(), codec, nullptr);
+    if (ret < 0) {
+        return Result<void>::err("Failed to open audio codec: " +
+                                 ffmpegError(ret));
+    }
+    ret = avcodec_parameters_from_context(audioStream_->codecpar,
+                                          audioCodecCtx_.get());
+    if (ret < 0)
+        return Result<void>::err("Failed to copy audio codec params");
+    audioStream_->time_base = audioCodecCtx_->time_base;
+
+    audioFrameSamples_ = audioCodecCtx_->frame_size > 0
+                                 ? audioCodecCtx_->frame_size
+                                 : VARIABLE_AUDIO_FRAME;
+    audioFrame_.reset(av_frame_alloc());
+    if (!audioFrame_)
+        return Result<void>::err("Failed to allocate audio frame");
+    audioFrame_->format = audioCodecCtx_->sample_fmt;
+    av_channel_layout_copy(&audioFrame_->ch_layout, &layout);
+    audioFrame_->sample_rate = rate;
+    audioFrame_->nb_samples = audioFrameSamples_;
+    if (av_frame_get_buffer(audioFrame_.get(), 0) < 0)
+        return Result<void>::err("Failed to allocate audio frame buffer");
+    pcm_.resize(static_cast<usize>(audioFrameSamples_) * CHANNELS);
+
+    // Same rate both sides: only the sample layout changes
+    SwrContext* s = nullptr;
+    ret = swr_alloc_set_opts2(&s,
+                              &layout,
+                              audioCodecCtx_->sample_fmt,
+                              rate,
+                              &layout,
+                              AV_SAMPLE_FMT_FLT,
+                              rate,
+                              0,
+                              nullptr);
+    swrCtx_.reset(s);
+    if (ret < 0 || !swrCtx_ || swr_init(swrCtx_.get()) < 0)
+        return Result<void>::err("Failed to create swresample context");
+    return Result<void>::ok();
+}
+
+Result<bool> SegmentConcat::copyVideo() {
+    for (;;) {
+        if (!input_) {
+            if (nextSegment_ == segments_.size())
+                return Result<bool>::ok(false);
+            if (auto result = openSegment(nextSegment_); !result)
+                return Result<bool>::err(result.error().message);
+        }
+        int ret = av_read_frame(input_.get(), packet_.get());
+        if (ret == AVERROR_EOF) {
+            input_.reset();
+            continue;
+        }
+        if (ret < 0) {
+            return Result<bool>::err("Failed to read segment: " +
+                                     ffmpegError(ret));
+        }
+        if (packet_->stream_index != inputStream_) {
+            av_packet_unref(packet_.get());
+            continue;
+        }
+
+        // Shifted by whole frames, so the joins land exactly on the frame
+        // grid whatever time bases the containers chose
+        const auto& segment = segments_[nextSegment_ - 1];
+        av_packet_rescale_ts(packet_.get(),
+                             input_->streams[inputStream_]->time_base,
+                             videoStream_->time_base);
+        i64 offset = av_rescale_q(
+                static_cast<i64>(segment.firstFrame),
+                AVRational{1, static_cast<int>(settings_.video.fps)},
+                videoStream_->time_base);
+        if (packet_->pts != AV_NOPTS_VALUE)
+            packet_->pts += offset;
+        if (packet_->dts != AV_NOPTS_VALUE) {
+            packet_->dts += offset;
+            videoUs_ = av_rescale_q(packet_->dts,
+                                    videoStream_->time_base,
+                                    AVRational{1, 1'000'000});
+        }
+        packet_->stream_index = videoStream_->index;
+        packet_->pos = -1;
+
+        AVPacketPtr packet(av_packet_alloc());
+        if (!packet)
+            return Result<bool>::err("Failed to allocate packet");
+        av_packet_move_ref(packet.get(), packet_.get());
+        interleaver_.push(std::move(packet));
+        ++videoFrames_;
+        return Result<bool>::ok(true);
+    }
+}
+
+Result<bool> SegmentConcat::encodeAudio() {
+    if (audioFlushed_)
+        return Result<bool>::ok(false);
+
+    usize got = audioSource_.read(pcm_.data(),
+                                  static_cast<usize>(audioFrameSamples_));
+    AVFrame* frame = nullptr;
+    if (got > 0) {
+        audioFrame_->nb_samples = audioFrameSamples_;
+        if (av_frame_make_writable(audioFrame_.get()) < 0)
+            return Result<bool>::err("Audio frame not writable");
+        const auto* in = reinterpret_cast<const uint8_t*>(pcm_.data());
+        int converted = swr_convert(swrCtx_.get(),
+                                    audioFrame_->data,
+                                    audioFrameSamples_,
+                                    &in,
+                                    static_cast<int>(got));
+        if (converted < 0) {
+            return Result<bool>::err("Audio resample error: " +
+                                     ffmpegError(converted));
+        }
+        // Only the last frame comes up short
+        audioFrame_->nb_samples = converted;
+        audioFrame_->pts = audioPts_;
+        audioPts_ += converted;
+        frame = audioFrame_.get();
+    } else {
+        audioFlushed_ = true; // Null frame: drain the encoder
+    }
+
+    int ret = avcodec_send_frame(audioCodecCtx_.get(), frame);
+    if (ret < 0) {
+        return Result<bool>::err("Failed to encode audio: " +
+                                 ffmpegError(ret));
+    }
+    for (;;) {
+        AVPacketPtr packet(av_packet_alloc());
+        if (!packet)
+            return Result<bool>::err("Failed to allocate packet");
+        ret = avcodec_receive_packet(audioCodecCtx_.get(), packet.get());
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
+            break;
+        if (ret < 0) {
+            return Result<bool>::err("Failed to encode audio: " +
+                                     ffmpegError(ret));
+        }
+        av_packet_rescale_ts(packet.get(),
+                             audioCodecCtx_->time_base,
+                             audioStream_->time_base);
+        packet->stream_index = audioStream_->index;
+        interleaver_.push(std::move(packet));
+    }
+    audioUs_ = audioPts_ * 1'000'000 / settings_.audio.sampleRate;
+    return Result<bool>::ok(true);
+}
+
+void SegmentConcat::writeInterleaved(bool drain) {
+    while (auto packet = interleaver_.pop(drain)) {
+        int ret = av_interleaved_write_frame(output_.get(), packet.get());
+        if (ret < 0)
+            LOG_WARN("Error writing packet: {}", ffmpegError(ret));
+    }
+}
+
+} // namespace vc
@@ -0,0 +1,81 @@
+#pragma once
+// SegmentConcat.hpp - Joins separately encoded video segments into one file
+// Stream copy all the way: not one pixel gets encoded twice
+
+#include "EncoderSettings.hpp"
+#include "FFmpegUtils.hpp"
+#include "PacketInterleaver.hpp"
+#include "audio/FFmpegAudioSource.hpp"
+#include "util/Result.hpp"
+#include "util/Types.hpp"
+
+#include <vector>
+
+namespace vc {
+
+// The last step of a chunked export. Each segment is a video-only file from
+// the same encoder settings that starts on a keyframe and never refers
+// back past it (a closed GOP), so its packets can simply follow the
+// previous segment's: they're copied as they are, with timestamps moved to
+// where the segment starts. The audio track is encoded here in one piece
+// from the original input, so there are no encoder priming gaps at the
+// joins. Both streams go through a PacketInterleaver into
+// settings.outputPath.
+class SegmentConcat {
+public:
+    struct Segment {
+        fs::path path;
+        u64 firstFrame{0}; // Where it starts in the whole video
+    };
+
+    SegmentConcat(std::vector<Segment> segments,
+                  fs::path audioInput,
+                  EncoderSettings settings);
+
+    Result<void> run();
+
+    u64 videoFrames() const {
+        return videoFrames_;
+    }
+    u64 audioSamples() const {
+        return static_cast<u64>(audioPts_);
+    }
+
+private:
+    Result<void> openSegment(usize index);
+    Result<void> openOutput();
+    Result<void> openAudio();
+
+    // Each queues the next packet(s) of its stream; false once it's done
+    Result<bool> copyVideo();
+    Result<bool> encodeAudio();
+    void writeInterleaved(bool drain);
+
+    std::vector<Segment> segments_;
+    fs::path audioInput_;
+    EncoderSettings settings_;
+
+    AVFormatContextPtr output_;
+    AVStream* videoStream_{nullptr};
+    AVStream* audioStream_{nullptr};
+    PacketInterleaver interleaver_;
+    AVPacketPtr packet_;
+
+    AVInputContextPtr input_; // The segment being copied
+    int inputStream_{-1};
+    usize nextSegment_{0};
+    u64 videoFrames_{0};
+    i64 videoUs_{0}; // How far each stream has got
+    i64 audioUs_{0};
+
+    FFmpegAudioSource audioSource_;
+    AVCodecContextPtr audioCodecCtx_;
+    SwrContextPtr swrCtx_;
+    AVFramePtr audioFrame_;
+    std::vector<f32> pcm_;
+    int audioFrameSamples_{0};
+    i64 audioPts_{0};
+    bool audioFlushed_{false};
+};
+
+} // namespace vc
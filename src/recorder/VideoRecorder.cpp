@@ -3,16 +3,69 @@
 #include "core/Logger.hpp"
 #include "util/FileUtils.hpp"
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <optional>
 
 namespace vc {
 
+namespace {
+
+constexpr u32 VIDEO_LANE = 0; // Stream indices, in creation order
+constexpr u32 AUDIO_LANE = 1;
+
+AVPixelFormat toAVPixelFormat(PixelFormat format) {
+    switch (format) {
+    case PixelFormat::YUV420P:
+        return AV_PIX_FMT_YUV420P;
+    case PixelFormat::YUV422P:
+        return AV_PIX_FMT_YUV422P;
+    case PixelFormat::YUV444P:
+        return AV_PIX_FMT_YUV444P;
+    case PixelFormat::RGB24:
+        return AV_PIX_FMT_RGB24;
+    }
+    return AV_PIX_FMT_YUV420P;
+}
+
+// Formats ColorConverter writes directly
+std::optional<ChromaFormat> chromaFormatOf(AVPixelFormat format) {
+    switch (format) {
+    case AV_PIX_FMT_YUV420P:
+        return ChromaFormat::Yuv420;
+    case AV_PIX_FMT_YUV422P:
+        return ChromaFormat::Yuv422;
+    case AV_PIX_FMT_YUV444P:
+        return ChromaFormat::Yuv444;
+    default:
+        return std::nullopt;
+    }
+}
+
+bool codecSupports(const AVCodec* codec, AVPixelFormat format) {
+    if (!codec->pix_fmts)
+        return true; // Doesn't say; let avcodec_open2 decide
+    for (const auto* f = codec->pix_fmts; *f != AV_PIX_FMT_NONE; ++f) {
+        if (*f == format)
+            return true;
+    }
+    return false;
+}
+
+} // namespace
+
 VideoRecorder::VideoRecorder() = default;
 
 VideoRecorder::~VideoRecorder() {
     if (isRecording()) {
         stop();
     }
+    if (replayThread_.joinable())
+        replayThread_.join();
 }
 
 Result<void> VideoRecorder::start(const EncoderSettings& settings) {
@@ -34,8 +87,35 @@ Result<void> VideoRecorder::start(const EncoderSettings& settings) {
     state_ = RecordingState::Starting;
     stateChanged.emitSignal(state_);
 
+    // A quarter of the cores converting leaves the rest to the encoder,
+    // which does far more work per frame
+    convertWorkers_ = settings_.convertThreads;
+    if (convertWorkers_ == 0) {
+        convertWorkers_ = std::clamp(
+                std::thread::hardware_concurrency() / 4, 1u, 4u);
+    }
+    convertWorkers_ = std::min(convertWorkers_, MAX_CONVERT_THREADS);
+
+    // Capture queue plus one frame in each converter and one in the PBO copy
+    usize frameBytes = static_cast<usize>(settings_.video.width) *
+                       settings_.video.height * 4;
+    if (auto result = framePool_.init(frameBytes,
+                                      FrameGrabber::MAX_QUEUE_SIZE +
+                                              convertWorkers_ + 1,
+                                      CONFIG.recording().hugePages);
+        !result) {
+        state_ = RecordingState::Error;
+        stateChanged.emitSignal(state_);
+        return result;
+    }
+    framePool_.resetStats();
+    // Offline renders wait for buffers instead of dropping
+    framePool_.setBlocking(settings_.backpressure ==
+                           BackpressurePolicy::BlockProducer);
+
     if (auto result = initFFmpeg(); !result) {
         cleanupFFmpeg();
+        framePool_.shutdown();
         state_ = RecordingState::Error;
         stateChanged.emitSignal(state_);
         return result;
@@ -44,23 +124,45 @@ Result<void> VideoRecorder::start(const EncoderSettings& settings) {
     // Reset stats
     stats_ = RecordingStats{};
     stats_.currentFile = settings_.outputPath.string();
+    stats_.convertThreads = convertWorkers_;
+    framesWritten_ = 0;
+    framesDuplicated_ = 0;
+    syncRepeats_ = 0;
+    syncDrops_ = 0;
+    avDriftUs_ = 0;
+    maxAvDriftUs_ = 0;
     statsUpdated.emitSignal(stats_);
 
-    // Start encoding thread
+    // Start the pipeline, back to front
     shouldStop_ = false;
     frameGrabber_.setSize(settings_.video.width, settings_.video.height);
+    frameGrabber_.setPool(&framePool_);
+    frameGrabber_.setPolicy(settings_.backpressure);
     frameGrabber_.start();
 
     startTime_ = std::chrono::duration_cast<std::chrono::microseconds>(
                          std::chrono::steady_clock::now().time_since_epoch())
                          .count();
-
-    encodingThread_ = std::thread(&VideoRecorder::encodingThread, this);
+    clock_.reset(startTime_, settings_.audio.sampleRate);
+
+    muxThread_ = std::thread(&VideoRecorder::muxThread, this);
+    for (auto& rendition : renditions_)
+        rendition->start();
+    if (audioStream_)
+        audioThread_ = std::thread(&VideoRecorder::audioEncodeThread, this);
+    videoThread_ = std::thread(&VideoRecorder::videoEncodeThread, this);
+    slicePool_.start(convertWorkers_);
+    activeConverters_ = convertWorkers_;
+    for (u32 worker = 0; worker < convertWorkers_; ++worker)
+        convertThreads_.emplace_back(&VideoRecorder::convertThread, this, worker);
 
     state_ = RecordingState::Recording;
     stateChanged.emitSignal(state_);
 
-    LOG_INFO("Recording started: {}", settings_.outputPath.string());
+    LOG_INFO("Recording started: {} (backpressure: {}, {} convert threads)",
+             settings_.outputPath.string(),
+             EncoderSettings::backpressureName(settings_.backpressure),
+             convertWorkers_);
     return Result<void>::ok();
 }
 
@@ -78,39 +180,149 @@ Result<void> VideoRecorder::stop() {
     state_ = RecordingState::Stopping;
     stateChanged.emitSignal(state_);
 
-    // Signal thread to stop
+    // Signal threads to stop. Each stage drains its input, then closes or
+    // ends its output, so shutting down front to back loses nothing.
     shouldStop_ = true;
     frameGrabber_.stop();
-
-    // Wait for encoding thread
-    if (encodingThread_.joinable()) {
-        encodingThread_.join();
+    // Whoever saw Recording before we changed it finishes their write;
+    // one blocked on a full ring gives up
+    audioSpaceSeq_.fetch_add(1, std::memory_order_release);
+    audioSpaceSeq_.notify_all();
+    while (audioProducers_.load() != 0)
+        std::this_thread::yield();
+    audioSeq_.fetch_add(1, std::memory_order_release);
+    audioSeq_.notify_all();
+
+    for (auto& thread : convertThreads_)
+        thread.join();
+    convertThreads_.clear();
+    slicePool_.stop();
+    if (videoThread_.joinable())
+        videoThread_.join();
+    if (audioThread_.joinable())
+        audioThread_.join();
+    muxQueue_.close();
+    if (muxThread_.joinable())
+        muxThread_.join();
+
+    // Finalize the file; segments before it are done or finishing on the
+    // writer's thread. A replay save in progress finishes first.
+    if (auto result = output_.close(); !result) {
+        LOG_WARN("{}", result.error().message);
+        error.emitSignal(result.error().message);
     }
-
-    // Flush encoders and finalize file
-    {
-        std::lock_guard lock(ffmpegMutex_);
-        flushEncoders();
-
-        // Write trailer
-        if (formatCtx_) {
-            av_write_trailer(formatCtx_.get());
+    // Ended by then too: the video encoder finished the first rendition,
+    // which finished the next, and the audio encoder ended their audio
+    for (auto& rendition : renditions_) {
+        if (auto result = rendition->close(); !result) {
+            LOG_WARN("{}", result.error().message);
+            error.emitSignal(result.error().message);
         }
+        LOG_INFO("Rendition {}x{}: {} frames, {} bytes, {}",
+                 rendition->width(),
+                 rendition->height(),
+                 rendition->framesWritten(),
+                 rendition->bytesWritten(),
+                 rendition->path().string());
     }
+    updateStats();
+    if (replayThread_.joinable())
+        replayThread_.join();
+    replay_.clear();
 
     cleanupFFmpeg();
 
+    // Every handle is back by now: the queue is drained and the converters
+    // are gone. Give the memory back until the next recording.
+    frameGrabber_.clear();
+    framePool_.setBlocking(false);
+    framePool_.shutdown();
+
     state_ = RecordingState::Stopped;
     stateChanged.emitSignal(state_);
 
     LOG_INFO("Recording stopped. Frames: {}, Dropped: {}",
              stats_.framesWritten,
              stats_.framesDropped);
+    auto queueStats = frameGrabber_.queueStats();
+    LOG_DEBUG("Frame queue: {} pushed, {} dropped oldest, {} dropped newest, "
+              "{} duplicated, {} stalls ({} ms)",
+              queueStats.pushed,
+              queueStats.droppedOldest,
+              queueStats.droppedNewest,
+              stats_.framesDuplicated,
+              queueStats.producerStalls,
+              queueStats.stallMicros / 1000);
+    if (settings_.audioClock) {
+        LOG_INFO("A/V sync: max drift {:.1f} ms, {} repeated, {} dropped, "
+                 "{} clock resyncs, audio clock skew {:.1f} ppm",
+                 stats_.maxAvDriftMs,
+                 stats_.syncRepeats,
+                 stats_.syncDrops,
+                 stats_.clockResyncs,
+                 stats_.clockSkewPpm);
+    }
+    LOG_DEBUG("Queue peaks: capture {}/{}, converted {}/{}, mux {}/{}",
+              stats_.captureQueue.peak,
+              stats_.captureQueue.capacity,
+              stats_.convertedQueue.peak,
+              stats_.convertedQueue.capacity,
+              stats_.muxQueue.peak,
+              stats_.muxQueue.capacity);
+
+    return Result<void>::ok();
+}
 
+Result<void> VideoRecorder::saveReplay(const fs::path& path) {
+    if (!isRecording() || !settings_.replay.enabled) {
+        return Result<void>::err("Replay buffer isn't running");
+    }
+    if (replaySaving_.exchange(true)) {
+        return Result<void>::err("Still saving the previous replay");
+    }
+    auto snapshot = replay_.snapshot();
+    if (!snapshot) {
+        replaySaving_ = false;
+        return Result<void>::err(snapshot.error().message);
+    }
+
+    fs::path output = path.empty() ? replayPath() : path;
+    file::ensureDir(output.parent_path());
+    // The last save is over (replaySaving_ was clear); reap its thread
+    if (replayThread_.joinable())
+        replayThread_.join();
+    replayThread_ = std::thread([this,
+                                 output,
+                                 snapshot = std::move(*snapshot)] {
+        auto result = ReplayBuffer::write(snapshot, output);
+        if (result) {
+            LOG_INFO("Replay saved: {} ({:.1f} s)",
+                     output.string(),
+                     snapshot.seconds);
+            replaySaved.emitSignal(output);
+        } else {
+            std::string errMsg = "Failed to save replay: " +
+                                 result.error().message;
+            LOG_ERROR("{}", errMsg);
+            error.emitSignal(errMsg);
+        }
+        replaySaving_ = false;
+    });
     return Result<void>::ok();
 }
 
-void VideoRecorder::submitVideoFrame(std::vector<u8>&& data,
+fs::path VideoRecorder::replayPath() const {
+    auto time = std::chrono::system_clock::to_time_t(
+            std::chrono::system_clock::now());
+    std::tm tm = *std::localtime(&time);
+    char buf[32];
+    std::strftime(buf, sizeof(buf), "_replay_%Y%m%d_%H%M%S", &tm);
+    const auto& base = settings_.outputPath;
+    return base.parent_path() /
+           (base.stem().string() + buf + base.extension().string());
+}
+
+void VideoRecorder::submitVideoFrame(FrameHandle data,
                                      u32 width,
                                      u32 height,
                                      i64 timestamp) {
@@ -121,7 +333,7 @@ void VideoRecorder::submitVideoFrame(std::vector<u8>&& data,
     frame.width = width;
     frame.height = height;
     frame.timestamp = timestamp;
-    frame.data = std::move(data); // ZERO COPY (move)
+    frame.data = std::move(data); // ZERO COPY (pooled buffer)
 
     // Push to queue for background processing
     frameGrabber_.pushFrame(std::move(frame));
@@ -134,14 +346,17 @@ void VideoRecorder::submitVideoFrame(const u8* data,
     if (state_ != RecordingState::Recording)
         return;
 
+    usize bytes = static_cast<usize>(width) * height * 4;
+    FrameHandle buffer = framePool_.acquire(bytes);
+    if (!buffer)
+        return; // The pool counts it, exhausted or undersized
+
     GrabbedFrame frame;
     frame.width = width;
     frame.height = height;
     frame.timestamp = timestamp;
-    frame.data.assign(
-            data,
-            data + width * height *
-                            4); // Still needed for legacy/const u8 paths
+    frame.data = std::move(buffer);
+    std::memcpy(frame.data.data(), data, bytes); // Legacy/const u8 paths
 
     // Push to queue for background processing
     frameGrabber_.pushFrame(std::move(frame));
@@ -151,130 +366,480 @@ void VideoRecorder::submitAudioSamples(const f32* data,
                                        u32 samples,
                                        u32 channels,
                                        u32 sampleRate) {
-    if (state_ != RecordingState::Recording)
-        return;
-    if (!audioStream_)
-        return;
+    // Counted in before the state check, so once stop() has seen the count
+    // at zero nobody is left writing to the ring
+    audioProducers_.fetch_add(1);
+    if (state_ == RecordingState::Recording && audioStream_) {
+        if (channels != settings_.audio.channels ||
+            sampleRate != settings_.audio.sampleRate) {
+            if (!audioFormatWarned_.exchange(true)) {
+                LOG_WARN("Audio arrives as {} Hz, {} ch but the recording "
+                         "expects {} Hz, {} ch",
+                         sampleRate,
+                         channels,
+                         settings_.audio.sampleRate,
+                         settings_.audio.channels);
+            }
+        }
+        // A different channel count would misalign every frame after it
+        if (channels == settings_.audio.channels) {
+            // On the clock before it's in the ring, so the encoder always
+            // knows where the samples it reads start. Overflow drops are
+            // counted as played: they were, just not recorded.
+            clock_.addAudio(
+                    samples,
+                    std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::steady_clock::now()
+                                    .time_since_epoch())
+                            .count());
+            usize count = static_cast<usize>(samples) * channels;
+            usize written = audioRing_.write(data, count, channels);
+            // Offline renders wait for the encoder instead of dropping
+            bool block =
+                    settings_.backpressure == BackpressurePolicy::BlockProducer;
+            while (written < count && block &&
+                   state_ == RecordingState::Recording) {
+                u32 seen = audioSpaceSeq_.load(std::memory_order_acquire);
+                audioSeq_.fetch_add(1, std::memory_order_release);
+                audioSeq_.notify_one();
+                written += audioRing_.write(data + written,
+                                            count - written,
+                                            channels);
+                if (written < count)
+                    audioSpaceSeq_.wait(seen, std::memory_order_acquire);
+            }
+            if (written < count)
+                audioSamplesDropped_ += (count - written) / channels;
+
+            // The audio encoder sleeps until there's something to do
+            audioSeq_.fetch_add(1, std::memory_order_release);
+            audioSeq_.notify_one();
+        }
+    }
+    audioProducers_.fetch_sub(1);
+}
 
-    // Check if audio is actually playing (not just silence/paused)
-    // This helps avoid recording while paused if the visualizer is still
-    // submitting frames However, the AudioEngine usually doesn't call this when
-    // paused.
+void VideoRecorder::convertThread(u32 worker) {
+    AVFramePtr out;
+    GrabbedFrame frame;
 
-    std::lock_guard lock(audioMutex_);
-    audioSampleRate_ = sampleRate;
-    audioChannels_ = channels;
+    // Take the output frame before the capture frame: whoever holds the
+    // sequence the encoder is waiting on can then always finish it
+    while (out || convertedPool_->pop(out)) {
+        // Read the sequence before checking for work so a push that lands
+        // in between makes the wait below return immediately
+        u32 seen = frameGrabber_.workSequence();
 
-    usize size = samples * channels;
-    audioBuffer_.insert(audioBuffer_.end(), data, data + size);
+        bool popped;
+        ConvertedFrame item;
+        {
+            std::lock_guard lock(capturePopMutex_);
+            popped = frameGrabber_.tryPop(frame);
+            if (popped)
+                item.sequence = nextSequence_++;
+        }
+        if (!popped) {
+            if (shouldStop_ && !frameGrabber_.hasFrames())
+                break;
+            frameGrabber_.waitForWork(seen);
+            continue;
+        }
+
+        item.timestamp = frame.timestamp;
+        item.repeatPrevious = frame.repeatPrevious;
+        item.valid = convertFrame(frame, out.get(), worker);
+        frame = {}; // Hand the capture buffer back before we queue
+        item.frame = std::move(out);
+        convertedQueue_->push(std::move(item));
+    }
+
+    if (out)
+        convertedPool_->push(std::move(out));
+    // Last one out tells the encoder there's nothing more coming
+    if (activeConverters_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        convertedQueue_->close();
 }
 
-void VideoRecorder::encodingThread() {
-    LOG_DEBUG("Encoding thread started");
+bool VideoRecorder::convertFrame(const GrabbedFrame& frame,
+                                 AVFrame* out,
+                                 u32 worker) {
+    // Only process if we have valid data
+    if (frame.data.empty() ||
+        frame.data.size() < static_cast<usize>(frame.width) * frame.height * 4)
+        return false;
 
-    auto lastStatsUpdate = std::chrono::steady_clock::now();
+    // The encoder or a rendition may still hold this frame's picture: let
+    // them keep it and take a free one rather than copying it
+    if (!av_frame_is_writable(out) && !pictures_.attach(out))
+        return false;
 
-    while (true) {
-        GrabbedFrame frame;
-        bool hasVideo = frameGrabber_.getNextFrame(frame, 10);
-        if (hasVideo) {
-            processVideoFrame(frame);
+    if (converter_ && frame.width == static_cast<u32>(out->width) &&
+        frame.height == static_cast<u32>(out->height)) {
+        PlanarImage planes;
+        for (usize i = 0; i < planes.data.size(); ++i) {
+            planes.data[i] = out->data[i];
+            planes.stride[i] = out->linesize[i];
         }
+        converter_->convert(frame.data.data(),
+                            static_cast<usize>(frame.width) * 4,
+                            frame.width,
+                            frame.height,
+                            planes,
+                            &slicePool_);
+        return true;
+    }
 
-        processAudioBuffer();
+    auto* scaler = scalerFor(worker, frame.width, frame.height);
+    if (!scaler)
+        return false;
+    scaler->source->data[0] = frame.data.data();
+    scaler->source->linesize[0] = static_cast<int>(frame.width * 4);
+    int ret = sws_scale_frame(scaler->ctx.get(), out, scaler->source.get());
+    scaler->source->data[0] = nullptr;
+    if (ret < 0) {
+        LOG_WARN("Frame scale error: {}", ffmpegError(ret));
+        return false;
+    }
+    return true;
+}
 
-        if (shouldStop_ && !hasVideo && !frameGrabber_.hasFrames()) {
-            break;
+VideoRecorder::Scaler* VideoRecorder::scalerFor(u32 worker,
+                                                u32 width,
+                                                u32 height) {
+    auto& scaler = scalers_[worker];
+    if (scaler.ctx && scaler.width == width && scaler.height == height)
+        return &scaler;
+
+    scaler = {};
+    SwsContextPtr ctx(sws_alloc_context());
+    AVFramePtr source(av_frame_alloc());
+    if (!ctx || !source)
+        return nullptr;
+
+    // swscale's own slice threads, sized like the fast path's
+    auto* opts = ctx.get();
+    av_opt_set_int(opts, "srcw", width, 0);
+    av_opt_set_int(opts, "srch", height, 0);
+    av_opt_set_int(opts, "src_format", captureFormat_, 0);
+    av_opt_set_int(opts, "dstw", videoCodecCtx_->width, 0);
+    av_opt_set_int(opts, "dsth", videoCodecCtx_->height, 0);
+    av_opt_set_int(opts, "dst_format", videoCodecCtx_->pix_fmt, 0);
+    av_opt_set_int(opts, "sws_flags", SWS_BILINEAR, 0);
+    av_opt_set_int(opts, "threads", slicePool_.size() + 1, 0);
+    if (int ret = sws_init_context(ctx.get(), nullptr, nullptr); ret < 0) {
+        LOG_WARN("Failed to create swscale context for {}x{}: {}",
+                 width,
+                 height,
+                 ffmpegError(ret));
+        return nullptr;
+    }
+
+    // Same matrix as ColorConverter, so scaled frames don't shift colour
+    const int* bt709 = sws_getCoefficients(SWS_CS_ITU709);
+    bool rgbSource = captureFormat_ == AV_PIX_FMT_RGBA;
+    sws_setColorspaceDetails(ctx.get(),
+                             bt709,
+                             rgbSource ? 1 : 0,
+                             bt709,
+                             videoCodecCtx_->color_range == AVCOL_RANGE_JPEG,
+                             0,
+                             1 << 16,
+                             1 << 16);
+
+    source->format = captureFormat_;
+    source->width = static_cast<int>(width);
+    source->height = static_cast<int>(height);
+
+    scaler.ctx = std::move(ctx);
+    scaler.source = std::move(source);
+    scaler.width = width;
+    scaler.height = height;
+    LOG_DEBUG("Convert worker {}: scaling {}x{} with swscale",
+              worker,
+              width,
+              height);
+    return &scaler;
+}
+
+void VideoRecorder::videoEncodeThread() {
+    LOG_DEBUG("Video encode thread started");
+
+    auto lastStatsUpdate = std::chrono::steady_clock::now();
+    const usize window = reorder_.size();
+    u64 next = 0;
+
+    ConvertedFrame item;
+    while (convertedQueue_->pop(item)) {
+        reorder_[item.sequence % window] = std::move(item);
+        for (;;) {
+            auto& ready = reorder_[next % window];
+            if (!ready.frame || ready.sequence != next)
+                break;
+            encodeVideo(ready);
+            ++next;
         }
 
         auto now = std::chrono::steady_clock::now();
         if (now - lastStatsUpdate >= std::chrono::seconds(1)) {
-            stats_.elapsed = Duration(
-                    std::chrono::duration_cast<std::chrono::milliseconds>(
-                            now -
-                            std::chrono::steady_clock::time_point(
-                                    std::chrono::microseconds(startTime_)))
-                            .count());
-
-            if (stats_.elapsed.count() > 0) {
-                stats_.avgFps = static_cast<f64>(stats_.framesWritten) *
-                                1000.0 / stats_.elapsed.count();
-            }
-
-            stats_.framesDropped = frameGrabber_.droppedFrames();
+            updateStats();
             statsUpdated.emitSignal(stats_);
             lastStatsUpdate = now;
         }
     }
 
-    LOG_DEBUG("Encoding thread finishing, flushing...");
+    // Drops after the last queued frame still owe their repeats. On the
+    // audio clock the timeline already filled every gap.
+    u32 owed = frameGrabber_.takeOwedRepeats();
+    if (!settings_.audioClock)
+        repeatLastVideoFrame(owed);
+
+    LOG_DEBUG("Video encode thread finishing, flushing...");
+    encodeFrame(videoCodecCtx_.get(), videoStream_, nullptr);
+    muxQueue_.push(MuxPacket{{}, VIDEO_LANE});
+    if (!renditions_.empty())
+        renditions_.front()->finish();
 }
 
-void VideoRecorder::processVideoFrame(const GrabbedFrame& frame) {
-    // Only process if we have valid data
-    if (frame.data.empty())
+void VideoRecorder::encodeVideo(ConvertedFrame& item) {
+    if (!settings_.audioClock)
+        repeatLastVideoFrame(item.repeatPrevious);
+
+    if (!item.valid ||
+        (settings_.audioClock && !placeOnTimeline(item.timestamp))) {
+        convertedPool_->push(std::move(item.frame));
         return;
+    }
 
-    std::lock_guard lock(ffmpegMutex_);
+    item.frame->pts = videoFrameCount_++;
+    if (encodeFrame(videoCodecCtx_.get(), videoStream_, item.frame.get())) {
+        ++framesWritten_;
+    }
+    // A reference, not a copy: the picture goes back to pictures_ only
+    // once the renditions are done with it
+    if (!renditions_.empty()) {
+        renditions_.front()->pushFrame(
+                AVFramePtr(av_frame_clone(item.frame.get())),
+                item.frame->pts);
+    }
 
-    if (!videoCodecCtx_ || !videoFrame_)
-        return;
+    // Keep this one for repeats; the one it replaces can be reused
+    if (lastVideoFrame_)
+        convertedPool_->push(std::move(lastVideoFrame_));
+    lastVideoFrame_ = std::move(item.frame);
+}
 
-    const u8* srcData[1] = {frame.data.data()};
-    int srcLinesize[1] = {static_cast<int>(frame.width * 4)};
+bool VideoRecorder::placeOnTimeline(i64 timestamp) {
+    auto placement = clock_.place(timestamp,
+                                  settings_.video.fps,
+                                  videoFrameCount_,
+                                  lastVideoFrame_ != nullptr);
+    videoFrameCount_ = placement.next;
+    if (placement.drop) {
+        ++syncDrops_;
+        return false;
+    }
+    if (placement.repeats > 0) {
+        repeatLastVideoFrame(placement.repeats);
+        syncRepeats_ += placement.repeats;
+    }
 
-    sws_scale(swsCtx_.get(),
-              srcData,
-              srcLinesize,
-              0,
-              frame.height,
-              videoFrame_->data,
-              videoFrame_->linesize);
+    i64 driftUs = placement.driftUs;
+    avDriftUs_.store(driftUs, std::memory_order_relaxed);
+    if (std::abs(driftUs) > maxAvDriftUs_.load(std::memory_order_relaxed))
+        maxAvDriftUs_.store(std::abs(driftUs), std::memory_order_relaxed);
+    return true;
+}
 
-    videoFrame_->pts = videoFrameCount_++;
+void VideoRecorder::repeatLastVideoFrame(u32 count) {
+    // Nothing encoded yet means nothing to repeat; the gap just shifts
+    if (count == 0 || !lastVideoFrame_)
+        return;
 
-    if (encodeVideoFrame(videoFrame_.get())) {
-        ++stats_.framesWritten;
+    for (u32 i = 0; i < count; ++i) {
+        i64 pts = videoFrameCount_++;
+        lastVideoFrame_->pts = pts;
+        if (encodeFrame(videoCodecCtx_.get(),
+                        videoStream_,
+                        lastVideoFrame_.get())) {
+            ++framesWritten_;
+            ++framesDuplicated_;
+        }
+        // The renditions repeat their own last frame
+        if (!renditions_.empty())
+            renditions_.front()->pushFrame(nullptr, pts);
     }
 }
 
-void VideoRecorder::processAudioBuffer() {
-    std::lock_guard lock(audioMutex_);
+void VideoRecorder::audioEncodeThread() {
+    LOG_DEBUG("Audio encode thread started");
 
-    if (!audioCodecCtx_ || !audioFrame_ || audioBuffer_.empty())
-        return;
+    for (;;) {
+        u32 seen = audioSeq_.load(std::memory_order_acquire);
+        processAudioBuffer();
+        if (shouldStop_)
+            break;
+        audioSeq_.wait(seen, std::memory_order_acquire);
+    }
+    // Whatever landed while we were checking, down to the last sample
+    processAudioBuffer(true);
+
+    encodeFrame(audioCodecCtx_.get(), audioStream_, nullptr);
+    muxQueue_.push(MuxPacket{{}, AUDIO_LANE});
+    for (auto& rendition : renditions_)
+        rendition->pushAudio(nullptr);
+}
 
-    int frameSize = audioCodecCtx_->frame_size;
-    if (frameSize <= 0)
+void VideoRecorder::processAudioBuffer(bool flush) {
+    if (!audioCodecCtx_ || !audioFrame_)
         return;
 
-    int channels = audioChannels_;
+    const usize channels = settings_.audio.channels;
+    const auto frameSamples = static_cast<usize>(audioFrameSamples_);
+    for (;;) {
+        usize queued = audioRing_.size() / channels;
+        // Only the very last frame may come up short
+        usize samples = std::min(queued, frameSamples);
+        if (samples == 0 || (samples < frameSamples && !flush))
+            return;
+        auto frames = static_cast<u32>(queued / frameSamples);
+        if (frames > audioPeakFrames_.load(std::memory_order_relaxed))
+            audioPeakFrames_.store(frames, std::memory_order_relaxed);
+
+        // The encoder may still hold the last frame's buffer
+        if (av_frame_make_writable(audioFrame_.get()) < 0)
+            return;
+        audioFrame_->nb_samples = static_cast<int>(samples);
+
+        // Converted in place, in pieces when the frame straddles the end
+        // of the ring. A channel count that doesn't divide the ring (six,
+        // say) can also split one sample there; that one goes through
+        // audioSeam_.
+        auto [head, tail] = audioRing_.peek(samples * channels);
+        usize split = head.size() % channels;
+        usize whole = head.size() - split;
+        bool ok = whole == 0 || convertAudio(head.first(whole), 0);
+        auto at = static_cast<int>(whole / channels);
+        if (ok && split > 0) {
+            std::copy(head.begin() + whole, head.end(), audioSeam_.begin());
+            std::copy_n(tail.begin(),
+                        channels - split,
+                        audioSeam_.begin() + split);
+            ok = convertAudio(audioSeam_, at++);
+            tail = tail.subspan(channels - split);
+        }
+        if (ok && !tail.empty())
+            ok = convertAudio(tail, at);
+        audioRing_.consume(samples * channels);
+        audioSpaceSeq_.fetch_add(1, std::memory_order_release);
+        audioSpaceSeq_.notify_one();
+        if (!ok)
+            continue;
+
+        audioFrame_->pts = audioFrameCount_;
+        if (settings_.audioClock)
+            audioFrame_->pts += clock_.audioStart();
+        audioFrameCount_ += static_cast<i64>(samples);
 
-    while (audioBuffer_.size() >= static_cast<usize>(frameSize * channels)) {
-        std::vector<f32> samples(audioBuffer_.begin(),
-                                 audioBuffer_.begin() + frameSize * channels);
-        audioBuffer_.erase(audioBuffer_.begin(),
-                           audioBuffer_.begin() + frameSize * channels);
+        encodeFrame(audioCodecCtx_.get(), audioStream_, audioFrame_.get());
+    }
+}
 
-        const u8* srcData[1] = {reinterpret_cast<const u8*>(samples.data())};
+bool VideoRecorder::convertAudio(std::span<const f32> samples, int offset) {
+    // Same rate in and out, so swresample converts sample for sample and
+    // keeps nothing back
+    const auto format = static_cast<AVSampleFormat>(audioFrame_->format);
+    const int channels = audioFrame_->ch_layout.nb_channels;
+    const bool planar = av_sample_fmt_is_planar(format);
+    const int step = av_get_bytes_per_sample(format) * (planar ? 1 : channels);
+
+    u8* out[AV_NUM_DATA_POINTERS] = {};
+    for (int plane = 0; plane < (planar ? channels : 1); ++plane)
+        out[plane] = audioFrame_->extended_data[plane] + offset * step;
+
+    const u8* in[1] = {reinterpret_cast<const u8*>(samples.data())};
+    int count = static_cast<int>(samples.size() / channels);
+    int ret = swr_convert(swrCtx_.get(), out, count, in, count);
+    if (ret < 0) {
+        LOG_WARN("Audio resample error: {}", ffmpegError(ret));
+        return false;
+    }
+    return true;
+}
 
-        int ret = swr_convert(swrCtx_.get(),
-                              audioFrame_->data,
-                              frameSize,
-                              srcData,
-                              frameSize);
-        if (ret < 0) {
-            LOG_WARN("Audio resample error: {}", ffmpegError(ret));
+void VideoRecorder::muxThread() {
+    MuxPacket item;
+    while (muxQueue_.pop(item)) {
+        if (item.packet)
+            interleaver_.push(std::move(item.packet));
+        else
+            interleaver_.finish(item.stream);
+        writeInterleaved(false);
+    }
+    writeInterleaved(true);
+}
+
+void VideoRecorder::writeInterleaved(bool drain) {
+    while (auto packet = interleaver_.pop(drain)) {
+        if (settings_.replay.enabled) {
+            replay_.push(std::move(packet));
             continue;
         }
+        output_.write(std::move(packet));
+    }
+}
 
-        audioFrame_->pts = audioFrameCount_;
-        audioFrameCount_ += frameSize;
+void VideoRecorder::updateStats() {
+    auto now = std::chrono::steady_clock::now();
+    stats_.elapsed = Duration(
+            std::chrono::duration_cast<std::chrono::milliseconds>(
+                    now - std::chrono::steady_clock::time_point(
+                                  std::chrono::microseconds(startTime_)))
+                    .count());
+
+    stats_.framesWritten = framesWritten_;
+    stats_.framesDuplicated = framesDuplicated_;
+    stats_.bytesWritten = output_.bytesWritten();
+    stats_.files = output_.files();
+    stats_.renditionBytes = 0;
+    for (const auto& rendition : renditions_)
+        stats_.renditionBytes += rendition->bytesWritten();
+    if (stats_.elapsed.count() > 0) {
+        stats_.avgFps = static_cast<f64>(stats_.framesWritten) * 1000.0 /
+                        stats_.elapsed.count();
+    }
 
-        {
-            std::lock_guard lockFFmpeg(ffmpegMutex_);
-            encodeAudioFrame(audioFrame_.get());
-        }
+    auto queueStats = frameGrabber_.queueStats();
+    stats_.framesDroppedOldest = queueStats.droppedOldest;
+    stats_.framesDroppedNewest = queueStats.droppedNewest;
+    stats_.producerStalls = queueStats.producerStalls;
+    stats_.framesDropped =
+            frameGrabber_.droppedFrames() + framePool_.exhaustedCount() +
+            framePool_.undersizedCount();
+
+    stats_.captureQueue = frameGrabber_.depth();
+    if (convertedQueue_)
+        stats_.convertedQueue = convertedQueue_->depth();
+    stats_.muxQueue = muxQueue_.depth();
+    if (audioFrameSamples_ > 0) {
+        usize frameValues = static_cast<usize>(audioFrameSamples_) *
+                            settings_.audio.channels;
+        stats_.audioQueue.current =
+                static_cast<u32>(audioRing_.size() / frameValues);
+        stats_.audioQueue.peak = audioPeakFrames_;
+        stats_.audioQueue.capacity =
+                static_cast<u32>(audioRing_.capacity() / frameValues);
+    }
+    stats_.audioSamplesDropped = audioSamplesDropped_;
+
+    stats_.avDriftMs = static_cast<f64>(avDriftUs_) / 1000.0;
+    stats_.maxAvDriftMs = static_cast<f64>(maxAvDriftUs_) / 1000.0;
+    stats_.clockSkewPpm = clock_.skewPpm();
+    stats_.syncRepeats = syncRepeats_;
+    stats_.syncDrops = syncDrops_;
+    stats_.clockResyncs = clock_.resyncs();
+    if (settings_.replay.enabled) {
+        stats_.replayBytes = replay_.bytes();
+        stats_.replaySeconds = replay_.seconds();
     }
 }
 
@@ -299,26 +864,11 @@ Result<void> VideoRecorder::initFFmpeg() {
         return result;
     }
 
-    if (!(formatCtx_->oformat->flags & AVFMT_NOFILE)) {
-        ret = avio_open(
-                &formatCtx_->pb, settings_.outputPath.c_str(), AVIO_FLAG_WRITE);
-        if (ret < 0) {
-            return Result<void>::err("Failed to open output file: " +
-                                     ffmpegError(ret));
-        }
-    }
-
-    AVDictionary* opts = nullptr;
-    ret = avformat_write_header(formatCtx_.get(), &opts);
-    av_dict_free(&opts);
-
-    if (ret < 0) {
-        return Result<void>::err("Failed to write header: " + ffmpegError(ret));
-    }
-
-    packet_.reset(av_packet_alloc());
-    if (!packet_) {
-        return Result<void>::err("Failed to allocate packet");
+    // This context is never written: it describes the streams, in the
+    // codecs' time bases, and OutputWriter (or the replay buffer) opens the
+    // actual files from it
+    if (auto result = initPipeline(); !result) {
+        return result;
     }
 
     LOG_DEBUG("FFmpeg initialized successfully");
@@ -349,11 +899,37 @@ Result<void> VideoRecorder::initVideoStream() {
             AVRational{1, static_cast<int>(settings_.video.fps)};
     videoCodecCtx_->framerate =
             AVRational{static_cast<int>(settings_.video.fps), 1};
-    videoCodecCtx_->pix_fmt = AV_PIX_FMT_YUV420P;
+    videoCodecCtx_->pix_fmt = toAVPixelFormat(settings_.video.pixelFormat);
+    if (!codecSupports(codec, videoCodecCtx_->pix_fmt)) {
+        LOG_WARN("{} can't encode {}, using {}",
+                 settings_.video.codecName(),
+                 settings_.video.pixelFormatName(),
+                 av_get_pix_fmt_name(codec->pix_fmts[0]));
+        videoCodecCtx_->pix_fmt = codec->pix_fmts[0];
+    }
     videoCodecCtx_->gop_size = settings_.video.gopSize > 0
                                        ? settings_.video.gopSize
                                        : settings_.video.fps * 2;
     videoCodecCtx_->max_b_frames = settings_.video.bFrames;
+    // Segments and replays start on a keyframe: nothing may refer back
+    // past one
+    bool cutOnKeyframes = settings_.file.segmentSeconds > 0 ||
+                          settings_.file.segmentMegabytes > 0 ||
+                          settings_.replay.enabled;
+    if (settings_.video.closedGop || cutOnKeyframes)
+        videoCodecCtx_->flags |= AV_CODEC_FLAG_CLOSED_GOP;
+    // Let the encoder size its own thread pool; FFmpeg's default of one
+    // thread leaves most of a big machine idle for codecs without their own
+    videoCodecCtx_->thread_count = 0;
+
+    // Every conversion path uses the BT.709 matrix; say so in the stream.
+    // The compositor's YCbCr is always limited range.
+    bool fullRange = settings_.video.fullRange && !settings_.video.gpuYCbCr;
+    videoCodecCtx_->colorspace = AVCOL_SPC_BT709;
+    videoCodecCtx_->color_primaries = AVCOL_PRI_BT709;
+    videoCodecCtx_->color_trc = AVCOL_TRC_BT709;
+    videoCodecCtx_->color_range =
+            fullRange ? AVCOL_RANGE_JPEG : AVCOL_RANGE_MPEG;
 
     if (formatCtx_->oformat->flags & AVFMT_GLOBALHEADER) {
         videoCodecCtx_->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
@@ -384,45 +960,46 @@ Result<void> VideoRecorder::initVideoStream() {
 
     videoStream_->time_base = videoCodecCtx_->time_base;
 
-    videoFrame_.reset(av_frame_alloc());
-    if (!videoFrame_) {
-        return Result<void>::err("Failed to allocate video frame");
+    // Same-size frames into plain planar YUV skip swscale entirely;
+    // anything else gets a scaler per worker when it first turns up. A
+    // window resize can send any frame that way, so swscale has to be able
+    // to read the capture format even when the converter covers the rest.
+    captureFormat_ =
+            settings_.video.gpuYCbCr ? AV_PIX_FMT_VUYA : AV_PIX_FMT_RGBA;
+    if (!sws_isSupportedInput(captureFormat_)) {
+        return Result<void>::err(
+                std::string("swscale can't read ") +
+                av_get_pix_fmt_name(captureFormat_) +
+                "; disable recording.video.gpu_ycbcr");
     }
-
-    videoFrame_->format = videoCodecCtx_->pix_fmt;
-    videoFrame_->width = videoCodecCtx_->width;
-    videoFrame_->height = videoCodecCtx_->height;
-
-    ret = av_frame_get_buffer(videoFrame_.get(), 0);
-    if (ret < 0) {
-        return Result<void>::err("Failed to allocate video frame buffer");
-    }
-
-    swsCtx_.reset(sws_getContext(settings_.video.width,
-                                 settings_.video.height,
-                                 AV_PIX_FMT_RGBA,
-                                 settings_.video.width,
-                                 settings_.video.height,
-                                 AV_PIX_FMT_YUV420P,
-                                 SWS_BILINEAR,
-                                 nullptr,
-                                 nullptr,
-                                 nullptr));
-
-    if (!swsCtx_) {
-        return Result<void>::err("Failed to create swscale context");
+    converter_.reset();
+    if (auto chroma = chromaFormatOf(videoCodecCtx_->pix_fmt)) {
+        ColorConverter::Format format;
+        format.vuya = settings_.video.gpuYCbCr;
+        format.chroma = *chroma;
+        format.fullRange = fullRange;
+        converter_ = std::make_unique<ColorConverter>(format);
     }
+    scalers_.clear();
+    scalers_.resize(convertWorkers_);
 
-    LOG_DEBUG("Video stream initialized: {}x{} @ {} fps, codec: {}",
+    LOG_DEBUG("Video stream initialized: {}x{} @ {} fps, codec: {}, {} ({})",
               settings_.video.width,
               settings_.video.height,
               settings_.video.fps,
-              settings_.video.codecName());
+              settings_.video.codecName(),
+              av_get_pix_fmt_name(videoCodecCtx_->pix_fmt),
+              !converter_           ? "swscale"
+              : converter_->usesAvx2() ? "AVX2"
+                                       : "scalar");
 
     return Result<void>::ok();
 }
 
 Result<void> VideoRecorder::initAudioStream() {
+    if (!settings_.audio.enabled)
+        return Result<void>::ok();
+
     const AVCodec* codec =
             avcodec_find_encoder_by_name(settings_.audio.codecName().c_str());
     if (!codec) {
@@ -479,15 +1056,24 @@ Result<void> VideoRecorder::initAudioStream() {
     audioFrame_->format = audioCodecCtx_->sample_fmt;
     av_channel_layout_copy(&audioFrame_->ch_layout, &audioCodecCtx_->ch_layout);
     audioFrame_->sample_rate = audioCodecCtx_->sample_rate;
-    audioFrame_->nb_samples = audioCodecCtx_->frame_size;
+    audioFrameSamples_ = audioCodecCtx_->frame_size > 0
+                                 ? audioCodecCtx_->frame_size
+                                 : VARIABLE_AUDIO_FRAME;
+    audioFrame_->nb_samples = audioFrameSamples_;
 
-    if (audioFrame_->nb_samples > 0) {
-        ret = av_frame_get_buffer(audioFrame_.get(), 0);
-        if (ret < 0) {
-            return Result<void>::err("Failed to allocate audio frame buffer");
-        }
+    ret = av_frame_get_buffer(audioFrame_.get(), 0);
+    if (ret < 0) {
+        return Result<void>::err("Failed to allocate audio frame buffer");
     }
 
+    // The only audio allocations; reused while the format stays the same
+    audioRing_.reset(static_cast<usize>(settings_.audio.sampleRate) *
+                     settings_.audio.channels * AUDIO_RING_SECONDS);
+    audioSeam_.assign(settings_.audio.channels, 0.0f);
+    audioSamplesDropped_ = 0;
+    audioPeakFrames_ = 0;
+    audioFormatWarned_ = false;
+
     SwrContext* s = nullptr;
     ret = swr_alloc_set_opts2(&s,
                               &audioCodecCtx_->ch_layout,
@@ -518,13 +1104,101 @@ Result<void> VideoRecorder::initAudioStream() {
     return Result<void>::ok();
 }
 
-void VideoRecorder::cleanupFFmpeg() {
-    std::lock_guard lock(ffmpegMutex_);
+Result<void> VideoRecorder::initPipeline() {
+    // Enough converted frames for every worker, a queue's worth ahead of
+    // the encoder, the ones parked in reorder_ behind a slow worker and the
+    // one kept for repeats. The encoder and the renditions hold references
+    // to the pictures, not these frames, so they don't count.
+    usize queueSize = convertWorkers_ * 2;
+    usize poolSize = queueSize + convertWorkers_ * 2;
+    if (!pictures_.init(videoCodecCtx_->pix_fmt,
+                        videoCodecCtx_->width,
+                        videoCodecCtx_->height)) {
+        return Result<void>::err("Failed to create video frame buffer pool");
+    }
+    convertedQueue_ = std::make_unique<StageQueue<ConvertedFrame>>(queueSize);
+    convertedPool_ = std::make_unique<StageQueue<AVFramePtr>>(poolSize);
+    for (usize i = 0; i < poolSize; ++i) {
+        AVFramePtr frame(av_frame_alloc());
+        if (!frame) {
+            return Result<void>::err("Failed to allocate video frame");
+        }
+        if (!pictures_.attach(frame.get())) {
+            return Result<void>::err("Failed to allocate video frame buffer");
+        }
+        convertedPool_->push(std::move(frame));
+    }
+    reorder_.clear();
+    reorder_.resize(poolSize);
+    nextSequence_ = 0;
+
+    std::vector<AVStream*> streams{videoStream_};
+    if (audioStream_)
+        streams.push_back(audioStream_);
+    interleaver_.reset(streams);
+    muxQueue_.reset();
+    if (settings_.replay.enabled) {
+        return replay_.reset(
+                streams,
+                VIDEO_LANE,
+                settings_.replay.seconds,
+                static_cast<usize>(settings_.replay.maxMegabytes) << 20);
+    }
 
-    packet_.reset();
-    videoFrame_.reset();
+    OutputWriter::Options output;
+    output.path = settings_.outputPath;
+    output.fragmentSeconds = settings_.file.fragmentSeconds;
+    output.segmentSeconds = settings_.file.segmentSeconds;
+    output.segmentBytes = static_cast<u64>(settings_.file.segmentMegabytes)
+                          << 20;
+    if (auto result = output_.open(streams, VIDEO_LANE, std::move(output));
+        !result) {
+        return result;
+    }
+
+    // Largest first, so each scales from the nearest size above it
+    auto renditions = settings_.renditions;
+    std::stable_sort(renditions.begin(),
+                     renditions.end(),
+                     [](const Rendition& a, const Rendition& b) {
+                         return static_cast<u64>(a.width) * a.height >
+                                static_cast<u64>(b.width) * b.height;
+                     });
+    renditions_.clear();
+    auto sourceWidth = static_cast<u32>(videoCodecCtx_->width);
+    auto sourceHeight = static_cast<u32>(videoCodecCtx_->height);
+    for (auto& rendition : renditions) {
+        auto encoder = std::make_unique<RenditionEncoder>(std::move(rendition));
+        if (auto result = encoder->open(settings_,
+                                        videoCodecCtx_.get(),
+                                        sourceWidth,
+                                        sourceHeight,
+                                        audioStream_);
+            !result) {
+            return result;
+        }
+        sourceWidth = encoder->width();
+        sourceHeight = encoder->height();
+        if (!renditions_.empty())
+            renditions_.back()->setNext(encoder.get());
+        renditions_.push_back(std::move(encoder));
+    }
+    return Result<void>::ok();
+}
+
+void VideoRecorder::cleanupFFmpeg() {
+    // Only ever called with the pipeline threads stopped
+    output_.close();
+    renditions_.clear();
+    reorder_.clear();
+    lastVideoFrame_.reset();
+    convertedQueue_.reset();
+    convertedPool_.reset();
+    pictures_.reset();
+    muxQueue_.reset();
     audioFrame_.reset();
-    swsCtx_.reset();
+    scalers_.clear();
+    converter_.reset();
     swrCtx_.reset();
     videoCodecCtx_.reset();
     audioCodecCtx_.reset();
@@ -534,106 +1208,57 @@ void VideoRecorder::cleanupFFmpeg() {
     audioStream_ = nullptr;
     videoFrameCount_ = 0;
     audioFrameCount_ = 0;
+    audioFrameSamples_ = 0;
 }
 
-bool VideoRecorder::encodeVideoFrame(AVFrame* frame) {
-    int ret = avcodec_send_frame(videoCodecCtx_.get(), frame);
-    if (ret < 0) {
-        std::string errMsg = "Error sending video frame: " + ffmpegError(ret);
-        LOG_WARN("{}", errMsg);
-        error.emitSignal(errMsg);
+bool VideoRecorder::encodeFrame(AVCodecContext* codec,
+                                AVStream* stream,
+                                AVFrame* frame) {
+    if (!codec || !stream)
         return false;
-    }
-
-    while (ret >= 0) {
-        ret = avcodec_receive_packet(videoCodecCtx_.get(), packet_.get());
-        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
-            break;
-        }
-        if (ret < 0) {
-            std::string errMsg =
-                    "Error receiving video packet: " + ffmpegError(ret);
-            LOG_WARN("{}", errMsg);
-            error.emitSignal(errMsg);
-            return false;
-        }
-
-        if (!writePacket(packet_.get(), videoStream_)) {
-            return false;
-        }
-    }
 
-    return true;
-}
-
-bool VideoRecorder::encodeAudioFrame(AVFrame* frame) {
-    int ret = avcodec_send_frame(audioCodecCtx_.get(), frame);
+    const char* kind = stream == videoStream_ ? "video" : "audio";
+    int ret = avcodec_send_frame(codec, frame);
     if (ret < 0) {
-        std::string errMsg = "Error sending audio frame: " + ffmpegError(ret);
+        std::string errMsg = std::string("Error sending ") + kind +
+                             " frame: " + ffmpegError(ret);
         LOG_WARN("{}", errMsg);
         error.emitSignal(errMsg);
         return false;
     }
 
-    while (ret >= 0) {
-        ret = avcodec_receive_packet(audioCodecCtx_.get(), packet_.get());
+    for (;;) {
+        AVPacketPtr packet(av_packet_alloc());
+        if (!packet)
+            return false;
+        ret = avcodec_receive_packet(codec, packet.get());
         if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
             break;
         }
         if (ret < 0) {
-            std::string errMsg =
-                    "Error receiving audio packet: " + ffmpegError(ret);
+            std::string errMsg = std::string("Error receiving ") + kind +
+                                 " packet: " + ffmpegError(ret);
             LOG_WARN("{}", errMsg);
             error.emitSignal(errMsg);
             return false;
         }
 
-        if (!writePacket(packet_.get(), audioStream_)) {
-            return false;
+        // The interleaver compares in stream time bases
+        av_packet_rescale_ts(packet.get(), codec->time_base, stream->time_base);
+        packet->stream_index = stream->index;
+        // Audio is encoded once, for every file
+        if (stream == audioStream_) {
+            for (auto& rendition : renditions_) {
+                AVPacketPtr ref(av_packet_clone(packet.get()));
+                if (ref)
+                    rendition->pushAudio(std::move(ref));
+            }
         }
+        muxQueue_.push(MuxPacket{std::move(packet),
+                                 static_cast<u32>(stream->index)});
     }
 
     return true;
 }
 
-bool VideoRecorder::writePacket(AVPacket* packet, AVStream* stream) {
-    av_packet_rescale_ts(packet,
-                         stream == videoStream_ ? videoCodecCtx_->time_base
-                                                : audioCodecCtx_->time_base,
-                         stream->time_base);
-
-    packet->stream_index = stream->index;
-
-    int ret = av_interleaved_write_frame(formatCtx_.get(), packet);
-    if (ret < 0) {
-        LOG_WARN("Error writing packet: {}", ffmpegError(ret));
-        return false;
-    }
-
-    stats_.bytesWritten += packet->size;
-    return true;
-}
-
-void VideoRecorder::flushEncoders() {
-    if (videoCodecCtx_) {
-        avcodec_send_frame(videoCodecCtx_.get(), nullptr);
-
-        int ret;
-        while ((ret = avcodec_receive_packet(videoCodecCtx_.get(),
-                                             packet_.get())) >= 0) {
-            writePacket(packet_.get(), videoStream_);
-        }
-    }
-
-    if (audioCodecCtx_) {
-        avcodec_send_frame(audioCodecCtx_.get(), nullptr);
-
-        int ret;
-        while ((ret = avcodec_receive_packet(audioCodecCtx_.get(),
-                                             packet_.get())) >= 0) {
-            writePacket(packet_.get(), audioStream_);
-        }
-    }
-}
-
 } // namespace vc
@@ -1,16 +1,27 @@
 #pragma once
 // VideoRecorder.hpp - FFmpeg-based video recording
 
+#include "ColorConvert.hpp"
 #include "EncoderSettings.hpp"
 #include "FFmpegUtils.hpp"
 #include "FrameGrabber.hpp"
+#include "FramePool.hpp"
+#include "OutputWriter.hpp"
+#include "PacketInterleaver.hpp"
+#include "RecordingClock.hpp"
+#include "RenditionEncoder.hpp"
+#include "ReplayBuffer.hpp"
 #include "util/Result.hpp"
 #include "util/Signal.hpp"
+#include "util/SpscRing.hpp"
+#include "util/StageQueue.hpp"
 #include "util/Types.hpp"
+#include "util/WorkerPool.hpp"
 
 #include <atomic>
-#include <condition_variable>
+#include <memory>
 #include <mutex>
+#include <span>
 #include <thread>
 #include <vector>
 
@@ -23,13 +34,80 @@ struct RecordingStats {
     u64 framesWritten{0};
     u64 framesDropped{0};
     u64 bytesWritten{0};
+    u32 files{0}; // Segments started, with EncoderSettings::file
+    u64 renditionBytes{0}; // All EncoderSettings::renditions together
+
+    // Backpressure counters (see BackpressurePolicy)
+    u64 framesDroppedOldest{0};
+    u64 framesDroppedNewest{0};
+    u64 framesDuplicated{0};
+    u64 producerStalls{0};
+
+    // Pipeline queue depths, one per stage input (see VideoRecorder)
+    StageDepth captureQueue;   // Capture -> convert
+    StageDepth convertedQueue; // Convert -> video encode
+    StageDepth audioQueue;     // Submitted audio, in codec frames
+    StageDepth muxQueue;       // Encoders -> mux
+    u32 convertThreads{0};
+    u64 audioSamplesDropped{0}; // Per channel, audio ring was full
+
+    // A/V sync on the audio clock (see RecordingClock)
+    f64 avDriftMs{0.0};    // Last frame's distance from its slot
+    f64 maxAvDriftMs{0.0}; // Largest |avDriftMs| so far
+    f64 clockSkewPpm{0.0}; // Audio clock against steady_clock
+    u64 syncRepeats{0};    // Frames repeated to fill a gap
+    u64 syncDrops{0};      // Frames dropped for landing on a taken slot
+    u64 clockResyncs{0};   // Audio clock jumps (pause, underrun)
+
+    // Replay mode: what saveReplay() would write right now
+    u64 replayBytes{0};
+    f64 replaySeconds{0.0};
+
     f64 avgFps{0.0};
     f64 encodingFps{0.0};
     std::string currentFile;
 };
 
+// Encodes in stages, each on its own thread(s), joined by bounded queues:
+//
+//   FrameGrabber -> convert workers -> video encoder --+
+//                   (N, sliced)                        +-> muxer -> file
+//   submitAudioSamples -------------> audio encoder ---+
+//
+// Converters take frames in parallel and tag them with a capture sequence
+// number; the video encoder puts them back in order. Each frame is cut into
+// slices shared with a pool of helpers, through ColorConverter when it is
+// already the output size, or swscale's own slice threads when it needs
+// scaling. Converted frames come from a fixed pool that cycles back from the
+// encoder, so the converters can't run further ahead than the pool allows.
+// Encoders hand packets to the muxer, which interleaves them by timestamp
+// and passes them to an OutputWriter (fragmented, and cut into segments if
+// EncoderSettings::file says so). Only the capture queue applies the
+// backpressure policy; the queues inside block, so whatever it accepted
+// reaches the file.
+//
+// With EncoderSettings::audioClock, the video encoder places each frame by
+// its capture timestamp on the audio sample clock and keeps constant frame
+// rate by repeating the previous frame into gaps and dropping frames that
+// land on a slot already taken. Otherwise frames are simply numbered.
+//
+// Each of EncoderSettings::renditions gets a RenditionEncoder, fed from the
+// video encoder: it takes a reference to every frame the main encoder gets
+// (nothing for a repeat), scales it down and encodes and muxes it on threads
+// of its own, with the same audio packets, into a file next to the main one.
+//
+// In replay mode (EncoderSettings::replay) nothing is written while
+// recording: the muxer hands its packets to a ReplayBuffer instead, and
+// saveReplay() writes the last stretch of it to a file from a thread of its
+// own while the pipeline carries on.
 class VideoRecorder {
 public:
+    static constexpr usize MUX_QUEUE_SIZE = 256;
+    static constexpr u32 MAX_CONVERT_THREADS = 8;
+    static constexpr u32 AUDIO_RING_SECONDS = 2;
+    // Chunk size for codecs that take any frame size (PCM)
+    static constexpr int VARIABLE_AUDIO_FRAME = 1024;
+
     VideoRecorder();
     ~VideoRecorder();
 
@@ -40,12 +118,23 @@ public:
     // Stop recording
     Result<void> stop();
 
-    // Submit frames
-    void submitVideoFrame(std::vector<u8>&& data,
+    // Replay mode: saves the buffer to `path`, by default next to
+    // outputPath with the time in its name. Returns once the packets are
+    // referenced; replaySaved (or error) follows from the saving thread.
+    Result<void> saveReplay(const fs::path& path = {});
+    bool replayMode() const {
+        return settings_.replay.enabled;
+    }
+
+    // Submit frames. Pooled buffers are handed over without copying.
+    void submitVideoFrame(FrameHandle data,
                           u32 width,
                           u32 height,
                           i64 timestamp);
     void submitVideoFrame(const u8* data, u32 width, u32 height, i64 timestamp);
+    // Interleaved float, from one thread at a time (the audio callback).
+    // Never allocates. What doesn't fit in the ring is dropped, unless the
+    // backpressure policy is BlockProducer; then it waits for the encoder.
     void submitAudioSamples(const f32* data,
                             u32 samples,
                             u32 channels,
@@ -67,28 +156,69 @@ public:
         return settings_;
     }
 
+    // Capture buffers, sized for the current recording. Producers acquire
+    // from here and pass the handle to submitVideoFrame().
+    FramePool& framePool() {
+        return framePool_;
+    }
+
     // Signals
     Signal<RecordingState> stateChanged;
     Signal<const RecordingStats&> statsUpdated;
     Signal<std::string> error;
+    Signal<fs::path> replaySaved;
 
 private:
-    // Encoding thread
-    void encodingThread();
-    void processVideoFrame(const GrabbedFrame& frame);
-    void processAudioBuffer();
-    void flushEncoders();
+    // A converted picture on its way to the video encoder
+    struct ConvertedFrame {
+        AVFramePtr frame; // From the converted pool, always set
+        u64 sequence{0};  // Capture order
+        i64 timestamp{0}; // Capture time, steady clock microseconds
+        u32 repeatPrevious{0};
+        bool valid{false}; // False if the capture was unusable
+    };
+
+    struct MuxPacket {
+        AVPacketPtr packet; // Null marks the end of the stream
+        u32 stream{0};
+    };
+
+    // Fallback for frames that need resizing or a format ColorConverter
+    // doesn't write
+    struct Scaler {
+        SwsContextPtr ctx;
+        AVFramePtr source; // Wraps the capture buffer, owns nothing
+        u32 width{0};
+        u32 height{0};
+    };
+
+    // Pipeline stages
+    void convertThread(u32 worker);
+    void videoEncodeThread();
+    void audioEncodeThread();
+    void muxThread();
+
+    bool convertFrame(const GrabbedFrame& frame, AVFrame* out, u32 worker);
+    Scaler* scalerFor(u32 worker, u32 width, u32 height);
+    void encodeVideo(ConvertedFrame& item);
+    bool placeOnTimeline(i64 timestamp);
+    void repeatLastVideoFrame(u32 count);
+    void processAudioBuffer(bool flush = false);
+    bool convertAudio(std::span<const f32> samples, int offset);
+    void writeInterleaved(bool drain);
+    void updateStats();
+    fs::path replayPath() const;
 
     // FFmpeg setup
     Result<void> initFFmpeg();
     Result<void> initVideoStream();
     Result<void> initAudioStream();
+    Result<void> initPipeline();
     void cleanupFFmpeg();
 
-    // Encoding
-    bool encodeVideoFrame(AVFrame* frame);
-    bool encodeAudioFrame(AVFrame* frame);
-    bool writePacket(AVPacket* packet, AVStream* stream);
+    // Sends `frame` (null flushes) and queues every packet it produces
+    // for the muxer
+    bool encodeFrame(AVCodecContext* codec, AVStream* stream, AVFrame* frame);
 
     // State
     std::atomic<RecordingState> state_{RecordingState::Stopped};
@@ -96,15 +226,70 @@ private:
     RecordingStats stats_;
 
     // Threading
-    std::thread encodingThread_;
+    std::vector<std::thread> convertThreads_;
+    std::thread videoThread_;
+    std::thread audioThread_;
+    std::thread muxThread_;
     std::atomic<bool> shouldStop_{false};
+    FramePool framePool_;
     FrameGrabber frameGrabber_;
+    u32 convertWorkers_{1};
+
+    // Convert stage. The pop and the sequence number are taken together so
+    // sequence order is capture order.
+    std::mutex capturePopMutex_;
+    u64 nextSequence_{0};
+    std::atomic<u32> activeConverters_{0};
+    std::unique_ptr<ColorConverter> converter_; // Null: swscale only
+    WorkerPool slicePool_;
+    std::vector<Scaler> scalers_; // One per worker, not thread-safe
+    AVPixelFormat captureFormat_{AV_PIX_FMT_RGBA};
+
+    // Video encode stage. Every in-flight sequence holds a pooled frame, so
+    // a ring the size of the pool reorders without collisions. The frames'
+    // pictures come from pictures_ and outlive them in the encoder and the
+    // renditions for as long as those need.
+    PictureBufferPool pictures_;
+    std::unique_ptr<StageQueue<AVFramePtr>> convertedPool_;
+    std::unique_ptr<StageQueue<ConvertedFrame>> convertedQueue_;
+    std::vector<ConvertedFrame> reorder_;
+    AVFramePtr lastVideoFrame_; // Kept back for CFR repeats
+    RecordingClock clock_;
 
-    // Audio buffer
-    std::vector<f32> audioBuffer_;
-    std::mutex audioMutex_;
-    u32 audioSampleRate_{48000};
-    u32 audioChannels_{2};
+    // Audio: the callback writes interleaved samples into the ring, the
+    // audio encoder converts them straight out of it. Allocated once in
+    // initAudioStream() and kept for the next recording.
+    SpscRing<f32> audioRing_;
+    std::vector<f32> audioSeam_; // One sample split by the ring's wrap
+    std::atomic<u32> audioSeq_{0};       // Futex: bumped per submission
+    std::atomic<u32> audioSpaceSeq_{0};  // Futex: bumped per encoded frame
+    std::atomic<u32> audioProducers_{0}; // Inside submitAudioSamples()
+    std::atomic<u64> audioSamplesDropped_{0};
+    std::atomic<bool> audioFormatWarned_{false};
+    int audioFrameSamples_{0}; // Per channel, per encoded frame
+    std::atomic<u32> audioPeakFrames_{0};
+
+    // Mux stage
+    StageQueue<MuxPacket> muxQueue_{MUX_QUEUE_SIZE};
+    PacketInterleaver interleaver_;
+
+    // Largest first; each scales from the one before (see RenditionEncoder)
+    std::vector<std::unique_ptr<RenditionEncoder>> renditions_;
+
+    // The mux stage's output: files, or in replay mode memory and the one
+    // save at a time
+    OutputWriter output_;
+    ReplayBuffer replay_;
+    std::thread replayThread_;
+    std::atomic<bool> replaySaving_{false};
+
+    // Written by the stage threads, copied into stats_ by updateStats()
+    std::atomic<u64> framesWritten_{0};
+    std::atomic<u64> framesDuplicated_{0};
+    std::atomic<u64> syncRepeats_{0};
+    std::atomic<u64> syncDrops_{0};
+    std::atomic<i64> avDriftUs_{0};
+    std::atomic<i64> maxAvDriftUs_{0};
 
     // FFmpeg contexts
     AVFormatContextPtr formatCtx_;
@@ -112,18 +297,13 @@ private:
     AVCodecContextPtr audioCodecCtx_;
     AVStream* videoStream_{nullptr};
     AVStream* audioStream_{nullptr};
-    SwsContextPtr swsCtx_;
     SwrContextPtr swrCtx_;
 
-    AVFramePtr videoFrame_;
     AVFramePtr audioFrame_;
-    AVPacketPtr packet_;
 
     i64 videoFrameCount_{0};
     i64 audioFrameCount_{0};
     i64 startTime_{0};
-
-    std::mutex ffmpegMutex_;
 };
 
 } // namespace vc
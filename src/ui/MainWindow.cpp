@@ -234,6 +234,11 @@ void MainWindow::setupMenuBar() {
             QKeySequence(Qt::CTRL | Qt::Key_R));
     recordMenu->addAction(
             "S&top Recording", this, &MainWindow::onStopRecording);
+    recordMenu->addAction(
+            "Save &Replay",
+            this,
+            &MainWindow::onSaveReplay,
+            QKeySequence(QString::fromStdString(CONFIG.keyboard().saveReplay)));
 
     auto* toolsMenu = menuBar()->addMenu("&Tools");
     toolsMenu->addAction("&Settings...",
@@ -326,16 +331,20 @@ void MainWindow::startRecording(const fs::path& outputPath) {
 
     auto settings = EncoderSettings::fromConfig();
     settings.outputPath = path;
-    visualizerPanel_->visualizer()->setRecordingSize(settings.video.width,
-                                                     settings.video.height);
-    visualizerPanel_->visualizer()->startRecording();
+    auto* visualizer = visualizerPanel_->visualizer();
+    settings.video.gpuYCbCr =
+            settings.video.gpuYCbCr && visualizer->canCaptureYCbCr();
+    visualizer->setCaptureYCbCr(settings.video.gpuYCbCr);
+    visualizer->setRecordingSize(settings.video.width, settings.video.height);
+    visualizer->startRecording();
 
     if (auto result = videoRecorder_->start(settings); !result) {
         QMessageBox::critical(this,
                               "Recording Error",
                               QString::fromStdString(result.error().message));
-        visualizerPanel_->visualizer()->stopRecording();
+        visualizer->stopRecording();
     } else {
+        presetBrowser_->thumbnailer().setPaused(true);
         updateWindowTitle();
         statusBar()->showMessage("Recording started: " +
                                  QString::fromStdString(path.string()));
@@ -346,11 +355,21 @@ void MainWindow::stopRecording() {
     if (videoRecorder_->isRecording()) {
         videoRecorder_->stop();
         visualizerPanel_->visualizer()->stopRecording();
+        presetBrowser_->thumbnailer().setPaused(false);
         updateWindowTitle();
         statusBar()->showMessage("Recording stopped");
     }
 }
 
+void MainWindow::saveReplay() {
+    if (auto result = videoRecorder_->saveReplay(); !result) {
+        statusBar()->showMessage(
+                QString::fromStdString(result.error().message), 5000);
+    } else {
+        statusBar()->showMessage("Saving replay...");
+    }
+}
+
 void MainWindow::selectPreset(const std::string& name) {
     visualizerPanel_->visualizer()->projectM().presets().selectByName(name);
 }
@@ -360,6 +379,9 @@ void MainWindow::onStartRecording(const QString& path) {
 void MainWindow::onStopRecording() {
     stopRecording();
 }
+void MainWindow::onSaveReplay() {
+    saveReplay();
+}
 
 void MainWindow::onOpenFiles() {
     QFileDialog dialog(this, "Open Audio Files", QDir::homePath());
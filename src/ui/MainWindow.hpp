@@ -60,11 +60,13 @@ public:
 
     void startRecording(const fs::path& outputPath = {});
     void stopRecording();
+    void saveReplay();
     void selectPreset(const std::string& name);
 
 public slots:
     void onStartRecording(const QString& outputPath);
     void onStopRecording();
+    void onSaveReplay();
 
 protected:
     void closeEvent(QCloseEvent* event) override;
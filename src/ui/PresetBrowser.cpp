@@ -1,14 +1,20 @@
 #include "PresetBrowser.hpp"
+#include "core/Config.hpp"
 #include "core/Logger.hpp"
 #include "visualizer/RatingManager.hpp"
 
 #include <QHBoxLayout>
-#include <QHeaderView>
 #include <QLabel>
 #include <QVBoxLayout>
 
 namespace vc {
 
+namespace {
+
+constexpr int SEARCH_DEBOUNCE_MS = 150;
+
+} // namespace
+
 PresetBrowser::PresetBrowser(QWidget* parent) : QWidget(parent) {
     setupUI();
 }
@@ -22,6 +28,8 @@ void PresetBrowser::setPresetManager(PresetManager* manager) {
         manager->presetChanged.connect([this](const PresetInfo*) {
             QMetaObject::invokeMethod(this, &PresetBrowser::scrollToCurrent);
         });
+        model_->setPresetManager(manager);
+        thumbnailer_.start(CONFIG.visualizer().thumbnailWorkers);
         refresh();
     }
 }
@@ -60,14 +68,22 @@ void PresetBrowser::setupUI() {
     filterLayout->addWidget(randomButton_);
     layout->addLayout(filterLayout);
 
-    presetList_ = new QListWidget();
+    model_ = new PresetListModel(this);
+    model_->setThumbnailer(&thumbnailer_);
+    presetList_ = new QListView();
+    presetList_->setModel(model_);
     presetList_->setAlternatingRowColors(true);
+    presetList_->setIconSize(PresetListModel::ICON_SIZE);
+    // Every row the same height: the view can lay out fifty thousand rows
+    // without asking the model about any of them
+    presetList_->setUniformItemSizes(true);
+    presetList_->setEditTriggers(QAbstractItemView::NoEditTriggers);
     connect(presetList_,
-            &QListWidget::itemDoubleClicked,
+            &QListView::doubleClicked,
             this,
             &PresetBrowser::onPresetDoubleClicked);
-    connect(presetList_,
-            &QListWidget::currentRowChanged,
+    connect(presetList_->selectionModel(),
+            &QItemSelectionModel::currentRowChanged,
             this,
             &PresetBrowser::onCurrentRowChanged);
     layout->addWidget(presetList_, 1);
@@ -108,35 +124,31 @@ void PresetBrowser::setupUI() {
             &PresetBrowser::onBlacklistClicked);
     buttonLayout->addWidget(blacklistButton_);
     layout->addLayout(buttonLayout);
+
+    searchTimer_.setSingleShot(true);
+    searchTimer_.setInterval(SEARCH_DEBOUNCE_MS);
+    connect(&searchTimer_,
+            &QTimer::timeout,
+            this,
+            &PresetBrowser::refreshList);
+    previewTimer_.setInterval(400);
+    connect(&previewTimer_,
+            &QTimer::timeout,
+            this,
+            &PresetBrowser::advancePreview);
 }
 
 void PresetBrowser::onStarClicked() {
     auto* star = qobject_cast<QPushButton*>(sender());
-    if (!star || !presetManager_)
-        return;
-    auto* item = presetList_->currentItem();
-    if (!item)
+    const auto* preset = currentPreset();
+    if (!star || !preset)
         return;
 
     int stars = star->property("stars").toInt();
-    std::string path = item->data(Qt::UserRole).toString().toStdString();
-    std::string name = item->text()
-                               .remove("★ ")
-                               .remove(QRegularExpression("\\[.*\\] "))
-                               .toStdString();
-
-    RatingManager::instance().setRating(name, stars);
+    RatingManager::instance().setRating(preset->name, stars);
     RatingManager::instance().save();
     updateRatingDisplay(stars);
-
-    // Update text in list
-    QString ratingStr =
-            QString("[%1]").arg(QString(stars, '*').leftJustified(5, '.'));
-    item->setText(
-            (presetManager_->current() && presetManager_->current()->favorite
-                     ? "★ "
-                     : "") +
-            ratingStr + " " + QString::fromStdString(name));
+    model_->refreshRow(presetList_->currentIndex().row());
 }
 
 void PresetBrowser::updateRatingDisplay(int stars) {
@@ -147,26 +159,41 @@ void PresetBrowser::updateRatingDisplay(int stars) {
     }
 }
 
-void PresetBrowser::onCurrentRowChanged(int row) {
-    if (row < 0)
-        return;
-    auto* item = presetList_->item(row);
-    if (!item)
+const PresetInfo* PresetBrowser::currentPreset() const {
+    return model_->presetAt(presetList_->currentIndex().row());
+}
+
+void PresetBrowser::onCurrentRowChanged(const QModelIndex& current) {
+    previewTimer_.stop();
+    previewStrip_ = {};
+    model_->setPreviewFrame(-1, {});
+    const auto* preset = model_->presetAt(current.row());
+    if (!preset)
         return;
-    std::string name = item->text()
-                               .remove("★ ")
-                               .remove(QRegularExpression("\\[.*\\] "))
-                               .toStdString();
-    int rating = RatingManager::instance().getRating(name);
-    updateRatingDisplay(rating);
+
+    if (thumbnailer_.hasThumbnail(preset->contentHash)) {
+        previewStrip_ = PresetThumbnailer::loadStrip(preset->contentHash);
+        previewFrame_ = PresetThumbnailer::PREVIEW_FRAMES - 1;
+        if (!previewStrip_.isNull())
+            previewTimer_.start();
+    }
+
+    updateRatingDisplay(RatingManager::instance().getRating(preset->name));
 }
 
 void PresetBrowser::refresh() {
     if (!presetManager_) {
-        presetList_->clear();
+        model_->setPresets({});
         return;
     }
+    thumbnailer_.setPack(presetManager_->pack());
     updateCategories();
+    refreshList();
+}
+
+void PresetBrowser::refreshList() {
+    if (!presetManager_)
+        return;
     std::vector<const PresetInfo*> presets;
     if (currentCategory_ == "__favorites__")
         presets = presetManager_->favoritePresets();
@@ -176,103 +203,72 @@ void PresetBrowser::refresh() {
         presets = presetManager_->byCategory(currentCategory_);
     else
         presets = presetManager_->activePresets();
-    populateList(presets);
+    model_->setPresets(presets);
 }
 
 void PresetBrowser::scrollToCurrent() {
     if (!presetManager_)
         return;
-    const auto* current = presetManager_->current();
-    if (!current)
+    int row = model_->rowOf(presetManager_->current());
+    if (row < 0)
         return;
-    std::string currentPath = current->path.string();
-    for (int i = 0; i < presetList_->count(); ++i) {
-        auto* item = presetList_->item(i);
-        if (item->data(Qt::UserRole).toString().toStdString() == currentPath) {
-            presetList_->scrollToItem(item);
-            presetList_->setCurrentItem(item);
-            break;
-        }
-    }
+    QModelIndex index = model_->index(row);
+    presetList_->scrollTo(index);
+    presetList_->setCurrentIndex(index);
 }
 
 void PresetBrowser::onSearchTextChanged(const QString& text) {
     searchQuery_ = text.toStdString();
-    refresh();
+    searchTimer_.start();
 }
 
 void PresetBrowser::onCategoryChanged(int index) {
     if (index < 0)
         return;
     currentCategory_ = categoryCombo_->itemData(index).toString().toStdString();
-    refresh();
+    searchTimer_.stop();
+    refreshList();
 }
 
-void PresetBrowser::onPresetDoubleClicked(QListWidgetItem* item) {
-    if (!presetManager_)
+void PresetBrowser::onPresetDoubleClicked(const QModelIndex& index) {
+    const auto* preset = model_->presetAt(index.row());
+    if (!presetManager_ || !preset)
         return;
-    QString path = item->data(Qt::UserRole).toString();
-    presetManager_->selectByPath(fs::path(path.toStdString()));
-    emit presetSelected(path);
+    fs::path path = preset->path;
+    presetManager_->selectByPath(path);
+    emit presetSelected(QString::fromStdString(path.string()));
 }
 
 void PresetBrowser::onFavoriteClicked() {
-    if (!presetManager_)
-        return;
-    auto* item = presetList_->currentItem();
-    if (!item)
+    const auto* preset = currentPreset();
+    if (!presetManager_ || !preset)
         return;
-    QString path = item->data(Qt::UserRole).toString();
-    for (usize i = 0; i < presetManager_->allPresets().size(); ++i) {
-        if (presetManager_->allPresets()[i].path.string() ==
-            path.toStdString()) {
-            presetManager_->toggleFavorite(i);
-            break;
-        }
-    }
-    refresh();
+    if (auto index = presetManager_->indexOfPath(preset->path))
+        presetManager_->toggleFavorite(*index);
+    refreshList();
 }
 
 void PresetBrowser::onBlacklistClicked() {
-    if (!presetManager_)
+    const auto* preset = currentPreset();
+    if (!presetManager_ || !preset)
         return;
-    auto* item = presetList_->currentItem();
-    if (!item)
-        return;
-    QString path = item->data(Qt::UserRole).toString();
-    for (usize i = 0; i < presetManager_->allPresets().size(); ++i) {
-        if (presetManager_->allPresets()[i].path.string() ==
-            path.toStdString()) {
-            presetManager_->toggleBlacklisted(i);
-            break;
-        }
-    }
-    refresh();
+    if (auto index = presetManager_->indexOfPath(preset->path))
+        presetManager_->toggleBlacklisted(*index);
+    refreshList();
 }
 
-void PresetBrowser::populateList(
-        const std::vector<const PresetInfo*>& presets) {
-    presetList_->clear();
-    for (const auto* preset : presets) {
-        int rating = RatingManager::instance().getRating(preset->name);
-        QString ratingStr =
-                QString("[%1]").arg(QString(rating, '*').leftJustified(5, '.'));
-        QString name = (preset->favorite ? "★ " : "") + ratingStr + " " +
-                       QString::fromStdString(preset->name);
-        auto* item = new QListWidgetItem(name, presetList_);
-        item->setData(Qt::UserRole,
-                      QString::fromStdString(preset->path.string()));
-        if (preset->favorite)
-            item->setForeground(QColor(255, 215, 0));
-
-        QString tooltip =
-                QString::fromStdString(preset->path.filename().string());
-        if (!preset->author.empty())
-            tooltip += "\nAuthor: " + QString::fromStdString(preset->author);
-        tooltip += "\nCategory: " + QString::fromStdString(preset->category);
-        tooltip += QString("\nPlays: %1").arg(preset->playCount);
-        item->setToolTip(tooltip);
+void PresetBrowser::advancePreview() {
+    int row = presetList_->currentIndex().row();
+    if (row < 0 || previewStrip_.isNull()) {
+        previewTimer_.stop();
+        return;
     }
+    previewFrame_ = (previewFrame_ + 1) % PresetThumbnailer::PREVIEW_FRAMES;
+    model_->setPreviewFrame(
+            row,
+            QPixmap::fromImage(
+                    PresetThumbnailer::frameOf(previewStrip_, previewFrame_)
+                            .scaled(PresetListModel::ICON_SIZE)));
 }
 
 void PresetBrowser::updateCategories() {
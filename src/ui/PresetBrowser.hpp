@@ -1,12 +1,15 @@
 #pragma once
 #include <QComboBox>
 #include <QLineEdit>
-#include <QListWidget>
+#include <QListView>
 #include <QPushButton>
+#include <QTimer>
 #include <QWidget>
 #include <vector>
+#include "PresetListModel.hpp"
 #include "util/Types.hpp"
 #include "visualizer/PresetManager.hpp"
+#include "visualizer/PresetThumbnailer.hpp"
 
 namespace vc {
 
@@ -16,6 +19,10 @@ public:
     explicit PresetBrowser(QWidget* parent = nullptr);
     void setPresetManager(PresetManager* manager);
 
+    PresetThumbnailer& thumbnailer() {
+        return thumbnailer_;
+    }
+
 signals:
     void presetSelected(const QString& path);
 
@@ -26,22 +33,25 @@ public slots:
 private slots:
     void onSearchTextChanged(const QString& text);
     void onCategoryChanged(int index);
-    void onPresetDoubleClicked(QListWidgetItem* item);
+    void onPresetDoubleClicked(const QModelIndex& index);
     void onFavoriteClicked();
     void onBlacklistClicked();
     void onStarClicked();
-    void onCurrentRowChanged(int row);
+    void onCurrentRowChanged(const QModelIndex& current);
 
 private:
     void setupUI();
-    void populateList(const std::vector<const PresetInfo*>& presets);
+    void refreshList(); // Keeps the category combo as it is
     void updateCategories();
     void updateRatingDisplay(int stars);
+    const PresetInfo* currentPreset() const;
+    void advancePreview();
 
     PresetManager* presetManager_{nullptr};
     QLineEdit* searchEdit_{nullptr};
     QComboBox* categoryCombo_{nullptr};
-    QListWidget* presetList_{nullptr};
+    QListView* presetList_{nullptr};
+    PresetListModel* model_{nullptr};
     QPushButton* randomButton_{nullptr};
     QPushButton* favoriteButton_{nullptr};
     QPushButton* blacklistButton_{nullptr};
@@ -49,6 +59,12 @@ private:
     std::vector<QPushButton*> ratingButtons_;
     std::string searchQuery_;
     std::string currentCategory_;
+    QTimer searchTimer_; // Debounces typing; one filter per pause
+
+    PresetThumbnailer thumbnailer_;
+    QTimer previewTimer_; // Plays the selected row's strip
+    QImage previewStrip_;
+    u32 previewFrame_{0};
 };
 
 } // namespace vc
@@ -0,0 +1,179 @@
+#include "PresetListModel.hpp"
+#include "visualizer/PresetThumbnailer.hpp"
+#include "visualizer/RatingManager.hpp"
+
+#include <QColor>
+#include <QIcon>
+#include <algorithm>
+
+namespace vc {
+
+const QSize PresetListModel::ICON_SIZE(64, 36);
+
+PresetListModel::PresetListModel(QObject* parent)
+    : QAbstractListModel(parent), placeholder_(ICON_SIZE) {
+    placeholder_.fill(QColor(0, 0, 0));
+}
+
+void PresetListModel::setPresetManager(const PresetManager* manager) {
+    beginResetModel();
+    manager_ = manager;
+    rows_.clear();
+    waiting_.clear();
+    previewRow_ = -1;
+    endResetModel();
+}
+
+void PresetListModel::setThumbnailer(PresetThumbnailer* thumbnailer) {
+    if (thumbnailer_)
+        disconnect(thumbnailer_, nullptr, this, nullptr);
+    thumbnailer_ = thumbnailer;
+    if (thumbnailer_) {
+        connect(thumbnailer_,
+                &PresetThumbnailer::thumbnailReady,
+                this,
+                &PresetListModel::onThumbnailReady);
+    }
+}
+
+void PresetListModel::setPresets(
+        const std::vector<const PresetInfo*>& presets) {
+    beginResetModel();
+    rows_.clear();
+    waiting_.clear();
+    previewRow_ = -1;
+    previewFrame_ = {};
+    if (manager_) {
+        const auto* base = manager_->allPresets().data();
+        rows_.reserve(presets.size());
+        for (const auto* preset : presets)
+            rows_.push_back(static_cast<u32>(preset - base));
+    }
+    endResetModel();
+}
+
+const PresetInfo* PresetListModel::presetAt(int row) const {
+    if (!manager_ || row < 0 || row >= static_cast<int>(rows_.size()))
+        return nullptr;
+    const auto& all = manager_->allPresets();
+    u32 index = rows_[row];
+    return index < all.size() ? &all[index] : nullptr;
+}
+
+int PresetListModel::rowOf(const PresetInfo* preset) const {
+    if (!manager_ || !preset)
+        return -1;
+    u32 index = static_cast<u32>(preset - manager_->allPresets().data());
+    for (usize row = 0; row < rows_.size(); ++row) {
+        if (rows_[row] == index)
+            return static_cast<int>(row);
+    }
+    return -1;
+}
+
+void PresetListModel::refreshRow(int row) {
+    if (row < 0 || row >= rowCount())
+        return;
+    emit dataChanged(index(row), index(row));
+}
+
+void PresetListModel::setPreviewFrame(int row, const QPixmap& frame) {
+    int previous = previewRow_;
+    previewRow_ = frame.isNull() ? -1 : row;
+    previewFrame_ = frame;
+    if (previous >= 0 && previous != previewRow_ && previous < rowCount())
+        emit dataChanged(
+                index(previous), index(previous), {Qt::DecorationRole});
+    if (previewRow_ >= 0 && previewRow_ < rowCount())
+        emit dataChanged(
+                index(previewRow_), index(previewRow_), {Qt::DecorationRole});
+}
+
+int PresetListModel::rowCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : static_cast<int>(rows_.size());
+}
+
+QVariant PresetListModel::data(const QModelIndex& index, int role) const {
+    const auto* preset = presetAt(index.row());
+    if (!preset)
+        return {};
+
+    switch (role) {
+    case Qt::DisplayRole: {
+        int rating = RatingManager::instance().getRating(preset->name);
+        QString stars = QString("[%1]").arg(
+                QString(rating, '*').leftJustified(5, '.'));
+        return (preset->favorite ? "★ " : "") + stars + " " +
+               QString::fromStdString(preset->name);
+    }
+    case Qt::ForegroundRole:
+        if (preset->favorite)
+            return QColor(255, 215, 0);
+        return {};
+    case Qt::ToolTipRole: {
+        QString tooltip =
+                QString::fromStdString(preset->path.filename().string());
+        if (!preset->author.empty())
+            tooltip += "\nAuthor: " + QString::fromStdString(preset->author);
+        tooltip += "\nCategory: " + QString::fromStdString(preset->category);
+        tooltip += QString("\nPlays: %1").arg(preset->playCount);
+        for (const auto& alias : preset->aliases) {
+            tooltip += "\nAlso: " +
+                       QString::fromStdString(alias.filename().string());
+        }
+        return tooltip;
+    }
+    case Qt::DecorationRole:
+        if (index.row() == previewRow_)
+            return previewFrame_;
+        return thumbnail(*preset, index.row());
+    case PathRole:
+        return QString::fromStdString(preset->path.string());
+    case NameRole:
+        return QString::fromStdString(preset->name);
+    case HashRole:
+        return QVariant::fromValue<quint64>(preset->contentHash);
+    default:
+        return {};
+    }
+}
+
+QVariant PresetListModel::thumbnail(const PresetInfo& preset,
+                                    int row) const {
+    if (!thumbnailer_ || !thumbnailer_->isRunning())
+        return {};
+    if (auto* cached = icons_.object(preset.contentHash))
+        return *cached;
+
+    // Only ever reached for painted rows, which is what keeps this lazy
+    if (!thumbnailer_->hasThumbnail(preset.contentHash)) {
+        thumbnailer_->request(preset.path, preset.contentHash);
+        auto& rows = waiting_[preset.contentHash];
+        if (std::find(rows.begin(), rows.end(), row) == rows.end())
+            rows.push_back(row);
+        return placeholder_;
+    }
+    QImage strip = PresetThumbnailer::loadStrip(preset.contentHash);
+    if (strip.isNull())
+        return placeholder_;
+    auto last = PresetThumbnailer::PREVIEW_FRAMES - 1;
+    QPixmap icon = QPixmap::fromImage(
+            PresetThumbnailer::frameOf(strip, last).scaled(ICON_SIZE));
+    icons_.insert(preset.contentHash, new QPixmap(icon));
+    return icon;
+}
+
+void PresetListModel::onThumbnailReady(quint64 hash) {
+    // Only rows that painted a placeholder for it can be waiting
+    auto it = waiting_.find(hash);
+    if (it == waiting_.end())
+        return;
+    std::vector<int> rows = std::move(it->second);
+    waiting_.erase(it);
+    for (int row : rows) {
+        if (row < rowCount())
+            emit dataChanged(index(row), index(row), {Qt::DecorationRole});
+    }
+}
+
+} // namespace vc
@@ -0,0 +1,73 @@
+#pragma once
+// PresetListModel.hpp - PresetManager's presets as a Qt item model
+// Fifty thousand list items, and the view only ever asks about twenty
+
+#include "util/Types.hpp"
+#include "visualizer/PresetManager.hpp"
+
+#include <QAbstractListModel>
+#include <QCache>
+#include <QPixmap>
+#include <unordered_map>
+#include <vector>
+
+namespace vc {
+
+class PresetThumbnailer;
+
+// Rows are indices into PresetManager::allPresets(), so a filter is one
+// vector swap and nothing is copied or allocated per preset. Text, tooltip
+// and thumbnail are produced in data(), i.e. only for rows the view paints.
+// Indices are bounds-checked, so a row that outlives a rescan by a few
+// events shows the wrong preset instead of crashing.
+class PresetListModel : public QAbstractListModel {
+    Q_OBJECT
+
+public:
+    enum Role {
+        PathRole = Qt::UserRole,
+        NameRole,
+        HashRole,
+    };
+
+    static constexpr int ICON_CACHE = 512; // Decoded thumbnails kept
+    static const QSize ICON_SIZE;
+
+    explicit PresetListModel(QObject* parent = nullptr);
+
+    void setPresetManager(const PresetManager* manager);
+    void setThumbnailer(PresetThumbnailer* thumbnailer);
+
+    // Replaces every row; pointers must come from manager->allPresets()
+    void setPresets(const std::vector<const PresetInfo*>& presets);
+
+    const PresetInfo* presetAt(int row) const;
+    int rowOf(const PresetInfo* preset) const; // -1 if filtered out
+
+    // Rating or favorite changed outside the model
+    void refreshRow(int row);
+    // Shown instead of the thumbnail on one row (null to stop)
+    void setPreviewFrame(int row, const QPixmap& frame);
+
+    int rowCount(const QModelIndex& parent = {}) const override;
+    QVariant data(const QModelIndex& index, int role) const override;
+
+private slots:
+    void onThumbnailReady(quint64 hash);
+
+private:
+    QVariant thumbnail(const PresetInfo& preset, int row) const;
+
+    const PresetManager* manager_{nullptr};
+    PresetThumbnailer* thumbnailer_{nullptr};
+    std::vector<u32> rows_;
+
+    mutable QCache<quint64, QPixmap> icons_{ICON_CACHE};
+    QPixmap placeholder_; // Keeps names lined up until a thumbnail exists
+    // Rows showing the placeholder, by the hash they're waiting for
+    mutable std::unordered_map<quint64, std::vector<int>> waiting_;
+    int previewRow_{-1};
+    QPixmap previewFrame_;
+};
+
+} // namespace vc
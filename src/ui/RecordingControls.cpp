@@ -11,6 +11,7 @@
 #include <QHBoxLayout>
 #include <QLabel>
 #include <QVBoxLayout>
+#include <algorithm>
 
 namespace vc {
 
@@ -18,6 +19,8 @@ RecordingControls::RecordingControls(QWidget* parent) : QWidget(parent) {
     setupUI();
 }
 
+RecordingControls::~RecordingControls() = default;
+
 void RecordingControls::setVideoRecorder(VideoRecorder* recorder) {
     recorder_ = recorder;
 
@@ -75,6 +78,26 @@ void RecordingControls::setupUI() {
     outputLayout->addWidget(browseButton_);
     recordLayout->addLayout(outputLayout);
 
+    // Instant replay: record into memory, keep only what gets saved
+    auto* replayLayout = new QHBoxLayout();
+    replayCheck_ = new QCheckBox("Replay buffer");
+    replayCheck_->setChecked(CONFIG.recording().replay.enabled);
+    replayCheck_->setToolTip(
+            QString("Keep the last %1 s in memory instead of writing a file")
+                    .arg(CONFIG.recording().replay.seconds));
+    connect(replayCheck_, &QCheckBox::toggled, this, [](bool enabled) {
+        CONFIG.recording().replay.enabled = enabled;
+    });
+    replayLayout->addWidget(replayCheck_);
+    replayButton_ = new QPushButton("Save Replay");
+    replayButton_->setEnabled(false);
+    connect(replayButton_,
+            &QPushButton::clicked,
+            this,
+            &RecordingControls::saveReplayRequested);
+    replayLayout->addWidget(replayButton_, 1);
+    recordLayout->addLayout(replayLayout);
+
     // Record button
     recordButton_ = new QPushButton("⏺ Start Recording");
     recordButton_->setObjectName("recordButton");
@@ -128,9 +151,87 @@ void RecordingControls::setupUI() {
     statsLayout->addWidget(bufferBar_);
 
     layout->addWidget(statsGroup);
+
+    setupBatchUI(layout);
     layout->addStretch();
 }
 
+void RecordingControls::setupBatchUI(QVBoxLayout* layout) {
+    auto* batchGroup = new QGroupBox("Batch Render");
+    auto* batchLayout = new QVBoxLayout(batchGroup);
+
+    // Folder or playlist in, folder out; the quality preset comes from above
+    auto* sourceLayout = new QHBoxLayout();
+    sourceLayout->addWidget(new QLabel("Tracks:"));
+    batchSourceEdit_ = new QLineEdit();
+    batchSourceEdit_->setPlaceholderText("Folder or playlist");
+    sourceLayout->addWidget(batchSourceEdit_, 1);
+    auto* folderButton = new QPushButton("📁");
+    folderButton->setFixedWidth(30);
+    folderButton->setToolTip("Pick a folder");
+    connect(folderButton, &QPushButton::clicked, this, [this] {
+        QString dir = QFileDialog::getExistingDirectory(this, "Tracks");
+        if (!dir.isEmpty())
+            batchSourceEdit_->setText(dir);
+    });
+    sourceLayout->addWidget(folderButton);
+    auto* playlistButton = new QPushButton("...");
+    playlistButton->setFixedWidth(30);
+    playlistButton->setToolTip("Pick a playlist");
+    connect(playlistButton, &QPushButton::clicked, this, [this] {
+        QString path = QFileDialog::getOpenFileName(
+                this, "Playlist", QString(), "Playlists (*.m3u *.m3u8)");
+        if (!path.isEmpty())
+            batchSourceEdit_->setText(path);
+    });
+    sourceLayout->addWidget(playlistButton);
+    batchLayout->addLayout(sourceLayout);
+
+    auto* outputLayout = new QHBoxLayout();
+    outputLayout->addWidget(new QLabel("Into:"));
+    batchOutputEdit_ = new QLineEdit(QString::fromStdString(
+            CONFIG.recording().outputDirectory.string()));
+    outputLayout->addWidget(batchOutputEdit_, 1);
+    auto* outputButton = new QPushButton("...");
+    outputButton->setFixedWidth(30);
+    connect(outputButton, &QPushButton::clicked, this, [this] {
+        QString dir = QFileDialog::getExistingDirectory(
+                this, "Render Into", batchOutputEdit_->text());
+        if (!dir.isEmpty())
+            batchOutputEdit_->setText(dir);
+    });
+    outputLayout->addWidget(outputButton);
+    batchLayout->addLayout(outputLayout);
+
+    auto* runLayout = new QHBoxLayout();
+    runLayout->addWidget(new QLabel("Workers:"));
+    batchWorkersSpin_ = new QSpinBox();
+    batchWorkersSpin_->setRange(0, 64);
+    batchWorkersSpin_->setSpecialValueText("Auto");
+    batchWorkersSpin_->setValue(0);
+    runLayout->addWidget(batchWorkersSpin_);
+    batchButton_ = new QPushButton("Render All");
+    connect(batchButton_,
+            &QPushButton::clicked,
+            this,
+            &RecordingControls::onBatchButtonClicked);
+    runLayout->addWidget(batchButton_, 1);
+    batchLayout->addLayout(runLayout);
+
+    batchList_ = new QListWidget();
+    batchList_->setMinimumHeight(80);
+    batchLayout->addWidget(batchList_, 1);
+
+    batchBar_ = new QProgressBar();
+    batchBar_->setRange(0, 1000);
+    batchBar_->setValue(0);
+    batchBar_->setTextVisible(false);
+    batchBar_->setMaximumHeight(8);
+    batchLayout->addWidget(batchBar_);
+
+    layout->addWidget(batchGroup);
+}
+
 void RecordingControls::updateState(RecordingState state) {
     currentState_ = state;
 
@@ -144,6 +245,8 @@ void RecordingControls::updateState(RecordingState state) {
         presetCombo_->setEnabled(true);
         outputEdit_->setEnabled(true);
         browseButton_->setEnabled(true);
+        replayCheck_->setEnabled(true);
+        replayButton_->setEnabled(false);
         break;
 
     case RecordingState::Starting:
@@ -161,6 +264,8 @@ void RecordingControls::updateState(RecordingState state) {
         presetCombo_->setEnabled(false);
         outputEdit_->setEnabled(false);
         browseButton_->setEnabled(false);
+        replayCheck_->setEnabled(false);
+        replayButton_->setEnabled(recorder_ && recorder_->replayMode());
 
         // Reset labels immediately
         timeLabel_->setText("00:00:00");
@@ -184,6 +289,8 @@ void RecordingControls::updateState(RecordingState state) {
         presetCombo_->setEnabled(true);
         outputEdit_->setEnabled(true);
         browseButton_->setEnabled(true);
+        replayCheck_->setEnabled(true);
+        replayButton_->setEnabled(false);
         break;
     }
 }
@@ -202,11 +309,53 @@ void RecordingControls::updateStats(const RecordingStats& stats) {
                                   .arg(stats.framesWritten)
                                   .arg(stats.framesDropped));
 
-    sizeLabel_->setText(
-            QString::fromStdString(file::humanSize(stats.bytesWritten)));
+    if (recorder_ && recorder_->replayMode()) {
+        // Nothing is written until a save; show what one would hold
+        sizeLabel_->setText(
+                QString("%1 (%2 s)")
+                        .arg(QString::fromStdString(
+                                file::humanSize(stats.replayBytes)))
+                        .arg(stats.replaySeconds, 0, 'f', 0));
+    } else {
+        QString size =
+                QString::fromStdString(file::humanSize(stats.bytesWritten));
+        if (stats.files > 1)
+            size += QString(" (%1 files)").arg(stats.files);
+        sizeLabel_->setText(size);
+    }
 
-    int bufferLevel = std::min(100, static_cast<int>(stats.avgFps * 1.5));
-    bufferBar_->setValue(bufferLevel);
+    // The fullest pipeline queue is the stage that's falling behind
+    auto fill = [](const StageDepth& depth) {
+        return depth.capacity ? static_cast<int>(depth.current * 100 /
+                                                 depth.capacity)
+                              : 0;
+    };
+    bufferBar_->setValue(std::max({fill(stats.captureQueue),
+                                   fill(stats.convertedQueue),
+                                   fill(stats.audioQueue),
+                                   fill(stats.muxQueue)}));
+    bufferBar_->setToolTip(
+            QString("Capture %1/%2 (peak %3)\n"
+                    "Converted %4/%5 (peak %6), %7 convert threads\n"
+                    "Audio %8/%9 frames, %10 samples dropped\n"
+                    "Mux %11/%12")
+                    .arg(stats.captureQueue.current)
+                    .arg(stats.captureQueue.capacity)
+                    .arg(stats.captureQueue.peak)
+                    .arg(stats.convertedQueue.current)
+                    .arg(stats.convertedQueue.capacity)
+                    .arg(stats.convertedQueue.peak)
+                    .arg(stats.convertThreads)
+                    .arg(stats.audioQueue.current)
+                    .arg(stats.audioQueue.capacity)
+                    .arg(stats.audioSamplesDropped)
+                    .arg(stats.muxQueue.current)
+                    .arg(stats.muxQueue.capacity) +
+            QString("\nA/V drift %1 ms (max %2), %3 repeated, %4 dropped")
+                    .arg(stats.avDriftMs, 0, 'f', 1)
+                    .arg(stats.maxAvDriftMs, 0, 'f', 1)
+                    .arg(stats.syncRepeats)
+                    .arg(stats.syncDrops));
 }
 
 void RecordingControls::onRecordButtonClicked() {
@@ -235,6 +384,95 @@ void RecordingControls::onPresetChanged(int index) {
     Q_UNUSED(index);
 }
 
+void RecordingControls::onBatchButtonClicked() {
+    if (renderQueue_ && renderQueue_->running()) {
+        batchButton_->setEnabled(false);
+        renderQueue_->cancel();
+        return;
+    }
+
+    RenderQueue::Options options;
+    options.source = batchSourceEdit_->text().toStdString();
+    options.outputDir = batchOutputEdit_->text().toStdString();
+    options.encoderPreset = presetCombo_->currentText().toStdString();
+    options.workers = static_cast<u32>(batchWorkersSpin_->value());
+    if (!CONFIG.configPath().empty()) {
+        options.workerArgs = {"--config", CONFIG.configPath().string()};
+    }
+
+    renderQueue_ = std::make_unique<RenderQueue>(std::move(options));
+    batchList_->clear();
+    batchBar_->setValue(0);
+    batchSourceEdit_->setEnabled(false);
+    batchOutputEdit_->setEnabled(false);
+    batchWorkersSpin_->setEnabled(false);
+    batchButton_->setEnabled(false);
+    batchButton_->setText("Loading...");
+
+    // Listing the tracks can mean a preset scan; the result comes back
+    // from the loading thread
+    renderQueue_->loaded.connect([this](const Result<void>& result) {
+        std::string message = result ? "" : result.error().message;
+        QMetaObject::invokeMethod(
+                this,
+                [this, message] { onBatchLoaded(message); },
+                Qt::QueuedConnection);
+    });
+    renderQueue_->loadAsync();
+}
+
+void RecordingControls::onBatchLoaded(const std::string& error) {
+    if (!error.empty()) {
+        batchList_->addItem(QString::fromStdString("Error: " + error));
+        renderQueue_.reset();
+        onBatchFinished();
+        return;
+    }
+    batchButton_->setEnabled(true);
+    for (usize i = 0; i < renderQueue_->jobs().size(); ++i) {
+        batchList_->addItem(QString());
+        updateBatchJob(i);
+    }
+
+    // Both fire on the GUI thread: the queue polls from a QTimer
+    renderQueue_->jobChanged.connect([this](usize i) { updateBatchJob(i); });
+    renderQueue_->finished.connect([this] { onBatchFinished(); });
+    batchButton_->setText("Cancel");
+    renderQueue_->start();
+}
+
+void RecordingControls::updateBatchJob(usize index) {
+    const auto& jobs = renderQueue_->jobs();
+    const auto& job = jobs[index];
+    QString text = QString::fromStdString(job.input.filename().string()) +
+                   " — " + RenderQueue::stateName(job.state);
+    if (job.state == JobState::Running)
+        text += QString(" %1%").arg(static_cast<int>(job.progress * 100));
+    if (!job.error.empty())
+        text += ": " + QString::fromStdString(job.error);
+    batchList_->item(static_cast<int>(index))->setText(text);
+
+    // Finished and skipped tracks count whole, running ones by how far
+    f64 done = 0.0;
+    for (const auto& j : jobs) {
+        if (j.state == JobState::Done || j.state == JobState::UpToDate ||
+            j.state == JobState::Failed)
+            done += 1.0;
+        else if (j.state == JobState::Running)
+            done += j.progress;
+    }
+    if (!jobs.empty())
+        batchBar_->setValue(static_cast<int>(done * 1000 / jobs.size()));
+}
+
+void RecordingControls::onBatchFinished() {
+    batchSourceEdit_->setEnabled(true);
+    batchOutputEdit_->setEnabled(true);
+    batchWorkersSpin_->setEnabled(true);
+    batchButton_->setText("Render All");
+    batchButton_->setEnabled(true);
+}
+
 QString RecordingControls::generateOutputPath() {
     const auto& recCfg = CONFIG.recording();
 
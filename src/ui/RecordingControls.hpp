@@ -3,14 +3,20 @@
 // Making those sweet YouTube videos
 
 #include "util/Types.hpp"
+#include "recorder/RenderQueue.hpp"
 #include "recorder/VideoRecorder.hpp"
 
 #include <QWidget>
+#include <QCheckBox>
 #include <QPushButton>
 #include <QLabel>
 #include <QComboBox>
 #include <QLineEdit>
+#include <QListWidget>
 #include <QProgressBar>
+#include <QSpinBox>
+#include <QVBoxLayout>
+#include <memory>
 
 namespace vc {
 
@@ -19,12 +25,14 @@ class RecordingControls : public QWidget {
     
 public:
     explicit RecordingControls(QWidget* parent = nullptr);
+    ~RecordingControls() override;
     
     void setVideoRecorder(VideoRecorder* recorder);
     
 signals:
     void startRecordingRequested(const QString& outputPath);
     void stopRecordingRequested();
+    void saveReplayRequested();
     
 public slots:
     void updateState(RecordingState state);
@@ -34,11 +42,16 @@ private slots:
     void onRecordButtonClicked();
     void onBrowseOutputClicked();
     void onPresetChanged(int index);
+    void onBatchButtonClicked();
     
 private:
     void setupUI();
+    void setupBatchUI(QVBoxLayout* layout);
     void updateUI();
     QString generateOutputPath();
+    void updateBatchJob(usize index);
+    void onBatchLoaded(const std::string& error); // Empty: loaded
+    void onBatchFinished();
     
     VideoRecorder* recorder_{nullptr};
     
@@ -51,9 +64,20 @@ private:
     QComboBox* presetCombo_{nullptr};
     QLineEdit* outputEdit_{nullptr};
     QPushButton* browseButton_{nullptr};
+    QCheckBox* replayCheck_{nullptr};
+    QPushButton* replayButton_{nullptr};
     
     QProgressBar* bufferBar_{nullptr};
     
+    // Batch render: offline exports of a folder or playlist
+    QLineEdit* batchSourceEdit_{nullptr};
+    QLineEdit* batchOutputEdit_{nullptr};
+    QSpinBox* batchWorkersSpin_{nullptr};
+    QPushButton* batchButton_{nullptr};
+    QListWidget* batchList_{nullptr};
+    QProgressBar* batchBar_{nullptr};
+    std::unique_ptr<RenderQueue> renderQueue_;
+    
     RecordingState currentState_{RecordingState::Stopped};
 };
 
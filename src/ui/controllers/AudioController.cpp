@@ -88,6 +88,10 @@ void AudioController::connectSignals() {
                     pcm.data(), frames, channels, sampleRate);
         }
     });
+    engine_->spectrumUpdated.connect([this](const AudioSpectrum& spectrum) {
+        window_->visualizerPanel()->visualizer()->setAudioFeatures(
+                spectrum.features);
+    });
 }
 
 } // namespace vc
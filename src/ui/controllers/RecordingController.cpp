@@ -8,6 +8,7 @@
 #include "ui/VisualizerPanel.hpp"
 #include "visualizer/VisualizerWindow.hpp"
 
+#include <QStatusBar>
 #include <QTimer>
 
 namespace vc {
@@ -31,13 +32,26 @@ void RecordingController::connectSignals() {
         window_->onStopRecording();
     });
 
-    // Connect visualizer frames to recorder
+    connect(controls_, &RecordingControls::saveReplayRequested, [this] {
+        window_->onSaveReplay();
+    });
+    // Fires on the thread that wrote the file
+    recorder_->replaySaved.connect([this](fs::path path) {
+        QMetaObject::invokeMethod(window_, [this, path] {
+            window_->statusBar()->showMessage(
+                    "Replay saved: " + QString::fromStdString(path.string()));
+        });
+    });
+
+    // Connect visualizer frames to recorder; capture fills the recorder's
+    // pooled buffers so nothing is allocated per frame
     auto* visualizer = window_->visualizerPanel()->visualizer();
+    visualizer->setFramePool(&recorder_->framePool());
     connect(
             visualizer,
             &VisualizerWindow::frameCaptured,
             this,
-            [this](std::vector<u8> data, u32 w, u32 h, i64 ts) {
+            [this](FrameHandle data, u32 w, u32 h, i64 ts) {
                 if (recorder_->isRecording()) {
                     recorder_->submitVideoFrame(std::move(data), w, h, ts);
                 }
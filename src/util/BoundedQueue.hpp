@@ -0,0 +1,108 @@
+#pragma once
+// BoundedQueue.hpp - Lock-free bounded MPMC ring buffer
+// Dmitry Vyukov's design: one CAS per operation, no mutex, no allocation
+
+#include "util/Types.hpp"
+
+#include <atomic>
+#include <bit>
+#include <memory>
+#include <new>
+#include <utility>
+
+namespace vc {
+
+// Fixed-capacity queue safe for any number of producers and consumers.
+// Capacity is rounded up to a power of two. T must be default-constructible
+// and move-assignable; slots are reused, never destroyed until the queue is.
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(usize capacity)
+        : mask_(std::bit_ceil(capacity < 2 ? usize(2) : capacity) - 1),
+          cells_(std::make_unique<Cell[]>(mask_ + 1)) {
+        for (usize i = 0; i <= mask_; ++i)
+            cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    // Moves from `value` only on success, so a failed push can be retried
+    bool tryPush(T&& value) {
+        usize pos = enqueuePos_.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            usize seq = cell->seq.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq) -
+                        static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0) {
+                if (enqueuePos_.compare_exchange_weak(
+                            pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                return false; // Full
+            } else {
+                pos = enqueuePos_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::move(value);
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T& out) {
+        usize pos = dequeuePos_.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            usize seq = cell->seq.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq) -
+                        static_cast<std::ptrdiff_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeuePos_.compare_exchange_weak(
+                            pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                return false; // Empty
+            } else {
+                pos = dequeuePos_.load(std::memory_order_relaxed);
+            }
+        }
+        out = std::move(cell->value);
+        cell->value = T{}; // Release whatever the slot was holding on to
+        cell->seq.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+    usize capacity() const {
+        return mask_ + 1;
+    }
+
+    // Approximate under concurrency; exact when producers and consumers
+    // are quiescent
+    usize sizeApprox() const {
+        usize head = dequeuePos_.load(std::memory_order_acquire);
+        usize tail = enqueuePos_.load(std::memory_order_acquire);
+        return tail > head ? tail - head : 0;
+    }
+    bool emptyApprox() const {
+        return sizeApprox() == 0;
+    }
+
+private:
+    struct Cell {
+        std::atomic<usize> seq{0};
+        T value{};
+    };
+
+    static constexpr usize CACHE_LINE = 64;
+
+    const usize mask_;
+    std::unique_ptr<Cell[]> cells_;
+    alignas(CACHE_LINE) std::atomic<usize> enqueuePos_{0};
+    alignas(CACHE_LINE) std::atomic<usize> dequeuePos_{0};
+};
+
+} // namespace vc
@@ -0,0 +1,96 @@
+#pragma once
+// SpscRing.hpp - Lock-free single-producer single-consumer sample ring
+// One writer, one reader, no locks, no allocation after reset()
+
+#include "util/Types.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+namespace vc {
+
+// Bulk copies in and out, for streams of plain values such as interleaved
+// PCM. The reader can look at what's queued in place (at most two spans,
+// split where the ring wraps) and consume it afterwards, so nothing needs
+// copying out first. Positions only ever grow; wrap-around of the counters
+// themselves is harmless.
+template <typename T>
+    requires std::is_trivially_copyable_v<T>
+class SpscRing {
+public:
+    using Spans = std::pair<std::span<const T>, std::span<const T>>;
+
+    SpscRing() = default;
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // Capacity rounds up to a power of two. Both sides must be idle.
+    void reset(usize capacity) {
+        capacity = std::bit_ceil(std::max<usize>(capacity, 2));
+        if (capacity != mask_ + 1 || !buffer_) {
+            buffer_ = std::make_unique<T[]>(capacity);
+            mask_ = capacity - 1;
+        }
+        clear();
+    }
+    void clear() {
+        head_.store(0, std::memory_order_relaxed);
+        tail_.store(0, std::memory_order_relaxed);
+    }
+
+    usize capacity() const {
+        return buffer_ ? mask_ + 1 : 0;
+    }
+    usize size() const {
+        return head_.load(std::memory_order_acquire) -
+               tail_.load(std::memory_order_acquire);
+    }
+
+    // Producer. Copies as much as fits, in whole groups of `unit` values
+    // (one per channel, say), and returns how much that was. The
+    // power-of-two capacity needn't be a multiple of `unit`, so without it
+    // a partial write could end mid-frame.
+    usize write(const T* data, usize count, usize unit = 1) {
+        usize head = head_.load(std::memory_order_relaxed);
+        usize tail = tail_.load(std::memory_order_acquire);
+        usize space = capacity() - (head - tail);
+        count = std::min(count, space - space % unit);
+        usize offset = head & mask_;
+        usize first = std::min(count, mask_ + 1 - offset);
+        std::memcpy(buffer_.get() + offset, data, first * sizeof(T));
+        std::memcpy(buffer_.get(), data + first, (count - first) * sizeof(T));
+        head_.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    // Consumer. The oldest `count` values (or fewer, if that's all there
+    // is) in place; valid until consume().
+    Spans peek(usize count) const {
+        usize tail = tail_.load(std::memory_order_relaxed);
+        usize head = head_.load(std::memory_order_acquire);
+        count = std::min(count, head - tail);
+        usize offset = tail & mask_;
+        usize first = std::min(count, mask_ + 1 - offset);
+        return {std::span<const T>(buffer_.get() + offset, first),
+                std::span<const T>(buffer_.get(), count - first)};
+    }
+    void consume(usize count) {
+        tail_.fetch_add(count, std::memory_order_release);
+    }
+
+private:
+    static constexpr usize CACHE_LINE = 64;
+
+    std::unique_ptr<T[]> buffer_;
+    usize mask_{0};
+    alignas(CACHE_LINE) std::atomic<usize> head_{0}; // Written by producer
+    alignas(CACHE_LINE) std::atomic<usize> tail_{0}; // Written by consumer
+};
+
+} // namespace vc
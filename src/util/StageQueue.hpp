@@ -0,0 +1,110 @@
+#pragma once
+// StageQueue.hpp - Blocking bounded queue between pipeline stages
+// BoundedQueue with a futex on each end and a way to say "that's all"
+
+#include "util/BoundedQueue.hpp"
+#include "util/Types.hpp"
+
+#include <atomic>
+
+namespace vc {
+
+// Snapshot of one queue's fill level, for stats and UI
+struct StageDepth {
+    u32 current{0};
+    u32 peak{0}; // High-water mark since the queue was last reset
+    u32 capacity{0};
+};
+
+// Any number of producers and consumers. push() waits while the queue is
+// full and pop() while it is empty, both on futexes, so an idle stage costs
+// nothing. close() ends the stream: pop() drains what is left, then fails.
+template <typename T>
+class StageQueue {
+public:
+    explicit StageQueue(usize capacity) : queue_(capacity) {}
+
+    StageQueue(const StageQueue&) = delete;
+    StageQueue& operator=(const StageQueue&) = delete;
+
+    // Waits for space. False if the queue was closed first; `value` is
+    // left alone in that case.
+    bool push(T&& value) {
+        for (;;) {
+            u32 seen = spaceSeq_.load(std::memory_order_acquire);
+            if (closed_.load(std::memory_order_acquire))
+                return false;
+            if (queue_.tryPush(std::move(value))) {
+                notePeak();
+                itemSeq_.fetch_add(1, std::memory_order_release);
+                itemSeq_.notify_all();
+                return true;
+            }
+            spaceSeq_.wait(seen, std::memory_order_acquire);
+        }
+    }
+
+    // Waits for an item. False once the queue is closed and drained.
+    bool pop(T& out) {
+        for (;;) {
+            u32 seen = itemSeq_.load(std::memory_order_acquire);
+            if (tryPop(out))
+                return true;
+            if (closed_.load(std::memory_order_acquire))
+                return tryPop(out); // Pushed before close, seen after
+            itemSeq_.wait(seen, std::memory_order_acquire);
+        }
+    }
+
+    bool tryPop(T& out) {
+        if (!queue_.tryPop(out))
+            return false;
+        spaceSeq_.fetch_add(1, std::memory_order_release);
+        spaceSeq_.notify_all();
+        return true;
+    }
+
+    // Call once every producer is done
+    void close() {
+        closed_.store(true, std::memory_order_release);
+        itemSeq_.fetch_add(1, std::memory_order_release);
+        itemSeq_.notify_all();
+        spaceSeq_.fetch_add(1, std::memory_order_release);
+        spaceSeq_.notify_all();
+    }
+
+    // Empty and open again, for the next run. Nobody may be using it.
+    void reset() {
+        T discard;
+        while (queue_.tryPop(discard)) {
+        }
+        peak_.store(0, std::memory_order_relaxed);
+        closed_.store(false, std::memory_order_release);
+    }
+
+    StageDepth depth() const {
+        StageDepth depth;
+        depth.current = static_cast<u32>(queue_.sizeApprox());
+        depth.peak = static_cast<u32>(peak_.load(std::memory_order_relaxed));
+        depth.capacity = static_cast<u32>(queue_.capacity());
+        return depth;
+    }
+
+private:
+    void notePeak() {
+        usize size = queue_.sizeApprox();
+        usize peak = peak_.load(std::memory_order_relaxed);
+        while (size > peak &&
+               !peak_.compare_exchange_weak(
+                       peak, size, std::memory_order_relaxed)) {
+        }
+    }
+
+    BoundedQueue<T> queue_;
+    std::atomic<u32> itemSeq_{0};
+    std::atomic<u32> spaceSeq_{0};
+    std::atomic<bool> closed_{false};
+    std::atomic<usize> peak_{0};
+};
+
+} // namespace vc
@@ -0,0 +1,92 @@
+#include "WorkerPool.hpp"
+
+#include <algorithm>
+
+namespace vc {
+
+WorkerPool::~WorkerPool() {
+    stop();
+}
+
+void WorkerPool::start(u32 threads) {
+    stop();
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = false;
+    }
+    threads_.reserve(threads);
+    for (u32 i = 0; i < threads; ++i)
+        threads_.emplace_back(&WorkerPool::workerLoop, this);
+}
+
+void WorkerPool::stop() {
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    workCond_.notify_all();
+    for (auto& thread : threads_)
+        thread.join();
+    threads_.clear();
+}
+
+void WorkerPool::drain(Batch& batch) {
+    for (;;) {
+        u32 index = batch.next.fetch_add(1, std::memory_order_relaxed);
+        if (index >= batch.count)
+            return;
+        (*batch.fn)(index);
+    }
+}
+
+void WorkerPool::parallelFor(u32 count, const std::function<void(u32)>& fn) {
+    if (count <= 1 || threads_.empty()) {
+        for (u32 i = 0; i < count; ++i)
+            fn(i);
+        return;
+    }
+
+    Batch batch;
+    batch.fn = &fn;
+    batch.count = count;
+    {
+        std::lock_guard lock(mutex_);
+        batches_.push_back(&batch);
+    }
+    // We take indices too, so one fewer helper than indices will do
+    for (u32 i = std::min(count - 1, size()); i > 0; --i)
+        workCond_.notify_one();
+
+    drain(batch);
+
+    // Every index is claimed. Unlist the batch so no one else joins, then
+    // wait out the helpers still finishing theirs; they hold `batch`.
+    std::unique_lock lock(mutex_);
+    auto it = std::find(batches_.begin(), batches_.end(), &batch);
+    if (it != batches_.end())
+        batches_.erase(it);
+    doneCond_.wait(lock, [&] { return batch.helpers == 0; });
+}
+
+void WorkerPool::workerLoop() {
+    std::unique_lock lock(mutex_);
+    for (;;) {
+        workCond_.wait(lock, [this] { return stopping_ || !batches_.empty(); });
+        if (stopping_)
+            return;
+
+        Batch* batch = batches_.front();
+        if (batch->next.load(std::memory_order_relaxed) >= batch->count) {
+            batches_.pop_front(); // Nothing left to claim
+            continue;
+        }
+        ++batch->helpers;
+        lock.unlock();
+        drain(*batch);
+        lock.lock();
+        if (--batch->helpers == 0)
+            doneCond_.notify_all();
+    }
+}
+
+} // namespace vc
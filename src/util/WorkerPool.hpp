@@ -0,0 +1,57 @@
+#pragma once
+// WorkerPool.hpp - Fixed set of threads for fork-join work
+// Many hands make light frames
+
+#include "util/Types.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vc {
+
+// parallelFor() splits a loop over the pool and the calling thread, which
+// takes indices too, so a busy or empty pool degrades to running inline
+// rather than waiting. Several threads may call parallelFor() at once; the
+// pool threads help whichever batch is oldest.
+class WorkerPool {
+public:
+    WorkerPool() = default;
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    void start(u32 threads);
+    void stop();
+    u32 size() const {
+        return static_cast<u32>(threads_.size());
+    }
+
+    // Runs fn(0) .. fn(count - 1) and returns when all of them have
+    void parallelFor(u32 count, const std::function<void(u32)>& fn);
+
+private:
+    struct Batch {
+        const std::function<void(u32)>* fn{nullptr};
+        u32 count{0};
+        std::atomic<u32> next{0};
+        u32 helpers{0}; // Pool threads inside it, under mutex_
+    };
+
+    void workerLoop();
+    static void drain(Batch& batch);
+
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    std::condition_variable workCond_;
+    std::condition_variable doneCond_;
+    std::deque<Batch*> batches_;
+    bool stopping_{false};
+};
+
+} // namespace vc
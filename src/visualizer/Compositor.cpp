@@ -0,0 +1,141 @@
+#include "Compositor.hpp"
+#include "core/Logger.hpp"
+
+namespace vc {
+
+namespace {
+
+// Full-screen triangle from gl_VertexID; no vertex buffer needed
+const char* VERT_SOURCE = R"(
+    #version 330 core
+    out vec2 uv;
+    void main() {
+        vec2 pos = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+        uv = pos;
+        gl_Position = vec4(pos * 2.0 - 1.0, 0.0, 1.0);
+    }
+)";
+
+const char* FRAG_SOURCE = R"(
+    #version 330 core
+    in vec2 uv;
+    out vec4 color;
+    uniform sampler2D scene;
+    uniform sampler2D overlay;
+    uniform vec2 sceneScale;
+    uniform bool hasOverlay;
+    uniform bool flipY;
+    uniform bool ycbcr;
+
+    void main() {
+        // st is in scene (GL) space; the overlay is stored top-down
+        vec2 st = vec2(uv.x, flipY ? 1.0 - uv.y : uv.y);
+        // Stay half a texel inside the logical region so bilinear filtering
+        // never pulls in the unused part of a grow-only target
+        vec2 halfTexel = 0.5 / vec2(textureSize(scene, 0));
+        vec2 sceneSt = clamp(st * sceneScale, halfTexel, sceneScale - halfTexel);
+        vec3 rgb = texture(scene, sceneSt).rgb;
+
+        if (hasOverlay) {
+            vec4 o = texture(overlay, vec2(st.x, 1.0 - st.y));
+            rgb = mix(rgb, o.rgb, o.a);
+        }
+
+        if (ycbcr) {
+            // BT.709, limited range. Byte order V U Y A (AV_PIX_FMT_VUYA).
+            float y = dot(rgb, vec3(0.2126, 0.7152, 0.0722));
+            float cb = (rgb.b - y) / 1.8556;
+            float cr = (rgb.r - y) / 1.5748;
+            vec3 yuv = vec3(16.0 + 219.0 * y,
+                            128.0 + 224.0 * cb,
+                            128.0 + 224.0 * cr) / 255.0;
+            color = vec4(yuv.z, yuv.y, yuv.x, 1.0);
+        } else {
+            color = vec4(rgb, 1.0);
+        }
+    }
+)";
+
+} // namespace
+
+Compositor::Compositor() = default;
+
+Compositor::~Compositor() {
+    destroy();
+}
+
+Result<void> Compositor::init() {
+    if (isInitialized())
+        return Result<void>::ok();
+
+    auto program = std::make_unique<QOpenGLShaderProgram>();
+    if (!program->addShaderFromSourceCode(QOpenGLShader::Vertex, VERT_SOURCE) ||
+        !program->addShaderFromSourceCode(QOpenGLShader::Fragment,
+                                          FRAG_SOURCE) ||
+        !program->link()) {
+        return Result<void>::err("Compositor shader failed: " +
+                                 program->log().toStdString());
+    }
+
+    if (!vao_.isCreated() && !vao_.create()) {
+        return Result<void>::err("Compositor: failed to create VAO");
+    }
+
+    locScene_ = program->uniformLocation("scene");
+    locOverlay_ = program->uniformLocation("overlay");
+    locSceneScale_ = program->uniformLocation("sceneScale");
+    locHasOverlay_ = program->uniformLocation("hasOverlay");
+    locFlipY_ = program->uniformLocation("flipY");
+    locYCbCr_ = program->uniformLocation("ycbcr");
+
+    program_ = std::move(program);
+    LOG_DEBUG("Compositor: initialized");
+    return Result<void>::ok();
+}
+
+void Compositor::destroy() {
+    program_.reset();
+    if (vao_.isCreated())
+        vao_.destroy();
+}
+
+void Compositor::compose(const Layers& layers, const Output& out) {
+    if (!program_ || layers.scene == 0 || out.width == 0 || out.height == 0)
+        return;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, out.fbo);
+    glViewport(0, 0, out.width, out.height);
+    glDisable(GL_BLEND);
+    glDisable(GL_DEPTH_TEST);
+
+    program_->bind();
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, layers.scene);
+    program_->setUniformValue(locScene_, 0);
+    program_->setUniformValue(
+            locSceneScale_, layers.sceneScale.x, layers.sceneScale.y);
+
+    bool hasOverlay = layers.overlay != 0;
+    if (hasOverlay) {
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, layers.overlay);
+    }
+    program_->setUniformValue(locOverlay_, 1);
+    program_->setUniformValue(locHasOverlay_, hasOverlay);
+    program_->setUniformValue(locFlipY_, out.flipY);
+    program_->setUniformValue(locYCbCr_, out.encoding == Encoding::YCbCr709);
+
+    vao_.bind();
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    vao_.release();
+
+    if (hasOverlay) {
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glActiveTexture(GL_TEXTURE0);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    program_->release();
+}
+
+} // namespace vc
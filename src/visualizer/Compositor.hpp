@@ -0,0 +1,66 @@
+#pragma once
+// Compositor.hpp - Final composition of scene + overlay, one pass per output
+// Every full-screen pass costs bandwidth; we only pay for the ones we show
+
+// clang-format off
+#include "util/GLIncludes.hpp" // Must be first
+#include <QOpenGLShaderProgram>
+#include <QOpenGLVertexArrayObject>
+// clang-format on
+
+#include "util/Result.hpp"
+#include "util/Types.hpp"
+
+#include <memory>
+
+namespace vc {
+
+class Compositor {
+public:
+    // What ends up in the output's color attachment
+    enum class Encoding {
+        RGBA,     // Display / encoder-side color conversion
+        YCbCr709  // BT.709 limited range, packed as VUYA bytes for FFmpeg
+    };
+
+    struct Layers {
+        GLuint scene{0};   // projectM output, GL orientation (bottom-up)
+        GLuint overlay{0}; // Optional, QImage orientation (top-down)
+        Vec2 sceneScale{1.0f, 1.0f}; // Logical region of a grow-only target
+    };
+
+    struct Output {
+        GLuint fbo{0}; // Screen: the context's defaultFramebufferObject()
+        u32 width{0};
+        u32 height{0};
+        bool flipY{false}; // Top-down rows for readback
+        Encoding encoding{Encoding::RGBA};
+    };
+
+    Compositor();
+    ~Compositor();
+
+    // GL resources (context must be current)
+    Result<void> init();
+    void destroy();
+    bool isInitialized() const {
+        return program_ != nullptr;
+    }
+
+    // Blend the layers into `out` with a single full-screen triangle.
+    // Alpha is written as 1.0 so compositors never see projectM's stray 0s.
+    void compose(const Layers& layers, const Output& out);
+
+private:
+    std::unique_ptr<QOpenGLShaderProgram> program_;
+    QOpenGLVertexArrayObject vao_;
+
+    int locScene_{-1};
+    int locOverlay_{-1};
+    int locHasOverlay_{-1};
+    int locSceneScale_{-1};
+    int locFlipY_{-1};
+    int locYCbCr_{-1};
+};
+
+} // namespace vc
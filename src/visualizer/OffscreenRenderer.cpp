@@ -0,0 +1,160 @@
+#include "OffscreenRenderer.hpp"
+#include "core/Logger.hpp"
+
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <mutex>
+
+namespace vc {
+
+namespace {
+
+QSurfaceFormat offscreenFormat() {
+    QSurfaceFormat format;
+    format.setVersion(3, 3);
+    format.setProfile(QSurfaceFormat::CoreProfile);
+    format.setDepthBufferSize(24);
+    return format;
+}
+
+// GLEW's entry points are process-wide; resolve them once, whoever is first
+Result<void> initGlewOnce() {
+    static std::mutex mutex;
+    static bool done = false;
+    std::lock_guard lock(mutex);
+    if (done)
+        return Result<void>::ok();
+    glewExperimental = GL_TRUE;
+    if (glewInit() != GLEW_OK)
+        return Result<void>::err("GLEW init failed");
+    done = true;
+    return Result<void>::ok();
+}
+
+} // namespace
+
+OffscreenRenderer::OffscreenRenderer() = default;
+
+OffscreenRenderer::~OffscreenRenderer() = default;
+
+Result<void> OffscreenRenderer::createSurface() {
+    surface_ = std::make_unique<QOffscreenSurface>();
+    surface_->setFormat(offscreenFormat());
+    surface_->create();
+    if (!surface_->isValid())
+        return Result<void>::err("Failed to create offscreen surface");
+    return Result<void>::ok();
+}
+
+Result<void> OffscreenRenderer::init(u32 width, u32 height, u32 fps) {
+    if (!surface_)
+        return Result<void>::err("Offscreen surface not created");
+
+    context_ = std::make_unique<QOpenGLContext>();
+    context_->setFormat(offscreenFormat());
+    if (!context_->create() || !context_->makeCurrent(surface_.get()))
+        return Result<void>::err("Failed to create offscreen GL context");
+    if (auto result = initGlewOnce(); !result)
+        return result;
+
+    if (auto result = scene_.create(width, height, true); !result)
+        return result;
+    if (auto result = readback_.create(width, height); !result)
+        return result;
+
+    projectM_ = projectm_create();
+    if (!projectM_)
+        return Result<void>::err("Failed to create ProjectM instance");
+    projectm_set_window_size(projectM_, width, height);
+    projectm_set_fps(projectM_, fps);
+    projectm_set_preset_duration(projectM_, 0);
+    projectm_set_preset_locked(projectM_, true);
+    projectm_set_preset_switch_failed_event_callback(
+            projectM_,
+            [](const char*, const char* message, void* self) {
+                static_cast<OffscreenRenderer*>(self)->loadError_ =
+                        message ? message : "preset failed to load";
+            },
+            this);
+    return Result<void>::ok();
+}
+
+void OffscreenRenderer::destroy() {
+    if (context_ && context_->makeCurrent(surface_.get())) {
+        if (projectM_)
+            projectm_destroy(projectM_);
+        scene_.destroy();
+        readback_.destroy();
+        context_->doneCurrent();
+    }
+    projectM_ = nullptr;
+    context_.reset();
+}
+
+Result<void> OffscreenRenderer::loadPreset(const std::string& data) {
+    if (!projectM_)
+        return Result<void>::err("Offscreen renderer not initialized");
+    // The callback fires synchronously from inside the load
+    loadError_.clear();
+    projectm_load_preset_data(projectM_, data.c_str(), false);
+    if (!loadError_.empty())
+        return Result<void>::err(loadError_);
+    return Result<void>::ok();
+}
+
+void OffscreenRenderer::addPCM(const f32* interleaved,
+                               u32 frames,
+                               u32 channels) {
+    if (!projectM_)
+        return;
+    projectm_pcm_add_float(projectM_,
+                           interleaved,
+                           frames,
+                           channels == 1 ? PROJECTM_MONO : PROJECTM_STEREO);
+}
+
+void OffscreenRenderer::renderFrame() {
+    if (!projectM_)
+        return;
+    scene_.bind();
+    glViewport(0, 0, scene_.width(), scene_.height());
+    projectm_opengl_render_frame(projectM_);
+    scene_.unbind();
+}
+
+void OffscreenRenderer::setFrameTime(f64 seconds) {
+#ifdef CHADVIS_HAVE_PROJECTM_FRAME_TIME
+    if (projectM_)
+        projectm_set_frame_time(projectM_, seconds);
+#else
+    (void)seconds;
+#endif
+}
+
+bool OffscreenRenderer::hasFrameTime() {
+#ifdef CHADVIS_HAVE_PROJECTM_FRAME_TIME
+    return true;
+#else
+    return false;
+#endif
+}
+
+QImage OffscreenRenderer::grab() {
+    QImage image(scene_.width(), scene_.height(), QImage::Format_RGBX8888);
+    readFrame(image.bits());
+    return image;
+}
+
+void OffscreenRenderer::readFrame(u8* pixels) {
+    if (!projectM_)
+        return;
+    // Flip on the GPU so the rows read back top-down
+    scene_.blitTo(readback_, false, true);
+    readback_.readPixels(pixels);
+}
+
+void OffscreenRenderer::finish() {
+    glFinish();
+}
+
+} // namespace vc
@@ -0,0 +1,84 @@
+#pragma once
+// OffscreenRenderer.hpp - A projectM instance with its own context and FBO
+// For rendering presets nobody is looking at (yet)
+
+// clang-format off
+#include "util/GLIncludes.hpp" // Must be first
+// clang-format on
+
+#include "RenderTarget.hpp"
+#include "util/Result.hpp"
+#include "util/Types.hpp"
+
+#include "projectM-4/projectM.h"
+#include <QImage>
+#include <memory>
+#include <string>
+
+class QOffscreenSurface;
+class QOpenGLContext;
+
+namespace vc {
+
+// Lifecycle is split across threads the way Qt wants it: the surface is a
+// window-system object and has to be created on the GUI thread, while the
+// context belongs to whichever thread calls init() and renders. destroy()
+// must run on that same thread; the destructor only frees the surface.
+class OffscreenRenderer {
+public:
+    OffscreenRenderer();
+    ~OffscreenRenderer();
+
+    OffscreenRenderer(const OffscreenRenderer&) = delete;
+    OffscreenRenderer& operator=(const OffscreenRenderer&) = delete;
+
+    // GUI thread
+    Result<void> createSurface();
+
+    // Render thread. Leaves the context current on this thread.
+    Result<void> init(u32 width, u32 height, u32 fps);
+    void destroy();
+    bool isInitialized() const {
+        return projectM_ != nullptr;
+    }
+
+    // Hard cut; an offscreen render has nothing to blend from. Fails if
+    // projectM rejects the preset (parse or shader errors).
+    Result<void> loadPreset(const std::string& data);
+    void addPCM(const f32* interleaved, u32 frames, u32 channels);
+    void renderFrame();
+
+    // Renders the next frame as if `seconds` had passed since the first,
+    // instead of going by the wall clock. Needs projectM 4.1; see
+    // hasFrameTime().
+    void setFrameTime(f64 seconds);
+    static bool hasFrameTime();
+
+    // Current frame, row 0 at the top. Alpha is ignored (projectM leaves 0s).
+    QImage grab();
+    // Same, into width() * height() * 4 bytes of RGBA at `pixels`
+    void readFrame(u8* pixels);
+
+    // Block until the GPU is done (for timing and budgets)
+    void finish();
+
+    u32 width() const {
+        return scene_.width();
+    }
+    u32 height() const {
+        return scene_.height();
+    }
+    projectm_handle handle() {
+        return projectM_;
+    }
+
+private:
+    std::unique_ptr<QOffscreenSurface> surface_;
+    std::unique_ptr<QOpenGLContext> context_;
+    projectm_handle projectM_{nullptr};
+    RenderTarget scene_;    // projectM output, with depth
+    RenderTarget readback_; // Flipped copy for grab()
+    std::string loadError_; // Set by projectM's switch-failed callback
+};
+
+} // namespace vc
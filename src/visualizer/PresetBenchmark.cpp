@@ -0,0 +1,222 @@
+#include "PresetBenchmark.hpp"
+#include "OffscreenRenderer.hpp"
+#include "PresetManager.hpp"
+#include "PresetPack.hpp"
+#include "audio/SyntheticAudio.hpp"
+#include "core/Logger.hpp"
+#include "util/FileUtils.hpp"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <format>
+#include <numeric>
+
+namespace vc {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+f64 msSince(Clock::time_point start) {
+    return std::chrono::duration<f64, std::milli>(Clock::now() - start)
+            .count();
+}
+
+// Nearest-rank percentile of sorted samples
+f64 percentile(const std::vector<f64>& sorted, f64 p) {
+    if (sorted.empty())
+        return 0.0;
+    auto rank = static_cast<usize>(std::ceil(p * sorted.size()));
+    return sorted[std::clamp<usize>(rank, 1, sorted.size()) - 1];
+}
+
+std::string csvField(std::string_view value) {
+    if (value.find_first_of(",\"\n") == std::string_view::npos)
+        return std::string(value);
+    std::string out = "\"";
+    for (char c : value) {
+        if (c == '"')
+            out += '"';
+        out += c;
+    }
+    return out + "\"";
+}
+
+} // namespace
+
+PresetBenchmark::PresetBenchmark(Options options)
+    : options_(std::move(options)) {}
+
+usize PresetBenchmark::failures() const {
+    return std::count_if(results_.begin(), results_.end(), [](const auto& r) {
+        return !r.error.empty();
+    });
+}
+
+Result<void> PresetBenchmark::run() {
+    PresetManager presets;
+    if (auto result = presets.scan(options_.presets); !result)
+        return result;
+    if (presets.empty())
+        return Result<void>::err("No presets found in " +
+                                 options_.presets.string());
+
+    OffscreenRenderer renderer;
+    if (auto result = renderer.createSurface(); !result)
+        return result;
+    if (auto result = renderer.init(
+                options_.width, options_.height, options_.fps);
+        !result) {
+        renderer.destroy();
+        return result;
+    }
+    if (const auto* name = glGetString(GL_RENDERER))
+        renderer_ = reinterpret_cast<const char*>(name);
+    LOG_INFO("PresetBenchmark: {} presets at {}x{} for {}s each on {}",
+             presets.count(),
+             options_.width,
+             options_.height,
+             options_.seconds,
+             renderer_);
+
+    results_.clear();
+    results_.reserve(presets.count());
+    auto pack = presets.pack();
+    const usize total = presets.count();
+    for (const auto& info : presets.allPresets()) {
+        results_.push_back(measure(renderer, pack.get(), info.path, info.name));
+        const auto& r = results_.back();
+        if (r.error.empty()) {
+            LOG_INFO("[{}/{}] {}: avg {:.2f} p95 {:.2f} p99 {:.2f} ms, "
+                     "compile {:.1f} ms",
+                     results_.size(),
+                     total,
+                     r.name,
+                     r.avgMs,
+                     r.p95Ms,
+                     r.p99Ms,
+                     r.compileMs);
+        } else {
+            LOG_WARN("[{}/{}] {}: {}", results_.size(), total, r.name, r.error);
+        }
+    }
+    renderer.destroy();
+
+    bool json = options_.report.extension() == ".json";
+    return json ? writeJson() : writeCsv();
+}
+
+PresetTiming PresetBenchmark::measure(OffscreenRenderer& renderer,
+                                      const PresetPack* pack,
+                                      const fs::path& path,
+                                      const std::string& name) {
+    PresetTiming timing;
+    timing.name = name;
+    timing.path = path;
+
+    auto start = Clock::now();
+    auto text = readPresetText(pack, path);
+    timing.loadMs = msSince(start);
+    if (!text) {
+        timing.error = text.error().message;
+        return timing;
+    }
+
+    start = Clock::now();
+    auto loaded = renderer.loadPreset(*text);
+    renderer.finish();
+    timing.compileMs = msSince(start);
+    if (!loaded) {
+        timing.error = loaded.error().message;
+        return timing;
+    }
+
+    // Same reference signal, from the same point, for every preset
+    SyntheticAudio audio;
+    const u32 audioFrames = SyntheticAudio::SAMPLE_RATE / options_.fps;
+    std::vector<f32> pcm(audioFrames * SyntheticAudio::CHANNELS);
+    const auto totalFrames = static_cast<u32>(
+            std::max(1.0, options_.seconds * options_.fps) + 1);
+
+    std::vector<f64> frameMs;
+    frameMs.reserve(totalFrames);
+    for (u32 frame = 0; frame < totalFrames; ++frame) {
+        audio.generate(pcm.data(), audioFrames);
+        renderer.addPCM(pcm.data(), audioFrames, SyntheticAudio::CHANNELS);
+        start = Clock::now();
+        renderer.renderFrame();
+        renderer.finish();
+        if (frame == 0)
+            timing.firstFrameMs = msSince(start);
+        else
+            frameMs.push_back(msSince(start));
+    }
+
+    std::sort(frameMs.begin(), frameMs.end());
+    timing.frames = static_cast<u32>(frameMs.size());
+    timing.avgMs = std::accumulate(frameMs.begin(), frameMs.end(), 0.0) /
+                   static_cast<f64>(frameMs.size());
+    timing.p95Ms = percentile(frameMs, 0.95);
+    timing.p99Ms = percentile(frameMs, 0.99);
+    timing.maxMs = frameMs.back();
+    return timing;
+}
+
+Result<void> PresetBenchmark::writeCsv() const {
+    std::string out = "name,path,load_ms,compile_ms,first_frame_ms,avg_ms,"
+                      "p95_ms,p99_ms,max_ms,frames,error\n";
+    for (const auto& r : results_) {
+        out += std::format("{},{},{:.3f},{:.3f},{:.3f},{:.3f},{:.3f},{:.3f},"
+                           "{:.3f},{},{}\n",
+                           csvField(r.name),
+                           csvField(r.path.string()),
+                           r.loadMs,
+                           r.compileMs,
+                           r.firstFrameMs,
+                           r.avgMs,
+                           r.p95Ms,
+                           r.p99Ms,
+                           r.maxMs,
+                           r.frames,
+                           csvField(r.error));
+    }
+    return file::writeText(options_.report, out);
+}
+
+Result<void> PresetBenchmark::writeJson() const {
+    QJsonArray presets;
+    for (const auto& r : results_) {
+        QJsonObject preset{
+                {"name", QString::fromStdString(r.name)},
+                {"path", QString::fromStdString(r.path.string())},
+                {"load_ms", r.loadMs},
+                {"compile_ms", r.compileMs},
+                {"first_frame_ms", r.firstFrameMs},
+                {"avg_ms", r.avgMs},
+                {"p95_ms", r.p95Ms},
+                {"p99_ms", r.p99Ms},
+                {"max_ms", r.maxMs},
+                {"frames", static_cast<qint64>(r.frames)},
+        };
+        if (!r.error.empty())
+            preset["error"] = QString::fromStdString(r.error);
+        presets.append(preset);
+    }
+    QJsonObject root{
+            {"renderer", QString::fromStdString(renderer_)},
+            {"width", static_cast<qint64>(options_.width)},
+            {"height", static_cast<qint64>(options_.height)},
+            {"fps", static_cast<qint64>(options_.fps)},
+            {"seconds", options_.seconds},
+            {"presets", presets},
+    };
+    QByteArray json = QJsonDocument(root).toJson(QJsonDocument::Indented);
+    return file::writeText(options_.report,
+                           std::string_view(json.constData(), json.size()));
+}
+
+} // namespace vc
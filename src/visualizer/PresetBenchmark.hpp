@@ -0,0 +1,73 @@
+#pragma once
+// PresetBenchmark.hpp - Times every preset in a collection, offscreen
+// Find out which presets melt the venue's laptop before the venue does
+
+#include "util/Result.hpp"
+#include "util/Types.hpp"
+
+#include <string>
+#include <vector>
+
+namespace vc {
+
+class OffscreenRenderer;
+class PresetPack;
+
+struct PresetTiming {
+    std::string name;
+    fs::path path;
+    f64 loadMs{0.0};       // Reading the text (disk or pack)
+    f64 compileMs{0.0};    // projectM parse and shader compile
+    f64 firstFrameMs{0.0}; // Whatever projectM deferred to the first frame
+    f64 avgMs{0.0};        // The rest are over the remaining frames
+    f64 p95Ms{0.0};
+    f64 p99Ms{0.0};
+    f64 maxMs{0.0};
+    u32 frames{0};
+    std::string error; // Empty if the preset loaded and rendered
+};
+
+// Renders each preset through an OffscreenRenderer, the same projectM path
+// VisualizerWindow uses, for `seconds` of SyntheticAudio at a fixed size.
+// Every frame is waited on with glFinish, so frame times are wall times of
+// the whole GPU (or llvmpipe) frame, not just command submission.
+//
+// Runs on the GUI thread, with a QGuiApplication but no windows, so
+// `LIBGL_ALWAYS_SOFTWARE=1 xvfb-run chadvis-projectm-qt --benchmark-presets`
+// works on machines without a GPU.
+class PresetBenchmark {
+public:
+    struct Options {
+        fs::path presets; // Directory or .cvpk pack
+        fs::path report;  // .json for JSON, anything else for CSV
+        u32 width{1280};
+        u32 height{720};
+        u32 fps{60};
+        f64 seconds{10.0};
+    };
+
+    explicit PresetBenchmark(Options options);
+
+    // Times every preset and writes the report. Fails only if nothing could
+    // be measured at all; per-preset failures are in the report.
+    Result<void> run();
+
+    const std::vector<PresetTiming>& results() const {
+        return results_;
+    }
+    usize failures() const;
+
+private:
+    PresetTiming measure(OffscreenRenderer& renderer,
+                         const PresetPack* pack,
+                         const fs::path& path,
+                         const std::string& name);
+    Result<void> writeCsv() const;
+    Result<void> writeJson() const;
+
+    Options options_;
+    std::string renderer_; // GL_RENDERER, e.g. "llvmpipe (LLVM 17.0.6)"
+    std::vector<PresetTiming> results_;
+};
+
+} // namespace vc
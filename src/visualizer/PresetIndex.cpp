@@ -0,0 +1,367 @@
+#include "PresetIndex.hpp"
+#include "core/Logger.hpp"
+#include "util/FileUtils.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+
+namespace vc {
+
+namespace {
+
+constexpr char MAGIC[4] = {'C', 'V', 'P', 'I'};
+constexpr u32 FLAG_RECURSIVE = 1;
+
+i64 ticks(fs::file_time_type t) {
+    return static_cast<i64>(t.time_since_epoch().count());
+}
+
+bool isPresetFile(const fs::path& path) {
+    auto ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return file::presetExtensions.contains(ext);
+}
+
+} // namespace
+
+PresetIndex::~PresetIndex() {
+    close();
+}
+
+Result<void> PresetIndex::open(const fs::path& file) {
+    close();
+
+    int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return Result<void>::ok(); // First run
+
+    struct stat st{};
+    if (::fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(Header)) {
+        ::close(fd);
+        return Result<void>::ok();
+    }
+
+    usize size = static_cast<usize>(st.st_size);
+    void* map = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED)
+        return Result<void>::err("Failed to map preset index: " +
+                                 std::string(std::strerror(errno)));
+
+    map_ = map;
+    mapSize_ = size;
+
+    const auto* base = static_cast<const u8*>(map);
+    const auto* header = reinterpret_cast<const Header*>(base);
+    u64 expected = sizeof(Header) + u64(header->dirCount) * sizeof(DirEntry) +
+                   u64(header->fileCount) * sizeof(FileEntry) +
+                   header->stringBytes;
+    bool valid = std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) == 0 &&
+                 header->version == VERSION && expected == size &&
+                 header->stringBytes > 0;
+
+    if (valid) {
+        header_ = header;
+        mappedDirs_ = reinterpret_cast<const DirEntry*>(base + sizeof(Header));
+        mappedFiles_ = reinterpret_cast<const FileEntry*>(
+                mappedDirs_ + header->dirCount);
+        strings_ = reinterpret_cast<const char*>(mappedFiles_ +
+                                                 header->fileCount);
+        valid = strings_[header->stringBytes - 1] == '\0';
+    }
+
+    // Offsets are trusted from here on, so check every one of them once
+    auto inStrings = [&](u32 offset) { return offset < header->stringBytes; };
+    for (u32 i = 0; valid && i < header->dirCount; ++i) {
+        const auto& d = mappedDirs_[i];
+        valid = inStrings(d.path) && inStrings(d.category) &&
+                (d.parent == NO_PARENT || d.parent < header->dirCount) &&
+                u64(d.firstFile) + d.fileCount <= header->fileCount;
+    }
+    for (u32 i = 0; valid && i < header->fileCount; ++i) {
+        const auto& f = mappedFiles_[i];
+        valid = inStrings(f.fileName) && inStrings(f.name) &&
+                inStrings(f.author);
+    }
+
+    if (!valid) {
+        LOG_WARN("PresetIndex: ignoring stale or damaged {}", file.string());
+        close();
+        return Result<void>::ok();
+    }
+
+    mappedLookup_.reserve(header_->dirCount);
+    mappedChildren_.assign(header_->dirCount, {});
+    for (u32 i = 0; i < header_->dirCount; ++i) {
+        mappedLookup_.emplace(std::string(str(mappedDirs_[i].path)), i);
+        if (mappedDirs_[i].parent != NO_PARENT)
+            mappedChildren_[mappedDirs_[i].parent].push_back(i);
+    }
+
+    LOG_DEBUG("PresetIndex: mapped {} presets in {} directories",
+              header_->fileCount,
+              header_->dirCount);
+    return Result<void>::ok();
+}
+
+void PresetIndex::close() {
+    if (map_)
+        ::munmap(map_, mapSize_);
+    map_ = nullptr;
+    mapSize_ = 0;
+    header_ = nullptr;
+    mappedDirs_ = nullptr;
+    mappedFiles_ = nullptr;
+    strings_ = nullptr;
+    mappedLookup_.clear();
+    mappedChildren_.clear();
+}
+
+const std::vector<PresetIndex::Record>& PresetIndex::refresh(
+        const fs::path& root,
+        bool recursive) {
+    records_.clear();
+    dirs_.clear();
+    dirPaths_.clear();
+    stats_ = {};
+    recursive_ = recursive;
+
+    bool usable = isOpen() &&
+                  ((header_->flags & FLAG_RECURSIVE) != 0) == recursive;
+    changed_ = !usable;
+
+    // Breadth-first; a directory's index in dirs_ is known before its
+    // children are queued
+    std::vector<std::pair<fs::path, u32>> queue{{root, NO_PARENT}};
+    for (usize i = 0; i < queue.size(); ++i) {
+        auto [path, parent] = std::move(queue[i]);
+
+        std::error_code ec;
+        auto mtime = fs::last_write_time(path, ec);
+        if (ec) {
+            changed_ = true;
+            continue;
+        }
+
+        u32 self = static_cast<u32>(dirs_.size());
+        Dir dir;
+        dir.path = path;
+        dir.parent = parent;
+        dir.mtime = ticks(mtime);
+        dir.firstRecord = static_cast<u32>(records_.size());
+        // Lexical, unlike fs::relative: no syscalls, and once per directory
+        dir.category = path == root ? "Uncategorized"
+                                    : path.lexically_relative(root).string();
+
+        const DirEntry* old = nullptr;
+        u32 oldIndex = 0;
+        if (usable) {
+            auto it = mappedLookup_.find(path.string());
+            if (it != mappedLookup_.end()) {
+                oldIndex = it->second;
+                old = &mappedDirs_[oldIndex];
+            }
+        }
+
+        if (old && old->mtime == dir.mtime) {
+            reuseDir(oldIndex, dir);
+            for (u32 child : mappedChildren_[oldIndex])
+                queue.emplace_back(str(mappedDirs_[child].path), self);
+            ++stats_.dirsReused;
+        } else {
+            std::vector<fs::path> subdirs;
+            listDir(path, old, dir, subdirs, recursive);
+            for (auto& sub : subdirs)
+                queue.emplace_back(std::move(sub), self);
+            changed_ = true;
+            ++stats_.dirsListed;
+        }
+
+        dir.recordCount = static_cast<u32>(records_.size()) - dir.firstRecord;
+        dirPaths_.push_back(dir.path);
+        dirs_.push_back(std::move(dir));
+    }
+
+    if (usable && dirs_.size() != header_->dirCount)
+        changed_ = true; // Something vanished
+
+    return records_;
+}
+
+void PresetIndex::reuseDir(u32 mapped, Dir& dir) {
+    const auto& old = mappedDirs_[mapped];
+    for (u32 i = 0; i < old.fileCount; ++i) {
+        const auto& f = mappedFiles_[old.firstFile + i];
+        Record r;
+        r.path = dir.path / str(f.fileName);
+        r.name = str(f.name);
+        r.author = str(f.author);
+        r.category = dir.category;
+        r.mtime = f.mtime;
+        r.size = f.size;
+        r.hash = f.hash;
+        records_.push_back(std::move(r));
+    }
+}
+
+void PresetIndex::listDir(const fs::path& path,
+                          const DirEntry* old,
+                          Dir& dir,
+                          std::vector<fs::path>& subdirs,
+                          bool recursive) {
+    std::unordered_map<std::string_view, const FileEntry*> previous;
+    if (old) {
+        for (u32 i = 0; i < old->fileCount; ++i) {
+            const auto& f = mappedFiles_[old->firstFile + i];
+            previous.emplace(str(f.fileName), &f);
+        }
+    }
+
+    std::vector<fs::directory_entry> files;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(path, ec)) {
+        std::error_code typeEc;
+        if (entry.is_directory(typeEc)) {
+            if (recursive)
+                subdirs.push_back(entry.path());
+        } else if (entry.is_regular_file(typeEc) &&
+                   isPresetFile(entry.path())) {
+            files.push_back(entry);
+        }
+    }
+    std::sort(files.begin(), files.end());
+    std::sort(subdirs.begin(), subdirs.end());
+
+    for (const auto& entry : files) {
+        Record r;
+        r.path = entry.path();
+        r.name = r.path.stem().string();
+        r.category = dir.category;
+        std::error_code statEc;
+        r.size = entry.file_size(statEc);
+        r.mtime = ticks(entry.last_write_time(statEc));
+
+        auto it = previous.find(r.path.filename().string());
+        if (it != previous.end() && it->second->mtime == r.mtime &&
+            it->second->size == r.size) {
+            r.author = str(it->second->author);
+            r.hash = it->second->hash;
+        } else {
+            r.author = parseAuthor(r.name);
+            r.hash = hashFile(r.path);
+            ++stats_.filesHashed;
+        }
+        records_.push_back(std::move(r));
+    }
+}
+
+Result<void> PresetIndex::save(const fs::path& file) const {
+    std::string strings(1, '\0'); // Offset 0 is the empty string
+    auto intern = [&](std::string_view s) -> u32 {
+        if (s.empty())
+            return 0;
+        u32 offset = static_cast<u32>(strings.size());
+        strings.append(s);
+        strings.push_back('\0');
+        return offset;
+    };
+
+    std::vector<DirEntry> dirs;
+    dirs.reserve(dirs_.size());
+    for (const auto& d : dirs_) {
+        dirs.push_back({intern(d.path.string()),
+                        intern(d.category),
+                        d.parent,
+                        d.firstRecord,
+                        d.recordCount,
+                        0,
+                        d.mtime});
+    }
+
+    std::vector<FileEntry> files;
+    files.reserve(records_.size());
+    for (const auto& r : records_) {
+        files.push_back({intern(r.path.filename().string()),
+                         intern(r.name),
+                         intern(r.author),
+                         0,
+                         r.mtime,
+                         r.size,
+                         r.hash});
+    }
+
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.flags = recursive_ ? FLAG_RECURSIVE : 0;
+    header.dirCount = static_cast<u32>(dirs.size());
+    header.fileCount = static_cast<u32>(files.size());
+    header.stringBytes = strings.size();
+
+    std::string out;
+    out.reserve(sizeof(Header) + dirs.size() * sizeof(DirEntry) +
+                files.size() * sizeof(FileEntry) + strings.size());
+    out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.append(reinterpret_cast<const char*>(dirs.data()),
+               dirs.size() * sizeof(DirEntry));
+    out.append(reinterpret_cast<const char*>(files.data()),
+               files.size() * sizeof(FileEntry));
+    out.append(strings);
+
+    if (auto result = file::ensureDir(file.parent_path()); !result)
+        return result;
+    return file::writeText(file, out);
+}
+
+u64 PresetIndex::hashBytes(const void* data, usize size, u64 hash) {
+    const auto* bytes = static_cast<const u8*>(data);
+    for (usize i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+u64 PresetIndex::hashPreset(std::string_view text) {
+    constexpr std::string_view blank = " \t\r\f\v";
+    u64 hash = HASH_SEED;
+    while (!text.empty()) {
+        usize end = text.find('\n');
+        std::string_view line = text.substr(0, end);
+        text.remove_prefix(end == std::string_view::npos ? text.size()
+                                                         : end + 1);
+        usize first = line.find_first_not_of(blank);
+        if (first == std::string_view::npos)
+            continue;
+        line = line.substr(first, line.find_last_not_of(blank) - first + 1);
+        hash = hashBytes(line.data(), line.size(), hash);
+        hash = hashBytes("\n", 1, hash);
+    }
+    return hash == 0 ? 1 : hash;
+}
+
+u64 PresetIndex::hashFile(const fs::path& path) {
+    auto text = file::readText(path);
+    return text ? hashPreset(*text) : 0;
+}
+
+std::string PresetIndex::parseAuthor(std::string_view name) {
+    // First " - " style separator with something on both sides
+    for (usize pos = name.find('-', 1); pos != std::string_view::npos;
+         pos = name.find('-', pos + 1)) {
+        if (pos + 1 >= name.size())
+            break;
+        auto author = name.substr(0, pos);
+        while (!author.empty() && std::isspace(static_cast<u8>(author.back())))
+            author.remove_suffix(1);
+        if (!author.empty())
+            return std::string(author);
+    }
+    return {};
+}
+
+} // namespace vc
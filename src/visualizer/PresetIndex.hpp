@@ -0,0 +1,153 @@
+#pragma once
+// PresetIndex.hpp - Memory-mapped on-disk index of the preset tree
+// Walking 50k files over NFS on every start is not a personality trait
+
+#include "util/Result.hpp"
+#include "util/Types.hpp"
+
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace vc {
+
+// The index remembers every directory's mtime. Adding, removing or renaming
+// a file bumps its directory's mtime, so refresh() only has to stat the
+// directories: unchanged ones are taken from the mapped index as-is, and
+// only changed ones are listed again (reusing entries whose file mtime and
+// size still match). Editing a preset in place doesn't touch the directory,
+// so its hash is only refreshed once something else in there changes.
+class PresetIndex {
+public:
+    static constexpr u32 VERSION = 2; // 2: hashes are hashPreset()
+
+    struct Record {
+        fs::path path;
+        std::string name;
+        std::string author;
+        std::string category;
+        i64 mtime{0};
+        u64 size{0};
+        u64 hash{0}; // hashPreset() of the file contents
+    };
+
+    struct Stats {
+        usize dirsReused{0};
+        usize dirsListed{0};
+        usize filesHashed{0};
+    };
+
+    PresetIndex() = default;
+    ~PresetIndex();
+
+    PresetIndex(const PresetIndex&) = delete;
+    PresetIndex& operator=(const PresetIndex&) = delete;
+
+    // Map a previously saved index. A missing or stale file is not an
+    // error; refresh() then simply lists everything.
+    Result<void> open(const fs::path& file);
+    void close();
+    bool isOpen() const {
+        return map_ != nullptr;
+    }
+
+    // Bring the index in line with the tree under `root`
+    const std::vector<Record>& refresh(const fs::path& root, bool recursive);
+    bool changed() const {
+        return changed_;
+    }
+    Result<void> save(const fs::path& file) const;
+
+    const std::vector<Record>& records() const {
+        return records_;
+    }
+    const std::vector<fs::path>& directories() const {
+        return dirPaths_;
+    }
+    const Stats& stats() const {
+        return stats_;
+    }
+
+    // FNV-1a; hashBytes can be chained by passing the previous result
+    static constexpr u64 HASH_SEED = 0xcbf29ce484222325ull;
+    static u64 hashBytes(const void* data, usize size, u64 hash = HASH_SEED);
+    // Content hash that ignores line endings, indentation, trailing
+    // whitespace and blank lines, so copies of a preset that went through
+    // different editors or archivers still hash the same. 0 is never
+    // returned for readable text.
+    static u64 hashPreset(std::string_view text);
+    static u64 hashFile(const fs::path& path); // 0 if unreadable
+    static std::string parseAuthor(std::string_view name); // "Author - Name"
+
+private:
+    // On-disk layout: Header, DirEntry[dirCount], FileEntry[fileCount], then
+    // NUL-terminated strings addressed by byte offset
+    struct Header {
+        char magic[4];
+        u32 version;
+        u32 flags; // Bit 0: recursive
+        u32 dirCount;
+        u32 fileCount;
+        u32 reserved;
+        u64 stringBytes;
+    };
+    struct DirEntry {
+        u32 path;
+        u32 category;
+        u32 parent; // NO_PARENT for the root
+        u32 firstFile;
+        u32 fileCount;
+        u32 reserved;
+        i64 mtime;
+    };
+    struct FileEntry {
+        u32 fileName;
+        u32 name;
+        u32 author;
+        u32 reserved;
+        i64 mtime;
+        u64 size;
+        u64 hash;
+    };
+    static constexpr u32 NO_PARENT = ~0u;
+
+    // Directory as produced by the last refresh()
+    struct Dir {
+        fs::path path;
+        std::string category;
+        u32 parent{NO_PARENT};
+        u32 firstRecord{0};
+        u32 recordCount{0};
+        i64 mtime{0};
+    };
+
+    std::string_view str(u32 offset) const {
+        return strings_ + offset;
+    }
+    void reuseDir(u32 mapped, Dir& dir);
+    void listDir(const fs::path& path,
+                 const DirEntry* old,
+                 Dir& dir,
+                 std::vector<fs::path>& subdirs,
+                 bool recursive);
+
+    // Mapped previous index
+    void* map_{nullptr};
+    usize mapSize_{0};
+    const Header* header_{nullptr};
+    const DirEntry* mappedDirs_{nullptr};
+    const FileEntry* mappedFiles_{nullptr};
+    const char* strings_{nullptr};
+    std::unordered_map<std::string, u32> mappedLookup_; // Dir path -> index
+    std::vector<std::vector<u32>> mappedChildren_;
+
+    // Current state
+    std::vector<Dir> dirs_;
+    std::vector<fs::path> dirPaths_;
+    std::vector<Record> records_;
+    bool recursive_{true};
+    bool changed_{false};
+    Stats stats_;
+};
+
+} // namespace vc
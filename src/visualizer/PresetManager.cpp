@@ -1,7 +1,8 @@
 #include "PresetManager.hpp"
 #include <algorithm>
 #include <fstream>
-#include <regex>
+#include <unordered_map>
+#include "PresetIndex.hpp"
 #include "core/Logger.hpp"
 #include "util/FileUtils.hpp"
 
@@ -15,42 +16,60 @@ Result<void> PresetManager::scan(const fs::path& directory, bool recursive) {
                                  directory.string());
     }
 
-    scanDirectory_ = directory;
-    presets_.clear();
+    // A pack that fails to open leaves the current list alone
+    std::shared_ptr<PresetPack> pack;
+    if (PresetPack::isPack(directory)) {
+        // A fresh mapping each time: readers holding the old one keep it
+        // alive, and a rebuilt pack is a new file, not the old one changed
+        pack = std::make_shared<PresetPack>();
+        if (auto result = pack->open(directory); !result)
+            return result;
+    }
 
-    auto files = file::listFiles(directory, file::presetExtensions, recursive);
+    // Selection survives a rescan by path; indices are about to change
+    fs::path currentPath;
+    if (currentIndex_ < presets_.size())
+        currentPath = presets_[currentIndex_].path;
+    std::vector<fs::path> historyPaths;
+    for (usize index : history_) {
+        if (index < presets_.size())
+            historyPaths.push_back(presets_[index].path);
+    }
 
-    for (const auto& path : files) {
-        PresetInfo info;
-        info.path = path;
-        info.name = path.stem().string();
+    scanDirectory_ = directory;
+    scanRecursive_ = recursive;
+    presets_.clear();
+    plannedIndex_.reset();
 
-        // Category is parent folder relative to scan directory
-        auto rel = fs::relative(path.parent_path(), directory);
-        info.category = rel.string();
-        if (info.category == ".")
-            info.category = "Uncategorized";
+    if (pack)
+        listPack(std::move(pack));
+    else
+        listDirectory(directory, recursive);
 
-        // Parse preset file for author info
-        parsePresetInfo(info);
+    collapseDuplicates();
 
+    for (auto& info : presets_) {
         // Apply saved state
-        if (favoriteNames_.contains(info.name)) {
-            info.favorite = true;
-        }
-        if (blacklistedNames_.contains(info.name)) {
-            info.blacklisted = true;
-        }
-
-        presets_.push_back(std::move(info));
+        info.favorite = listedUnder(favoriteNames_, info);
+        info.blacklisted = listedUnder(blacklistedNames_, info);
+        info.quarantined = listedUnder(quarantinedNames_, info);
     }
 
     // Sort by name
     std::sort(presets_.begin(),
               presets_.end(),
               [](const auto& a, const auto& b) { return a.name < b.name; });
-
-    LOG_INFO("Scanned {} presets from {}", presets_.size(), directory.string());
+    updateQuarantineActive();
+    searchIndex_.build(presets_);
+    smartRotation_.invalidate();
+
+    currentIndex_ = searchIndex_.findPath(currentPath).value_or(0);
+    history_.clear();
+    for (const auto& path : historyPaths) {
+        if (auto index = searchIndex_.findPath(path))
+            history_.push_back(*index);
+    }
+    historyPosition_ = history_.empty() ? 0 : history_.size() - 1;
 
     // Apply pending preset if one was requested before scanning
     if (!pendingPresetName_.empty()) {
@@ -70,14 +89,118 @@ Result<void> PresetManager::scan(const fs::path& directory, bool recursive) {
     return Result<void>::ok();
 }
 
+void PresetManager::listPack(std::shared_ptr<const PresetPack> pack) {
+    presets_.reserve(pack->size());
+    for (usize i = 0; i < pack->size(); ++i) {
+        PresetInfo info;
+        info.path = pack->virtualPath(i);
+        info.name = pack->name(i);
+        info.author = pack->author(i);
+        info.category = pack->category(i);
+        info.contentHash = pack->hash(i);
+        presets_.push_back(std::move(info));
+    }
+    indexedDirs_ = {pack->path().parent_path()};
+    pack_ = std::move(pack);
+
+    LOG_INFO("Scanned {} presets from pack {}",
+             presets_.size(),
+             pack_->path().string());
+}
+
+void PresetManager::listDirectory(const fs::path& directory, bool recursive) {
+    pack_.reset();
+
+    PresetIndex index;
+    if (!indexPath_.empty()) {
+        if (auto result = index.open(indexPath_); !result)
+            LOG_WARN("{}", result.error().message);
+    }
+    const auto& records = index.refresh(directory, recursive);
+    if (!indexPath_.empty() && index.changed()) {
+        if (auto result = index.save(indexPath_); !result)
+            LOG_WARN("PresetIndex: {}", result.error().message);
+    }
+    indexedDirs_ = index.directories();
+
+    presets_.reserve(records.size());
+    for (const auto& record : records) {
+        PresetInfo info;
+        info.path = record.path;
+        info.name = record.name;
+        info.author = record.author;
+        info.category = record.category;
+        info.contentHash = record.hash;
+        presets_.push_back(std::move(info));
+    }
+
+    const auto& stats = index.stats();
+    LOG_INFO("Scanned {} presets from {} ({} dirs listed, {} from index)",
+             presets_.size(),
+             directory.string(),
+             stats.dirsListed,
+             stats.dirsReused);
+}
+
+void PresetManager::collapseDuplicates() {
+    // Path order makes the surviving entry the same on every scan
+    std::sort(presets_.begin(),
+              presets_.end(),
+              [](const auto& a, const auto& b) { return a.path < b.path; });
+
+    std::unordered_map<u64, usize> firstWithHash; // Into the kept prefix
+    firstWithHash.reserve(presets_.size());
+    usize kept = 0;
+    for (usize i = 0; i < presets_.size(); ++i) {
+        u64 hash = presets_[i].contentHash;
+        if (hash != 0) { // 0: couldn't be read, never a duplicate
+            auto [first, added] = firstWithHash.try_emplace(hash, kept);
+            if (!added) {
+                presets_[first->second].aliases.push_back(
+                        std::move(presets_[i].path));
+                continue;
+            }
+        }
+        if (kept != i)
+            presets_[kept] = std::move(presets_[i]);
+        ++kept;
+    }
+    duplicates_ = presets_.size() - kept;
+    presets_.resize(kept);
+
+    if (duplicates_ > 0)
+        LOG_INFO("Folded {} duplicate presets into aliases", duplicates_);
+}
+
+bool PresetManager::listedUnder(const std::set<std::string>& names,
+                                const PresetInfo& info) {
+    if (names.contains(info.name))
+        return true;
+    for (const auto& alias : info.aliases) {
+        if (names.contains(alias.stem().string()))
+            return true;
+    }
+    return false;
+}
+
+void PresetManager::forget(std::set<std::string>& names,
+                           const PresetInfo& info) {
+    names.erase(info.name);
+    for (const auto& alias : info.aliases)
+        names.erase(alias.stem().string());
+}
+
 void PresetManager::rescan() {
     if (!scanDirectory_.empty()) {
-        scan(scanDirectory_);
+        scan(scanDirectory_, scanRecursive_);
     }
 }
 
 void PresetManager::clear() {
+    searchIndex_.clear();
     presets_.clear();
+    plannedIndex_.reset();
+    smartRotation_.invalidate();
     currentIndex_ = 0;
     listChanged.emitSignal();
 }
@@ -108,14 +231,6 @@ std::vector<const PresetInfo*> PresetManager::favoritePresets() const {
     return result;
 }
 
-std::vector<std::string> PresetManager::categories() const {
-    std::set<std::string> cats;
-    for (const auto& p : presets_) {
-        cats.insert(p.category);
-    }
-    return {cats.begin(), cats.end()};
-}
-
 const PresetInfo* PresetManager::current() const {
     if (currentIndex_ >= presets_.size())
         return nullptr;
@@ -145,6 +260,7 @@ bool PresetManager::selectByIndex(usize index) {
             historyPosition_--;
         }
     }
+    smartRotation_.noteShown(index);
 
     currentIndex_ = index;
     presets_[currentIndex_].playCount++;
@@ -155,85 +271,59 @@ bool PresetManager::selectByIndex(usize index) {
 }
 
 bool PresetManager::selectByName(const std::string& name) {
-    LOG_INFO("PresetManager::selectByName: searching for '{}'", name);
-    LOG_INFO("  Total presets: {}", presets_.size());
-
     // If no presets loaded yet, store as pending
     if (presets_.empty()) {
-        LOG_INFO("  No presets loaded yet, storing as pending preset");
+        LOG_INFO("PresetManager: no presets yet, '{}' is pending", name);
         pendingPresetName_ = name;
         return false;
     }
 
-    // First try exact match
-    for (usize i = 0; i < presets_.size(); ++i) {
-        LOG_DEBUG("  Checking preset {}: '{}'", i, presets_[i].name);
-        if (presets_[i].name == name && !presets_[i].blacklisted) {
-            LOG_INFO("  FOUND at index {}, calling selectByIndex", i);
-            return selectByIndex(i);
-        }
-    }
-
-    // If no exact match, try partial match (contains)
-    LOG_INFO("  No exact match, trying partial match");
-    for (usize i = 0; i < presets_.size(); ++i) {
-        if (presets_[i].blacklisted)
-            continue;
-
-        // Check if preset name contains the search string
-        if (presets_[i].name.find(name) != std::string::npos) {
-            LOG_INFO("  FOUND partial match at index {}: '{}'",
-                     i,
-                     presets_[i].name);
-            return selectByIndex(i);
+    // Exact name first; same-named presets sit next to each other in the
+    // sorted list, and an alias's name finds the entry it was folded into
+    if (auto first = searchIndex_.findName(name)) {
+        for (usize i = *first; i < presets_.size() &&
+                               (i == *first || presets_[i].name == name);
+             ++i) {
+            if (!presets_[i].blacklisted)
+                return selectByIndex(i);
         }
     }
 
-    // If still no match, try case-insensitive partial match
-    LOG_INFO("  No partial match, trying case-insensitive");
-    std::string lowerName = name;
-    std::transform(
-            lowerName.begin(), lowerName.end(), lowerName.begin(), ::tolower);
-
-    for (usize i = 0; i < presets_.size(); ++i) {
-        if (presets_[i].blacklisted)
-            continue;
-
-        std::string lowerPreset = presets_[i].name;
-        std::transform(lowerPreset.begin(),
-                       lowerPreset.end(),
-                       lowerPreset.begin(),
-                       ::tolower);
-
-        if (lowerPreset.find(lowerName) != std::string::npos) {
-            LOG_INFO("  FOUND case-insensitive match at index {}: '{}'",
-                     i,
+    // Then the best-ranked substring match (never a fuzzy guess)
+    for (usize i : searchIndex_.search(name, false)) {
+        if (!presets_[i].blacklisted) {
+            LOG_INFO("PresetManager: '{}' matched '{}'",
+                     name,
                      presets_[i].name);
             return selectByIndex(i);
         }
     }
 
-    LOG_WARN("  PRESET NOT FOUND: '{}'", name);
+    LOG_WARN("PresetManager: preset not found: '{}'", name);
     return false;
 }
 
 bool PresetManager::selectByPath(const fs::path& path) {
-    LOG_DEBUG("PresetManager::selectByPath: {}", path.string());
-    for (usize i = 0; i < presets_.size(); ++i) {
-        if (presets_[i].path == path && !presets_[i].blacklisted) {
-            LOG_DEBUG(
-                    "PresetManager: Found preset at index {}, calling "
-                    "selectByIndex",
-                    i);
-            return selectByIndex(i);
-        }
-    }
+    auto index = searchIndex_.findPath(path);
+    if (index && !presets_[*index].blacklisted)
+        return selectByIndex(*index);
     LOG_WARN("PresetManager: Could not find preset by path: {}", path.string());
     return false;
 }
 
 bool PresetManager::selectRandom() {
-    auto active = activePresets();
+    if (plannedIndex_) {
+        usize index = *plannedIndex_;
+        plannedIndex_.reset();
+        if (index < presets_.size() && inRotation(presets_[index]))
+            return selectByIndex(index);
+    }
+
+    std::vector<const PresetInfo*> active;
+    for (const auto& p : presets_) {
+        if (inRotation(p))
+            active.push_back(&p);
+    }
     if (active.empty())
         return false;
 
@@ -249,6 +339,54 @@ bool PresetManager::selectRandom() {
     return false;
 }
 
+const PresetInfo* PresetManager::planNext(bool shuffle) {
+    if (presets_.empty())
+        return nullptr;
+
+    if (shuffle) {
+        if (!plannedIndex_ || *plannedIndex_ >= presets_.size() ||
+            !inRotation(presets_[*plannedIndex_])) {
+            plannedIndex_.reset();
+            std::vector<usize> candidates;
+            for (usize i = 0; i < presets_.size(); ++i) {
+                if (inRotation(presets_[i]))
+                    candidates.push_back(i);
+            }
+            if (candidates.empty())
+                return nullptr;
+            std::uniform_int_distribution<usize> dist(0, candidates.size() - 1);
+            plannedIndex_ = candidates[dist(rng_)];
+        }
+        return &presets_[*plannedIndex_];
+    }
+
+    // Mirrors selectNext() without touching any state
+    if (!history_.empty() && historyPosition_ < history_.size() - 1)
+        return &presets_[history_[historyPosition_ + 1]];
+    if (history_.empty())
+        return presets_[0].blacklisted ? nullptr : &presets_[0];
+
+    const std::string& currentName = presets_[currentIndex_].name;
+    for (usize step = 1; step < presets_.size(); ++step) {
+        const auto& info = presets_[(currentIndex_ + step) % presets_.size()];
+        if (inRotation(info) && info.name != currentName)
+            return &info;
+    }
+    return nullptr;
+}
+
+const PresetInfo* PresetManager::planSmart(const AudioFeatures& features) {
+    smartRotation_.update(presets_);
+    auto index = smartRotation_.pick(
+            features,
+            [this](usize i) { return inRotation(presets_[i]); },
+            rng_);
+    if (!index)
+        return planNext(true);
+    plannedIndex_ = *index;
+    return &presets_[*index];
+}
+
 bool PresetManager::selectNext() {
     LOG_DEBUG("PresetManager::selectNext() called, current index: {}",
               currentIndex_);
@@ -277,7 +415,7 @@ bool PresetManager::selectNext() {
     usize start = currentIndex_;
     do {
         currentIndex_ = (currentIndex_ + 1) % presets_.size();
-        if (!presets_[currentIndex_].blacklisted) {
+        if (inRotation(presets_[currentIndex_])) {
             // Skip presets with the same name as current
             if (presets_[currentIndex_].name == currentName) {
                 continue;
@@ -311,7 +449,7 @@ bool PresetManager::selectPrevious() {
     do {
         currentIndex_ =
                 (currentIndex_ == 0) ? presets_.size() - 1 : currentIndex_ - 1;
-        if (!presets_[currentIndex_].blacklisted) {
+        if (inRotation(presets_[currentIndex_])) {
             // Skip presets with the same name as current
             if (presets_[currentIndex_].name == currentName) {
                 continue;
@@ -331,7 +469,7 @@ void PresetManager::setFavorite(usize index, bool favorite) {
     if (favorite) {
         favoriteNames_.insert(presets_[index].name);
     } else {
-        favoriteNames_.erase(presets_[index].name);
+        forget(favoriteNames_, presets_[index]);
     }
     listChanged.emitSignal();
 }
@@ -344,8 +482,9 @@ void PresetManager::setBlacklisted(usize index, bool blacklisted) {
     if (blacklisted) {
         blacklistedNames_.insert(presets_[index].name);
     } else {
-        blacklistedNames_.erase(presets_[index].name);
+        forget(blacklistedNames_, presets_[index]);
     }
+    updateQuarantineActive();
     listChanged.emitSignal();
 }
 
@@ -361,56 +500,74 @@ void PresetManager::toggleBlacklisted(usize index) {
     setBlacklisted(index, !presets_[index].blacklisted);
 }
 
-std::vector<const PresetInfo*> PresetManager::search(
-        const std::string& query) const {
-    std::vector<const PresetInfo*> result;
-
-    std::string lowerQuery = query;
-    std::transform(lowerQuery.begin(),
-                   lowerQuery.end(),
-                   lowerQuery.begin(),
-                   ::tolower);
-
-    for (const auto& p : presets_) {
-        std::string lowerName = p.name;
-        std::transform(lowerName.begin(),
-                       lowerName.end(),
-                       lowerName.begin(),
-                       ::tolower);
+void PresetManager::setQuarantined(const std::set<std::string>& names) {
+    quarantinedNames_ = names;
+    for (auto& p : presets_)
+        p.quarantined = listedUnder(quarantinedNames_, p);
+    updateQuarantineActive();
+}
 
-        if (lowerName.find(lowerQuery) != std::string::npos) {
-            result.push_back(&p);
+bool PresetManager::setQuarantined(const std::string& name, bool quarantined) {
+    bool listed = quarantinedNames_.contains(name);
+    if (listed == quarantined)
+        return false;
+    if (quarantined)
+        quarantinedNames_.insert(name);
+    else
+        quarantinedNames_.erase(name);
+
+    // Entries with this name are adjacent; an alias answers for one entry
+    if (auto first = searchIndex_.findName(name)) {
+        for (usize i = *first; i < presets_.size(); ++i) {
+            auto& p = presets_[i];
+            if (i != *first && p.name != name)
+                break;
+            p.quarantined = listedUnder(quarantinedNames_, p);
         }
     }
+    updateQuarantineActive();
+    return true;
+}
+
+usize PresetManager::quarantinedCount() const {
+    return std::count_if(presets_.begin(), presets_.end(), [](const auto& p) {
+        return p.quarantined && !p.blacklisted;
+    });
+}
+
+bool PresetManager::inRotation(const PresetInfo& info) const {
+    return !info.blacklisted && !(info.quarantined && quarantineActive_);
+}
 
+void PresetManager::updateQuarantineActive() {
+    quarantineActive_ = std::any_of(
+            presets_.begin(), presets_.end(), [](const PresetInfo& p) {
+                return !p.blacklisted && !p.quarantined;
+            });
+}
+
+std::vector<const PresetInfo*> PresetManager::search(
+        const std::string& query) const {
+    std::vector<const PresetInfo*> result;
+    for (usize index : searchIndex_.search(query))
+        result.push_back(&presets_[index]);
     return result;
 }
 
 std::vector<const PresetInfo*> PresetManager::byCategory(
         const std::string& category) const {
     std::vector<const PresetInfo*> result;
+    auto id = searchIndex_.categoryId(category);
+    if (!id)
+        return result;
     for (const auto& p : presets_) {
-        if (p.category == category && !p.blacklisted) {
+        if (p.categoryId == *id && !p.blacklisted) {
             result.push_back(&p);
         }
     }
     return result;
 }
 
-void PresetManager::parsePresetInfo(PresetInfo& info) {
-    // Try to extract author from filename pattern "Author - Name"
-    std::regex authorPattern(R"(^(.+?)\s*-\s*(.+)$)");
-    std::smatch match;
-
-    if (std::regex_match(info.name, match, authorPattern)) {
-        info.author = match[1].str();
-        // Keep full name for display
-    }
-
-    // Could also parse the actual preset file here for metadata
-    // but most presets don't have standardized metadata
-}
-
 Result<void> PresetManager::loadState(const fs::path& path) {
     std::ifstream file(path);
     if (!file) {
@@ -435,11 +592,12 @@ Result<void> PresetManager::loadState(const fs::path& path) {
         }
     }
 
-    // Apply to loaded presets
+    // Apply to loaded presets, under any of their names like scan() does
     for (auto& p : presets_) {
-        p.favorite = favoriteNames_.contains(p.name);
-        p.blacklisted = blacklistedNames_.contains(p.name);
+        p.favorite = listedUnder(favoriteNames_, p);
+        p.blacklisted = listedUnder(blacklistedNames_, p);
     }
+    updateQuarantineActive();
 
     return Result<void>::ok();
 }
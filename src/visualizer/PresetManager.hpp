@@ -2,9 +2,14 @@
 // PresetManager.hpp - ProjectM preset management
 // Because manually browsing .milk files is for peasants
 
+#include <memory>
+#include <optional>
 #include <random>
 #include <set>
 #include <vector>
+#include "PresetPack.hpp"
+#include "PresetSearchIndex.hpp"
+#include "SmartRotation.hpp"
 #include "util/Result.hpp"
 #include "util/Signal.hpp"
 #include "util/Types.hpp"
@@ -16,16 +21,32 @@ struct PresetInfo {
     std::string name;
     std::string author;
     std::string category; // Parent folder name
+    u32 categoryId{0};    // Index into PresetManager::categories()
     bool favorite{false};
     bool blacklisted{false};
+    bool quarantined{false}; // Over the GPU budget, skipped by rotation
     u32 playCount{0};
+    u64 contentHash{0}; // PresetIndex::hashPreset() of the file
+    std::vector<fs::path> aliases; // Same content under other paths
 };
 
 class PresetManager {
 public:
     PresetManager();
 
-    // Scanning
+    // Scanning. With an index path set, scan() maps the previous index and
+    // only lists directories that changed since. A .cvpk PresetPack can be
+    // scanned in place of a directory; its presets get virtual paths, so
+    // read them with readPresetText(pack().get(), path).
+    //
+    // Presets with the same content hash are listed once, under the first
+    // path in sort order, with the rest as aliases. Rotation, search and
+    // play counts only ever see that one entry; its alias paths still
+    // resolve to it, and favorite or blacklist state saved under any of
+    // its names applies to it.
+    void setIndexPath(const fs::path& path) {
+        indexPath_ = path;
+    }
     Result<void> scan(const fs::path& directory, bool recursive = true);
     void rescan();
     void clear();
@@ -34,6 +55,9 @@ public:
     usize count() const {
         return presets_.size();
     }
+    usize duplicateCount() const {
+        return duplicates_;
+    }
     usize activeCount() const; // Excludes blacklisted
     bool empty() const {
         return presets_.empty();
@@ -44,7 +68,22 @@ public:
     }
     std::vector<const PresetInfo*> activePresets() const;
     std::vector<const PresetInfo*> favoritePresets() const;
-    std::vector<std::string> categories() const;
+    const std::vector<std::string>& categories() const {
+        return searchIndex_.categories();
+    }
+    std::optional<usize> indexOfPath(const fs::path& path) const {
+        return searchIndex_.findPath(path);
+    }
+    // Every directory under the scan root (for the file watcher); for a
+    // pack, the directory it lives in, so rebuilding it triggers a rescan
+    const std::vector<fs::path>& directories() const {
+        return indexedDirs_;
+    }
+    // Open pack, if the scan root is one. Shared so reader threads can keep
+    // it mapped across a rescan.
+    std::shared_ptr<const PresetPack> pack() const {
+        return pack_;
+    }
 
     // Selection
     const PresetInfo* current() const;
@@ -59,6 +98,14 @@ public:
     bool selectNext();
     bool selectPrevious();
 
+    // Look-ahead for rotation: what the next selectRandom() (shuffle) or
+    // selectNext() will pick. A shuffle pick is drawn now and honoured
+    // later, so the caller can preload it. Nothing is emitted.
+    const PresetInfo* planNext(bool shuffle);
+    // Same, but drawn by SmartRotation to suit `features`; falls back to a
+    // plain shuffle pick when nothing suitable is left
+    const PresetInfo* planSmart(const AudioFeatures& features);
+
     // Pending preset (for command-line args before scanning)
     void setPendingPreset(const std::string& name) {
         pendingPresetName_ = name;
@@ -76,7 +123,15 @@ public:
     void toggleFavorite(usize index);
     void toggleBlacklisted(usize index);
 
-    // Search
+    // GPU-cost quarantine (names from PresetProfiler). Quarantined presets
+    // can still be picked by hand but random/next/previous skip them,
+    // unless that would leave nothing to rotate through.
+    void setQuarantined(const std::set<std::string>& names);
+    // Just this name; returns whether anything changed
+    bool setQuarantined(const std::string& name, bool quarantined);
+    usize quarantinedCount() const;
+
+    // Search (ranked, case-insensitive, typo tolerant; see PresetSearchIndex)
     std::vector<const PresetInfo*> search(const std::string& query) const;
     std::vector<const PresetInfo*> byCategory(
             const std::string& category) const;
@@ -90,17 +145,36 @@ public:
     Signal<> listChanged;
 
 private:
-    void parsePresetInfo(PresetInfo& info);
+    // Fill presets_ (unsorted, saved state not applied) from either source
+    void listPack(std::shared_ptr<const PresetPack> pack);
+    void listDirectory(const fs::path& directory, bool recursive);
+    void collapseDuplicates();
+    // Saved state is by name, and an entry answers to its aliases' names
+    static bool listedUnder(const std::set<std::string>& names,
+                            const PresetInfo& info);
+    static void forget(std::set<std::string>& names, const PresetInfo& info);
+    bool inRotation(const PresetInfo& info) const;
+    void updateQuarantineActive();
 
     std::vector<PresetInfo> presets_;
+    PresetSearchIndex searchIndex_; // Rebuilt whenever presets_ changes
     usize currentIndex_{0};
     fs::path scanDirectory_;
+    bool scanRecursive_{true};
+    fs::path indexPath_;
+    std::vector<fs::path> indexedDirs_;
+    usize duplicates_{0}; // Folded into aliases by the last scan
+    std::shared_ptr<const PresetPack> pack_;
 
     std::vector<usize> history_;
     usize historyPosition_{0};
+    std::optional<usize> plannedIndex_; // Drawn by planNext(true)
+    SmartRotation smartRotation_;
 
     std::set<std::string> favoriteNames_;
     std::set<std::string> blacklistedNames_;
+    std::set<std::string> quarantinedNames_;
+    bool quarantineActive_{false}; // False if it would exclude everything
     std::string pendingPresetName_; // Preset requested before scanning
 
     std::mt19937 rng_{std::random_device{}()};
@@ -0,0 +1,387 @@
+#include "PresetPack.hpp"
+#include "PresetIndex.hpp"
+#include "core/Logger.hpp"
+#include "util/FileUtils.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <unordered_set>
+
+#ifdef CHADVIS_HAVE_ZSTD
+#include <zdict.h>
+#include <zstd.h>
+#endif
+
+namespace vc {
+
+namespace {
+
+constexpr char MAGIC[4] = {'C', 'V', 'P', 'K'};
+
+#ifdef CHADVIS_HAVE_ZSTD
+constexpr int COMPRESSION_LEVEL = 19; // Built once, read forever
+constexpr usize DICTIONARY_SIZE = 112 * 1024;
+constexpr usize MIN_DICTIONARY_SAMPLES = 64;
+#endif
+
+struct Source {
+    std::string path; // Relative, '/' separated
+    std::string name;
+    std::string author;
+    std::string category;
+    std::string body;
+    u64 hash{0};
+};
+
+} // namespace
+
+PresetPack::~PresetPack() {
+    close();
+}
+
+bool PresetPack::isPack(const fs::path& path) {
+    auto ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext == EXTENSION;
+}
+
+Result<PresetPack::BuildStats> PresetPack::build(const fs::path& sourceDir,
+                                                 const fs::path& packFile,
+                                                 bool compress) {
+    if (!fs::is_directory(sourceDir))
+        return Result<BuildStats>::err("Not a preset directory: " +
+                                       sourceDir.string());
+
+    auto files = file::listFiles(sourceDir, file::presetExtensions, true);
+    std::sort(files.begin(), files.end());
+
+    BuildStats stats;
+    std::vector<Source> sources;
+    sources.reserve(files.size());
+    for (const auto& file : files) {
+        auto text = file::readText(file);
+        if (!text) {
+            LOG_WARN("PresetPack: skipping {}", text.error().message);
+            continue;
+        }
+        if (text->size() > std::numeric_limits<u32>::max())
+            continue;
+        Source s;
+        s.path = file.lexically_relative(sourceDir).generic_string();
+        s.name = file.stem().string();
+        s.author = PresetIndex::parseAuthor(s.name);
+        // Same categories as a directory scan would produce
+        s.category = file.parent_path() == sourceDir
+                             ? "Uncategorized"
+                             : file.parent_path()
+                                       .lexically_relative(sourceDir)
+                                       .string();
+        s.body = std::move(*text);
+        s.hash = PresetIndex::hashPreset(s.body);
+        stats.inputBytes += s.body.size();
+        sources.push_back(std::move(s));
+    }
+
+    std::string strings(1, '\0'); // Offset 0 is the empty string
+    std::unordered_map<std::string, u32> interned;
+    auto intern = [&](const std::string& s) -> u32 {
+        if (s.empty())
+            return 0;
+        auto [it, added] =
+                interned.try_emplace(s, static_cast<u32>(strings.size()));
+        if (added) {
+            strings.append(s);
+            strings.push_back('\0');
+        }
+        return it->second;
+    };
+
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.count = static_cast<u32>(sources.size());
+
+    std::string data;
+    std::vector<Entry> entries;
+    entries.reserve(sources.size());
+
+#ifdef CHADVIS_HAVE_ZSTD
+    // Presets are a few KB of very similar text: far too little for zstd to
+    // learn from one at a time, plenty to train a shared dictionary on
+    std::unique_ptr<ZSTD_CCtx, decltype(&ZSTD_freeCCtx)> cctx(
+            compress ? ZSTD_createCCtx() : nullptr, ZSTD_freeCCtx);
+    std::unique_ptr<ZSTD_CDict, decltype(&ZSTD_freeCDict)> cdict(
+            nullptr, ZSTD_freeCDict);
+    if (compress && sources.size() >= MIN_DICTIONARY_SAMPLES) {
+        std::string samples;
+        std::vector<size_t> sizes;
+        std::unordered_set<u64> sampled; // Duplicates would skew it
+        for (const auto& s : sources) {
+            if (!sampled.insert(s.hash).second)
+                continue;
+            samples.append(s.body);
+            sizes.push_back(s.body.size());
+        }
+        std::string dict(DICTIONARY_SIZE, '\0');
+        size_t dictSize = ZDICT_trainFromBuffer(dict.data(),
+                                                dict.size(),
+                                                samples.data(),
+                                                sizes.data(),
+                                                static_cast<u32>(sizes.size()));
+        if (ZDICT_isError(dictSize)) {
+            LOG_WARN("PresetPack: no dictionary ({})",
+                     ZDICT_getErrorName(dictSize));
+        } else {
+            header.flags |= FLAG_DICTIONARY;
+            header.dictOffset = 0;
+            header.dictSize = dictSize;
+            data.append(dict.data(), dictSize);
+            cdict.reset(ZSTD_createCDict(
+                    dict.data(), dictSize, COMPRESSION_LEVEL));
+        }
+    }
+#else
+    if (compress)
+        LOG_WARN("PresetPack: built without zstd, writing an uncompressed "
+                 "pack");
+#endif
+
+    std::unordered_map<u64, usize> firstWithHash; // Into entries
+    for (const auto& s : sources) {
+        Entry e{};
+        e.path = intern(s.path);
+        e.name = intern(s.name);
+        e.author = intern(s.author);
+        e.category = intern(s.category);
+        e.offset = data.size();
+        e.size = static_cast<u32>(s.body.size());
+        e.hash = s.hash;
+
+        // Same preset under another name: point at the body already stored
+        auto [first, added] = firstWithHash.try_emplace(s.hash, entries.size());
+        if (!added) {
+            const Entry& original = entries[first->second];
+            e.offset = original.offset;
+            e.storedSize = original.storedSize;
+            e.size = original.size;
+            e.flags = original.flags;
+            entries.push_back(e);
+            ++stats.duplicates;
+            continue;
+        }
+
+        bool stored = false;
+#ifdef CHADVIS_HAVE_ZSTD
+        if (cctx) {
+            std::string packed(ZSTD_compressBound(s.body.size()), '\0');
+            size_t n = cdict ? ZSTD_compress_usingCDict(cctx.get(),
+                                                        packed.data(),
+                                                        packed.size(),
+                                                        s.body.data(),
+                                                        s.body.size(),
+                                                        cdict.get())
+                             : ZSTD_compressCCtx(cctx.get(),
+                                                 packed.data(),
+                                                 packed.size(),
+                                                 s.body.data(),
+                                                 s.body.size(),
+                                                 COMPRESSION_LEVEL);
+            if (!ZSTD_isError(n) && n < s.body.size()) {
+                data.append(packed.data(), n);
+                e.storedSize = static_cast<u32>(n);
+                e.flags = FLAG_ZSTD;
+                stored = true;
+                ++stats.compressed;
+            }
+        }
+#endif
+        if (!stored) {
+            data.append(s.body);
+            e.storedSize = e.size;
+        }
+        entries.push_back(e);
+    }
+
+    header.stringBytes = strings.size();
+    header.dataBytes = data.size();
+
+    std::string out;
+    out.reserve(sizeof(Header) + entries.size() * sizeof(Entry) +
+                strings.size() + data.size());
+    out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.append(reinterpret_cast<const char*>(entries.data()),
+               entries.size() * sizeof(Entry));
+    out.append(strings);
+    out.append(data);
+
+    if (packFile.has_parent_path()) {
+        if (auto result = file::ensureDir(packFile.parent_path()); !result)
+            return Result<BuildStats>::err(result.error().message);
+    }
+    if (auto result = file::writeText(packFile, out); !result)
+        return Result<BuildStats>::err(result.error().message);
+
+    stats.presets = sources.size();
+    stats.packBytes = out.size();
+    return Result<BuildStats>::ok(stats);
+}
+
+Result<void> PresetPack::open(const fs::path& packFile) {
+    close();
+
+    int fd = ::open(packFile.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return Result<void>::err("Failed to open preset pack: " +
+                                 packFile.string());
+
+    struct stat st{};
+    if (::fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(Header)) {
+        ::close(fd);
+        return Result<void>::err("Not a preset pack: " + packFile.string());
+    }
+
+    usize size = static_cast<usize>(st.st_size);
+    void* map = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED)
+        return Result<void>::err("Failed to map preset pack: " +
+                                 std::string(std::strerror(errno)));
+
+    map_ = map;
+    mapSize_ = size;
+    path_ = packFile;
+
+    const auto* base = static_cast<const u8*>(map);
+    const auto* header = reinterpret_cast<const Header*>(base);
+    u64 tableBytes = u64(header->count) * sizeof(Entry);
+    bool valid = std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) == 0 &&
+                 header->version == VERSION && header->stringBytes > 0 &&
+                 sizeof(Header) + tableBytes + header->stringBytes +
+                                 header->dataBytes ==
+                         size;
+
+    if (valid) {
+        header_ = header;
+        entries_ = reinterpret_cast<const Entry*>(base + sizeof(Header));
+        strings_ = reinterpret_cast<const char*>(entries_ + header->count);
+        data_ = reinterpret_cast<const u8*>(strings_ + header->stringBytes);
+        valid = strings_[header->stringBytes - 1] == '\0';
+    }
+    if (valid && (header->flags & FLAG_DICTIONARY)) {
+        valid = header->dictOffset + header->dictSize <= header->dataBytes;
+    }
+
+    // Offsets are trusted from here on, so check every one of them once
+    auto inStrings = [&](u32 offset) { return offset < header->stringBytes; };
+    for (u32 i = 0; valid && i < header->count; ++i) {
+        const auto& e = entries_[i];
+        valid = inStrings(e.path) && inStrings(e.name) &&
+                inStrings(e.author) && inStrings(e.category) &&
+                e.offset + e.storedSize <= header->dataBytes &&
+                ((e.flags & FLAG_ZSTD) || e.storedSize == e.size);
+    }
+
+    if (!valid) {
+        close();
+        return Result<void>::err("Damaged or incompatible preset pack: " +
+                                 packFile.string());
+    }
+
+    // The table is read in full right away; bodies are paged in on demand
+    ::madvise(map_, sizeof(Header) + tableBytes, MADV_WILLNEED);
+
+#ifdef CHADVIS_HAVE_ZSTD
+    if (header_->flags & FLAG_DICTIONARY) {
+        dictionary_ = ZSTD_createDDict(data_ + header_->dictOffset,
+                                       header_->dictSize);
+    }
+#endif
+
+    byPath_.reserve(header_->count);
+    for (u32 i = 0; i < header_->count; ++i)
+        byPath_.emplace(str(entries_[i].path), i);
+
+    LOG_DEBUG("PresetPack: mapped {} presets from {}",
+              header_->count,
+              packFile.string());
+    return Result<void>::ok();
+}
+
+void PresetPack::close() {
+#ifdef CHADVIS_HAVE_ZSTD
+    ZSTD_freeDDict(static_cast<ZSTD_DDict*>(dictionary_));
+#endif
+    dictionary_ = nullptr;
+    if (map_)
+        ::munmap(map_, mapSize_);
+    map_ = nullptr;
+    mapSize_ = 0;
+    header_ = nullptr;
+    entries_ = nullptr;
+    strings_ = nullptr;
+    data_ = nullptr;
+    byPath_.clear();
+    path_.clear();
+}
+
+std::optional<usize> PresetPack::find(const fs::path& path) const {
+    if (!isOpen())
+        return std::nullopt;
+    auto relative = path.lexically_relative(path_).generic_string();
+    auto it = byPath_.find(relative);
+    if (it == byPath_.end())
+        return std::nullopt;
+    return it->second;
+}
+
+Result<std::string> PresetPack::read(usize i) const {
+    if (i >= size())
+        return Result<std::string>::err("Preset pack index out of range");
+    const auto& e = entries_[i];
+    const char* stored = reinterpret_cast<const char*>(data_ + e.offset);
+    if (!(e.flags & FLAG_ZSTD))
+        return Result<std::string>::ok(std::string(stored, e.size));
+
+#ifdef CHADVIS_HAVE_ZSTD
+    thread_local std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)> dctx(
+            ZSTD_createDCtx(), ZSTD_freeDCtx);
+    std::string out(e.size, '\0');
+    const auto* dict = static_cast<const ZSTD_DDict*>(dictionary_);
+    size_t n = dict ? ZSTD_decompress_usingDDict(dctx.get(),
+                                                 out.data(),
+                                                 out.size(),
+                                                 stored,
+                                                 e.storedSize,
+                                                 dict)
+                    : ZSTD_decompressDCtx(dctx.get(),
+                                          out.data(),
+                                          out.size(),
+                                          stored,
+                                          e.storedSize);
+    if (ZSTD_isError(n) || n != e.size) {
+        return Result<std::string>::err("Corrupt preset in pack: " +
+                                        std::string(relativePath(i)));
+    }
+    return Result<std::string>::ok(std::move(out));
+#else
+    return Result<std::string>::err(
+            "Preset pack is compressed but zstd support is not built in");
+#endif
+}
+
+Result<std::string> readPresetText(const PresetPack* pack,
+                                   const fs::path& path) {
+    if (pack) {
+        if (auto index = pack->find(path))
+            return pack->read(*index);
+    }
+    return file::readText(path);
+}
+
+} // namespace vc
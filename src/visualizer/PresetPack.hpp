@@ -0,0 +1,136 @@
+#pragma once
+// PresetPack.hpp - Every preset in one memory-mapped file
+// Fifty thousand open() calls walked into a NAS. None of them came back.
+
+#include "util/Result.hpp"
+#include "util/Types.hpp"
+
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+
+namespace vc {
+
+// A .cvpk pack is built once from a preset directory by
+// `--build-preset-pack` and then used as visualizer.preset_path. Opening it
+// is one mmap; listing it reads the entry table; loading a preset is a
+// memcpy, or a zstd decompression if the pack was built compressed. The
+// filesystem is never asked about individual presets. Presets with the same
+// normalized content are stored once; their entries share a body.
+//
+// Presets in a pack get virtual paths, the pack's path joined with their
+// path inside it, so everything keyed by path (history, the search index,
+// favorites by path) works unchanged.
+class PresetPack {
+public:
+    static constexpr u32 VERSION = 2; // 2: hashes are hashPreset()
+    static constexpr std::string_view EXTENSION = ".cvpk";
+
+    struct BuildStats {
+        usize presets{0};
+        u64 inputBytes{0};
+        u64 packBytes{0};
+        usize compressed{0}; // Entries stored compressed
+        usize duplicates{0}; // Entries sharing an earlier entry's body
+    };
+
+    PresetPack() = default;
+    ~PresetPack();
+
+    PresetPack(const PresetPack&) = delete;
+    PresetPack& operator=(const PresetPack&) = delete;
+
+    static bool isPack(const fs::path& path);
+
+    // Packs every preset under `sourceDir`. `compress` needs zstd support;
+    // without it the pack is written uncompressed with a warning.
+    static Result<BuildStats> build(const fs::path& sourceDir,
+                                    const fs::path& packFile,
+                                    bool compress = true);
+
+    Result<void> open(const fs::path& packFile);
+    void close();
+    bool isOpen() const {
+        return map_ != nullptr;
+    }
+    const fs::path& path() const {
+        return path_;
+    }
+
+    usize size() const {
+        return header_ ? header_->count : 0;
+    }
+    std::string_view relativePath(usize i) const {
+        return str(entries_[i].path);
+    }
+    std::string_view name(usize i) const {
+        return str(entries_[i].name);
+    }
+    std::string_view author(usize i) const {
+        return str(entries_[i].author);
+    }
+    std::string_view category(usize i) const {
+        return str(entries_[i].category);
+    }
+    u64 hash(usize i) const {
+        return entries_[i].hash;
+    }
+    fs::path virtualPath(usize i) const {
+        return path_ / relativePath(i);
+    }
+
+    // Entry for a virtual path, if it points into this pack
+    std::optional<usize> find(const fs::path& path) const;
+
+    // Safe to call from any thread while the pack is open
+    Result<std::string> read(usize i) const;
+
+private:
+    // On-disk layout: Header, Entry[count], NUL-terminated strings, then
+    // the preset bodies (and the zstd dictionary, if any) back to back
+    struct Header {
+        char magic[4];
+        u32 version;
+        u32 flags; // FLAG_DICTIONARY
+        u32 count;
+        u64 stringBytes;
+        u64 dataBytes;
+        u64 dictOffset; // Into the data section
+        u64 dictSize;
+    };
+    struct Entry {
+        u32 path; // Relative to the pack, with '/' separators
+        u32 name;
+        u32 author;
+        u32 category;
+        u64 offset; // Into the data section
+        u32 storedSize;
+        u32 size;  // Uncompressed
+        u64 hash;  // PresetIndex::hashPreset() of the body
+        u32 flags; // FLAG_ZSTD
+        u32 reserved;
+    };
+    static constexpr u32 FLAG_DICTIONARY = 1;
+    static constexpr u32 FLAG_ZSTD = 1;
+
+    std::string_view str(u32 offset) const {
+        return strings_ + offset;
+    }
+
+    fs::path path_;
+    void* map_{nullptr};
+    usize mapSize_{0};
+    const Header* header_{nullptr};
+    const Entry* entries_{nullptr};
+    const char* strings_{nullptr};
+    const u8* data_{nullptr};
+    std::unordered_map<std::string_view, u32> byPath_; // Views into the map
+    void* dictionary_{nullptr}; // ZSTD_DDict, shared by every reader
+};
+
+// Preset source from the pack if `path` is one of its virtual paths,
+// otherwise from disk
+Result<std::string> readPresetText(const PresetPack* pack,
+                                   const fs::path& path);
+
+} // namespace vc
@@ -0,0 +1,102 @@
+#include "PresetPreloader.hpp"
+#include "core/Logger.hpp"
+
+#include <algorithm>
+
+namespace vc {
+
+PresetPreloader::PresetPreloader() = default;
+
+PresetPreloader::~PresetPreloader() {
+    stop();
+}
+
+void PresetPreloader::start() {
+    if (worker_.joinable())
+        return;
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = false;
+    }
+    worker_ = std::thread(&PresetPreloader::workerLoop, this);
+}
+
+void PresetPreloader::stop() {
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+        queue_.clear();
+    }
+    cond_.notify_all();
+    if (worker_.joinable())
+        worker_.join();
+}
+
+void PresetPreloader::setPack(std::shared_ptr<const PresetPack> pack) {
+    std::lock_guard lock(mutex_);
+    pack_ = std::move(pack);
+}
+
+void PresetPreloader::request(const fs::path& path) {
+    if (path.empty())
+        return;
+    {
+        std::lock_guard lock(mutex_);
+        if (find(path) != cache_.end() ||
+            std::find(queue_.begin(), queue_.end(), path) != queue_.end())
+            return;
+        queue_.push_back(path);
+    }
+    cond_.notify_one();
+}
+
+std::optional<std::string> PresetPreloader::take(const fs::path& path) {
+    std::lock_guard lock(mutex_);
+    auto it = find(path);
+    if (it == cache_.end())
+        return std::nullopt;
+    // Keep it around: "previous preset" is a very likely next request
+    cache_.splice(cache_.begin(), cache_, it);
+    return cache_.front().data;
+}
+
+bool PresetPreloader::isReady(const fs::path& path) const {
+    std::lock_guard lock(mutex_);
+    return std::any_of(cache_.begin(), cache_.end(), [&](const Entry& e) {
+        return e.path == path;
+    });
+}
+
+std::list<PresetPreloader::Entry>::iterator PresetPreloader::find(
+        const fs::path& path) {
+    return std::find_if(cache_.begin(), cache_.end(), [&](const Entry& e) {
+        return e.path == path;
+    });
+}
+
+void PresetPreloader::workerLoop() {
+    LOG_DEBUG("PresetPreloader: I/O thread started");
+    std::unique_lock lock(mutex_);
+    while (true) {
+        cond_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+        if (stopping_)
+            break;
+
+        fs::path path = std::move(queue_.front());
+        queue_.pop_front();
+        auto pack = pack_; // Stays mapped even if swapped meanwhile
+
+        lock.unlock();
+        auto text = readPresetText(pack.get(), path);
+        if (!text)
+            LOG_WARN("PresetPreloader: {}", text.error().message);
+        lock.lock();
+
+        cache_.push_front({std::move(path), text ? *text : std::string{}});
+        if (cache_.size() > CACHE_SIZE)
+            cache_.pop_back();
+    }
+    LOG_DEBUG("PresetPreloader: I/O thread stopped");
+}
+
+} // namespace vc
@@ -0,0 +1,67 @@
+#pragma once
+// PresetPreloader.hpp - Reads preset files on an I/O thread
+// The render loop has better things to do than wait on a disk
+
+#include "PresetPack.hpp"
+#include "util/Types.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+namespace vc {
+
+// Preset sources are small text files, so they are read whole and kept in a
+// short LRU cache. The render thread only ever polls (take() never blocks);
+// handing the text to projectM still has to happen on its GL context.
+class PresetPreloader {
+public:
+    static constexpr usize CACHE_SIZE = 8;
+
+    PresetPreloader();
+    ~PresetPreloader();
+
+    PresetPreloader(const PresetPreloader&) = delete;
+    PresetPreloader& operator=(const PresetPreloader&) = delete;
+
+    void start();
+    void stop();
+    bool isRunning() const {
+        return worker_.joinable();
+    }
+
+    // Reads of paths inside this pack come from the pack, not the disk
+    void setPack(std::shared_ptr<const PresetPack> pack);
+
+    // Queue a read. Cheap no-op if the file is cached or already queued.
+    void request(const fs::path& path);
+
+    // Contents if the read has finished, nullopt while still in flight.
+    // A failed read yields an empty string so callers can fall back.
+    std::optional<std::string> take(const fs::path& path);
+
+    bool isReady(const fs::path& path) const;
+
+private:
+    struct Entry {
+        fs::path path;
+        std::string data;
+    };
+
+    void workerLoop();
+    std::list<Entry>::iterator find(const fs::path& path);
+
+    std::thread worker_;
+    mutable std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque<fs::path> queue_;
+    std::list<Entry> cache_; // Most recently used first
+    std::shared_ptr<const PresetPack> pack_;
+    bool stopping_{false};
+};
+
+} // namespace vc
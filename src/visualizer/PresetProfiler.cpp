@@ -0,0 +1,189 @@
+#include "PresetProfiler.hpp"
+#include "core/Logger.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+namespace vc {
+
+Result<void> PresetProfiler::init() {
+    if (isAvailable())
+        return Result<void>::ok();
+    if (!GLEW_VERSION_3_3 && !GLEW_ARB_timer_query)
+        return Result<void>::err("GPU timer queries not supported");
+
+    for (auto& q : queries_) {
+        glGenQueries(1, &q.id);
+        q.pending = false;
+    }
+    next_ = 0;
+    open_ = nullptr;
+    return Result<void>::ok();
+}
+
+void PresetProfiler::destroy() {
+    if (open_) {
+        glEndQuery(GL_TIME_ELAPSED);
+        open_ = nullptr;
+    }
+    for (auto& q : queries_) {
+        if (q.id)
+            glDeleteQueries(1, &q.id);
+        q = Query{};
+    }
+}
+
+void PresetProfiler::beginPreset(const std::string& name,
+                                 f32 compileMs,
+                                 u32 warmupFrames) {
+    flush();
+    active_ = name;
+    ++generation_; // Results still in flight belong to the old preset
+    warmup_ = warmupFrames;
+    if (!name.empty())
+        costs_[name].compileMs = compileMs;
+}
+
+void PresetProfiler::flush() {
+    if (active_.empty() || session_.empty()) {
+        session_.clear();
+        return;
+    }
+
+    u64 n = session_.size();
+    f32 sum = 0.0f;
+    for (f32 v : session_)
+        sum += v;
+    f32 mean = sum / n;
+
+    auto p95It = session_.begin() + (n * 95) / 100;
+    std::nth_element(session_.begin(), p95It, session_.end());
+    f32 p95 = *p95It;
+    session_.clear();
+
+    // Sessions are merged by weight; the merged p95 is an approximation,
+    // which is plenty for a yes/no budget check. The weight is capped so
+    // driver updates or edited presets still move the numbers.
+    auto& cost = costs_[active_];
+    u64 total = cost.samples + n;
+    cost.meanMsPerMp = (cost.meanMsPerMp * cost.samples + mean * n) / total;
+    cost.p95MsPerMp = (cost.p95MsPerMp * cost.samples + p95 * n) / total;
+    cost.samples = std::min<u64>(total, 10 * MAX_SESSION_SAMPLES);
+}
+
+void PresetProfiler::beginFrame(u32 width, u32 height) {
+    if (!isAvailable())
+        return;
+    collect();
+
+    Query& q = queries_[next_];
+    if (q.pending || active_.empty() || width == 0 || height == 0)
+        return;
+
+    glBeginQuery(GL_TIME_ELAPSED, q.id);
+    q.pixels = width * height;
+    q.generation = generation_;
+    open_ = &q;
+    next_ = (next_ + 1) % QUERY_COUNT;
+}
+
+void PresetProfiler::endFrame() {
+    if (!open_)
+        return;
+    glEndQuery(GL_TIME_ELAPSED);
+    open_->pending = true;
+    open_ = nullptr;
+}
+
+void PresetProfiler::collect() {
+    for (auto& q : queries_) {
+        if (!q.pending)
+            continue;
+        GLint available = 0;
+        glGetQueryObjectiv(q.id, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            continue;
+
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(q.id, GL_QUERY_RESULT, &ns);
+        q.pending = false;
+
+        if (q.generation != generation_)
+            continue;
+        if (warmup_ > 0) {
+            --warmup_;
+            continue;
+        }
+        if (session_.size() < MAX_SESSION_SAMPLES) {
+            f32 ms = static_cast<f32>(ns) / 1e6f;
+            session_.push_back(ms / (static_cast<f32>(q.pixels) / 1e6f));
+        }
+    }
+}
+
+const PresetCost* PresetProfiler::cost(const std::string& name) const {
+    auto it = costs_.find(name);
+    return it != costs_.end() ? &it->second : nullptr;
+}
+
+std::set<std::string> PresetProfiler::overBudget(f32 budgetMs,
+                                                 u32 width,
+                                                 u32 height) const {
+    std::set<std::string> names;
+    if (budgetMs <= 0.0f)
+        return names;
+    for (const auto& [name, cost] : costs_) {
+        if (cost.samples >= MIN_SAMPLES && cost.p95At(width, height) > budgetMs)
+            names.insert(name);
+    }
+    return names;
+}
+
+bool PresetProfiler::overBudget(const std::string& name,
+                                f32 budgetMs,
+                                u32 width,
+                                u32 height) const {
+    const auto* c = cost(name);
+    return budgetMs > 0.0f && c && c->samples >= MIN_SAMPLES &&
+           c->p95At(width, height) > budgetMs;
+}
+
+Result<void> PresetProfiler::load(const fs::path& path) {
+    std::ifstream file(path);
+    if (!file)
+        return Result<void>::ok(); // Nothing measured yet
+
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        auto tab = line.find('\t');
+        if (tab == std::string::npos)
+            continue;
+
+        PresetCost cost;
+        std::istringstream fields(line.substr(tab + 1));
+        if (fields >> cost.samples >> cost.meanMsPerMp >> cost.p95MsPerMp >>
+            cost.compileMs) {
+            costs_[line.substr(0, tab)] = cost;
+        }
+    }
+    LOG_DEBUG("PresetProfiler: loaded costs for {} presets", costs_.size());
+    return Result<void>::ok();
+}
+
+Result<void> PresetProfiler::save(const fs::path& path) const {
+    std::ofstream file(path);
+    if (!file)
+        return Result<void>::err("Failed to open file for writing");
+
+    file << "# name\tsamples\tmean_ms_per_mp\tp95_ms_per_mp\tcompile_ms\n";
+    for (const auto& [name, cost] : costs_) {
+        file << name << '\t' << cost.samples << '\t' << cost.meanMsPerMp
+             << '\t' << cost.p95MsPerMp << '\t' << cost.compileMs << '\n';
+    }
+    return Result<void>::ok();
+}
+
+} // namespace vc
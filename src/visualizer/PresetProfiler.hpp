@@ -0,0 +1,100 @@
+#pragma once
+// PresetProfiler.hpp - Per-preset GPU cost from timer queries
+// Some presets are art. Some are a space heater with a waveform.
+
+#include "util/GLIncludes.hpp"
+#include "util/Result.hpp"
+#include "util/Types.hpp"
+
+#include <array>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+namespace vc {
+
+// Frame costs are stored per megapixel so numbers measured in a small
+// window still predict what the preset does at 4K; milk presets are almost
+// entirely fill-bound, so this scales close enough to linear.
+struct PresetCost {
+    u64 samples{0};
+    f32 meanMsPerMp{0.0f};
+    f32 p95MsPerMp{0.0f};
+    f32 compileMs{0.0f}; // Wall time of the last load (parse + shaders)
+
+    f32 p95At(u32 width, u32 height) const {
+        return p95MsPerMp * static_cast<f32>(width) * height / 1e6f;
+    }
+};
+
+// GL_TIME_ELAPSED queries wrapped around projectM's render call. A small
+// ring keeps a few frames in flight so reading results never stalls the
+// pipeline; a frame whose slot is still busy simply goes unmeasured.
+class PresetProfiler {
+public:
+    static constexpr usize QUERY_COUNT = 4;
+    static constexpr usize MAX_SESSION_SAMPLES = 4096;
+    static constexpr u64 MIN_SAMPLES = 120; // Before a verdict is trusted
+
+    PresetProfiler() = default;
+    ~PresetProfiler() = default;
+
+    PresetProfiler(const PresetProfiler&) = delete;
+    PresetProfiler& operator=(const PresetProfiler&) = delete;
+
+    // GL context must be current
+    Result<void> init();
+    void destroy();
+    bool isAvailable() const {
+        return queries_[0].id != 0;
+    }
+
+    // A new preset is on screen. Folds the previous one's samples into its
+    // stats. Transition frames render both presets, so the first
+    // `warmupFrames` are not attributed to anyone.
+    void beginPreset(const std::string& name, f32 compileMs, u32 warmupFrames);
+    void flush();
+    // The preset being measured, empty for none
+    const std::string& activePreset() const {
+        return active_;
+    }
+
+    void beginFrame(u32 width, u32 height);
+    void endFrame();
+
+    const PresetCost* cost(const std::string& name) const;
+
+    // Presets whose p95 at this resolution exceeds the budget
+    std::set<std::string> overBudget(f32 budgetMs, u32 width, u32 height) const;
+    bool overBudget(const std::string& name,
+                    f32 budgetMs,
+                    u32 width,
+                    u32 height) const;
+
+    // Persistence (tab separated, one preset per line)
+    Result<void> load(const fs::path& path);
+    Result<void> save(const fs::path& path) const;
+
+private:
+    struct Query {
+        GLuint id{0};
+        u32 pixels{0};
+        u32 generation{0};
+        bool pending{false};
+    };
+
+    void collect();
+
+    std::array<Query, QUERY_COUNT> queries_{};
+    usize next_{0};
+    Query* open_{nullptr};
+
+    std::string active_;
+    u32 generation_{0};
+    u32 warmup_{0};
+    std::vector<f32> session_; // ms per megapixel
+
+    std::unordered_map<std::string, PresetCost> costs_;
+};
+
+} // namespace vc
@@ -0,0 +1,208 @@
+#include "PresetSearchIndex.hpp"
+#include "PresetManager.hpp"
+
+#include <algorithm>
+#include <cctype>
+
+namespace vc {
+
+std::string PresetSearchIndex::lower(std::string_view s) {
+    std::string out(s);
+    for (auto& c : out)
+        c = static_cast<char>(std::tolower(static_cast<u8>(c)));
+    return out;
+}
+
+void PresetSearchIndex::build(std::vector<PresetInfo>& presets) {
+    clear();
+    presets_ = &presets;
+
+    lowerNames_.reserve(presets.size());
+    byName_.reserve(presets.size());
+    byPath_.reserve(presets.size());
+    for (usize i = 0; i < presets.size(); ++i) {
+        lowerNames_.push_back(lower(presets[i].name));
+        byName_.try_emplace(presets[i].name, i);
+        byPath_.try_emplace(presets[i].path.string(), i);
+        categories_.push_back(presets[i].category);
+    }
+    // Duplicates folded by PresetManager still answer to their own path
+    // and, for exact lookups, their own name
+    for (usize i = 0; i < presets.size(); ++i) {
+        for (const auto& alias : presets[i].aliases) {
+            byPath_.try_emplace(alias.string(), i);
+            byName_.try_emplace(aliasNames_.emplace_back(
+                                        alias.stem().string()),
+                                i);
+        }
+    }
+
+    std::sort(categories_.begin(), categories_.end());
+    categories_.erase(std::unique(categories_.begin(), categories_.end()),
+                      categories_.end());
+    categoryIds_.reserve(categories_.size());
+    for (u32 id = 0; id < categories_.size(); ++id)
+        categoryIds_.emplace(categories_[id], id);
+    for (auto& p : presets)
+        p.categoryId = categoryIds_.at(p.category);
+}
+
+void PresetSearchIndex::clear() {
+    lowerNames_.clear();
+    byName_.clear();
+    aliasNames_.clear();
+    byPath_.clear();
+    categories_.clear();
+    categoryIds_.clear();
+    presets_ = nullptr;
+    trigrams_.clear();
+    trigramsBuilt_ = false;
+}
+
+std::optional<usize> PresetSearchIndex::findName(std::string_view name) const {
+    auto it = byName_.find(name);
+    if (it == byName_.end())
+        return std::nullopt;
+    return it->second;
+}
+
+std::optional<usize> PresetSearchIndex::findPath(const fs::path& path) const {
+    auto it = byPath_.find(path.string());
+    if (it == byPath_.end())
+        return std::nullopt;
+    return it->second;
+}
+
+std::optional<u32> PresetSearchIndex::categoryId(
+        std::string_view category) const {
+    auto it = categoryIds_.find(category);
+    if (it == categoryIds_.end())
+        return std::nullopt;
+    return it->second;
+}
+
+void PresetSearchIndex::ensureTrigrams() const {
+    if (trigramsBuilt_.load(std::memory_order_acquire))
+        return;
+    std::lock_guard lock(trigramMutex_);
+    if (trigramsBuilt_.load(std::memory_order_relaxed))
+        return; // Another search built them while we waited
+    std::vector<u32> grams;
+    for (usize i = 0; i < lowerNames_.size(); ++i) {
+        const auto& name = lowerNames_[i];
+        grams.clear();
+        for (usize k = 0; k + 3 <= name.size(); ++k)
+            grams.push_back(trigram(name.data() + k));
+        std::sort(grams.begin(), grams.end());
+        grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+        for (u32 g : grams)
+            trigrams_[g].push_back(static_cast<u32>(i));
+    }
+    trigramsBuilt_.store(true, std::memory_order_release);
+}
+
+PresetSearchIndex::Tier PresetSearchIndex::classify(
+        usize index,
+        std::string_view query) const {
+    std::string_view name = lowerNames_[index];
+    if (name == query)
+        return Exact;
+
+    Tier best = Fuzzy;
+    for (usize pos = name.find(query); pos != std::string_view::npos;
+         pos = name.find(query, pos + 1)) {
+        if (pos == 0)
+            return Prefix;
+        if (!std::isalnum(static_cast<u8>(name[pos - 1])))
+            return WordStart;
+        best = Substring;
+    }
+    return best;
+}
+
+std::vector<usize> PresetSearchIndex::search(std::string_view query,
+                                             bool fuzzy) const {
+    std::vector<usize> result;
+    if (!presets_)
+        return result;
+
+    std::string q = lower(query);
+    if (q.empty()) {
+        result.resize(lowerNames_.size());
+        for (usize i = 0; i < result.size(); ++i)
+            result[i] = i;
+        return result;
+    }
+
+    struct Hit {
+        usize index;
+        Tier tier;
+        u16 shared; // Query trigrams present, for fuzzy ranking
+    };
+    std::vector<Hit> hits;
+
+    if (q.size() < 3) {
+        // Too short for trigrams; the lowered names are still precomputed
+        for (usize i = 0; i < lowerNames_.size(); ++i) {
+            Tier tier = classify(i, q);
+            if (tier != Fuzzy)
+                hits.push_back({i, tier, 0});
+        }
+    } else {
+        ensureTrigrams();
+
+        std::vector<u32> grams;
+        for (usize k = 0; k + 3 <= q.size(); ++k)
+            grams.push_back(trigram(q.data() + k));
+        std::sort(grams.begin(), grams.end());
+        grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+
+        // One counter per preset, per call, so searches don't share state
+        std::vector<u16> shares(lowerNames_.size(), 0);
+        std::vector<u32> touched;
+        for (u32 g : grams) {
+            auto it = trigrams_.find(g);
+            if (it == trigrams_.end())
+                continue;
+            for (u32 index : it->second) {
+                if (shares[index]++ == 0)
+                    touched.push_back(index);
+            }
+        }
+
+        // A substring match has every trigram; fuzzy needs 60% of them
+        u16 need = static_cast<u16>(std::min<usize>(grams.size(), 0xFFFF));
+        u16 fuzzyMin = static_cast<u16>(std::max(1, (need * 6 + 9) / 10));
+        std::vector<Hit> near;
+        for (u32 index : touched) {
+            u16 shared = shares[index];
+            Tier tier = shared == need ? classify(index, q) : Fuzzy;
+            if (tier != Fuzzy)
+                hits.push_back({index, tier, shared});
+            else if (fuzzy && need >= 2 && shared >= fuzzyMin)
+                near.push_back({index, tier, shared});
+        }
+        // Near misses are for typos, not for burying real matches in noise
+        if (hits.size() < FUZZY_FALLBACK)
+            hits.insert(hits.end(), near.begin(), near.end());
+    }
+
+    std::sort(hits.begin(), hits.end(), [this](const Hit& a, const Hit& b) {
+        if (a.tier != b.tier)
+            return a.tier < b.tier;
+        if (a.shared != b.shared)
+            return a.shared > b.shared;
+        usize la = lowerNames_[a.index].size();
+        usize lb = lowerNames_[b.index].size();
+        if (la != lb)
+            return la < lb;
+        return a.index < b.index;
+    });
+
+    result.reserve(hits.size());
+    for (const auto& hit : hits)
+        result.push_back(hit.index);
+    return result;
+}
+
+} // namespace vc
@@ -0,0 +1,78 @@
+#pragma once
+// PresetSearchIndex.hpp - Hash and trigram lookups over the preset list
+// Typing "fract" shouldn't lowercase fifty thousand strings. Twice.
+
+#include "util/Types.hpp"
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace vc {
+
+struct PresetInfo;
+
+// Built from PresetManager's sorted list and rebuilt whenever it changes;
+// results are indices into that list. Lowercased names are kept once. The
+// trigram postings are only built on the first search, so startup doesn't
+// pay for them. Const lookups and searches may run on several threads at
+// once; build() and clear() may not overlap with anything.
+class PresetSearchIndex {
+public:
+    static constexpr usize FUZZY_FALLBACK = 8;
+
+    // Assigns PresetInfo::categoryId while it is at it
+    void build(std::vector<PresetInfo>& presets);
+    void clear();
+
+    // First index with exactly this name (duplicates are adjacent)
+    std::optional<usize> findName(std::string_view name) const;
+    std::optional<usize> findPath(const fs::path& path) const;
+
+    // Case-insensitive, best first: exact, prefix, word start, substring.
+    // If that finds fewer than FUZZY_FALLBACK and `fuzzy` is set, names
+    // sharing most of the query's trigrams follow, so a typo still finds
+    // something. Ties go to the shorter name.
+    std::vector<usize> search(std::string_view query, bool fuzzy = true) const;
+    // Build the trigram postings now instead of on the first search
+    void prepare() const {
+        ensureTrigrams();
+    }
+
+    // Interned categories, sorted; PresetInfo::categoryId indexes this
+    const std::vector<std::string>& categories() const {
+        return categories_;
+    }
+    std::optional<u32> categoryId(std::string_view category) const;
+
+private:
+    enum Tier : u8 { Exact, Prefix, WordStart, Substring, Fuzzy };
+
+    static u32 trigram(const char* s) {
+        return (u32(u8(s[0])) << 16) | (u32(u8(s[1])) << 8) | u8(s[2]);
+    }
+    static std::string lower(std::string_view s);
+
+    void ensureTrigrams() const;
+    Tier classify(usize index, std::string_view query) const;
+
+    std::vector<std::string> lowerNames_;
+    std::unordered_map<std::string_view, usize> byName_; // Views into list
+    std::deque<std::string> aliasNames_; // Stable storage for byName_ views
+    std::unordered_map<std::string, usize> byPath_;
+    std::vector<std::string> categories_;
+    std::unordered_map<std::string_view, u32> categoryIds_;
+    const std::vector<PresetInfo>* presets_{nullptr};
+
+    // Lazily built, once, under the mutex; postings hold ascending preset
+    // indices
+    mutable std::unordered_map<u32, std::vector<u32>> trigrams_;
+    mutable std::atomic<bool> trigramsBuilt_{false};
+    mutable std::mutex trigramMutex_;
+};
+
+} // namespace vc
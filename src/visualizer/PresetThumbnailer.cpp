@@ -0,0 +1,296 @@
+#include "PresetThumbnailer.hpp"
+#include "SmartRotation.hpp"
+#include "audio/SyntheticAudio.hpp"
+#include "core/Logger.hpp"
+#include "util/FileUtils.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <format>
+
+namespace vc {
+
+namespace {
+
+// Brightness and frame-to-frame change of a finished strip, for
+// SmartRotation. Luma is approximated as (2R + 5G + B) / 8.
+PresetTraits measure(const QImage& strip) {
+    constexpr u32 W = PresetThumbnailer::WIDTH;
+    constexpr u32 H = PresetThumbnailer::HEIGHT;
+    constexpr u32 N = PresetThumbnailer::PREVIEW_FRAMES;
+    u64 lumaSum = 0;
+    u64 diffSum = 0;
+    for (u32 y = 0; y < H; ++y) {
+        const u8* row = strip.constScanLine(static_cast<int>(y));
+        for (u32 x = 0; x < W; ++x) {
+            i32 previous = -1;
+            for (u32 frame = 0; frame < N; ++frame) {
+                const u8* px = row + (frame * W + x) * 4;
+                i32 luma = (2 * px[0] + 5 * px[1] + px[2]) >> 3;
+                lumaSum += static_cast<u64>(luma);
+                if (previous >= 0)
+                    diffSum += static_cast<u64>(std::abs(luma - previous));
+                previous = luma;
+            }
+        }
+    }
+    PresetTraits traits;
+    traits.brightness = static_cast<f32>(lumaSum) / (255.0f * W * H * N);
+    traits.motion = static_cast<f32>(diffSum) / (255.0f * W * H * (N - 1));
+    return traits;
+}
+
+} // namespace
+
+PresetThumbnailer::PresetThumbnailer(QObject* parent) : QObject(parent) {}
+
+PresetThumbnailer::~PresetThumbnailer() {
+    stop();
+}
+
+fs::path PresetThumbnailer::thumbnailPath(u64 hash) {
+    return file::cacheDir() / "thumbnails" / std::format("{:016x}.png", hash);
+}
+
+QImage PresetThumbnailer::loadStrip(u64 hash) {
+    QImage strip(QString::fromStdString(thumbnailPath(hash).string()));
+    if (strip.width() != static_cast<int>(WIDTH * PREVIEW_FRAMES) ||
+        strip.height() != static_cast<int>(HEIGHT))
+        return {};
+    return strip;
+}
+
+QImage PresetThumbnailer::frameOf(const QImage& strip, u32 frame) {
+    if (strip.isNull())
+        return {};
+    return strip.copy(static_cast<int>((frame % PREVIEW_FRAMES) * WIDTH),
+                      0,
+                      WIDTH,
+                      HEIGHT);
+}
+
+void PresetThumbnailer::start(u32 workers) {
+    if (isRunning() || workers == 0)
+        return;
+
+    // What is already cached, so hasThumbnail() never touches the disk
+    {
+        std::lock_guard lock(mutex_);
+        finished_.clear();
+        std::error_code ec;
+        fs::path dir = thumbnailPath(0).parent_path();
+        for (const auto& entry : fs::directory_iterator(dir, ec)) {
+            auto name = entry.path().filename().string();
+            if (name.size() != 20 || entry.path().extension() != ".png")
+                continue;
+            u64 hash = 0;
+            auto [end, err] =
+                    std::from_chars(name.data(), name.data() + 16, hash, 16);
+            if (err == std::errc{} && end == name.data() + 16)
+                finished_.insert(hash);
+        }
+    }
+
+    stopping_ = false;
+    sleepFactor_ = std::max(0.0, workers / DUTY_CYCLE - 1.0);
+    for (u32 i = 0; i < workers; ++i) {
+        auto renderer = std::make_unique<OffscreenRenderer>();
+        if (auto result = renderer->createSurface(); !result) {
+            LOG_WARN("PresetThumbnailer: {}", result.error().message);
+            break;
+        }
+        workers_.emplace_back(
+                &PresetThumbnailer::workerLoop, this, renderer.get());
+        renderers_.push_back(std::move(renderer));
+    }
+    LOG_INFO("PresetThumbnailer: {} workers, {} thumbnails cached",
+             workers_.size(),
+             finished_.size());
+}
+
+void PresetThumbnailer::stop() {
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+        pending_.clear();
+        inFlight_.clear();
+    }
+    cond_.notify_all();
+    for (auto& worker : workers_) {
+        if (worker.joinable())
+            worker.join();
+    }
+    workers_.clear();
+    renderers_.clear(); // Surfaces go on the GUI thread, like they came
+}
+
+void PresetThumbnailer::setPaused(bool paused) {
+    {
+        std::lock_guard lock(mutex_);
+        paused_ = paused;
+    }
+    cond_.notify_all();
+}
+
+void PresetThumbnailer::setPack(std::shared_ptr<const PresetPack> pack) {
+    std::lock_guard lock(mutex_);
+    pack_ = std::move(pack);
+}
+
+void PresetThumbnailer::request(const fs::path& path, u64 hash) {
+    if (!isRunning() || hash == 0)
+        return;
+    {
+        std::lock_guard lock(mutex_);
+        if (finished_.contains(hash) || failed_.contains(hash))
+            return;
+        if (inFlight_.contains(hash)) {
+            // Still waiting? Then it is wanted again, move it to the front
+            auto it = std::find_if(
+                    pending_.begin(), pending_.end(), [&](const Job& j) {
+                        return j.hash == hash;
+                    });
+            if (it != pending_.end()) {
+                Job job = std::move(*it);
+                pending_.erase(it);
+                pending_.push_back(std::move(job));
+            }
+            return;
+        }
+        pending_.push_back({path, hash, pack_});
+        inFlight_.insert(hash);
+        if (pending_.size() > MAX_PENDING) {
+            inFlight_.erase(pending_.front().hash);
+            pending_.pop_front();
+        }
+    }
+    cond_.notify_one();
+}
+
+bool PresetThumbnailer::hasThumbnail(u64 hash) const {
+    std::lock_guard lock(mutex_);
+    return finished_.contains(hash);
+}
+
+void PresetThumbnailer::waitWhilePaused() {
+    std::unique_lock lock(mutex_);
+    cond_.wait(lock, [this] { return stopping_ || !paused_; });
+}
+
+void PresetThumbnailer::workerLoop(OffscreenRenderer* renderer) {
+    if (auto result = renderer->init(WIDTH, HEIGHT, FPS); !result) {
+        LOG_WARN("PresetThumbnailer: {}", result.error().message);
+        renderer->destroy();
+        return;
+    }
+
+    std::unique_lock lock(mutex_);
+    while (true) {
+        cond_.wait(lock, [this] {
+            return stopping_ || (!paused_ && !pending_.empty());
+        });
+        if (stopping_)
+            break;
+
+        Job job = std::move(pending_.back());
+        pending_.pop_back();
+
+        lock.unlock();
+        bool ok = render(*renderer, job);
+        lock.lock();
+
+        inFlight_.erase(job.hash);
+        if (stopping_)
+            break;
+        if (ok) {
+            finished_.insert(job.hash);
+            emit thumbnailReady(job.hash);
+        } else {
+            failed_.insert(job.hash);
+        }
+    }
+    lock.unlock();
+    renderer->destroy();
+}
+
+bool PresetThumbnailer::render(OffscreenRenderer& renderer, const Job& job) {
+    auto text = readPresetText(job.pack.get(), job.path);
+    if (!text) {
+        LOG_WARN("PresetThumbnailer: {}", text.error().message);
+        return false;
+    }
+    if (auto loaded = renderer.loadPreset(*text); !loaded) {
+        LOG_WARN("PresetThumbnailer: {}: {}",
+                 job.path.filename().string(),
+                 loaded.error().message);
+        return false;
+    }
+
+    constexpr u32 totalFrames = FPS * SECONDS;
+    constexpr u32 every = totalFrames / PREVIEW_FRAMES;
+    constexpr u32 audioFrames = SyntheticAudio::SAMPLE_RATE / FPS;
+
+    SyntheticAudio audio;
+    std::vector<f32> pcm(audioFrames * SyntheticAudio::CHANNELS);
+    QImage strip(WIDTH * PREVIEW_FRAMES, HEIGHT, QImage::Format_RGBX8888);
+    u32 kept = 0;
+
+    for (u32 frame = 0; frame < totalFrames; ++frame) {
+        if (paused_)
+            waitWhilePaused();
+        if (stopping_)
+            return false;
+
+        auto start = std::chrono::steady_clock::now();
+        audio.generate(pcm.data(), audioFrames);
+        renderer.addPCM(pcm.data(), audioFrames, SyntheticAudio::CHANNELS);
+        renderer.renderFrame();
+
+        // Last frame of each stretch, so the preset has had time to move
+        if ((frame + 1) % every == 0 && kept < PREVIEW_FRAMES) {
+            QImage image = renderer.grab();
+            for (u32 y = 0; y < HEIGHT; ++y) {
+                std::memcpy(strip.scanLine(y) + kept * WIDTH * 4,
+                            image.constScanLine(y),
+                            WIDTH * 4);
+            }
+            ++kept;
+        }
+
+        renderer.finish();
+        auto busy = std::chrono::steady_clock::now() - start;
+        std::this_thread::sleep_for(
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                        busy * sleepFactor_));
+    }
+
+    fs::path path = thumbnailPath(job.hash);
+    if (auto result = file::ensureDir(path.parent_path()); !result) {
+        LOG_WARN("PresetThumbnailer: {}", result.error().message);
+        return false;
+    }
+    // Via a temp file so the browser never loads half a PNG
+    fs::path tmp = path;
+    tmp += ".tmp";
+    if (!strip.save(QString::fromStdString(tmp.string()), "PNG")) {
+        LOG_WARN("PresetThumbnailer: failed to write {}", tmp.string());
+        return false;
+    }
+    std::error_code ec;
+    fs::rename(tmp, path, ec);
+    if (ec) {
+        LOG_WARN("PresetThumbnailer: {}", ec.message());
+        fs::remove(tmp, ec);
+        return false;
+    }
+    SmartRotation::recordTraits(job.hash, measure(strip));
+    LOG_DEBUG("PresetThumbnailer: {} -> {}",
+              job.path.filename().string(),
+              path.filename().string());
+    return true;
+}
+
+} // namespace vc
@@ -0,0 +1,96 @@
+#pragma once
+// PresetThumbnailer.hpp - Renders preset previews in the background
+// A picture is worth a thousand filenames like "Geiss - Reaction Diffusion 2"
+
+#include "OffscreenRenderer.hpp"
+#include "PresetPack.hpp"
+#include "util/Types.hpp"
+
+#include <QImage>
+#include <QObject>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace vc {
+
+// Each worker owns an OffscreenRenderer and plays a preset for a few seconds
+// of SyntheticAudio, keeping PREVIEW_FRAMES evenly spaced frames. They are
+// saved side by side as one PNG strip under cacheDir()/thumbnails, named
+// after the preset's content hash, so renames and duplicates cost nothing
+// and an edited preset gets a fresh preview.
+//
+// Requests are served newest first: the browser asks for whatever is on
+// screen, and what was on screen a scroll ago matters less. To stay out of
+// the live render's way, workers sleep after every frame so that together
+// they keep the GPU busy at most DUTY_CYCLE of the time, and pause entirely
+// while recording.
+class PresetThumbnailer : public QObject {
+    Q_OBJECT
+
+public:
+    static constexpr u32 WIDTH = 160;
+    static constexpr u32 HEIGHT = 90;
+    static constexpr u32 FPS = 30;
+    static constexpr u32 SECONDS = 3;
+    static constexpr u32 PREVIEW_FRAMES = 4;
+    static constexpr f64 DUTY_CYCLE = 0.25;
+    static constexpr usize MAX_PENDING = 128;
+
+    explicit PresetThumbnailer(QObject* parent = nullptr);
+    ~PresetThumbnailer() override;
+
+    // GUI thread: the offscreen surfaces have to be created there
+    void start(u32 workers);
+    void stop();
+    bool isRunning() const {
+        return !workers_.empty();
+    }
+
+    void setPaused(bool paused);
+    void setPack(std::shared_ptr<const PresetPack> pack);
+
+    // Queue a render unless the thumbnail exists or is being made
+    void request(const fs::path& path, u64 hash);
+    bool hasThumbnail(u64 hash) const;
+
+    static fs::path thumbnailPath(u64 hash);
+    // The whole strip; PREVIEW_FRAMES frames of WIDTH x HEIGHT
+    static QImage loadStrip(u64 hash);
+    static QImage frameOf(const QImage& strip, u32 frame);
+
+signals:
+    void thumbnailReady(quint64 hash);
+
+private:
+    struct Job {
+        fs::path path;
+        u64 hash{0};
+        std::shared_ptr<const PresetPack> pack;
+    };
+
+    void workerLoop(OffscreenRenderer* renderer);
+    bool render(OffscreenRenderer& renderer, const Job& job);
+    void waitWhilePaused();
+
+    std::vector<std::unique_ptr<OffscreenRenderer>> renderers_;
+    std::vector<std::thread> workers_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque<Job> pending_;           // Newest at the back
+    std::unordered_set<u64> inFlight_;  // Queued or rendering
+    std::unordered_set<u64> finished_;  // On disk
+    std::unordered_set<u64> failed_;    // Don't retry this session
+    std::shared_ptr<const PresetPack> pack_;
+    std::atomic<bool> stopping_{false};
+    std::atomic<bool> paused_{false};
+    f64 sleepFactor_{0.0}; // Idle time per unit of GPU time, per worker
+};
+
+} // namespace vc
@@ -0,0 +1,105 @@
+#include "PresetWatcher.hpp"
+#include "PresetPack.hpp"
+#include "core/Logger.hpp"
+#include "util/FileUtils.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace vc {
+
+#ifdef __linux__
+
+namespace {
+
+// The same events that bump a directory's mtime, which is what the index
+// revalidates against
+constexpr u32 WATCH_MASK = IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                           IN_MOVED_TO | IN_DELETE_SELF;
+
+} // namespace
+
+PresetWatcher::PresetWatcher() {
+    fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd_ < 0)
+        LOG_WARN("PresetWatcher: inotify unavailable: {}",
+                 std::strerror(errno));
+}
+
+PresetWatcher::~PresetWatcher() {
+    if (fd_ >= 0)
+        ::close(fd_);
+}
+
+void PresetWatcher::watch(const std::vector<fs::path>& dirs) {
+    if (fd_ < 0)
+        return;
+
+    for (const auto& [wd, path] : watches_)
+        inotify_rm_watch(fd_, wd);
+    watches_.clear();
+
+    for (const auto& dir : dirs) {
+        int wd = inotify_add_watch(fd_, dir.c_str(), WATCH_MASK);
+        if (wd < 0) {
+            // Usually fs.inotify.max_user_watches; the rest still works
+            LOG_WARN("PresetWatcher: cannot watch {}: {}",
+                     dir.string(),
+                     std::strerror(errno));
+            break;
+        }
+        watches_.emplace(wd, dir);
+    }
+    LOG_DEBUG("PresetWatcher: watching {} directories", watches_.size());
+}
+
+bool PresetWatcher::drain() {
+    if (fd_ < 0)
+        return false;
+
+    bool relevant = false;
+    alignas(inotify_event) char buffer[16 * 1024];
+    while (true) {
+        ssize_t len = ::read(fd_, buffer, sizeof(buffer));
+        if (len <= 0)
+            break; // EAGAIN: drained
+
+        for (char* p = buffer; p < buffer + len;) {
+            auto* event = reinterpret_cast<inotify_event*>(p);
+            p += sizeof(inotify_event) + event->len;
+
+            if (event->mask & (IN_Q_OVERFLOW | IN_DELETE_SELF | IN_ISDIR)) {
+                relevant = true;
+            } else if (event->len > 0) {
+                auto ext = fs::path(event->name).extension().string();
+                std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+                // A rebuilt pack lands as a rename onto its .cvpk name
+                relevant |= file::presetExtensions.contains(ext) ||
+                            ext == PresetPack::EXTENSION;
+            }
+        }
+    }
+    return relevant;
+}
+
+#else
+
+PresetWatcher::PresetWatcher() = default;
+PresetWatcher::~PresetWatcher() = default;
+
+void PresetWatcher::watch(const std::vector<fs::path>&) {
+}
+
+bool PresetWatcher::drain() {
+    return false;
+}
+
+#endif
+
+} // namespace vc
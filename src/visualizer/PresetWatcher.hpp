@@ -0,0 +1,43 @@
+#pragma once
+// PresetWatcher.hpp - inotify on the preset tree
+// Drop a .milk in the folder, see it in the browser. Revolutionary.
+
+#include "util/Types.hpp"
+
+#include <unordered_map>
+#include <vector>
+
+namespace vc {
+
+// Thin inotify wrapper. The fd is non-blocking and meant for an event loop
+// (QSocketNotifier); drain() says whether anything preset-related changed,
+// and the owner rescans, which the index keeps cheap. On platforms without
+// inotify the watcher is simply unavailable.
+class PresetWatcher {
+public:
+    PresetWatcher();
+    ~PresetWatcher();
+
+    PresetWatcher(const PresetWatcher&) = delete;
+    PresetWatcher& operator=(const PresetWatcher&) = delete;
+
+    bool isAvailable() const {
+        return fd_ >= 0;
+    }
+    int fd() const {
+        return fd_;
+    }
+
+    // Replace the watched set (directories only, not recursive by itself)
+    void watch(const std::vector<fs::path>& dirs);
+
+    // Consume pending events. True if a preset file or a directory was
+    // created, removed or renamed.
+    bool drain();
+
+private:
+    int fd_{-1};
+    std::unordered_map<int, fs::path> watches_;
+};
+
+} // namespace vc
@@ -3,6 +3,8 @@
 #include "core/Logger.hpp"
 #include "util/FileUtils.hpp"
 
+#include <chrono>
+
 namespace vc {
 
 ProjectMBridge::ProjectMBridge() = default;
@@ -17,6 +19,9 @@ Result<void> ProjectMBridge::init(const ProjectMConfig& config) {
     width_ = config.width;
     height_ = config.height;
     shuffleEnabled_ = config.shufflePresets;
+    fps_ = config.fps;
+    transitionDuration_ = config.transitionDuration;
+    gpuBudgetMs_ = config.gpuBudgetMs;
 
     projectM_ = projectm_create();
     if (!projectM_)
@@ -33,9 +38,15 @@ Result<void> ProjectMBridge::init(const ProjectMConfig& config) {
     presets_.presetChanged.connect(
             [this](const PresetInfo* p) { onPresetManagerChanged(p); });
 
+    if (auto result = profiler_.init(); !result)
+        LOG_WARN("Preset profiling disabled: {}", result.error().message);
+    profiler_.load(file::configDir() / "preset_stats.txt");
+
     if (!config.presetPath.empty() && fs::exists(config.presetPath)) {
+        presets_.setIndexPath(file::cacheDir() / "preset_index.bin");
         presets_.scan(config.presetPath);
         presets_.loadState(file::configDir() / "preset_state.txt");
+        updateQuarantine();
     }
 
     if (config.useDefaultPreset)
@@ -56,6 +67,9 @@ Result<void> ProjectMBridge::init(const ProjectMConfig& config) {
 void ProjectMBridge::shutdown() {
     if (projectM_) {
         presets_.saveState(file::configDir() / "preset_state.txt");
+        profiler_.flush();
+        profiler_.save(file::configDir() / "preset_stats.txt");
+        profiler_.destroy();
         projectm_destroy(projectM_);
         projectM_ = nullptr;
     }
@@ -64,7 +78,9 @@ void ProjectMBridge::shutdown() {
 void ProjectMBridge::render() {
     if (!projectM_)
         return;
+    profiler_.beginFrame(width_, height_);
     projectm_opengl_render_frame(projectM_);
+    profiler_.endFrame();
 }
 
 void ProjectMBridge::renderToTarget(RenderTarget& target) {
@@ -74,7 +90,9 @@ void ProjectMBridge::renderToTarget(RenderTarget& target) {
         resize(target.width(), target.height());
     target.bind();
     glViewport(0, 0, target.width(), target.height());
+    profiler_.beginFrame(width_, height_);
     projectm_opengl_render_frame(projectM_);
+    profiler_.endFrame();
     target.unbind();
 }
 
@@ -104,18 +122,23 @@ void ProjectMBridge::resize(u32 width, u32 height) {
     width_ = width;
     height_ = height;
     projectm_set_window_size(projectM_, width_, height_);
+    updateQuarantine(); // Budgets are per resolution
 }
 
 void ProjectMBridge::resetViewport(u32 width, u32 height) {
     if (!projectM_)
         return;
+    bool changed = width != width_ || height != height_;
     width_ = width;
     height_ = height;
     projectm_set_window_size(projectM_, width, height);
     glViewport(0, 0, width, height);
+    if (changed)
+        updateQuarantine();
 }
 
 void ProjectMBridge::setFPS(u32 fps) {
+    fps_ = fps;
     if (projectM_)
         projectm_set_fps(projectM_, fps);
 }
@@ -131,6 +154,73 @@ void ProjectMBridge::loadPreset(const fs::path& path, bool smooth) {
     presetChanged.emitSignal(path.stem().string());
 }
 
+void ProjectMBridge::applyPreset(const fs::path& path,
+                                 const std::string& name,
+                                 const std::string& data,
+                                 bool smooth) {
+    if (!projectM_)
+        return;
+
+    // No preloaded text: a pack read is only a memcpy away, anything else
+    // goes through projectM's own file loader
+    std::string packed;
+    auto pack = presets_.pack();
+    if (data.empty() && pack && pack->find(path)) {
+        if (auto text = readPresetText(pack.get(), path))
+            packed = std::move(*text);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    if (!data.empty())
+        projectm_load_preset_data(projectM_, data.c_str(), smooth);
+    else if (!packed.empty())
+        projectm_load_preset_data(projectM_, packed.c_str(), smooth);
+    else
+        projectm_load_preset_file(projectM_, path.c_str(), smooth);
+    f32 loadMs = std::chrono::duration<f32, std::milli>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+
+    // The outgoing preset's numbers are final now; it's the only one whose
+    // verdict can have changed
+    u32 warmup = smooth ? transitionDuration_ * fps_ : 0;
+    std::string outgoing = profiler_.activePreset();
+    profiler_.beginPreset(name, loadMs, warmup);
+    if (!outgoing.empty())
+        updateQuarantine(outgoing);
+}
+
+void ProjectMBridge::setGpuBudget(f32 budgetMs) {
+    gpuBudgetMs_ = budgetMs;
+    updateQuarantine();
+}
+
+void ProjectMBridge::updateQuarantine() {
+    usize before = presets_.quarantinedCount();
+    presets_.setQuarantined(
+            profiler_.overBudget(gpuBudgetMs_, width_, height_));
+    usize after = presets_.quarantinedCount();
+    if (after != before) {
+        LOG_INFO("{} presets over the {:.1f} ms GPU budget at {}x{}",
+                 after,
+                 gpuBudgetMs_,
+                 width_,
+                 height_);
+    }
+}
+
+void ProjectMBridge::updateQuarantine(const std::string& name) {
+    bool over = profiler_.overBudget(name, gpuBudgetMs_, width_, height_);
+    if (presets_.setQuarantined(name, over)) {
+        LOG_INFO("{} is {} the {:.1f} ms GPU budget at {}x{}",
+                 name,
+                 over ? "over" : "back under",
+                 gpuBudgetMs_,
+                 width_,
+                 height_);
+    }
+}
+
 void ProjectMBridge::nextPreset(bool smooth) {
     if (presetLocked_)
         return;
@@ -3,6 +3,7 @@
 // Where the magic happens (literally, ProjectM is magic)
 
 #include "PresetManager.hpp"
+#include "PresetProfiler.hpp"
 #include "RenderTarget.hpp"
 #include "util/Result.hpp"
 #include "util/Signal.hpp"
@@ -27,6 +28,7 @@ struct ProjectMConfig {
     bool shufflePresets{true};
     std::string forcePreset{};
     bool useDefaultPreset{false};
+    f32 gpuBudgetMs{0.0f}; // 0 disables the quarantine
     u32 meshX{128};
     u32 meshY{96};
 };
@@ -63,6 +65,7 @@ public:
     void setShuffleEnabled(bool enabled) {
         shuffleEnabled_ = enabled;
     }
+    void setGpuBudget(f32 budgetMs);
 
     // Preset control
     PresetManager& presets() {
@@ -73,6 +76,12 @@ public:
     }
 
     void loadPreset(const fs::path& path, bool smooth = true);
+    // Hand an already-read preset to projectM (GL context must be current).
+    // Empty `data` falls back to reading `path`.
+    void applyPreset(const fs::path& path,
+                     const std::string& name,
+                     const std::string& data,
+                     bool smooth);
     void nextPreset(bool smooth = true);
     void previousPreset(bool smooth = true);
     void randomPreset(bool smooth = true);
@@ -89,6 +98,9 @@ public:
         return height_;
     }
     std::string currentPresetName() const;
+    const PresetProfiler& profiler() const {
+        return profiler_;
+    }
 
     // Internal access (for VisualizerWindow to load presets with GL context)
     projectm_handle getHandle() {
@@ -101,14 +113,22 @@ public:
 
 private:
     void onPresetManagerChanged(const PresetInfo* preset);
+    // Every preset (the budget or resolution changed), or just `name`
+    // (its numbers did)
+    void updateQuarantine();
+    void updateQuarantine(const std::string& name);
 
     projectm_handle projectM_{nullptr};
     PresetManager presets_;
+    PresetProfiler profiler_;
 
     u32 width_{1920};
     u32 height_{1080};
     bool presetLocked_{false};
     bool shuffleEnabled_{false};
+    u32 fps_{60};
+    u32 transitionDuration_{3};
+    f32 gpuBudgetMs_{0.0f};
 };
 
 } // namespace vc
@@ -1,6 +1,7 @@
 #include "RenderTarget.hpp"
 #include "core/Logger.hpp"
 #include <QOpenGLContext>
+#include <algorithm>
 
 namespace vc {
 
@@ -16,6 +17,9 @@ RenderTarget::RenderTarget(RenderTarget&& other) noexcept
     , depthBuffer_(std::exchange(other.depthBuffer_, 0))
     , width_(std::exchange(other.width_, 0))
     , height_(std::exchange(other.height_, 0))
+    , allocWidth_(std::exchange(other.allocWidth_, 0))
+    , allocHeight_(std::exchange(other.allocHeight_, 0))
+    , allocations_(std::exchange(other.allocations_, 0))
     , hasDepth_(std::exchange(other.hasDepth_, false))
 {
 }
@@ -28,26 +32,50 @@ RenderTarget& RenderTarget::operator=(RenderTarget&& other) noexcept {
         depthBuffer_ = std::exchange(other.depthBuffer_, 0);
         width_ = std::exchange(other.width_, 0);
         height_ = std::exchange(other.height_, 0);
+        allocWidth_ = std::exchange(other.allocWidth_, 0);
+        allocHeight_ = std::exchange(other.allocHeight_, 0);
+        allocations_ = std::exchange(other.allocations_, 0);
         hasDepth_ = std::exchange(other.hasDepth_, false);
     }
     return *this;
 }
 
+namespace {
+
+u32 sizeClass(u32 value) {
+    return (value + RenderTarget::SIZE_CLASS - 1) / RenderTarget::SIZE_CLASS *
+           RenderTarget::SIZE_CLASS;
+}
+
+} // namespace
+
 Result<void> RenderTarget::create(u32 width, u32 height, bool withDepth) {
     if (width == 0 || height == 0) {
         return Result<void>::err("Invalid render target size");
     }
     
+    destroy();
+    hasDepth_ = withDepth;
+    
+    if (auto result = allocate(sizeClass(width), sizeClass(height)); !result) {
+        return result;
+    }
+    width_ = width;
+    height_ = height;
+    return Result<void>::ok();
+}
+
+Result<void> RenderTarget::allocate(u32 allocWidth, u32 allocHeight) {
     // Verify OpenGL context is current
     if (QOpenGLContext::currentContext() == nullptr) {
         return Result<void>::err("No OpenGL context current for RenderTarget::create()");
     }
     
-    destroy();
+    releaseStorage();
     
-    width_ = width;
-    height_ = height;
-    hasDepth_ = withDepth;
+    allocWidth_ = allocWidth;
+    allocHeight_ = allocHeight;
+    ++allocations_;
     
     // Create framebuffer
     glGenFramebuffers(1, &fbo_);
@@ -56,7 +84,7 @@ Result<void> RenderTarget::create(u32 width, u32 height, bool withDepth) {
     // Create texture
     glGenTextures(1, &texture_);
     glBindTexture(GL_TEXTURE_2D, texture_);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, allocWidth, allocHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -65,14 +93,15 @@ Result<void> RenderTarget::create(u32 width, u32 height, bool withDepth) {
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture_, 0);
     
     // Create depth buffer if requested
-    if (withDepth) {
+    if (hasDepth_) {
         glGenRenderbuffers(1, &depthBuffer_);
         glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer_);
-        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, allocWidth, allocHeight);
         glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer_);
     }
     
     // Clear to transparent black immediately to prevent ghosting/artifacts
+    glViewport(0, 0, allocWidth, allocHeight);
     glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
     glClear(GL_COLOR_BUFFER_BIT);
     
@@ -85,18 +114,18 @@ Result<void> RenderTarget::create(u32 width, u32 height, bool withDepth) {
         return Result<void>::err("Framebuffer incomplete: " + std::to_string(status));
     }
     
-    LOG_DEBUG("Created render target {}x{}", width, height);
+    LOG_DEBUG("Allocated render target storage {}x{} (#{})",
+              allocWidth, allocHeight, allocations_);
     return Result<void>::ok();
 }
 
-void RenderTarget::destroy() {
+void RenderTarget::releaseStorage() {
     // Only attempt GL operations if context is current
     if (QOpenGLContext::currentContext() == nullptr) {
         // Can't delete GL objects without context, just clear handles
         depthBuffer_ = 0;
         texture_ = 0;
         fbo_ = 0;
-        width_ = height_ = 0;
         return;
     }
     
@@ -112,14 +141,35 @@ void RenderTarget::destroy() {
         glDeleteFramebuffers(1, &fbo_);
         fbo_ = 0;
     }
+}
+
+void RenderTarget::destroy() {
+    releaseStorage();
     width_ = height_ = 0;
+    allocWidth_ = allocHeight_ = 0;
 }
 
 Result<void> RenderTarget::resize(u32 width, u32 height) {
-    if (width == width_ && height == height_) {
+    if (width == 0 || height == 0) {
+        return Result<void>::err("Invalid render target size");
+    }
+    if (fits(width, height)) {
+        // Just a new viewport into the same storage
+        width_ = width;
+        height_ = height;
         return Result<void>::ok();
     }
-    return create(width, height, hasDepth_);
+    
+    // Grow-only: never give back the dimension that didn't overflow, so
+    // toggling between two sizes settles after the first round trip
+    if (auto result = allocate(sizeClass(std::max(width, allocWidth_)),
+                               sizeClass(std::max(height, allocHeight_)));
+        !result) {
+        return result;
+    }
+    width_ = width;
+    height_ = height;
+    return Result<void>::ok();
 }
 
 void RenderTarget::bind() {
@@ -141,13 +191,15 @@ void RenderTarget::readPixels(void* data, GLenum format, GLenum type) {
     glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
 }
 
-void RenderTarget::blitTo(RenderTarget& other, bool linear) {
+void RenderTarget::blitTo(RenderTarget& other, bool linear, bool flipY) {
     glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo_);
     glBindFramebuffer(GL_DRAW_FRAMEBUFFER, other.fbo_);
     
+    GLint dstY0 = flipY ? other.height_ : 0;
+    GLint dstY1 = flipY ? 0 : other.height_;
     glBlitFramebuffer(
         0, 0, width_, height_,
-        0, 0, other.width_, other.height_,
+        0, dstY0, other.width_, dstY1,
         GL_COLOR_BUFFER_BIT,
         linear ? GL_LINEAR : GL_NEAREST
     );
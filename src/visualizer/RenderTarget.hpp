@@ -8,8 +8,13 @@
 
 namespace vc {
 
+// The GL storage only ever grows, in SIZE_CLASS steps. width()/height() are
+// the logical size - the sub-region that gets rendered, blitted and read
+// back - so resizing within the allocation is free.
 class RenderTarget {
 public:
+    static constexpr u32 SIZE_CLASS = 256;
+
     RenderTarget();
     ~RenderTarget();
     
@@ -25,7 +30,7 @@ public:
     Result<void> create(u32 width, u32 height, bool withDepth = false);
     void destroy();
     
-    // Resize (recreates buffers)
+    // Change the logical size; reallocates only when it outgrows storage
     Result<void> resize(u32 width, u32 height);
     
     // Binding
@@ -40,20 +45,44 @@ public:
     u32 height() const { return height_; }
     Size size() const { return {width_, height_}; }
     bool isValid() const { return fbo_ != 0; }
+    bool hasDepth() const { return hasDepth_; }
+    
+    // Backing storage, and the UV extent of the logical region within it
+    u32 allocatedWidth() const { return allocWidth_; }
+    u32 allocatedHeight() const { return allocHeight_; }
+    Vec2 uvScale() const {
+        if (allocWidth_ == 0 || allocHeight_ == 0)
+            return {1.0f, 1.0f};
+        return {static_cast<f32>(width_) / allocWidth_,
+                static_cast<f32>(height_) / allocHeight_};
+    }
+    bool fits(u32 width, u32 height) const {
+        return isValid() && width <= allocWidth_ && height <= allocHeight_;
+    }
+    
+    // Number of GL (re)allocations over this target's lifetime
+    u32 allocationCount() const { return allocations_; }
     
     // Read pixels
     void readPixels(void* data, GLenum format = GL_RGBA, GLenum type = GL_UNSIGNED_BYTE);
     
-    // Blit to another target
-    void blitTo(RenderTarget& other, bool linear = true);
+    // Blit to another target. flipY writes rows top-down, which is what the
+    // encoder wants - the GPU does the flip for free during the copy.
+    void blitTo(RenderTarget& other, bool linear = true, bool flipY = false);
     void blitToScreen(u32 screenWidth, u32 screenHeight, bool linear = true);
     
 private:
+    Result<void> allocate(u32 allocWidth, u32 allocHeight);
+    void releaseStorage();
+    
     GLuint fbo_{0};
     GLuint texture_{0};
     GLuint depthBuffer_{0};
     u32 width_{0};
     u32 height_{0};
+    u32 allocWidth_{0};
+    u32 allocHeight_{0};
+    u32 allocations_{0};
     bool hasDepth_{false};
 };
 
@@ -0,0 +1,77 @@
+#include "RenderTargetPool.hpp"
+#include "core/Logger.hpp"
+
+namespace vc {
+
+Result<RenderTarget*> RenderTargetPool::acquire(u32 width,
+                                                u32 height,
+                                                bool withDepth) {
+    auto area = [](const Entry& e) {
+        return static_cast<u64>(e.target->allocatedWidth()) *
+               e.target->allocatedHeight();
+    };
+
+    Entry* best = nullptr;   // Smallest free target that already fits
+    Entry* growee = nullptr; // Largest free target, if none fits
+
+    for (auto& entry : entries_) {
+        if (entry.inUse || entry.target->hasDepth() != withDepth)
+            continue;
+        if (entry.target->fits(width, height)) {
+            if (!best || area(entry) < area(*best))
+                best = &entry;
+        } else if (!growee || area(entry) > area(*growee)) {
+            growee = &entry;
+        }
+    }
+
+    Entry* chosen = best ? best : growee;
+    if (chosen) {
+        if (auto result = chosen->target->resize(width, height); !result)
+            return Result<RenderTarget*>::err(result.error());
+        chosen->inUse = true;
+        return Result<RenderTarget*>::ok(chosen->target.get());
+    }
+
+    auto target = std::make_unique<RenderTarget>();
+    if (auto result = target->create(width, height, withDepth); !result)
+        return Result<RenderTarget*>::err(result.error());
+
+    entries_.push_back({std::move(target), true});
+    LOG_DEBUG("RenderTargetPool: {} targets ({} MB)",
+              entries_.size(),
+              allocatedBytes() / (1024 * 1024));
+    return Result<RenderTarget*>::ok(entries_.back().target.get());
+}
+
+void RenderTargetPool::release(RenderTarget* target) {
+    for (auto& entry : entries_) {
+        if (entry.target.get() == target) {
+            entry.inUse = false;
+            return;
+        }
+    }
+}
+
+void RenderTargetPool::clear() {
+    entries_.clear();
+}
+
+usize RenderTargetPool::inUse() const {
+    usize count = 0;
+    for (const auto& entry : entries_)
+        count += entry.inUse ? 1 : 0;
+    return count;
+}
+
+u64 RenderTargetPool::allocatedBytes() const {
+    u64 bytes = 0;
+    for (const auto& entry : entries_) {
+        const auto& t = *entry.target;
+        u64 pixels = static_cast<u64>(t.allocatedWidth()) * t.allocatedHeight();
+        bytes += pixels * (t.hasDepth() ? 8 : 4); // RGBA8 (+ D24S8)
+    }
+    return bytes;
+}
+
+} // namespace vc
@@ -0,0 +1,50 @@
+#pragma once
+// RenderTargetPool.hpp - Reusable render targets keyed by format and size
+// Allocating VRAM mid-frame is how you get a hitch. So we don't.
+
+#include "RenderTarget.hpp"
+#include "util/Result.hpp"
+#include "util/Types.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace vc {
+
+// Targets handed back with release() keep their storage and are reused by
+// the next acquire() with the same format. Prefers the smallest free target
+// that already fits, then grows the largest free one, and only creates a new
+// target when nothing of that format is free.
+class RenderTargetPool {
+public:
+    RenderTargetPool() = default;
+    ~RenderTargetPool() = default;
+
+    RenderTargetPool(const RenderTargetPool&) = delete;
+    RenderTargetPool& operator=(const RenderTargetPool&) = delete;
+
+    // GL context must be current. The returned target is owned by the pool
+    // and stays valid until release() or clear().
+    Result<RenderTarget*> acquire(u32 width, u32 height, bool withDepth);
+    void release(RenderTarget* target);
+
+    // Destroy everything (context must be current)
+    void clear();
+
+    // Stats
+    usize size() const {
+        return entries_.size();
+    }
+    usize inUse() const;
+    u64 allocatedBytes() const;
+
+private:
+    struct Entry {
+        std::unique_ptr<RenderTarget> target;
+        bool inUse{false};
+    };
+
+    std::vector<Entry> entries_;
+};
+
+} // namespace vc
@@ -0,0 +1,240 @@
+#include "SmartRotation.hpp"
+#include "PresetManager.hpp"
+#include "core/Logger.hpp"
+#include "util/FileUtils.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <format>
+#include <fstream>
+#include <mutex>
+
+namespace vc {
+
+namespace {
+
+u32 cellOf(f32 value) {
+    auto cell = static_cast<i32>(value * SmartRotation::GRID);
+    return static_cast<u32>(
+            std::clamp<i32>(cell, 0, SmartRotation::GRID - 1));
+}
+
+// Rank of every entry by `key`, scaled to a grid cell
+template<typename Key>
+std::vector<u32> percentileCells(usize count, Key key) {
+    std::vector<u32> order(count);
+    for (usize i = 0; i < count; ++i)
+        order[i] = static_cast<u32>(i);
+    std::sort(order.begin(), order.end(), [&](u32 a, u32 b) {
+        return key(a) < key(b);
+    });
+    std::vector<u32> cells(count);
+    for (usize rank = 0; rank < count; ++rank)
+        cells[order[rank]] = static_cast<u32>(rank * SmartRotation::GRID /
+                                              count);
+    return cells;
+}
+
+std::mutex& recordMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+} // namespace
+
+fs::path SmartRotation::traitsPath() {
+    return file::cacheDir() / "preset_traits.tsv";
+}
+
+void SmartRotation::recordTraits(u64 hash, const PresetTraits& traits) {
+    std::lock_guard lock(recordMutex());
+    fs::path path = traitsPath();
+    if (auto result = file::ensureDir(path.parent_path()); !result) {
+        LOG_WARN("SmartRotation: {}", result.error().message);
+        return;
+    }
+    // One short line per write, so a reader never sees more than a torn
+    // last line, which it skips
+    std::ofstream file(path, std::ios::app);
+    file << std::format("{:016x}\t{:.4f}\t{:.4f}\n",
+                        hash,
+                        traits.motion,
+                        traits.brightness);
+}
+
+PresetTraits SmartRotation::target(const AudioFeatures& features) {
+    // Rough guesses at where typical music falls; presets are placed by
+    // percentile, so these only need the right order, not the right scale
+    f32 onsets = std::min(features.onsetDensity / 8.0f, 1.0f);
+    f32 tempo = features.tempo > 0.0f
+                        ? std::clamp((features.tempo - 70.0f) / 110.0f,
+                                     0.0f,
+                                     1.0f)
+                        : features.energy;
+    PresetTraits target;
+    target.motion = std::clamp(
+            0.5f * features.energy + 0.3f * onsets + 0.2f * tempo, 0.0f, 1.0f);
+    target.brightness = std::clamp(
+            (features.spectralCentroid - 0.02f) / 0.2f, 0.0f, 1.0f);
+    return target;
+}
+
+void SmartRotation::invalidate() {
+    dirty_ = true;
+    recent_.clear();
+    recentSet_.clear();
+}
+
+void SmartRotation::update(const std::vector<PresetInfo>& presets) {
+    bool traitsChanged = loadTraits();
+    if (dirty_ || traitsChanged)
+        this->rebuild(presets);
+}
+
+bool SmartRotation::loadTraits() {
+    std::error_code ec;
+    fs::path path = traitsPath();
+    auto time = fs::last_write_time(path, ec);
+    if (ec || time == traitsTime_)
+        return false;
+    traitsTime_ = time;
+
+    auto text = file::readText(path);
+    if (!text) {
+        LOG_WARN("SmartRotation: {}", text.error().message);
+        return false;
+    }
+
+    // Later lines win, so a re-rendered preset is re-measured
+    traits_.clear();
+    std::string_view rest = *text;
+    while (!rest.empty()) {
+        usize end = rest.find('\n');
+        if (end == std::string_view::npos)
+            break; // Torn final line, still being written
+        std::string_view line = rest.substr(0, end);
+        rest.remove_prefix(end + 1);
+
+        const char* p = line.data();
+        const char* last = p + line.size();
+        u64 hash = 0;
+        PresetTraits traits;
+        auto r = std::from_chars(p, last, hash, 16);
+        if (r.ec != std::errc{} || r.ptr == last || *r.ptr != '\t')
+            continue;
+        r = std::from_chars(r.ptr + 1, last, traits.motion);
+        if (r.ec != std::errc{} || r.ptr == last || *r.ptr != '\t')
+            continue;
+        r = std::from_chars(r.ptr + 1, last, traits.brightness);
+        if (r.ec != std::errc{})
+            continue;
+        traits_[hash] = traits;
+    }
+    LOG_DEBUG("SmartRotation: {} presets with traits", traits_.size());
+    return true;
+}
+
+void SmartRotation::rebuild(const std::vector<PresetInfo>& presets) {
+    dirty_ = false;
+    for (auto& cell : cells_)
+        cell.clear();
+    unknown_.clear();
+
+    std::vector<u32> knownIndex;
+    std::vector<const PresetTraits*> knownTraits;
+    for (usize i = 0; i < presets.size(); ++i) {
+        auto it = traits_.find(presets[i].contentHash);
+        if (it == traits_.end()) {
+            unknown_.push_back(static_cast<u32>(i));
+            continue;
+        }
+        knownIndex.push_back(static_cast<u32>(i));
+        knownTraits.push_back(&it->second);
+    }
+    known_ = knownIndex.size();
+    total_ = presets.size();
+
+    auto x = percentileCells(known_, [&](u32 i) {
+        return knownTraits[i]->motion;
+    });
+    auto y = percentileCells(known_, [&](u32 i) {
+        return knownTraits[i]->brightness;
+    });
+    for (usize i = 0; i < known_; ++i)
+        cells_[y[i] * GRID + x[i]].push_back(knownIndex[i]);
+
+    avoid_ = std::min(AVOID_RECENT, known_ / 2);
+    while (recent_.size() > avoid_) {
+        recentSet_.erase(recent_.front());
+        recent_.pop_front();
+    }
+}
+
+std::optional<usize> SmartRotation::pick(const AudioFeatures& features,
+                                         const Eligible& eligible,
+                                         std::mt19937& rng) {
+    // Coverage decides how much the traits are trusted
+    f64 unknownShare = total_ > 0 ? 1.0 - static_cast<f64>(known_) /
+                                                  static_cast<f64>(total_)
+                                  : 1.0;
+    std::bernoulli_distribution explore(std::max(EXPLORE, unknownShare));
+    if (known_ == 0 || explore(rng)) {
+        if (auto index = drawFrom(unknown_, eligible, rng))
+            return index;
+    }
+    if (auto index = walkGrid(target(features), eligible, rng))
+        return index;
+    return drawFrom(unknown_, eligible, rng);
+}
+
+std::optional<usize> SmartRotation::walkGrid(const PresetTraits& target,
+                                             const Eligible& eligible,
+                                             std::mt19937& rng) const {
+    const i32 cx = static_cast<i32>(cellOf(target.motion));
+    const i32 cy = static_cast<i32>(cellOf(target.brightness));
+    const i32 size = static_cast<i32>(GRID);
+    for (i32 ring = 0; ring < size; ++ring) {
+        for (i32 dy = -ring; dy <= ring; ++dy) {
+            for (i32 dx = -ring; dx <= ring; ++dx) {
+                if (std::max(std::abs(dx), std::abs(dy)) != ring)
+                    continue; // Inside the ring, already tried
+                i32 x = cx + dx;
+                i32 y = cy + dy;
+                if (x < 0 || y < 0 || x >= size || y >= size)
+                    continue;
+                if (auto index = drawFrom(cells_[y * size + x], eligible, rng))
+                    return index;
+            }
+        }
+    }
+    return std::nullopt;
+}
+
+std::optional<usize> SmartRotation::drawFrom(const std::vector<u32>& bucket,
+                                             const Eligible& eligible,
+                                             std::mt19937& rng) const {
+    if (bucket.empty())
+        return std::nullopt;
+    // A few random draws rather than a scan: a bucket full of blacklisted
+    // or recent presets is rare and the next ring is close enough
+    std::uniform_int_distribution<usize> dist(0, bucket.size() - 1);
+    for (u32 draw = 0; draw < DRAWS_PER_CELL; ++draw) {
+        usize index = bucket[dist(rng)];
+        if (!recentSet_.contains(index) && eligible(index))
+            return index;
+    }
+    return std::nullopt;
+}
+
+void SmartRotation::noteShown(usize index) {
+    if (avoid_ == 0 || !recentSet_.insert(index).second)
+        return;
+    recent_.push_back(index);
+    while (recent_.size() > avoid_) {
+        recentSet_.erase(recent_.front());
+        recent_.pop_front();
+    }
+}
+
+} // namespace vc
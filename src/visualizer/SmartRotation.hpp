@@ -0,0 +1,96 @@
+#pragma once
+// SmartRotation.hpp - Picks the next preset to suit the music
+// Slow song, slow preset. Groundbreaking stuff.
+
+#include "audio/AudioAnalyzer.hpp"
+#include "util/Types.hpp"
+
+#include <array>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <random>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace vc {
+
+struct PresetInfo;
+
+// What a preset looks like, measured from its thumbnail render
+struct PresetTraits {
+    f32 motion{0.0f};     // Mean change between preview frames, 0..1
+    f32 brightness{0.0f}; // Mean luma, 0..1
+};
+
+// Presets with known traits are bucketed on a GRID x GRID grid once per
+// scan, each axis by percentile so the cells fill evenly whatever the
+// library looks like. A pick maps the live AudioFeatures onto the same
+// grid (energy, onset density and tempo to motion, spectral centroid to
+// brightness) and walks outwards ring by ring from that cell until a
+// bucket yields an eligible preset that is not among the last AVOID_RECENT
+// shown. The cost depends on the grid and a few random draws per cell,
+// never on the number of presets.
+//
+// Traits are learned: PresetThumbnailer measures every preview it renders
+// and appends the result to traitsPath(), which is re-read when it changes.
+// Presets not measured yet sit in a separate pool that a pick draws from
+// with the share of the library they make up (at least EXPLORE), so a
+// library with a few thumbnails rendered mostly shuffles as before and
+// the grid takes over as coverage grows. Recent presets are avoided in a
+// window sized from the measured ones, so a small known set still cycles
+// rather than running dry.
+class SmartRotation {
+public:
+    static constexpr u32 GRID = 8;
+    static constexpr usize AVOID_RECENT = 32;
+    static constexpr f64 EXPLORE = 0.2;
+    static constexpr u32 DRAWS_PER_CELL = 4;
+
+    using Eligible = std::function<bool(usize)>;
+
+    static fs::path traitsPath();
+    // Appends to traitsPath(); safe from any thread
+    static void recordTraits(u64 hash, const PresetTraits& traits);
+    // Where music with these features belongs, in percentile space
+    static PresetTraits target(const AudioFeatures& features);
+
+    // Re-bucket if the list was invalidated or the traits file changed
+    void update(const std::vector<PresetInfo>& presets);
+    void invalidate(); // Preset list changed; indices are stale
+
+    std::optional<usize> pick(const AudioFeatures& features,
+                              const Eligible& eligible,
+                              std::mt19937& rng);
+    void noteShown(usize index);
+
+    usize knownCount() const {
+        return known_;
+    }
+
+private:
+    bool loadTraits();
+    void rebuild(const std::vector<PresetInfo>& presets);
+    std::optional<usize> drawFrom(const std::vector<u32>& bucket,
+                                  const Eligible& eligible,
+                                  std::mt19937& rng) const;
+    std::optional<usize> walkGrid(const PresetTraits& target,
+                                  const Eligible& eligible,
+                                  std::mt19937& rng) const;
+
+    std::unordered_map<u64, PresetTraits> traits_; // By content hash
+    fs::file_time_type traitsTime_{};
+    bool dirty_{true};
+
+    std::array<std::vector<u32>, GRID * GRID> cells_;
+    std::vector<u32> unknown_;
+    usize known_{0};
+    usize total_{0};
+    usize avoid_{AVOID_RECENT}; // Capped for small known sets on rebuild
+
+    std::deque<usize> recent_;
+    std::unordered_set<usize> recentSet_;
+};
+
+} // namespace vc
@@ -29,6 +29,13 @@ VisualizerWindow::VisualizerWindow(QWindow* parent) : QWindow(parent) {
     fpsTimer_.setInterval(1000);
     connect(&fpsTimer_, &QTimer::timeout, this, &VisualizerWindow::updateFPS);
     connect(&renderTimer_, &QTimer::timeout, this, &VisualizerWindow::render);
+
+    presetRescanTimer_.setSingleShot(true);
+    presetRescanTimer_.setInterval(500);
+    connect(&presetRescanTimer_,
+            &QTimer::timeout,
+            this,
+            &VisualizerWindow::onPresetsChangedOnDisk);
 }
 
 VisualizerWindow::~VisualizerWindow() {
@@ -36,9 +43,12 @@ VisualizerWindow::~VisualizerWindow() {
         this->destroyPBOs();
         projectM_.shutdown();
         renderTarget_.destroy();
-        overlayTarget_.destroy();
+        captureTarget_ = nullptr;
+        targetPool_.clear();
+        compositor_.destroy();
         context_->doneCurrent();
     }
+    presetPreloader_.stop();
 }
 
 void VisualizerWindow::exposeEvent(QExposeEvent* event) {
@@ -83,18 +93,28 @@ void VisualizerWindow::initialize() {
     pmConfig.transitionDuration = vizConfig.smoothPresetDuration;
     pmConfig.shufflePresets = vizConfig.shufflePresets;
     pmConfig.useDefaultPreset = vizConfig.useDefaultPreset;
-
-    projectM_.presetLoading.connect(
-            [this](bool loading) { presetLoading_ = loading; });
+    pmConfig.gpuBudgetMs = vizConfig.gpuBudgetMs;
+
+    // Must be running before init() selects the first preset, and know
+    // about a preset pack before it is asked to read from one
+    presetPreloader_.start();
+    projectM_.presets().listChanged.connect([this] {
+        presetPreloader_.setPack(projectM_.presets().pack());
+    });
     projectM_.presetChanged.connect(
             [this](const std::string& name) { loadPresetFromManager(); });
 
     if (auto result = projectM_.init(pmConfig); !result)
         return;
 
+    this->watchPresetDirectories();
+
     // Use withDepth=true for projectM rendering
     renderTarget_.create(width(), height(), true);
-    overlayTarget_.create(width(), height(), false);
+    if (auto result = compositor_.init(); !result) {
+        LOG_ERROR("{} - falling back to blits, overlay won't be recorded",
+                  result.error().message);
+    }
 
     setRenderRate(vizConfig.fps);
     renderTimer_.start();
@@ -114,12 +134,74 @@ void VisualizerWindow::initialize() {
 }
 
 void VisualizerWindow::onPresetRotationTimeout() {
+    if (this->smartRotation()) {
+        // Pick for the music playing now, then hold the switch for the
+        // next downbeat; the preloader has the bar's length to read it
+        AudioFeatures features;
+        {
+            std::lock_guard lock(audioMutex_);
+            features = audioFeatures_;
+        }
+        const auto* next = projectM_.presets().planSmart(features);
+        if (!next)
+            return;
+        presetPreloader_.request(next->path);
+        rotationDownbeat_ = features.downbeatCount;
+        rotationWait_.start();
+        rotationPending_ = true;
+        return;
+    }
     if (CONFIG.visualizer().shufflePresets)
         projectM_.randomPreset();
     else
         projectM_.nextPreset();
 }
 
+bool VisualizerWindow::smartRotation() const {
+    const auto& vizConfig = CONFIG.visualizer();
+    return vizConfig.shufflePresets && vizConfig.smartRotation;
+}
+
+void VisualizerWindow::rotateOnDownbeat() {
+    if (!rotationPending_)
+        return;
+    u64 downbeats;
+    {
+        std::lock_guard lock(audioMutex_);
+        downbeats = audioFeatures_.downbeatCount;
+    }
+    // Silence or beatless audio never produces one, hence the deadline
+    if (downbeats == rotationDownbeat_ &&
+        rotationWait_.elapsed() < MAX_DOWNBEAT_WAIT_MS)
+        return;
+    rotationPending_ = false;
+    projectM_.randomPreset(); // Takes the pick planned by planSmart()
+}
+
+void VisualizerWindow::watchPresetDirectories() {
+    if (!presetWatcher_.isAvailable())
+        return;
+    presetWatcher_.watch(projectM_.presets().directories());
+    if (!presetNotifier_) {
+        presetNotifier_ = std::make_unique<QSocketNotifier>(
+                presetWatcher_.fd(), QSocketNotifier::Read);
+        connect(presetNotifier_.get(),
+                &QSocketNotifier::activated,
+                this,
+                [this] {
+                    if (presetWatcher_.drain())
+                        presetRescanTimer_.start();
+                });
+    }
+}
+
+void VisualizerWindow::onPresetsChangedOnDisk() {
+    // Only directories whose mtime moved get listed again
+    projectM_.presets().rescan();
+    this->watchPresetDirectories();
+    this->preloadNextPreset();
+}
+
 void VisualizerWindow::render() {
     if (!initialized_ || !isExposed())
         return;
@@ -149,7 +231,11 @@ void VisualizerWindow::renderFrame() {
         renderH = std::max(120u, h / 2);
     }
 
-    // 2. Feed audio data
+    // 2. Swap in a newly selected preset if its text has arrived
+    this->rotateOnDownbeat();
+    this->applyPendingPreset();
+
+    // 3. Feed audio data
     {
         std::lock_guard lock(audioMutex_);
         if (!audioQueue_.empty()) {
@@ -173,69 +259,96 @@ void VisualizerWindow::renderFrame() {
             projectM_.resize(renderW, renderH);
         }
 
-        if (presetLoading_) {
-            renderTarget_.bind();
-            glClearColor(0, 0, 0, 1);
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-            renderTarget_.unbind();
-        } else {
-            projectM_.renderToTarget(renderTarget_);
-        }
+        projectM_.renderToTarget(renderTarget_);
 
-        // Output from FBO
-        if (recording_) {
-            if (overlayTarget_.width() != renderW ||
-                overlayTarget_.height() != renderH) {
-                overlayTarget_.resize(renderW, renderH);
-                this->setupPBOs();
-            }
+        GLuint screenFbo = context_->defaultFramebufferObject();
+        bool capturing =
+                recording_ && this->ensureCaptureTarget(renderW, renderH);
 
+        if (compositor_.isInitialized()) {
+            // Overlay is rasterized once, at the size of the largest output
+            // we care about, and sampled by every compositor pass
+            Compositor::Layers layers;
+            layers.scene = renderTarget_.texture();
+            layers.sceneScale = renderTarget_.uvScale();
             if (overlayEngine_) {
-                overlayTarget_.bind();
-                glClearColor(0, 0, 0, 0);
-                glClear(GL_COLOR_BUFFER_BIT);
-                renderTarget_.blitTo(overlayTarget_, true);
-                overlayEngine_->render(renderW, renderH);
-                this->captureAsync();
-                overlayTarget_.unbind();
-            } else {
-                renderTarget_.bind();
+                overlayEngine_->prepare(recording_ ? renderW : w,
+                                        recording_ ? renderH : h);
+                layers.overlay = overlayEngine_->texture();
+            }
+
+            if (capturing) {
+                // Capture: flipped so rows read back top-down, optionally
+                // already in the encoder's color space
+                compositor_.compose(
+                        layers,
+                        {captureTarget_->fbo(),
+                         renderW,
+                         renderH,
+                         true,
+                         captureYCbCr_ ? Compositor::Encoding::YCbCr709
+                                       : Compositor::Encoding::RGBA});
                 this->captureAsync();
-                renderTarget_.unbind();
+                emit frameReady();
             }
-            emit frameReady();
-        }
 
-        // Blit back to screen
-        glBindFramebuffer(GL_FRAMEBUFFER, context_->defaultFramebufferObject());
-        glViewport(0, 0, w, h);
-        glClearColor(0, 0, 0, 1);
-        glClear(GL_COLOR_BUFFER_BIT);
-        renderTarget_.blitToScreen(w, h, true);
-    } else {
-        // Direct to screen (Peak Performance Mode)
-        projectM_.resetViewport(w, h);
-        if (presetLoading_) {
-            glClearColor(0, 0, 0, 1);
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            compositor_.compose(layers, {screenFbo, w, h});
         } else {
-            projectM_.render();
+            if (capturing) {
+                renderTarget_.blitTo(*captureTarget_, false, true);
+                this->captureAsync();
+                emit frameReady();
+            }
 
-            // ProjectM often leaves alpha at 0, which breaks some compositors
-            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_TRUE);
+            glBindFramebuffer(GL_FRAMEBUFFER, screenFbo);
+            glViewport(0, 0, w, h);
             glClearColor(0, 0, 0, 1);
             glClear(GL_COLOR_BUFFER_BIT);
-            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+            renderTarget_.blitToScreen(w, h, true);
+            if (overlayEngine_)
+                overlayEngine_->render(w, h);
         }
-    }
+    } else {
+        // Direct to screen (Peak Performance Mode)
+        projectM_.resetViewport(w, h);
+        projectM_.render();
+
+        // ProjectM often leaves alpha at 0, which breaks some compositors
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_TRUE);
+        glClearColor(0, 0, 0, 1);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
 
-    if (overlayEngine_) {
-        overlayEngine_->render(w, h);
+        if (overlayEngine_) {
+            overlayEngine_->render(w, h);
+        }
     }
 
     ++frameCount_;
 }
 
+bool VisualizerWindow::ensureCaptureTarget(u32 width, u32 height) {
+    if (captureTarget_ && captureTarget_->width() == width &&
+        captureTarget_->height() == height)
+        return true;
+
+    if (captureTarget_) {
+        if (auto result = captureTarget_->resize(width, height); !result) {
+            LOG_ERROR("Capture target: {}", result.error().message);
+            return false;
+        }
+    } else {
+        auto result = targetPool_.acquire(width, height, false);
+        if (!result) {
+            LOG_ERROR("Capture target: {}", result.error().message);
+            return false;
+        }
+        captureTarget_ = *result;
+    }
+    this->setupPBOs();
+    return true;
+}
+
 void VisualizerWindow::setupPBOs() {
     this->destroyPBOs();
     glGenBuffers(2, pbos_);
@@ -258,6 +371,10 @@ void VisualizerWindow::destroyPBOs() {
 void VisualizerWindow::captureAsync() {
     u32 nextIndex = (pboIndex_ + 1) % 2;
     u32 size = recordWidth_ * recordHeight_ * 4;
+
+    // captureTarget_ already holds this frame top-down (flipped while
+    // compositing), so the readback needs no CPU fix-up
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, captureTarget_->fbo());
     glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos_[pboIndex_]);
     glReadPixels(0,
                  0,
@@ -266,23 +383,31 @@ void VisualizerWindow::captureAsync() {
                  GL_RGBA,
                  GL_UNSIGNED_BYTE,
                  nullptr);
-    if (pboAvailable_) {
+    // The frame read now is mapped next time; its timestamp goes with it
+    pboTimestamps_[pboIndex_] =
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch())
+                    .count();
+    // No free buffer means the encoder is behind, and one that's too small
+    // that the pool is still sized for another resolution. Either way skip
+    // the map entirely so the drop costs nothing (the pool counts it).
+    FrameHandle buffer;
+    if (pboAvailable_ && framePool_ && framePool_->isInitialized())
+        buffer = framePool_->acquire(size);
+    if (buffer) {
         glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos_[nextIndex]);
         u8* ptr = (u8*)glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
         if (ptr) {
-            std::vector<u8> buffer(ptr,
-                                   ptr + size); // Copy from PBO to CPU RAM once
+            std::memcpy(buffer.data(), ptr, size); // PBO to pooled RAM once
             glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
-            emit frameCaptured(
-                    std::move(buffer), // Pass moved vector to signal
-                    recordWidth_,
-                    recordHeight_,
-                    std::chrono::duration_cast<std::chrono::microseconds>(
-                            std::chrono::steady_clock::now().time_since_epoch())
-                            .count());
+            emit frameCaptured(std::move(buffer), // Handle, not pixels
+                               recordWidth_,
+                               recordHeight_,
+                               pboTimestamps_[nextIndex]);
         }
     }
     glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
     pboIndex_ = nextIndex;
     pboAvailable_ = true;
 }
@@ -299,6 +424,11 @@ void VisualizerWindow::feedAudio(const f32* data,
     std::memcpy(audioQueue_.data() + offset, data, frames * 2 * sizeof(f32));
 }
 
+void VisualizerWindow::setAudioFeatures(const AudioFeatures& features) {
+    std::lock_guard lock(audioMutex_);
+    audioFeatures_ = features;
+}
+
 void VisualizerWindow::setRenderRate(int fps) {
     if (fps > 0) {
         targetFps_ = fps;
@@ -317,9 +447,9 @@ void VisualizerWindow::startRecording() {
     recording_ = true;
     if (context_ && context_->makeCurrent(this)) {
         renderTarget_.resize(recordWidth_, recordHeight_);
-        overlayTarget_.resize(recordWidth_, recordHeight_);
+        // Sets up the PBOs too
+        this->ensureCaptureTarget(recordWidth_, recordHeight_);
         projectM_.resize(recordWidth_, recordHeight_);
-        this->setupPBOs();
         context_->doneCurrent();
     }
 }
@@ -328,6 +458,12 @@ void VisualizerWindow::stopRecording() {
     recording_ = false;
     if (context_ && context_->makeCurrent(this)) {
         this->destroyPBOs();
+        // Back to the pool with its storage intact; the next recording
+        // picks it up without touching the allocator
+        if (captureTarget_) {
+            targetPool_.release(captureTarget_);
+            captureTarget_ = nullptr;
+        }
         // Resize back to window resolution handled in next renderFrame
         context_->doneCurrent();
     }
@@ -355,30 +491,53 @@ void VisualizerWindow::updateFPS() {
 }
 
 void VisualizerWindow::loadPresetFromManager() {
-    std::lock_guard lock(presetLoadMutex_);
-    if (presetLoadInProgress_)
-        return;
-    presetLoadInProgress_ = true;
-    if (!context_ || !context_->isValid() || !context_->makeCurrent(this)) {
-        presetLoadInProgress_ = false;
+    // No GL work here: the file is read on the I/O thread and renderFrame()
+    // hands it to projectM, so the old preset keeps animating meanwhile
+    const auto* preset = projectM_.presets().current();
+    if (!preset) {
+        LOG_WARN("Cannot load preset: nothing selected");
         return;
     }
-    presetLoading_ = true;
-    const auto* preset = projectM_.presets().current();
-    auto handle = projectM_.getHandle();
+    pendingPreset_ = preset->path;
+    pendingPresetName_ = preset->name;
+    presetPreloader_.request(pendingPreset_);
+    rotationPending_ = false; // Whatever changed it beat the downbeat
+}
 
-    if (preset && handle) {
-        LOG_DEBUG("Loading preset: {}", preset->name);
-        projectm_load_preset_file(handle, preset->path.c_str(), false);
-        emit presetNameUpdated(QString::fromStdString(preset->name));
-    } else {
-        LOG_WARN("Cannot load preset: preset={}, handle={}",
-                 (void*)preset,
-                 (void*)handle);
-    }
-    presetLoading_ = false;
-    presetLoadInProgress_ = false;
-    context_->doneCurrent();
+void VisualizerWindow::applyPendingPreset() {
+    if (pendingPreset_.empty() || !projectM_.isInitialized())
+        return;
+
+    auto data = presetPreloader_.take(pendingPreset_);
+    if (!data && presetPreloader_.isRunning())
+        return; // Still reading; try again next frame
+
+    // Parsing and shader compilation still run here, on projectM's context.
+    // A soft cut keeps the outgoing preset on screen while it happens.
+    LOG_DEBUG("Loading preset: {}", pendingPresetName_);
+    projectM_.applyPreset(pendingPreset_,
+                          pendingPresetName_,
+                          data ? *data : std::string{},
+                          presetShown_);
+    presetShown_ = true;
+
+    emit presetNameUpdated(QString::fromStdString(pendingPresetName_));
+    pendingPreset_.clear();
+    pendingPresetName_.clear();
+
+    this->preloadNextPreset();
+}
+
+void VisualizerWindow::preloadNextPreset() {
+    // Read the rotation's next pick now, well before presetRotationTimer_
+    // fires, so the switch never waits on the disk. Smart rotation can't
+    // know the pick that early; it preloads while waiting for a downbeat.
+    if (this->smartRotation())
+        return;
+    const auto* next =
+            projectM_.presets().planNext(CONFIG.visualizer().shufflePresets);
+    if (next)
+        presetPreloader_.request(next->path);
 }
 
 void VisualizerWindow::updateSettings() {
@@ -388,11 +547,15 @@ void VisualizerWindow::updateSettings() {
     setRenderRate(vizConfig.fps);
     projectM_.setBeatSensitivity(vizConfig.beatSensitivity);
     projectM_.setShuffleEnabled(vizConfig.shufflePresets);
+    projectM_.setGpuBudget(vizConfig.gpuBudgetMs);
     presetRotationTimer_.stop();
+    rotationPending_ = false;
     if (vizConfig.presetDuration > 0 && !vizConfig.useDefaultPreset) {
         presetRotationTimer_.setInterval(vizConfig.presetDuration * 1000);
         presetRotationTimer_.start();
     }
+    // Shuffle may have been toggled; re-plan the next pick
+    this->preloadNextPreset();
 }
 
 void VisualizerWindow::keyPressEvent(QKeyEvent* event) {
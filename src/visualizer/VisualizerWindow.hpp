@@ -2,13 +2,21 @@
 // VisualizerWindow.hpp - QWindow-based visualization
 // Now with Async PBO Recording for peak performance.
 
+#include "Compositor.hpp"
+#include "PresetPreloader.hpp"
+#include "PresetWatcher.hpp"
 #include "ProjectMBridge.hpp"
 #include "RenderTarget.hpp"
+#include "RenderTargetPool.hpp"
+#include "audio/AudioAnalyzer.hpp"
+#include "recorder/FramePool.hpp"
 #include "util/GLIncludes.hpp"
 #include "util/Types.hpp"
 
+#include <QElapsedTimer>
 #include <QOpenGLContext>
 #include <QOpenGLFunctions_3_3_Core>
+#include <QSocketNotifier>
 #include <QTimer>
 #include <QWindow>
 #include <atomic>
@@ -26,7 +34,7 @@ class VisualizerWindow : public QWindow, protected QOpenGLFunctions_3_3_Core {
 signals:
     void presetNameUpdated(const QString& name);
     void frameReady();
-    void frameCaptured(std::vector<u8> data,
+    void frameCaptured(vc::FrameHandle data,
                        u32 width,
                        u32 height,
                        i64 timestamp);
@@ -54,6 +62,18 @@ public:
         return renderTarget_;
     }
     void setRecordingSize(u32 width, u32 height);
+    // Captured frames are copied out of the PBOs into buffers from this pool
+    void setFramePool(FramePool* pool) {
+        framePool_ = pool;
+    }
+    // Capture BT.709 VUYA instead of RGBA (encoder must agree). Needs the
+    // compositor; the blit fallback can only produce RGBA.
+    bool canCaptureYCbCr() const {
+        return compositor_.isInitialized();
+    }
+    void setCaptureYCbCr(bool enabled) {
+        captureYCbCr_ = enabled && canCaptureYCbCr();
+    }
     bool isRecording() const {
         return recording_;
     }
@@ -61,6 +81,8 @@ public:
     void stopRecording();
     void setRenderRate(int fps);
     void feedAudio(const f32* data, u32 frames, u32 channels, u32 sampleRate);
+    // Latest AudioAnalyzer features, from any thread; steer smart rotation
+    void setAudioFeatures(const AudioFeatures& features);
 
 public slots:
     void toggleFullscreen();
@@ -75,35 +97,58 @@ private slots:
     void render();
     void updateFPS();
     void onPresetRotationTimeout();
+    void onPresetsChangedOnDisk();
 
 private:
     void initialize();
     void renderFrame();
     void setupPBOs();
     void destroyPBOs();
+    bool ensureCaptureTarget(u32 width, u32 height);
+    void applyPendingPreset();
+    void preloadNextPreset();
+    bool smartRotation() const;
+    void rotateOnDownbeat();
+    void watchPresetDirectories();
     void captureAsync();
     void cleanup();
 
     std::unique_ptr<QOpenGLContext> context_;
     ProjectMBridge projectM_;
-    bool presetLoading_{false};
+    PresetPreloader presetPreloader_;
+    fs::path pendingPreset_; // Selected, applied once its text is in memory
+    std::string pendingPresetName_;
+    bool presetShown_{false}; // First preset cuts in, the rest blend
+    PresetWatcher presetWatcher_;
+    std::unique_ptr<QSocketNotifier> presetNotifier_;
+    QTimer presetRescanTimer_; // Debounces bursts like an unzip
     OverlayEngine* overlayEngine_{nullptr};
 
     RenderTarget renderTarget_;
-    RenderTarget overlayTarget_;
+    RenderTargetPool targetPool_;
+    RenderTarget* captureTarget_{nullptr}; // Top-down composite for the PBOs
+    Compositor compositor_;
 
     QTimer renderTimer_;
     QTimer fpsTimer_;
     QTimer presetRotationTimer_;
 
+    // Smart rotation: the timer picks, the next downbeat switches
+    static constexpr i64 MAX_DOWNBEAT_WAIT_MS = 4000;
+    bool rotationPending_{false};
+    u64 rotationDownbeat_{0}; // downbeatCount when the timer fired
+    QElapsedTimer rotationWait_;
+
     // Recording & PBOs
     bool recording_{false};
     u32 recordWidth_{1920};
     u32 recordHeight_{1080};
     GLuint pbos_[2]{0, 0};
+    i64 pboTimestamps_[2]{0, 0}; // When each PBO's frame was rendered
     u32 pboIndex_{0};
     bool pboAvailable_{false};
-    std::vector<u8> captureBuffer_;
+    bool captureYCbCr_{false};
+    FramePool* framePool_{nullptr};
 
     u32 targetFps_{60};
     u32 frameCount_{0};
@@ -116,9 +161,7 @@ private:
     std::mutex audioMutex_;
     std::vector<f32> audioQueue_;
     u32 audioSampleRate_{48000};
-
-    std::mutex presetLoadMutex_;
-    bool presetLoadInProgress_{false};
+    AudioFeatures audioFeatures_;
 };
 
 } // namespace vc
@@ -0,0 +1,148 @@
+/**
+ * @file test_capture_orientation.cpp
+ * @brief Capture path must hand the encoder top-down rows without a CPU flip
+ *
+ * Renders a known pattern (top half green, bottom half red in screen terms)
+ * into an FBO, runs it through the compositor's capture pass (and the blit
+ * fallback) plus PBO readback like VisualizerWindow does, and checks that
+ * row 0 of the result is the top.
+ */
+#include "util/GLIncludes.hpp"
+#include "visualizer/Compositor.hpp"
+#include "visualizer/RenderTarget.hpp"
+
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QtTest>
+#include <cstring>
+#include <vector>
+
+using namespace vc;
+
+class TestCaptureOrientation : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void flippedBlitIsTopDown();
+    void pboReadbackIsTopDown();
+    void compositorCaptureIsTopDown();
+    void cleanupTestCase();
+
+private:
+    void drawPattern(RenderTarget& target);
+    static bool isGreen(const u8* px) {
+        return px[0] < 16 && px[1] > 240 && px[2] < 16;
+    }
+    static bool isRed(const u8* px) {
+        return px[0] > 240 && px[1] < 16 && px[2] < 16;
+    }
+
+    static constexpr u32 W = 64;
+    static constexpr u32 H = 32;
+
+    QOffscreenSurface surface_;
+    QOpenGLContext context_;
+};
+
+void TestCaptureOrientation::initTestCase() {
+    surface_.create();
+    QVERIFY(context_.create());
+    QVERIFY(context_.makeCurrent(&surface_));
+    glewExperimental = GL_TRUE;
+    QCOMPARE(glewInit(), GLenum(GLEW_OK));
+}
+
+void TestCaptureOrientation::cleanupTestCase() {
+    context_.doneCurrent();
+}
+
+void TestCaptureOrientation::drawPattern(RenderTarget& target) {
+    // GL's origin is bottom-left: y in [0, H/2) is the bottom of the image
+    target.bind();
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(0, 0, W, H / 2);
+    glClearColor(1, 0, 0, 1);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glScissor(0, H / 2, W, H / 2);
+    glClearColor(0, 1, 0, 1);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glDisable(GL_SCISSOR_TEST);
+    target.unbind();
+}
+
+void TestCaptureOrientation::flippedBlitIsTopDown() {
+    RenderTarget source, capture;
+    QVERIFY(source.create(W, H));
+    QVERIFY(capture.create(W, H));
+    drawPattern(source);
+
+    source.blitTo(capture, false, true);
+
+    std::vector<u8> pixels(W * H * 4);
+    capture.readPixels(pixels.data());
+
+    // Memory row 0 is what the encoder treats as the top line
+    QVERIFY(isGreen(pixels.data()));
+    QVERIFY(isRed(pixels.data() + (H - 1) * W * 4));
+}
+
+void TestCaptureOrientation::pboReadbackIsTopDown() {
+    RenderTarget source, capture;
+    QVERIFY(source.create(W, H));
+    QVERIFY(capture.create(W, H));
+    drawPattern(source);
+
+    source.blitTo(capture, false, true);
+
+    GLuint pbo = 0;
+    glGenBuffers(1, &pbo);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+    glBufferData(GL_PIXEL_PACK_BUFFER, W * H * 4, nullptr, GL_STREAM_READ);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, capture.fbo());
+    glReadPixels(0, 0, W, H, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+    std::vector<u8> pixels(W * H * 4);
+    auto* ptr = static_cast<const u8*>(
+            glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY));
+    QVERIFY(ptr != nullptr);
+    std::memcpy(pixels.data(), ptr, pixels.size());
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glDeleteBuffers(1, &pbo);
+
+    for (u32 y = 0; y < H; ++y) {
+        const u8* row = pixels.data() + y * W * 4;
+        if (y < H / 2)
+            QVERIFY2(isGreen(row), qPrintable(QString("row %1").arg(y)));
+        else
+            QVERIFY2(isRed(row), qPrintable(QString("row %1").arg(y)));
+    }
+}
+
+void TestCaptureOrientation::compositorCaptureIsTopDown() {
+    RenderTarget source, capture;
+    QVERIFY(source.create(W, H));
+    QVERIFY(capture.create(W, H));
+    drawPattern(source);
+
+    Compositor compositor;
+    auto result = compositor.init();
+    QVERIFY2(result, result ? "" : result.error().message.c_str());
+
+    // Storage is rounded up to a size class; only the logical region counts
+    QVERIFY(source.allocatedWidth() > W);
+    compositor.compose({source.texture(), 0, source.uvScale()},
+                       {capture.fbo(), W, H, true});
+
+    std::vector<u8> pixels(W * H * 4);
+    capture.readPixels(pixels.data());
+
+    QVERIFY(isGreen(pixels.data()));
+    QVERIFY(isRed(pixels.data() + (H - 1) * W * 4));
+}
+
+QTEST_MAIN(TestCaptureOrientation)
+#include "test_capture_orientation.moc"
@@ -0,0 +1,199 @@
+/**
+ * @file test_ColorConvert.cpp
+ * @brief ColorConverter: AVX2 against scalar, odd sizes, sliced conversion
+ *
+ * Planes are padded and pre-filled with a guard byte, so a kernel writing
+ * past the edge of a row or plane shows up as a changed guard.
+ */
+#include "recorder/ColorConvert.hpp"
+#include "util/WorkerPool.hpp"
+
+#include <QtTest>
+#include <random>
+#include <vector>
+
+using namespace vc;
+
+namespace {
+
+constexpr u8 GUARD = 0xCD;
+constexpr u32 PAD = 32;
+
+// Frames that are neither multiples of 16 wide nor even in either direction
+const Size SIZES[] = {{1, 1},
+                      {3, 2},
+                      {15, 3},
+                      {17, 17},
+                      {31, 64},
+                      {33, 65},
+                      {101, 129},
+                      {255, 7}};
+
+const ChromaFormat CHROMAS[] = {
+        ChromaFormat::Yuv420, ChromaFormat::Yuv422, ChromaFormat::Yuv444};
+
+struct Planes {
+    Planes(ChromaFormat chroma, u32 width, u32 height) {
+        u32 cw = chroma == ChromaFormat::Yuv444 ? width : (width + 1) / 2;
+        u32 ch = chroma == ChromaFormat::Yuv420 ? (height + 1) / 2 : height;
+        widths = {width, cw, cw};
+        heights = {height, ch, ch};
+        for (usize i = 0; i < 3; ++i) {
+            strides[i] = widths[i] + PAD;
+            bytes[i].assign(static_cast<usize>(strides[i]) * (heights[i] + 1),
+                            GUARD);
+            image.data[i] = bytes[i].data();
+            image.stride[i] = static_cast<i32>(strides[i]);
+        }
+    }
+
+    // Everything outside the picture still holds GUARD
+    bool guardsIntact() const {
+        for (usize i = 0; i < 3; ++i) {
+            for (usize at = 0; at < bytes[i].size(); ++at) {
+                u32 y = static_cast<u32>(at / strides[i]);
+                u32 x = static_cast<u32>(at % strides[i]);
+                bool inside = y < heights[i] && x < widths[i];
+                if (!inside && bytes[i][at] != GUARD)
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    bool operator==(const Planes& other) const {
+        return bytes == other.bytes;
+    }
+
+    std::array<u32, 3> widths{}, heights{}, strides{};
+    std::array<std::vector<u8>, 3> bytes;
+    PlanarImage image;
+};
+
+std::vector<u8> noise(u32 width, u32 height, usize stride) {
+    std::mt19937 rng(width * 131 + height);
+    std::uniform_int_distribution<int> byte(0, 255);
+    std::vector<u8> pixels(stride * height);
+    for (auto& p : pixels)
+        p = static_cast<u8>(byte(rng));
+    return pixels;
+}
+
+QString describe(ChromaFormat chroma, bool fullRange, Size size) {
+    static const char* names[] = {"420", "422", "444"};
+    return QString("%1 %2 %3x%4")
+            .arg(names[static_cast<int>(chroma)])
+            .arg(fullRange ? "full" : "limited")
+            .arg(size.width)
+            .arg(size.height);
+}
+
+} // namespace
+
+class TestColorConvert : public QObject {
+    Q_OBJECT
+
+private slots:
+    void avx2MatchesScalar();
+    void oddSizesStayInBounds();
+    void slicedMatchesWhole();
+};
+
+void TestColorConvert::avx2MatchesScalar() {
+    if (!ColorConverter::cpuHasAvx2())
+        QSKIP("CPU has no AVX2");
+
+    for (ChromaFormat chroma : CHROMAS) {
+        for (bool fullRange : {false, true}) {
+            ColorConverter::Format format;
+            format.chroma = chroma;
+            format.fullRange = fullRange;
+            ColorConverter simd(format);
+            ColorConverter scalar(format, false);
+            QVERIFY(simd.usesAvx2());
+            QVERIFY(!scalar.usesAvx2());
+
+            for (Size size : SIZES) {
+                usize stride = static_cast<usize>(size.width) * 4 + 12;
+                auto src = noise(size.width, size.height, stride);
+                Planes a(chroma, size.width, size.height);
+                Planes b(chroma, size.width, size.height);
+                simd.convert(src.data(),
+                             stride,
+                             size.width,
+                             size.height,
+                             a.image,
+                             nullptr);
+                scalar.convert(src.data(),
+                               stride,
+                               size.width,
+                               size.height,
+                               b.image,
+                               nullptr);
+                QVERIFY2(a == b,
+                         qPrintable(describe(chroma, fullRange, size)));
+            }
+        }
+    }
+}
+
+void TestColorConvert::oddSizesStayInBounds() {
+    for (ChromaFormat chroma : CHROMAS) {
+        for (bool vuya : {false, true}) {
+            ColorConverter::Format format;
+            format.vuya = vuya;
+            format.chroma = chroma;
+            ColorConverter converter(format, false);
+
+            for (Size size : SIZES) {
+                usize stride = static_cast<usize>(size.width) * 4;
+                auto src = noise(size.width, size.height, stride);
+                Planes planes(chroma, size.width, size.height);
+                converter.convert(src.data(),
+                                  stride,
+                                  size.width,
+                                  size.height,
+                                  planes.image,
+                                  nullptr);
+                QVERIFY2(planes.guardsIntact(),
+                         qPrintable(describe(chroma, false, size) +
+                                    (vuya ? " vuya" : " rgba")));
+            }
+        }
+    }
+}
+
+void TestColorConvert::slicedMatchesWhole() {
+    // Slice edges land on even rows; the odd last row stays with the last
+    WorkerPool pool;
+    pool.start(3);
+    const Size size{203, 517};
+    usize stride = static_cast<usize>(size.width) * 4;
+    auto src = noise(size.width, size.height, stride);
+
+    for (ChromaFormat chroma : CHROMAS) {
+        ColorConverter::Format format;
+        format.chroma = chroma;
+        ColorConverter converter(format);
+        Planes whole(chroma, size.width, size.height);
+        Planes sliced(chroma, size.width, size.height);
+        converter.convert(src.data(),
+                          stride,
+                          size.width,
+                          size.height,
+                          whole.image,
+                          nullptr);
+        converter.convert(src.data(),
+                          stride,
+                          size.width,
+                          size.height,
+                          sliced.image,
+                          &pool);
+        QVERIFY2(whole == sliced,
+                 qPrintable(describe(chroma, false, size)));
+    }
+    pool.stop();
+}
+
+QTEST_MAIN(TestColorConvert)
+#include "test_ColorConvert.moc"
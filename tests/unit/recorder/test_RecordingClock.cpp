@@ -0,0 +1,195 @@
+/**
+ * @file test_RecordingClock.cpp
+ * @brief RecordingClock and frame placement on simulated recordings
+ *
+ * Audio arrives in 10 ms buffers and video at 60 fps, both stamped by a
+ * simulated steady clock with some delivery jitter. Frames are placed the
+ * way VideoRecorder does it: repeats fill late gaps, early frames drop.
+ */
+#include "recorder/RecordingClock.hpp"
+
+#include <QtTest>
+#include <cmath>
+#include <functional>
+#include <random>
+
+using namespace vc;
+
+namespace {
+
+constexpr i64 ORIGIN_US = 5'000'000'000; // Steady clock at recording zero
+constexpr u32 SAMPLE_RATE = 48000;
+constexpr u64 BUFFER_FRAMES = 480;
+constexpr f64 FPS = 60.0;
+constexpr f64 FRAME_US = 1e6 / FPS;
+constexpr i64 SECOND_US = 1'000'000;
+// Where the video ends against the audio: a frame either way is jitter,
+// and the audio is only known up to the end of its last buffer
+constexpr f64 SYNC_SLACK_US = FRAME_US + 10'000;
+
+class Simulation {
+public:
+    // `ppm`: how fast the audio hardware runs against steady_clock
+    explicit Simulation(f64 ppm) : audioRate_(1.0 + ppm * 1e-6) {
+        clock.reset(ORIGIN_US, SAMPLE_RATE);
+    }
+
+    // Runs both streams up to `untilUs` after zero. While `stalled` no
+    // audio arrives; afterwards it carries on from the last sample, as a
+    // paused or starved source does.
+    void run(i64 untilUs, bool stalled = false) {
+        const auto end = static_cast<f64>(untilUs);
+        for (;;) {
+            f64 videoAt = static_cast<f64>(frame_) * FRAME_US;
+            bool audioNext = !stalled && nextAudioUs_ <= videoAt;
+            if ((audioNext ? nextAudioUs_ : videoAt) >= end)
+                break;
+            if (audioNext) {
+                clock.addAudio(BUFFER_FRAMES, stamp(nextAudioUs_, 1000));
+                samples_ += BUFFER_FRAMES;
+                nextAudioUs_ += static_cast<f64>(BUFFER_FRAMES) * 1e6 /
+                                SAMPLE_RATE / audioRate_;
+            } else {
+                if (!skip(frame_))
+                    capture(stamp(videoAt, 2000));
+                ++frame_;
+            }
+        }
+        if (stalled)
+            nextAudioUs_ = std::max(nextAudioUs_, end);
+    }
+
+    // Where the video ends against where the audio does, in recording time
+    i64 syncErrorUs() const {
+        f64 audioEnd = static_cast<f64>(clock.audioStart() +
+                                        static_cast<i64>(samples_)) *
+                       1e6 / SAMPLE_RATE;
+        return std::llround(static_cast<f64>(next) * FRAME_US - audioEnd);
+    }
+
+    // Captures the renderer never delivered
+    std::function<bool(u64)> skip = [](u64) { return false; };
+
+    RecordingClock clock;
+    i64 next{0}; // VideoRecorder's videoFrameCount_
+    bool started{false};
+    u64 repeats{0};
+    u64 drops{0};
+    i64 maxDriftUs{0};
+
+private:
+    // VideoRecorder::placeOnTimeline and the encode that follows it
+    void capture(i64 steadyUs) {
+        auto placement = clock.place(steadyUs, FPS, next, started);
+        next = placement.next;
+        if (placement.drop) {
+            ++drops;
+            return;
+        }
+        repeats += placement.repeats;
+        next += placement.repeats + 1;
+        started = true;
+        maxDriftUs = std::max(maxDriftUs, std::abs(placement.driftUs));
+    }
+
+    // Delivered up to `jitterUs` late
+    i64 stamp(f64 us, int jitterUs) {
+        std::uniform_int_distribution<int> jitter(0, jitterUs);
+        return ORIGIN_US + std::llround(us) + jitter(rng_);
+    }
+
+    f64 audioRate_;
+    f64 nextAudioUs_{20'000}; // The first buffer lands 20 ms in
+    u64 samples_{0};
+    u64 frame_{0};
+    std::mt19937 rng_{42};
+};
+
+} // namespace
+
+class TestRecordingClock : public QObject {
+    Q_OBJECT
+
+private slots:
+    void steadyClocksNeedNoFill();
+    void fastAudioOverAnHour();
+    void slowAudioOverAnHour();
+    void stallResyncs();
+    void missedCapturesAreRepeated();
+};
+
+void TestRecordingClock::steadyClocksNeedNoFill() {
+    // Long enough for a millisecond of jitter to stay under 2 ppm
+    Simulation sim(0.0);
+    sim.run(600 * SECOND_US);
+
+    QVERIFY(sim.clock.hasAudio());
+    // The first buffer's 10 ms ended 20 ms in, give or take its jitter
+    QVERIFY(sim.clock.audioStart() >= 480 && sim.clock.audioStart() <= 528);
+    QCOMPARE(sim.repeats, u64(0));
+    QCOMPARE(sim.drops, u64(0));
+    QCOMPARE(sim.clock.resyncs(), u64(0));
+    QVERIFY(std::abs(sim.clock.skewPpm()) < 2.0);
+    QVERIFY(sim.maxDriftUs < FRAME_US);
+    QVERIFY(std::abs(sim.syncErrorUs()) < SYNC_SLACK_US);
+}
+
+void TestRecordingClock::fastAudioOverAnHour() {
+    // 50 ppm over an hour is 180 ms more audio: ten or eleven frames
+    Simulation sim(50.0);
+    sim.run(3600 * SECOND_US);
+
+    QVERIFY2(std::abs(sim.clock.skewPpm() - 50.0) < 2.0,
+             qPrintable(QString::number(sim.clock.skewPpm())));
+    QVERIFY2(sim.repeats >= 10 && sim.repeats <= 11,
+             qPrintable(QString::number(sim.repeats)));
+    QCOMPARE(sim.drops, u64(0));
+    QCOMPARE(sim.clock.resyncs(), u64(0));
+    QVERIFY(sim.maxDriftUs < FRAME_US);
+    QVERIFY2(std::abs(sim.syncErrorUs()) < SYNC_SLACK_US,
+             qPrintable(QString::number(sim.syncErrorUs())));
+}
+
+void TestRecordingClock::slowAudioOverAnHour() {
+    Simulation sim(-50.0);
+    sim.run(3600 * SECOND_US);
+
+    QVERIFY(std::abs(sim.clock.skewPpm() + 50.0) < 2.0);
+    QCOMPARE(sim.repeats, u64(0));
+    QVERIFY2(sim.drops >= 10 && sim.drops <= 11,
+             qPrintable(QString::number(sim.drops)));
+    QVERIFY(std::abs(sim.syncErrorUs()) < SYNC_SLACK_US);
+}
+
+void TestRecordingClock::stallResyncs() {
+    // Two seconds without audio: the track has no gap, so the video drops
+    // two seconds of frames to meet it again
+    Simulation sim(0.0);
+    sim.run(30 * SECOND_US);
+    sim.run(32 * SECOND_US, true);
+    QCOMPARE(sim.clock.resyncs(), u64(0));
+    sim.run(600 * SECOND_US);
+
+    QCOMPARE(sim.clock.resyncs(), u64(1));
+    QVERIFY2(sim.drops >= 119 && sim.drops <= 121,
+             qPrintable(QString::number(sim.drops)));
+    QCOMPARE(sim.repeats, u64(0));
+    QVERIFY(std::abs(sim.clock.skewPpm()) < 2.0);
+    QVERIFY(std::abs(sim.syncErrorUs()) < SYNC_SLACK_US);
+}
+
+void TestRecordingClock::missedCapturesAreRepeated() {
+    // A ten-frame hitch every ten seconds, six times
+    Simulation sim(0.0);
+    sim.skip = [](u64 frame) {
+        return frame % 600 >= 300 && frame % 600 < 310;
+    };
+    sim.run(60 * SECOND_US);
+
+    QCOMPARE(sim.repeats, u64(60));
+    QCOMPARE(sim.drops, u64(0));
+    QVERIFY(std::abs(sim.syncErrorUs()) < SYNC_SLACK_US);
+}
+
+QTEST_MAIN(TestRecordingClock)
+#include "test_RecordingClock.moc"
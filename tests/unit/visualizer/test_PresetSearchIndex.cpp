@@ -0,0 +1,154 @@
+/**
+ * @file test_PresetSearchIndex.cpp
+ * @brief Ranked preset search, concurrent searches, and a 50k-preset benchmark
+ *
+ * The library is synthetic: names built from a fixed word list with a
+ * seeded generator, so every run sees the same 50,000 presets.
+ */
+#include "visualizer/PresetManager.hpp"
+#include "visualizer/PresetSearchIndex.hpp"
+
+#include <QtTest>
+#include <algorithm>
+#include <format>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace vc;
+
+class TestPresetSearchIndex : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void ranksExactPrefixWordSubstring();
+    void fuzzyFindsTypos();
+    void concurrentSearchesAgree();
+    void benchmarkFirstSearch();
+    void benchmarkSearch();
+
+private:
+    static std::vector<PresetInfo> library(usize count);
+    static PresetInfo preset(const std::string& name);
+
+    static constexpr usize LIBRARY_SIZE = 50'000;
+
+    std::vector<PresetInfo> presets_;
+    PresetSearchIndex index_;
+};
+
+PresetInfo TestPresetSearchIndex::preset(const std::string& name) {
+    PresetInfo info;
+    info.name = name;
+    info.category = "test";
+    info.path = "/presets/test/" + name + ".milk";
+    return info;
+}
+
+std::vector<PresetInfo> TestPresetSearchIndex::library(usize count) {
+    static const char* words[] = {
+            "fractal", "tunnel", "nebula", "spiral", "waves",  "geiss",
+            "plasma",  "vortex", "bloom",  "shader", "mirror", "cosmic",
+            "flux",    "grid",   "pulse",  "swirl",  "echo",   "prism"};
+    constexpr usize WORDS = std::size(words);
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<usize> word(0, WORDS - 1);
+    std::vector<PresetInfo> presets;
+    presets.reserve(count);
+    for (usize i = 0; i < count; ++i) {
+        presets.push_back(preset(std::format("{} - {} {} {}",
+                                             words[word(rng)],
+                                             words[word(rng)],
+                                             words[word(rng)],
+                                             i)));
+    }
+    std::sort(presets.begin(), presets.end(), [](const auto& a, const auto& b) {
+        return a.name < b.name;
+    });
+    return presets;
+}
+
+void TestPresetSearchIndex::initTestCase() {
+    presets_ = library(LIBRARY_SIZE);
+}
+
+void TestPresetSearchIndex::ranksExactPrefixWordSubstring() {
+    std::vector<PresetInfo> presets = {preset("a starburst"),
+                                       preset("burst"),
+                                       preset("burst of light"),
+                                       preset("starburst"),
+                                       preset("unrelated")};
+    PresetSearchIndex index;
+    index.build(presets);
+
+    auto hits = index.search("burst", false);
+    QCOMPARE(hits.size(), usize(4));
+    QCOMPARE(presets[hits[0]].name, std::string("burst"));          // Exact
+    QCOMPARE(presets[hits[1]].name, std::string("burst of light")); // Prefix
+    // Substrings, shorter name first
+    QCOMPARE(presets[hits[2]].name, std::string("starburst"));
+    QCOMPARE(presets[hits[3]].name, std::string("a starburst"));
+
+    QVERIFY(index.search("BURST", false) == hits);
+    QVERIFY(index.findName("starburst").has_value());
+    QVERIFY(!index.findName("Starburst").has_value());
+}
+
+void TestPresetSearchIndex::fuzzyFindsTypos() {
+    std::vector<PresetInfo> presets = {preset("kaleidoscope dreams"),
+                                       preset("nothing alike")};
+    PresetSearchIndex index;
+    index.build(presets);
+
+    QVERIFY(index.search("kaleidoscpe", false).empty());
+    auto hits = index.search("kaleidoscpe");
+    QCOMPARE(hits.size(), usize(1));
+    QCOMPARE(presets[hits[0]].name, std::string("kaleidoscope dreams"));
+}
+
+void TestPresetSearchIndex::concurrentSearchesAgree() {
+    // The trigram postings are built by whichever search gets there first
+    PresetSearchIndex index;
+    index.build(presets_);
+    const std::vector<std::string> queries = {
+            "fractal", "spiral tun", "geis", "plasmaa", "echo prism"};
+
+    std::vector<std::vector<std::vector<usize>>> results(4);
+    std::vector<std::thread> threads;
+    for (usize t = 0; t < results.size(); ++t) {
+        threads.emplace_back([&, t] {
+            for (const auto& query : queries)
+                results[t].push_back(index.search(query));
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    for (usize q = 0; q < queries.size(); ++q) {
+        auto expected = index.search(queries[q]);
+        for (const auto& perThread : results)
+            QVERIFY(perThread[q] == expected);
+    }
+}
+
+void TestPresetSearchIndex::benchmarkFirstSearch() {
+    // Includes building the trigram postings for the whole library
+    QBENCHMARK_ONCE {
+        index_.build(presets_);
+        auto hits = index_.search("fract");
+        QVERIFY(!hits.empty());
+    }
+}
+
+void TestPresetSearchIndex::benchmarkSearch() {
+    index_.build(presets_);
+    index_.prepare();
+    QBENCHMARK {
+        auto hits = index_.search("vortex bl");
+        QVERIFY(!hits.empty());
+    }
+}
+
+QTEST_MAIN(TestPresetSearchIndex)
+#include "test_PresetSearchIndex.moc"